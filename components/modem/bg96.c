@@ -13,11 +13,15 @@
 // limitations under the License.
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
+#include "esp_modem_identity.h"
+#include "esp_modem.h"
 #include "bg96.h"
 
 #define MODEM_RESULT_CODE_POWERDOWN "POWERED DOWN"
+#define BG96_BAND_CONFIG_ALL "F,400A0E189F,A0E189F" /*!< Factory band configuration: GSM, eMTC, NB-IoT */
 
 /**
  * @brief Macro defined for error checking
@@ -39,7 +43,6 @@ static const char *DCE_TAG = "bg96";
  *
  */
 typedef struct {
-    void *priv_resource; /*!< Private resource */
     modem_dce_t parent;  /*!< DCE parent class */
 } bg96_modem_dce_t;
 
@@ -49,14 +52,13 @@ typedef struct {
 static esp_err_t bg96_handle_csq(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
     if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
     } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     } else if (!strncmp(line, "+CSQ", strlen("+CSQ"))) {
         /* store value of rssi and ber */
-        uint32_t **csq = bg96_dce->priv_resource;
+        uint32_t **csq = dce->handle_line_ctx;
         /* +CSQ: <rssi>,<ber> */
         sscanf(line, "%*s%d,%d", csq[0], csq[1]);
         err = ESP_OK;
@@ -70,14 +72,13 @@ static esp_err_t bg96_handle_csq(modem_dce_t *dce, const char *line)
 static esp_err_t bg96_handle_cbc(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
     if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
     } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     } else if (!strncmp(line, "+CBC", strlen("+CBC"))) {
         /* store value of bcs, bcl, voltage */
-        uint32_t **cbc = bg96_dce->priv_resource;
+        uint32_t **cbc = dce->handle_line_ctx;
         /* +CBC: <bcs>,<bcl>,<voltage> */
         sscanf(line, "%*s%d,%d,%d", cbc[0], cbc[1], cbc[2]);
         err = ESP_OK;
@@ -102,7 +103,7 @@ static esp_err_t bg96_handle_exit_data_mode(modem_dce_t *dce, const char *line)
 }
 
 /**
- * @brief Handle response from ATD*99#
+ * @brief Handle response from ATD*99***<cid>#
  */
 static esp_err_t bg96_handle_atd_ppp(modem_dce_t *dce, const char *line)
 {
@@ -178,6 +179,47 @@ static esp_err_t bg96_handle_cimi(modem_dce_t *dce, const char *line)
     return err;
 }
 
+/**
+ * @brief Handle response from AT+QCCID
+ */
+static esp_err_t bg96_handle_qccid(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+QCCID", strlen("+QCCID"))) {
+        /* +QCCID: <iccid> */
+        if (sscanf(line, "%*s%20s", dce->iccid) == 1) {
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+QNWINFO
+ */
+static esp_err_t bg96_handle_qnwinfo(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    int *band = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+QNWINFO", strlen("+QNWINFO"))) {
+        /* +QNWINFO: <act>,<oper>,<band>,<channel>, e.g. "LTE BAND 20" */
+        const char *p = strstr(line, "LTE BAND ");
+        if (p) {
+            *band = atoi(p + strlen("LTE BAND "));
+        }
+        err = ESP_OK;
+    }
+    return err;
+}
+
 /**
  * @brief Handle response from AT+COPS?
  */
@@ -204,10 +246,12 @@ static esp_err_t bg96_handle_cops(modem_dce_t *dce, const char *line)
             p[++i] = strtok_r(NULL, ",", &str_ptr);
         }
         if (i >= 3) {
-            int len = snprintf(dce->oper, MODEM_MAX_OPERATOR_LENGTH, "%s", p[2]);
+            char oper[MODEM_MAX_OPERATOR_LENGTH];
+            int len = snprintf(oper, sizeof(oper), "%s", p[2]);
             if (len > 2) {
                 /* Strip "\r\n" */
-                strip_cr_lf_tail(dce->oper, len);
+                strip_cr_lf_tail(oper, len);
+                esp_modem_identity_set_operator(dce, oper);
                 err = ESP_OK;
             }
         }
@@ -230,6 +274,98 @@ static esp_err_t bg96_handle_power_down(modem_dce_t *dce, const char *line)
     return err;
 }
 
+/**
+ * @brief Handle response from AT+QIACT?
+ */
+static esp_err_t bg96_handle_qiact(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    bool *active = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+QIACT", strlen("+QIACT"))) {
+        /* +QIACT: <contextID>,<context_state>,<context_type>,<IP_address>, one line per active context */
+        int cid = 0, state = 0;
+        if (sscanf(line, "%*s%d,%d", &cid, &state) == 2 && cid == dce->cid) {
+            *active = state == 1;
+        }
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+QIOPEN, done with "+QIOPEN: <connectID>,<err>" after OK
+ */
+static esp_err_t bg96_handle_qiopen(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    int *result = dce->handle_line_ctx;
+    if (!strncmp(line, "+QIOPEN", strlen("+QIOPEN"))) {
+        sscanf(line, "%*s%*d,%d", result);
+        err = esp_modem_process_command_done(dce, *result ? MODEM_STATE_FAIL : MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        /* Accepted, the connection result comes later */
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response to the payload of AT+QISEND
+ */
+static esp_err_t bg96_handle_qisend(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, "SEND OK")) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, "SEND FAIL") || strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+QIRD, the payload has been read after the header line
+ */
+static esp_err_t bg96_handle_qird(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+QIRD", strlen("+QIRD"))) {
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Track sockets, "+QIURC: "recv",<connectID>", "+QIURC: "closed",<connectID>" and "+QIURC: "pdpdeact",<contextID>"
+ */
+static void bg96_handle_qiurc(modem_dce_t *dce, const char *line, void *context)
+{
+    modem_socket_event_t event = {
+        .id = -1
+    };
+    if (sscanf(line, "+QIURC: \"recv\",%d", &event.id) == 1) {
+        event.closed = false;
+    } else if (sscanf(line, "+QIURC: \"closed\",%d", &event.id) == 1) {
+        event.closed = true;
+    } else if (strstr(line, "\"pdpdeact\"")) {
+        event.id = -1;
+        event.closed = true;
+    } else {
+        return;
+    }
+    esp_modem_post_event(dce->dte, ESP_MODEM_EVENT_SOCKET, &event, sizeof(event));
+}
+
 /**
  * @brief Get signal quality
  *
@@ -243,12 +379,9 @@ static esp_err_t bg96_handle_power_down(modem_dce_t *dce, const char *line)
 static esp_err_t bg96_get_signal_quality(modem_dce_t *dce, uint32_t *rssi, uint32_t *ber)
 {
     modem_dte_t *dte = dce->dte;
-    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
     uint32_t *resource[2] = {rssi, ber};
-    bg96_dce->priv_resource = resource;
-    dce->handle_line = bg96_handle_csq;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CSQ\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire signal quality failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT+CSQ\r", MODEM_COMMAND_TIMEOUT_DEFAULT, bg96_handle_csq, resource) == ESP_OK,
+              "inquire signal quality failed", err);
     ESP_LOGD(DCE_TAG, "inquire signal quality ok");
     return ESP_OK;
 err:
@@ -269,12 +402,9 @@ err:
 static esp_err_t bg96_get_battery_status(modem_dce_t *dce, uint32_t *bcs, uint32_t *bcl, uint32_t *voltage)
 {
     modem_dte_t *dte = dce->dte;
-    bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
     uint32_t *resource[3] = {bcs, bcl, voltage};
-    bg96_dce->priv_resource = resource;
-    dce->handle_line = bg96_handle_cbc;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CBC\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire battery status failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT+CBC\r", MODEM_COMMAND_TIMEOUT_DEFAULT, bg96_handle_cbc, resource) == ESP_OK,
+              "inquire battery status failed", err);
     ESP_LOGD(DCE_TAG, "inquire battery status ok");
     return ESP_OK;
 err:
@@ -293,19 +423,33 @@ err:
 static esp_err_t bg96_set_working_mode(modem_dce_t *dce, modem_mode_t mode)
 {
     modem_dte_t *dte = dce->dte;
+    char command[24];
     switch (mode) {
     case MODEM_COMMAND_MODE:
-        dce->handle_line = bg96_handle_exit_data_mode;
-        DCE_CHECK(dte->send_cmd(dte, "+++", MODEM_COMMAND_TIMEOUT_MODE_CHANGE) == ESP_OK, "send command failed", err);
-        DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "enter command mode failed", err);
+        /* Dropping DTR is immediate, the escape sequence needs a guard time on each side */
+        if (!dce->dtr_switch || esp_modem_dce_suspend_data_mode(dce) != ESP_OK) {
+            DCE_CHECK(dte->send_cmd(dte, "+++", MODEM_COMMAND_TIMEOUT_MODE_CHANGE,
+                                    bg96_handle_exit_data_mode, NULL) == ESP_OK,
+                      "enter command mode failed", err);
+        }
         ESP_LOGD(DCE_TAG, "enter command mode ok");
         dce->mode = MODEM_COMMAND_MODE;
         break;
     case MODEM_PPP_MODE:
-        dce->handle_line = bg96_handle_atd_ppp;
-        DCE_CHECK(dte->send_cmd(dte, "ATD*99***1#\r", MODEM_COMMAND_TIMEOUT_MODE_CHANGE) == ESP_OK, "send command failed", err);
-        DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "enter ppp mode failed", err);
+        if (dce->data_suspended) {
+            /* The data call is still up, no need to dial and negotiate again, the DTE dials if it was lost */
+            DCE_CHECK(esp_modem_dce_resume_data_mode(dce) == ESP_OK, "data call lost", err);
+            ESP_LOGD(DCE_TAG, "resume ppp mode ok");
+            dce->data_suspended = false;
+            dce->mode = MODEM_PPP_MODE;
+            break;
+        }
+        /* Dial the selected PDP context */
+        snprintf(command, sizeof(command), "ATD*99***%d#\r", dce->cid);
+        DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_MODE_CHANGE, bg96_handle_atd_ppp, NULL) == ESP_OK,
+                  "enter ppp mode failed", err);
         ESP_LOGD(DCE_TAG, "enter ppp mode ok");
+        dce->data_suspended = false;
         dce->mode = MODEM_PPP_MODE;
         break;
     default:
@@ -329,9 +473,8 @@ err:
 static esp_err_t bg96_power_down(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
-    dce->handle_line = bg96_handle_power_down;
-    DCE_CHECK(dte->send_cmd(dte, "AT+QPOWD=1\r", MODEM_COMMAND_TIMEOUT_POWEROFF) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "power down failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT+QPOWD=1\r", MODEM_COMMAND_TIMEOUT_POWEROFF, bg96_handle_power_down, NULL) == ESP_OK,
+              "power down failed", err);
     ESP_LOGD(DCE_TAG, "power down ok");
     return ESP_OK;
 err:
@@ -341,17 +484,16 @@ err:
 /**
  * @brief Get DCE module name
  *
- * @param bg96_dce bg96 object
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t bg96_get_module_name(bg96_modem_dce_t *bg96_dce)
+static esp_err_t bg96_get_module_name(modem_dce_t *dce)
 {
-    modem_dte_t *dte = bg96_dce->parent.dte;
-    bg96_dce->parent.handle_line = bg96_handle_cgmm;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CGMM\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(bg96_dce->parent.state == MODEM_STATE_SUCCESS, "get module name failed", err);
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CGMM\r", MODEM_COMMAND_TIMEOUT_DEFAULT, bg96_handle_cgmm, NULL) == ESP_OK,
+              "get module name failed", err);
     ESP_LOGD(DCE_TAG, "get module name ok");
     return ESP_OK;
 err:
@@ -361,17 +503,16 @@ err:
 /**
  * @brief Get DCE module IMEI number
  *
- * @param bg96_dce bg96 object
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t bg96_get_imei_number(bg96_modem_dce_t *bg96_dce)
+static esp_err_t bg96_get_imei_number(modem_dce_t *dce)
 {
-    modem_dte_t *dte = bg96_dce->parent.dte;
-    bg96_dce->parent.handle_line = bg96_handle_cgsn;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CGSN\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(bg96_dce->parent.state == MODEM_STATE_SUCCESS, "get imei number failed", err);
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CGSN\r", MODEM_COMMAND_TIMEOUT_DEFAULT, bg96_handle_cgsn, NULL) == ESP_OK,
+              "get imei number failed", err);
     ESP_LOGD(DCE_TAG, "get imei number ok");
     return ESP_OK;
 err:
@@ -381,43 +522,257 @@ err:
 /**
  * @brief Get DCE module IMSI number
  *
- * @param bg96_dce bg96 object
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t bg96_get_imsi_number(bg96_modem_dce_t *bg96_dce)
+static esp_err_t bg96_get_imsi_number(modem_dce_t *dce)
 {
-    modem_dte_t *dte = bg96_dce->parent.dte;
-    bg96_dce->parent.handle_line = bg96_handle_cimi;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CIMI\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(bg96_dce->parent.state == MODEM_STATE_SUCCESS, "get imsi number failed", err);
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CIMI\r", MODEM_COMMAND_TIMEOUT_DEFAULT, bg96_handle_cimi, NULL) == ESP_OK,
+              "get imsi number failed", err);
     ESP_LOGD(DCE_TAG, "get imsi number ok");
     return ESP_OK;
 err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Get ICCID number of the SIM card
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_get_iccid_number(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+QCCID\r", MODEM_COMMAND_TIMEOUT_DEFAULT, bg96_handle_qccid, NULL) == ESP_OK,
+              "get iccid number failed", err);
+    ESP_LOGD(DCE_TAG, "get iccid number ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 /**
  * @brief Get Operator's name
  *
- * @param bg96_dce bg96 object
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t bg96_get_operator_name(bg96_modem_dce_t *bg96_dce)
+static esp_err_t bg96_get_operator_name(modem_dce_t *dce)
 {
-    modem_dte_t *dte = bg96_dce->parent.dte;
-    bg96_dce->parent.handle_line = bg96_handle_cops;
-    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK, "send command failed", err);
-    DCE_CHECK(bg96_dce->parent.state == MODEM_STATE_SUCCESS, "get network operator failed", err);
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR, bg96_handle_cops, NULL) == ESP_OK,
+              "get network operator failed", err);
     ESP_LOGD(DCE_TAG, "get network operator ok");
     return ESP_OK;
 err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Get band configuration restricted to the serving LTE band
+ *
+ * @param dce Modem DCE object
+ * @param hint buffer for the band configuration
+ * @param len length of buffer
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error or when not served by LTE
+ */
+static esp_err_t bg96_get_band_hint(modem_dce_t *dce, char *hint, size_t len)
+{
+    modem_dte_t *dte = dce->dte;
+    int band = 0;
+    DCE_CHECK(dte->send_cmd(dte, "AT+QNWINFO\r", MODEM_COMMAND_TIMEOUT_DEFAULT, bg96_handle_qnwinfo, &band) == ESP_OK,
+              "get network information failed", err);
+    DCE_CHECK(band > 0 && band <= 64, "not served by LTE", err);
+    /* GSM bands unchanged, same LTE band for eMTC and NB-IoT */
+    uint64_t mask = 1ULL << (band - 1);
+    snprintf(hint, len, "0,%" PRIX64 ",%" PRIX64, mask, mask);
+    ESP_LOGD(DCE_TAG, "get band hint ok: %s", hint);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Set band configuration
+ *
+ * @param dce Modem DCE object
+ * @param config band configuration, NULL for all bands
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_set_band_config(modem_dce_t *dce, const char *config)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[64];
+    int len = snprintf(command, sizeof(command), "AT+QCFG=\"band\",%s,1\r", config ? config : BG96_BAND_CONFIG_ALL);
+    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set band configuration failed", err);
+    ESP_LOGD(DCE_TAG, "set band configuration ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Bring the IP stack of the module up or down (AT+QICSGP, AT+QIACT), with socket events tracked
+ *
+ * @param dce Modem DCE object
+ * @param on true to activate the context of the APN, false to deactivate it
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_set_socket_stack(modem_dce_t *dce, bool on)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[MODEM_MAX_APN_LENGTH + 32];
+    bool active = false;
+    esp_modem_unregister_urc_handler(dte, bg96_handle_qiurc, dce);
+    if (!on) {
+        snprintf(command, sizeof(command), "AT+QIDEACT=%d\r", dce->cid);
+        DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET,
+                                esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+                  "deactivate ip stack failed", err);
+        ESP_LOGD(DCE_TAG, "deactivate ip stack ok");
+        return ESP_OK;
+    }
+    DCE_CHECK(esp_modem_register_urc_handler(dte, "+QIURC:", bg96_handle_qiurc, dce) == ESP_OK,
+              "register +QIURC handler failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT+QIACT?\r", MODEM_COMMAND_TIMEOUT_DEFAULT, bg96_handle_qiact, &active) == ESP_OK,
+              "get ip stack state failed", err_urc);
+    if (!active) {
+        snprintf(command, sizeof(command), "AT+QICSGP=%d,1,\"%s\"\r", dce->cid, dce->apn);
+        DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                                esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+                  "set context failed", err_urc);
+        snprintf(command, sizeof(command), "AT+QIACT=%d\r", dce->cid);
+        DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET,
+                                esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+                  "activate ip stack failed", err_urc);
+    }
+    ESP_LOGD(DCE_TAG, "activate ip stack ok");
+    return ESP_OK;
+err_urc:
+    esp_modem_unregister_urc_handler(dte, bg96_handle_qiurc, dce);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Connect a socket of the module (AT+QIOPEN), in buffer access mode
+ *
+ * @param dce Modem DCE object
+ * @param id connection identifier, 0 to 11
+ * @param type TCP or UDP
+ * @param host host name or address of the peer
+ * @param port port of the peer
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_socket_open(modem_dce_t *dce, int id, modem_socket_type_t type, const char *host, uint16_t port)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[128];
+    int result = -1;
+    int len = snprintf(command, sizeof(command), "AT+QIOPEN=%d,%d,\"%s\",\"%s\",%d,0,0\r", dce->cid, id,
+                       type == MODEM_SOCKET_UDP ? "UDP" : "TCP", host, port);
+    DCE_CHECK(len < sizeof(command), "host name too long: %s", err, host);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET, bg96_handle_qiopen, &result) == ESP_OK,
+              "open socket %d failed, error %d", err, id, result);
+    ESP_LOGD(DCE_TAG, "open socket %d ok", id);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Send on a socket of the module (AT+QISEND)
+ *
+ * @param dce Modem DCE object
+ * @param id connection identifier
+ * @param data data to send
+ * @param length length of data, at most MODEM_SOCKET_PAYLOAD_MAX
+ * @return int length of data sent, -1 on error
+ */
+static int bg96_socket_send(modem_dce_t *dce, int id, const void *data, size_t length)
+{
+    char command[32];
+    snprintf(command, sizeof(command), "AT+QISEND=%d,%d\r", id, length);
+    DCE_CHECK(esp_modem_send_payload(dce->dte, command, ">", data, length, MODEM_COMMAND_TIMEOUT_SOCKET_DATA,
+                                     bg96_handle_qisend, NULL) == ESP_OK,
+              "send on socket %d failed", err, id);
+    return length;
+err:
+    return -1;
+}
+
+/**
+ * @brief Read what arrived on a socket of the module (AT+QIRD)
+ *
+ * @param dce Modem DCE object
+ * @param id connection identifier
+ * @param buffer buffer of the data
+ * @param length size of buffer, at most MODEM_SOCKET_PAYLOAD_MAX
+ * @return int length of data read, 0 if none arrived, -1 on error
+ */
+static int bg96_socket_recv(modem_dce_t *dce, int id, void *buffer, size_t length)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[32];
+    /* +QIRD: <read_actual_length>[,<remoteIP>,<remote_port>] then the data on the next line */
+    esp_modem_payload_t payload = {
+        .prefix = "+QIRD:",
+        .same_line = false,
+        .buffer = buffer,
+        .size = length
+    };
+    snprintf(command, sizeof(command), "AT+QIRD=%d,%d\r", id, length);
+    DCE_CHECK(esp_modem_expect_payload(dte, &payload) == ESP_OK, "expect payload failed", err);
+    esp_err_t res = dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET_DATA, bg96_handle_qird, NULL);
+    esp_modem_expect_payload(dte, NULL);
+    DCE_CHECK(res == ESP_OK, "read socket %d failed", err, id);
+    return payload.received;
+err:
+    return -1;
+}
+
+/**
+ * @brief Close a socket of the module (AT+QICLOSE)
+ *
+ * @param dce Modem DCE object
+ * @param id connection identifier
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t bg96_socket_close(modem_dce_t *dce, int id)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[32];
+    snprintf(command, sizeof(command), "AT+QICLOSE=%d\r", id);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET_DATA,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "close socket %d failed", err, id);
+    ESP_LOGD(DCE_TAG, "close socket %d ok", id);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 /**
  * @brief Deinitialize BG96 object
  *
@@ -430,18 +785,25 @@ static esp_err_t bg96_deinit(modem_dce_t *dce)
 {
     bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
     if (dce->dte) {
+        esp_modem_unregister_urc_handler(dce->dte, bg96_handle_qiurc, dce);
+        esp_modem_dce_untrack_power_save(dce);
         dce->dte->dce = NULL;
     }
     free(bg96_dce);
     return ESP_OK;
 }
 
-modem_dce_t *bg96_init(modem_dte_t *dte)
+modem_dce_t *bg96_init(modem_dte_t *dte, const esp_modem_dce_config_t *config)
 {
     DCE_CHECK(dte, "DCE should bind with a DTE", err);
+    DCE_CHECK(config && config->apn, "invalid config", err);
+    DCE_CHECK(strlen(config->apn) < MODEM_MAX_APN_LENGTH, "apn too long: %s", err, config->apn);
+    DCE_CHECK(config->cid >= 1 && config->cid <= MODEM_MAX_PDP_CID, "invalid cid: %d", err, config->cid);
     /* malloc memory for bg96_dce object */
     bg96_modem_dce_t *bg96_dce = calloc(1, sizeof(bg96_modem_dce_t));
     DCE_CHECK(bg96_dce, "calloc bg96_dce failed", err);
+    strcpy(bg96_dce->parent.apn, config->apn);
+    bg96_dce->parent.cid = config->cid;
     /* Bind DTE with DCE */
     bg96_dce->parent.dte = dte;
     dte->dce = &(bg96_dce->parent);
@@ -456,22 +818,38 @@ modem_dce_t *bg96_init(modem_dte_t *dte)
     bg96_dce->parent.get_signal_quality = bg96_get_signal_quality;
     bg96_dce->parent.get_battery_status = bg96_get_battery_status;
     bg96_dce->parent.set_working_mode = bg96_set_working_mode;
+    bg96_dce->parent.get_module_name = bg96_get_module_name;
+    bg96_dce->parent.get_imei_number = bg96_get_imei_number;
+    bg96_dce->parent.get_imsi_number = bg96_get_imsi_number;
+    bg96_dce->parent.get_iccid_number = bg96_get_iccid_number;
+    bg96_dce->parent.get_operator_name = bg96_get_operator_name;
+    bg96_dce->parent.get_band_hint = bg96_get_band_hint;
+    bg96_dce->parent.set_band_config = bg96_set_band_config;
+    bg96_dce->parent.set_psm = esp_modem_dce_set_psm;
+    bg96_dce->parent.set_edrx = esp_modem_dce_set_edrx;
+    bg96_dce->parent.get_power_save = esp_modem_dce_get_power_save;
+    /* AT+CNMPSD is SIMCom only and the BG96 has no release assistance command, release is left to the network */
+    bg96_dce->parent.release_connection = NULL;
+    bg96_dce->parent.set_socket_stack = bg96_set_socket_stack;
+    bg96_dce->parent.socket_open = bg96_socket_open;
+    bg96_dce->parent.socket_send = bg96_socket_send;
+    bg96_dce->parent.socket_recv = bg96_socket_recv;
+    bg96_dce->parent.socket_close = bg96_socket_close;
     bg96_dce->parent.power_down = bg96_power_down;
     bg96_dce->parent.deinit = bg96_deinit;
+    DCE_CHECK(esp_modem_dce_track_power_save(&(bg96_dce->parent)) == ESP_OK, "track power save failed", err_track);
+    esp_modem_timeline_begin(dte, ESP_MODEM_PHASE_OPEN);
     /* Sync between DTE and DCE */
     DCE_CHECK(esp_modem_dce_sync(&(bg96_dce->parent)) == ESP_OK, "sync failed", err_io);
     /* Close echo */
     DCE_CHECK(esp_modem_dce_echo(&(bg96_dce->parent), false) == ESP_OK, "close echo mode failed", err_io);
-    /* Get Module name */
-    DCE_CHECK(bg96_get_module_name(bg96_dce) == ESP_OK, "get module name failed", err_io);
-    /* Get IMEI number */
-    DCE_CHECK(bg96_get_imei_number(bg96_dce) == ESP_OK, "get imei failed", err_io);
-    /* Get IMSI number */
-    DCE_CHECK(bg96_get_imsi_number(bg96_dce) == ESP_OK, "get imsi failed", err_io);
-    /* Get operator name */
-    DCE_CHECK(bg96_get_operator_name(bg96_dce) == ESP_OK, "get operator name failed", err_io);
+    /* Identity comes from the cache on warm boot, otherwise it is queried on first access */
+    esp_modem_identity_restore(&(bg96_dce->parent));
+    esp_modem_timeline_end(dte, ESP_MODEM_PHASE_OPEN);
     return &(bg96_dce->parent);
 err_io:
+    esp_modem_dce_untrack_power_save(&(bg96_dce->parent));
+err_track:
     free(bg96_dce);
 err:
     return NULL;
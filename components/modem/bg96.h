@@ -24,9 +24,10 @@ extern "C" {
  * @brief Create and initialize BG96 object
  *
  * @param dte Modem DTE object
+ * @param config APN, the GPIOs of the module are not used
  * @return modem_dce_t* Modem DCE object
  */
-modem_dce_t *bg96_init(modem_dte_t *dte);
+modem_dce_t *bg96_init(modem_dte_t *dte, const esp_modem_dce_config_t *config);
 
 #ifdef __cplusplus
 }
@@ -17,13 +17,32 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
 #include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_cmux.h"
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
 #include "sdkconfig.h"
 
-#define ESP_MODEM_LINE_BUFFER_SIZE (CONFIG_EXAMPLE_UART_RX_BUFFER_SIZE / 2)
 #define ESP_MODEM_EVENT_QUEUE_SIZE (16)
+#define ESP_MODEM_ASYNC_QUEUE_SIZE (4)
+#define ESP_MODEM_ASYNC_COMMAND_MAX_LENGTH (64)
+#define ESP_MODEM_DTR_DROP_MS (50)
+#define ESP_MODEM_QUIESCE_TIMEOUT_MS (500)
+#define ESP_MODEM_URC_HANDLER_MAX (20)
+#define ESP_MODEM_URC_PREFIX_MAX_LENGTH (16)
+#define ESP_MODEM_PAYLOAD_TIMEOUT_MS (1000)
+#define ESP_MODEM_PAYLOAD_SCRAP_SIZE (32)
+#define ESP_MODEM_PROMPT_LINE_MAX_LENGTH (128)
+#define ESP_MODEM_PROMPT_ESCAPE (0x1B)
+#define ESP_MODEM_HDLC_FLAG (0x7E)
+#define ESP_MODEM_CMUX_N1 (127)
+#define ESP_MODEM_CMUX_N1_DEFAULT (31)
+#define ESP_MODEM_CMUX_DLC_MAX (3)
+#define ESP_MODEM_CMUX_DLC_NONE (0xFF)
+#define ESP_MODEM_CMUX_TIMEOUT_MS (1000)
 
 #define MIN_PATTERN_INTERVAL (9)
 #define MIN_POST_IDLE (0)
@@ -46,6 +65,31 @@ static const char *MODEM_TAG = "esp-modem";
 
 ESP_EVENT_DEFINE_BASE(ESP_MODEM_EVENT);
 
+/* The GPIO ISR service is shared, only uninstalled by the last DTE using it, if a DTE installed it */
+static uint32_t s_isr_service_users;
+static bool s_isr_service_owned;
+
+/**
+ * @brief Command queued for asynchronous execution
+ *
+ */
+typedef struct {
+    char command[ESP_MODEM_ASYNC_COMMAND_MAX_LENGTH]; /*!< Command string */
+    uint32_t timeout;                                 /*!< Timeout value, unit: ms */
+    modem_async_handler_t handler;                    /*!< Handler for response lines */
+    void *context;                                    /*!< Context passed to handler */
+} esp_modem_async_cmd_t;
+
+/**
+ * @brief Handler registered for an unsolicited result code
+ *
+ */
+typedef struct {
+    char prefix[ESP_MODEM_URC_PREFIX_MAX_LENGTH]; /*!< Start of the lines to handle */
+    esp_modem_urc_handler_t handler;              /*!< Handler, NULL if the entry is free */
+    void *context;                                /*!< Context passed to handler */
+} esp_modem_urc_entry_t;
+
 /**
  * @brief ESP32 Modem DTE
  *
@@ -53,10 +97,42 @@ ESP_EVENT_DEFINE_BASE(ESP_MODEM_EVENT);
 typedef struct {
     uart_port_t uart_port;                  /*!< UART port */
     uint8_t *buffer;                        /*!< Internal buffer to store response lines/data from DCE */
+    int line_buffer_size;                   /*!< Size of buffer, and of the line buffers of the multiplexer */
+    int pattern_queue_size;                 /*!< Size of the UART pattern queue */
     QueueHandle_t event_queue;              /*!< UART event queue handle */
     esp_event_loop_handle_t event_loop_hdl; /*!< Event loop handle */
     TaskHandle_t uart_event_task_hdl;       /*!< UART event task handle */
     SemaphoreHandle_t process_sem;          /*!< Semaphore used for indicating processing status */
+    SemaphoreHandle_t quiesce_sem;          /*!< Given by the UART event task once parked */
+    volatile bool quiesce;                  /*!< Request the UART event task to park */
+    SemaphoreHandle_t cmd_lock;             /*!< Mutex serializing commands on the AT channel */
+    QueueHandle_t async_queue;              /*!< Queue of pending asynchronous commands */
+    esp_modem_async_cmd_t async_cmd;        /*!< Asynchronous command in flight */
+    bool async_active;                      /*!< Whether an asynchronous command is in flight */
+    TickType_t async_deadline;              /*!< Tick count when the command in flight times out */
+    int dtr_pin;                            /*!< DTR GPIO, -1 if not wired */
+    int dcd_pin;                            /*!< DCD GPIO, -1 if not wired */
+    bool dcd_follows_carrier;               /*!< DCD set to follow the carrier (AT&C1) */
+    volatile bool dcd_dropped;              /*!< Set by the DCD interrupt, checked by the UART event task */
+    bool hdlc_idle;                         /*!< Data stream between HDLC frames */
+    uint8_t no_carrier_matched;             /*!< Characters of "NO CARRIER" matched between HDLC frames */
+    uint32_t baud_rate;                     /*!< Baud rate of the UART */
+    bool cmux;                              /*!< UART runs the 27.010 multiplexer */
+    bool cmux_data;                         /*!< Data channel in data mode */
+    bool cmux_dv;                           /*!< Data valid seen in the modem status of the data channel */
+    bool cmux_ack;                          /*!< Answer to the last channel request, set by the UART event task */
+    uint8_t cmux_wait_dlci;                 /*!< Channel waiting for an answer, ESP_MODEM_CMUX_DLC_NONE if none */
+    TaskHandle_t cmux_dial_task;            /*!< Task dialing on the data channel, its commands go there */
+    uint16_t cmux_n1;                       /*!< Max length of the information field */
+    uint8_t *cmux_buffer;                   /*!< Information field and lines of the channels */
+    esp_modem_cmux_decoder_t cmux_decoder;  /*!< Frame decoder */
+    char *cmux_line[ESP_MODEM_CMUX_DLC_MAX];        /*!< Line being received on each channel */
+    size_t cmux_line_len[ESP_MODEM_CMUX_DLC_MAX];   /*!< Length of the line being received */
+    esp_modem_timeline_t timeline;          /*!< Boot to IP timeline */
+    esp_modem_urc_entry_t urc[ESP_MODEM_URC_HANDLER_MAX]; /*!< Handlers of unsolicited result codes */
+    SemaphoreHandle_t urc_lock;             /*!< Recursive mutex of the handler table, held while handlers run */
+    esp_modem_payload_t *volatile payload;  /*!< Payload expected after a header line, NULL if none */
+    uint32_t stale_patterns;                /*!< Pattern events left for line feeds already read as payload */
     modem_dte_t parent;                     /*!< DTE interface that should extend */
     esp_modem_on_receive receive_cb;        /*!< ptr to data reception */
     void *receive_cb_ctx;                   /*!< ptr to rx fn context data */
@@ -71,24 +147,62 @@ esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb,
     return ESP_OK;
 }
 
+/**
+ * @brief Pass a line to the handlers of unsolicited result codes
+ *
+ * @param esp_dte ESP modem DTE object
+ * @param line line string
+ * @return true if at least one handler took the line
+ */
+static bool esp_dte_handle_urc(esp_modem_dte_t *esp_dte, const char *line)
+{
+    bool handled = false;
+    /* Held while the handlers run, an unregistered handler is not running anymore once unregister returned */
+    xSemaphoreTakeRecursive(esp_dte->urc_lock, portMAX_DELAY);
+    for (int i = 0; i < ESP_MODEM_URC_HANDLER_MAX; i++) {
+        esp_modem_urc_entry_t *entry = &esp_dte->urc[i];
+        if (entry->handler && !strncmp(line, entry->prefix, strlen(entry->prefix))) {
+            entry->handler(esp_dte->parent.dce, line, entry->context);
+            handled = true;
+        }
+    }
+    xSemaphoreGiveRecursive(esp_dte->urc_lock);
+    return handled;
+}
+
 /**
  * @brief Handle one line in DTE
  *
  * @param esp_dte ESP modem DTE object
+ * @param line line string
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte)
+static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte, const char *line)
 {
     modem_dce_t *dce = esp_dte->parent.dce;
     MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    const char *line = (const char *)(esp_dte->buffer);
     /* Skip pure "\r\n" lines */
     if (strlen(line) > 2) {
         ESP_LOGD(MODEM_TAG, "modem>>: %s", line);
-        MODEM_CHECK(dce->handle_line, "no handler for line", err_handle);
-        MODEM_CHECK(dce->handle_line(dce, line) == ESP_OK, "handle line failed", err_handle);
+        /* A module in PSM sends nothing, handlers of sleep codes then set the state they report */
+        esp_modem_dce_wake_up(dce);
+        /* Unsolicited result codes may come at any time, even within the answer to a command */
+        bool urc = esp_dte_handle_urc(esp_dte, line);
+        if (esp_dte->async_active) {
+            if (esp_dte->async_cmd.handler(dce, line, esp_dte->async_cmd.context)) {
+                esp_dte->async_active = false;
+                xSemaphoreGive(esp_dte->cmd_lock);
+            }
+            return ESP_OK;
+        }
+        if (!urc) {
+            MODEM_CHECK(dce->handle_line, "no handler for line", err_handle);
+            MODEM_CHECK(dce->handle_line(dce, line) == ESP_OK, "handle line failed", err_handle);
+        } else if (dce->handle_line) {
+            dce->handle_line(dce, line);
+        }
     }
     return ESP_OK;
 err_handle:
@@ -99,6 +213,71 @@ err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Read the payload announced by a header line as is
+ *
+ * The header line already holds the payload up to its first line feed, if on the same line. The
+ * rest is read from the UART, what does not fit in the buffer is dropped. The UART still reports
+ * the line feeds read as payload, these pattern events are left to be ignored.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param line_len length of the header line
+ */
+static void esp_dte_read_payload(esp_modem_dte_t *esp_dte, size_t line_len)
+{
+    esp_modem_payload_t *payload = esp_dte->payload;
+    char *line = (char *)esp_dte->buffer;
+    char *end = NULL;
+    long length = strtol(line + strlen(payload->prefix), &end, 10);
+    size_t start = line_len;
+    if (payload->same_line && *end == ',') {
+        start = end + 1 - line;
+    }
+    /* Armed for one header line */
+    esp_dte->payload = NULL;
+    payload->length = length > 0 ? length : 0;
+    /* A line is cut before its line feed only when the buffer is full */
+    bool cut = line[line_len - 1] != '\n';
+    size_t in_line = MIN(line_len - start, payload->length);
+    payload->received = MIN(in_line, payload->size);
+    memcpy(payload->buffer, line + start, payload->received);
+    line[start] = '\0';
+    size_t left = payload->length - in_line;
+    uint32_t line_feeds = 0;
+    uint8_t scrap[ESP_MODEM_PAYLOAD_SCRAP_SIZE];
+    while (left) {
+        bool room = payload->received < payload->size;
+        uint8_t *pos = room ? payload->buffer + payload->received : scrap;
+        size_t chunk = MIN(left, room ? payload->size - payload->received : sizeof(scrap));
+        int len = uart_read_bytes(esp_dte->uart_port, pos, chunk, pdMS_TO_TICKS(ESP_MODEM_PAYLOAD_TIMEOUT_MS));
+        if (len <= 0) {
+            ESP_LOGE(MODEM_TAG, "payload cut short, %d bytes missing", left);
+            payload->length -= left;
+            break;
+        }
+        for (int i = 0; i < len; i++) {
+            line_feeds += pos[i] == '\n';
+        }
+        if (room) {
+            payload->received += len;
+        }
+        left -= len;
+    }
+    if (payload->received < payload->length) {
+        ESP_LOGW(MODEM_TAG, "payload of %d bytes truncated to %d", payload->length, payload->received);
+    }
+    if (cut && line_feeds) {
+        /* The line feed of the current event was part of the payload */
+        line_feeds--;
+    } else if (cut) {
+        /* It ends the payload, read it too so that its position leaves the pattern queue */
+        uint8_t c = 0;
+        while (c != '\n' && uart_read_bytes(esp_dte->uart_port, &c, 1, pdMS_TO_TICKS(ESP_MODEM_PAYLOAD_TIMEOUT_MS)) == 1) {
+        }
+    }
+    esp_dte->stale_patterns += line_feeds;
+}
+
 /**
  * @brief Handle when a pattern has been detected by UART
  *
@@ -109,28 +288,335 @@ static void esp_handle_uart_pattern(esp_modem_dte_t *esp_dte)
     int pos = uart_pattern_pop_pos(esp_dte->uart_port);
     int read_len = 0;
     if (pos != -1) {
-        if (pos < ESP_MODEM_LINE_BUFFER_SIZE - 1) {
+        if (pos < esp_dte->line_buffer_size - 1) {
             /* read one line(include '\n') */
             read_len = pos + 1;
         } else {
             ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
-            read_len = ESP_MODEM_LINE_BUFFER_SIZE - 1;
+            read_len = esp_dte->line_buffer_size - 1;
         }
         read_len = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, read_len, pdMS_TO_TICKS(100));
         if (read_len) {
             /* make sure the line is a standard string */
             esp_dte->buffer[read_len] = '\0';
+            esp_modem_payload_t *payload = esp_dte->payload;
+            if (payload && !strncmp((const char *)esp_dte->buffer, payload->prefix, strlen(payload->prefix))) {
+                esp_dte_read_payload(esp_dte, read_len);
+            }
             /* Send new line to handle */
-            esp_dte_handle_line(esp_dte);
+            esp_dte_handle_line(esp_dte, (const char *)esp_dte->buffer);
         } else {
             ESP_LOGE(MODEM_TAG, "uart read bytes failed");
         }
+    } else if (esp_dte->stale_patterns) {
+        /* Line feed of a payload, its position already left the queue */
+        esp_dte->stale_patterns--;
     } else {
         ESP_LOGW(MODEM_TAG, "Pattern Queue Size too small");
         uart_flush(esp_dte->uart_port);
     }
 }
 
+/**
+ * @brief Look for the NO CARRIER result code between HDLC frames
+ *
+ * The DCE prints the result code after the closing flag of the last frame. Inside a frame it can
+ * not be taken for one: a frame starts with the address field 0xFF or, compressed, an odd protocol
+ * byte which is neither CR, LF nor 'N'.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data received data
+ * @param length length of data
+ * @return true if the result code has been found
+ */
+static bool esp_dte_scan_no_carrier(esp_modem_dte_t *esp_dte, const uint8_t *data, size_t length)
+{
+    static const char no_carrier[] = MODEM_RESULT_CODE_NO_CARRIER;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = data[i];
+        if (c == ESP_MODEM_HDLC_FLAG) {
+            esp_dte->hdlc_idle = true;
+            esp_dte->no_carrier_matched = 0;
+        } else if (!esp_dte->hdlc_idle) {
+            continue;
+        } else if (c == no_carrier[esp_dte->no_carrier_matched]) {
+            if (++esp_dte->no_carrier_matched == sizeof(no_carrier) - 1) {
+                esp_dte->no_carrier_matched = 0;
+                return true;
+            }
+        } else if (esp_dte->no_carrier_matched || (c != '\r' && c != '\n')) {
+            /* Start of a frame */
+            esp_dte->hdlc_idle = false;
+            esp_dte->no_carrier_matched = 0;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Drop pending input and detect lines again
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_enter_line_mode(esp_modem_dte_t *esp_dte)
+{
+    uart_disable_rx_intr(esp_dte->uart_port);
+    uart_flush_input(esp_dte->uart_port);
+    xQueueReset(esp_dte->event_queue);
+    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    uart_pattern_queue_reset(esp_dte->uart_port, esp_dte->pattern_queue_size);
+    esp_dte->stale_patterns = 0;
+}
+
+/**
+ * @brief Follow the DCE back to command mode after the network dropped the data call
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param reason how the loss has been detected
+ */
+static void esp_dte_handle_carrier_loss(esp_modem_dte_t *esp_dte, esp_modem_carrier_loss_t reason)
+{
+    modem_dce_t *dce = esp_dte->parent.dce;
+    static const char *const sources[] = {"no carrier", "dcd", "msc"};
+    ESP_LOGW(MODEM_TAG, "carrier lost (%s)", sources[reason]);
+    if (esp_dte->cmux) {
+        /* Only the data channel left data mode, the multiplexer keeps running */
+        esp_dte->cmux_data = false;
+    } else {
+        /* The DCE left data mode on its own, only the line mode of the DTE has to follow */
+        esp_dte_enter_line_mode(esp_dte);
+    }
+    dce->mode = MODEM_COMMAND_MODE;
+    dce->data_suspended = false;
+    /* Tear down the netif now rather than after LCP or TCP timeouts */
+    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_STOP, NULL, 0, 0);
+    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_CARRIER_LOST, &reason, sizeof(reason), 0);
+}
+
+/**
+ * @brief Take the GPIO ISR service, installed by the first DTE unless the application did
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_take_isr_service(void)
+{
+    esp_err_t res = gpio_install_isr_service(0);
+    MODEM_CHECK(res == ESP_OK || res == ESP_ERR_INVALID_STATE, "install gpio isr service failed", err);
+    if (res == ESP_OK) {
+        s_isr_service_owned = true;
+    }
+    s_isr_service_users++;
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Give the GPIO ISR service back, uninstalled with its last user if installed here
+ */
+static void esp_dte_give_isr_service(void)
+{
+    if (--s_isr_service_users == 0 && s_isr_service_owned) {
+        gpio_uninstall_isr_service();
+        s_isr_service_owned = false;
+    }
+}
+
+/**
+ * @brief DCD interrupt, the line goes high (inactive) when the carrier is lost
+ *
+ * @param arg ESP32 Modem DTE object
+ */
+static void IRAM_ATTR esp_dte_dcd_isr_handler(void *arg)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)arg;
+    uart_event_t wake = {
+        .type = UART_EVENT_MAX
+    };
+    BaseType_t task_woken = pdFALSE;
+    esp_dte->dcd_dropped = true;
+    xQueueSendFromISR(esp_dte->event_queue, &wake, &task_woken);
+    if (task_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * @brief Send bytes on a channel of the multiplexer, in frames of at most N1 bytes
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci channel
+ * @param data data buffer
+ * @param length length of data
+ * @return int length of data sent, -1 on error
+ */
+static int esp_dte_cmux_write(esp_modem_dte_t *esp_dte, uint8_t dlci, const void *data, size_t length)
+{
+    uint8_t frame[ESP_MODEM_CMUX_N1 + ESP_MODEM_CMUX_FRAME_OVERHEAD];
+    const uint8_t *pos = data;
+    size_t left = length;
+    do {
+        size_t chunk = MIN(left, esp_dte->cmux_n1);
+        size_t len = esp_modem_cmux_encode(dlci, ESP_MODEM_CMUX_UIH, true, pos, chunk, frame);
+        /* One write per frame, so that frames sent by other tasks do not interleave */
+        if (uart_write_bytes(esp_dte->uart_port, (const char *)frame, len) < 0) {
+            return -1;
+        }
+        pos += chunk;
+        left -= chunk;
+    } while (left);
+    return length;
+}
+
+/**
+ * @brief Send a command on the AT channel, in frames when the multiplexer runs
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param command command string
+ * @return int length of data sent, -1 on error
+ */
+static int esp_dte_write_cmd(esp_modem_dte_t *esp_dte, const char *command)
+{
+    if (esp_dte->cmux) {
+        /* Chosen with the command lock held, commands of other tasks stay on the AT channel while dialing */
+        uint8_t dlci = esp_dte->cmux_dial_task == xTaskGetCurrentTaskHandle() ?
+                       ESP_MODEM_CMUX_DLC_DATA : ESP_MODEM_CMUX_DLC_AT;
+        return esp_dte_cmux_write(esp_dte, dlci, command, strlen(command));
+    }
+    return uart_write_bytes(esp_dte->uart_port, command, strlen(command));
+}
+
+/**
+ * @brief Handle PPP data received on the data channel
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data received data
+ * @param length length of data
+ */
+static void esp_dte_handle_cmux_data(esp_modem_dte_t *esp_dte, const uint8_t *data, size_t length)
+{
+    bool no_carrier = esp_dte_scan_no_carrier(esp_dte, data, length);
+    if (esp_dte->receive_cb) {
+        esp_dte->receive_cb((void *)data, length, esp_dte->receive_cb_ctx);
+    }
+    if (no_carrier && esp_dte->parent.dce && esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
+        esp_dte_handle_carrier_loss(esp_dte, ESP_MODEM_CARRIER_LOSS_NO_CARRIER);
+    }
+}
+
+/**
+ * @brief Assemble lines received on a channel in command mode
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci channel
+ * @param data received data
+ * @param length length of data
+ */
+static void esp_dte_handle_cmux_text(esp_modem_dte_t *esp_dte, uint8_t dlci, const uint8_t *data, size_t length)
+{
+    char *line = esp_dte->cmux_line[dlci];
+    size_t *len = &esp_dte->cmux_line_len[dlci];
+    for (size_t i = 0; i < length; i++) {
+        /* Lines too long for the buffer are truncated */
+        if (*len < esp_dte->line_buffer_size - 1) {
+            line[(*len)++] = data[i];
+        }
+        if (data[i] != '\n') {
+            continue;
+        }
+        line[*len] = '\0';
+        *len = 0;
+        /* The rest of the frame already is PPP data, and the dial command returns on this line */
+        bool connect = dlci == ESP_MODEM_CMUX_DLC_DATA && strstr(line, MODEM_RESULT_CODE_CONNECT);
+        if (connect) {
+            esp_dte->cmux_data = true;
+            esp_dte->cmux_dv = false;
+            esp_dte->hdlc_idle = true;
+            esp_dte->no_carrier_matched = 0;
+        }
+        esp_dte_handle_line(esp_dte, line);
+        if (connect) {
+            esp_dte_handle_cmux_data(esp_dte, data + i + 1, length - i - 1);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Handle a message on the control channel of the multiplexer
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param info information field
+ * @param length length of the information field
+ */
+static void esp_dte_handle_cmux_control(esp_modem_dte_t *esp_dte, const uint8_t *info, size_t length)
+{
+    /* Type, length and values, the length fits in one byte as N1 is below 128 */
+    if (length < 2) {
+        return;
+    }
+    uint8_t type = info[0] & ~(ESP_MODEM_CMUX_CR | ESP_MODEM_CMUX_EA);
+    bool command = info[0] & ESP_MODEM_CMUX_CR;
+    if (type == ESP_MODEM_CMUX_MSC && command && length >= 4) {
+        /* Acknowledge with the same values */
+        uint8_t response[4] = {info[0] & ~ESP_MODEM_CMUX_CR, info[1], info[2], info[3]};
+        esp_dte_cmux_write(esp_dte, ESP_MODEM_CMUX_DLC_CONTROL, response, sizeof(response));
+        if ((info[2] >> 2) != ESP_MODEM_CMUX_DLC_DATA || !esp_dte->cmux_data) {
+            return;
+        }
+        /* Some DCEs never set data valid, only its fall is taken for a carrier loss */
+        if (info[3] & ESP_MODEM_CMUX_V24_DV) {
+            esp_dte->cmux_dv = true;
+        } else if (esp_dte->cmux_dv && esp_dte->parent.dce && esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
+            esp_dte->cmux_dv = false;
+            esp_dte_handle_carrier_loss(esp_dte, ESP_MODEM_CARRIER_LOSS_MSC);
+        }
+    } else if (type == ESP_MODEM_CMUX_CLD && !command && esp_dte->cmux_wait_dlci == ESP_MODEM_CMUX_DLC_CONTROL) {
+        esp_dte->cmux_ack = true;
+        esp_dte->cmux_wait_dlci = ESP_MODEM_CMUX_DLC_NONE;
+        xSemaphoreGive(esp_dte->process_sem);
+    }
+}
+
+/**
+ * @brief Handle a frame received from the multiplexer
+ *
+ * @param context ESP32 Modem DTE object
+ * @param dlci channel
+ * @param control control field
+ * @param info information field
+ * @param length length of the information field
+ */
+static void esp_dte_handle_cmux_frame(void *context, uint8_t dlci, uint8_t control, const uint8_t *info, size_t length)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)context;
+    switch (control & ~ESP_MODEM_CMUX_PF) {
+    case ESP_MODEM_CMUX_UA:
+    case ESP_MODEM_CMUX_DM:
+        if (dlci == esp_dte->cmux_wait_dlci) {
+            esp_dte->cmux_ack = (control & ~ESP_MODEM_CMUX_PF) == ESP_MODEM_CMUX_UA;
+            esp_dte->cmux_wait_dlci = ESP_MODEM_CMUX_DLC_NONE;
+            xSemaphoreGive(esp_dte->process_sem);
+        }
+        break;
+    case ESP_MODEM_CMUX_UIH:
+    case ESP_MODEM_CMUX_UI:
+        if (dlci == ESP_MODEM_CMUX_DLC_CONTROL) {
+            esp_dte_handle_cmux_control(esp_dte, info, length);
+        } else if (dlci == ESP_MODEM_CMUX_DLC_DATA && esp_dte->cmux_data) {
+            esp_dte_handle_cmux_data(esp_dte, info, length);
+        } else if (dlci < ESP_MODEM_CMUX_DLC_MAX) {
+            esp_dte_handle_cmux_text(esp_dte, dlci, info, length);
+        }
+        break;
+    default:
+        ESP_LOGD(MODEM_TAG, "cmux frame 0x%02x ignored on channel %d", control, dlci);
+        break;
+    }
+}
+
 /**
  * @brief Handle when new data received by UART
  *
@@ -140,9 +626,13 @@ static void esp_handle_uart_data(esp_modem_dte_t *esp_dte)
 {
     size_t length = 0;
     uart_get_buffered_data_len(esp_dte->uart_port, &length);
-    length = MIN(ESP_MODEM_LINE_BUFFER_SIZE, length);
+    length = MIN(esp_dte->line_buffer_size, length);
     length = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, length, portMAX_DELAY);
     /* pass the input data to configured callback */
+    if (length && esp_dte->cmux) {
+        esp_modem_cmux_decode(&esp_dte->cmux_decoder, esp_dte->buffer, length, esp_dte_handle_cmux_frame, esp_dte);
+        return;
+    }
     if (length) {
         ESP_LOGD(MODEM_TAG, "handle_uart_data #1, len %d", length);
         ESP_LOG_BUFFER_HEXDUMP(MODEM_TAG, esp_dte->buffer, length, ESP_LOG_INFO);   // After that, it's crash when receive_cb == NULL
@@ -150,12 +640,52 @@ static void esp_handle_uart_data(esp_modem_dte_t *esp_dte)
             ESP_LOGD(MODEM_TAG, "handle_uart_data #2, callback method is NULL");
         }
         assert(esp_dte->receive_cb);
+        bool no_carrier = esp_dte_scan_no_carrier(esp_dte, esp_dte->buffer, length);
         esp_dte->receive_cb(esp_dte->buffer, length, esp_dte->receive_cb_ctx);
         ESP_LOGD(MODEM_TAG, "handle_uart_data #3");
+        if (no_carrier && esp_dte->parent.dce && esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
+            esp_dte_handle_carrier_loss(esp_dte, ESP_MODEM_CARRIER_LOSS_NO_CARRIER);
+        }
     }
     ESP_LOGD(MODEM_TAG, "handle_uart_data #4");
 }
 
+/**
+ * @brief Start or expire asynchronous commands
+ *
+ * Commands are only started while the AT channel is idle, i.e. in command mode,
+ * or at any time under the multiplexer, with no synchronous command pending.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_handle_async_cmd(esp_modem_dte_t *esp_dte)
+{
+    modem_dce_t *dce = esp_dte->parent.dce;
+    if (esp_dte->async_active) {
+        if ((int32_t)(xTaskGetTickCount() - esp_dte->async_deadline) >= 0) {
+            ESP_LOGW(MODEM_TAG, "async command timeout: %s", esp_dte->async_cmd.command);
+            esp_dte->async_active = false;
+            esp_dte->async_cmd.handler(dce, NULL, esp_dte->async_cmd.context);
+            xSemaphoreGive(esp_dte->cmd_lock);
+        }
+        return;
+    }
+    if (!dce || (dce->mode != MODEM_COMMAND_MODE && !esp_dte->cmux) || dce->handle_line) {
+        return;
+    }
+    if (!uxQueueMessagesWaiting(esp_dte->async_queue) || xSemaphoreTake(esp_dte->cmd_lock, 0) != pdTRUE) {
+        return;
+    }
+    if (xQueueReceive(esp_dte->async_queue, &esp_dte->async_cmd, 0) != pdTRUE) {
+        xSemaphoreGive(esp_dte->cmd_lock);
+        return;
+    }
+    esp_dte->async_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(esp_dte->async_cmd.timeout);
+    esp_dte->async_active = true;
+    esp_dte_write_cmd(esp_dte, esp_dte->async_cmd.command);
+    ESP_LOGD(MODEM_TAG, "modem<< (async): %s", esp_dte->async_cmd.command);
+}
+
 /**
  * @brief UART Event Task Entry
  *
@@ -166,6 +696,12 @@ static void uart_event_task_entry(void *param)
     esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
     uart_event_t event;
     while (1) {
+        if (esp_dte->quiesce) {
+            /* Park until the DTE has been reset, nothing of the UART is touched meanwhile */
+            xSemaphoreGive(esp_dte->quiesce_sem);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
         if (xQueueReceive(esp_dte->event_queue, &event, pdMS_TO_TICKS(100))) {
             switch (event.type) {
             case UART_DATA:
@@ -175,11 +711,13 @@ static void uart_event_task_entry(void *param)
                 ESP_LOGW(MODEM_TAG, "HW FIFO Overflow");
                 uart_flush_input(esp_dte->uart_port);
                 xQueueReset(esp_dte->event_queue);
+                esp_dte->stale_patterns = 0;
                 break;
             case UART_BUFFER_FULL:
                 ESP_LOGW(MODEM_TAG, "Ring Buffer Full");
                 uart_flush_input(esp_dte->uart_port);
                 xQueueReset(esp_dte->event_queue);
+                esp_dte->stale_patterns = 0;
                 break;
             case UART_BREAK:
                 ESP_LOGW(MODEM_TAG, "Rx Break");
@@ -193,46 +731,169 @@ static void uart_event_task_entry(void *param)
             case UART_PATTERN_DET:
                 esp_handle_uart_pattern(esp_dte);
                 break;
+            case UART_EVENT_MAX:
+                /* Wake up posted by esp_modem_dte_quiesce() or the DCD interrupt */
+                if (esp_dte->dcd_dropped) {
+                    esp_dte->dcd_dropped = false;
+                    /* Ignore glitches, and the drop that follows a hang up */
+                    if (!esp_dte->cmux && gpio_get_level(esp_dte->dcd_pin) && esp_dte->parent.dce &&
+                            esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
+                        esp_dte_handle_carrier_loss(esp_dte, ESP_MODEM_CARRIER_LOSS_DCD);
+                    }
+                }
+                break;
             default:
                 ESP_LOGW(MODEM_TAG, "unknown uart event type: %d", event.type);
                 break;
             }
         }
+        esp_handle_async_cmd(esp_dte);
         /* Drive the event loop */
         esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(50));
     }
     vTaskDelete(NULL);
 }
 
+/**
+ * @brief Take the command lock and install the handler of a command
+ *
+ * The handler and the state of the DCE belong to the command holding the lock, they are only
+ * touched with it held.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param handler handler for response lines, called from the DTE task
+ * @param context context of handler, as dce->handle_line_ctx
+ */
+static void esp_dte_begin_cmd(esp_modem_dte_t *esp_dte, modem_line_handler_t handler, void *context)
+{
+    modem_dce_t *dce = esp_dte->parent.dce;
+    /* Wait for any command in flight, an asynchronous one is bounded by its own timeout */
+    xSemaphoreTake(esp_dte->cmd_lock, portMAX_DELAY);
+    dce->handle_line_ctx = context;
+    dce->handle_line = handler;
+    dce->state = MODEM_STATE_PROCESSING;
+}
+
+/**
+ * @brief Take the result of a command, then remove its handler and give the command lock back
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param done whether the command has been processed in time
+ * @return esp_err_t
+ *      - ESP_OK if the DCE answered with success
+ *      - ESP_ERR_TIMEOUT if it did not answer in time
+ *      - ESP_FAIL if it answered with an error
+ */
+static esp_err_t esp_dte_end_cmd(esp_modem_dte_t *esp_dte, bool done)
+{
+    modem_dce_t *dce = esp_dte->parent.dce;
+    esp_err_t ret = !done ? ESP_ERR_TIMEOUT : dce->state == MODEM_STATE_SUCCESS ? ESP_OK : ESP_FAIL;
+    dce->handle_line = NULL;
+    dce->handle_line_ctx = NULL;
+    xSemaphoreGive(esp_dte->cmd_lock);
+    return ret;
+}
+
 /**
  * @brief Send command to DCE
  *
  * @param dte Modem DTE object
  * @param command command string
  * @param timeout timeout value, unit: ms
+ * @param handler handler for response lines, called from the DTE task
+ * @param context context of handler, as dce->handle_line_ctx
  * @return esp_err_t
  *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the DCE did not answer in time
  *      - ESP_FAIL on error
  */
-static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout,
+                                        modem_line_handler_t handler, void *context)
 {
-    esp_err_t ret = ESP_FAIL;
-    modem_dce_t *dce = dte->dce;
-    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dte->dce, "DTE has not yet bind with DCE", err);
     MODEM_CHECK(command, "command is NULL", err);
+    MODEM_CHECK(handler, "handler is NULL", err);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    /* Calculate timeout clock tick */
-    /* Reset runtime information */
-    dce->state = MODEM_STATE_PROCESSING;
+    esp_dte_begin_cmd(esp_dte, handler, context);
     /* Send command via UART */
-    uart_write_bytes(esp_dte->uart_port, command, strlen(command));
+    esp_dte_write_cmd(esp_dte, command);
     ESP_LOGD(MODEM_TAG, "modem<<: %s", command);
-    /* Check timeout */
-    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE, "process command timeout", err);
-    ret = ESP_OK;
+    bool done = xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE;
+    if (!done) {
+        ESP_LOGE(MODEM_TAG, "process command timeout: %s", command);
+    }
+    return esp_dte_end_cmd(esp_dte, done);
 err:
-    dce->handle_line = NULL;
-    return ret;
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Drop DTR and wait for the result code from DCE
+ *
+ * @param dte Modem DTE object
+ * @param timeout timeout value, unit: ms
+ * @param handler handler for response lines, called from the DTE task
+ * @param context context of handler, as dce->handle_line_ctx
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED if DTR is not wired
+ *      - ESP_ERR_TIMEOUT if the DCE did not answer in time
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_pulse_dtr(modem_dte_t *dte, uint32_t timeout, modem_line_handler_t handler,
+        void *context)
+{
+    MODEM_CHECK(dte->dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(handler, "handler is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    /* Under the multiplexer the DTR line is shared by all channels */
+    if (esp_dte->dtr_pin < 0 || esp_dte->cmux) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    esp_dte_begin_cmd(esp_dte, handler, context);
+    /* DTR is active low, an ON to OFF transition is a high pulse */
+    gpio_set_level(esp_dte->dtr_pin, 1);
+    vTaskDelay(pdMS_TO_TICKS(ESP_MODEM_DTR_DROP_MS));
+    gpio_set_level(esp_dte->dtr_pin, 0);
+    ESP_LOGD(MODEM_TAG, "modem<<: DTR drop");
+    bool done = xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE;
+    if (!done) {
+        ESP_LOGE(MODEM_TAG, "process dtr drop timeout");
+    }
+    return esp_dte_end_cmd(esp_dte, done);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Queue a command to be sent once the AT channel is idle
+ *
+ * @param dte Modem DTE object
+ * @param command command string
+ * @param timeout timeout value, unit: ms
+ * @param handler handler for response lines, called from the DTE task
+ * @param context context passed to handler
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_send_cmd_async(modem_dte_t *dte, const char *command, uint32_t timeout,
+        modem_async_handler_t handler, void *context)
+{
+    MODEM_CHECK(command, "command is NULL", err);
+    MODEM_CHECK(handler, "handler is NULL", err);
+    MODEM_CHECK(strlen(command) < ESP_MODEM_ASYNC_COMMAND_MAX_LENGTH, "command too long: %s", err, command);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_async_cmd_t cmd = {
+        .timeout = timeout,
+        .handler = handler,
+        .context = context
+    };
+    strcpy(cmd.command, command);
+    MODEM_CHECK(xQueueSend(esp_dte->async_queue, &cmd, 0) == pdTRUE, "async queue full", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
 }
 
 /**
@@ -247,6 +908,10 @@ static int esp_modem_dte_send_data(modem_dte_t *dte, const char *data, uint32_t
 {
     MODEM_CHECK(data, "data is NULL", err);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (esp_dte->cmux) {
+        /* Out of data mode the frames would be taken for commands, drop them as the DCE would */
+        return esp_dte->cmux_data ? esp_dte_cmux_write(esp_dte, ESP_MODEM_CMUX_DLC_DATA, data, length) : length;
+    }
     return uart_write_bytes(esp_dte->uart_port, data, length);
 err:
     return -1;
@@ -270,6 +935,7 @@ static esp_err_t esp_modem_dte_send_wait(modem_dte_t *dte, const char *data, uin
     MODEM_CHECK(data, "data is NULL", err_param);
     MODEM_CHECK(prompt, "prompt is NULL", err_param);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(!esp_dte->cmux, "prompt not supported with cmux", err_param);
     // We'd better disable pattern detection here for a moment in case prompt string contains the pattern character
     uart_disable_pattern_det_intr(esp_dte->uart_port);
     // uart_disable_rx_intr(esp_dte->uart_port);
@@ -290,6 +956,63 @@ err_param:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Wait for the prompt of the DCE, with pattern detection disabled
+ *
+ * Lines before the prompt are not seen by the UART event task, unsolicited result codes among
+ * them are dispatched from here, on the calling task. Lines too long for the buffer are dropped.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param prompt prompt string
+ * @param timeout timeout value, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK if the prompt arrived
+ *      - ESP_FAIL on an error result code
+ *      - ESP_ERR_TIMEOUT on timeout
+ */
+static esp_err_t esp_dte_wait_prompt(esp_modem_dte_t *esp_dte, const char *prompt, uint32_t timeout)
+{
+    size_t len = strlen(prompt);
+    size_t matched = 0;
+    char line[ESP_MODEM_PROMPT_LINE_MAX_LENGTH];
+    size_t line_len = 0;
+    bool overflow = false;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t ticks = pdMS_TO_TICKS(timeout);
+    while (matched < len) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        uint8_t c;
+        if (elapsed >= ticks || uart_read_bytes(esp_dte->uart_port, &c, 1, ticks - elapsed) != 1) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (line_len < sizeof(line) - 1) {
+            line[line_len++] = c;
+        } else {
+            overflow = true;
+        }
+        /* Echo and line ends before the prompt are skipped, a refused command ends with ERROR */
+        if (c == '\n') {
+            line[line_len] = '\0';
+            if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+                ESP_LOGE(MODEM_TAG, "command refused: %s", line);
+                return ESP_FAIL;
+            }
+            /* Skip pure "\r\n" lines, as the UART event task does; urc_lock is recursive, taken from this task as well */
+            if (overflow) {
+                ESP_LOGW(MODEM_TAG, "line before prompt too long, dropped");
+            } else if (line_len > 2) {
+                ESP_LOGD(MODEM_TAG, "modem>>: %s", line);
+                esp_modem_dce_wake_up(esp_dte->parent.dce);
+                esp_dte_handle_urc(esp_dte, line);
+            }
+            line_len = 0;
+            overflow = false;
+        }
+        matched = c == prompt[matched] ? matched + 1 : c == prompt[0];
+    }
+    return ESP_OK;
+}
+
 /**
  * @brief Change Modem's working mode
  *
@@ -307,15 +1030,33 @@ static esp_err_t esp_modem_dte_change_mode(modem_dte_t *dte, modem_mode_t new_mo
     MODEM_CHECK(dce->mode != new_mode, "already in mode: %d", err, new_mode);
     switch (new_mode) {
     case MODEM_PPP_MODE:
+        if (esp_dte->cmux) {
+            /* Dial on the data channel, the UART event task follows it into data mode on CONNECT */
+            esp_dte->cmux_dial_task = xTaskGetCurrentTaskHandle();
+            esp_err_t res = dce->set_working_mode(dce, new_mode);
+            esp_dte->cmux_dial_task = NULL;
+            MODEM_CHECK(res == ESP_OK, "set new working mode:%d failed", err, new_mode);
+            break;
+        }
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err, new_mode);
+        esp_dte->hdlc_idle = true;
+        esp_dte->no_carrier_matched = 0;
         uart_disable_pattern_det_intr(esp_dte->uart_port);
         uart_enable_rx_intr(esp_dte->uart_port);
         break;
     case MODEM_COMMAND_MODE:
+        if (esp_dte->cmux) {
+            /* No escape on the data channel, the call is hung up from the AT channel */
+            esp_dte->cmux_data = false;
+            dce->mode = MODEM_COMMAND_MODE;
+            MODEM_CHECK(dce->hang_up(dce) == ESP_OK, "hang up failed", err);
+            break;
+        }
         uart_disable_rx_intr(esp_dte->uart_port);
         uart_flush(esp_dte->uart_port);
         uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-        uart_pattern_queue_reset(esp_dte->uart_port, CONFIG_EXAMPLE_UART_PATTERN_QUEUE_SIZE);
+        uart_pattern_queue_reset(esp_dte->uart_port, esp_dte->pattern_queue_size);
+        esp_dte->stale_patterns = 0;
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err, new_mode);
         break;
     default:
@@ -326,6 +1067,162 @@ err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Park the UART event task
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_quiesce(esp_modem_dte_t *esp_dte)
+{
+    uart_event_t wake = {
+        .type = UART_EVENT_MAX
+    };
+    esp_dte->quiesce = true;
+    /* Do not wait for the receive timeout of the task */
+    xQueueSend(esp_dte->event_queue, &wake, 0);
+    MODEM_CHECK(xSemaphoreTake(esp_dte->quiesce_sem, pdMS_TO_TICKS(ESP_MODEM_QUIESCE_TIMEOUT_MS)) == pdTRUE,
+                "uart event task not responding", err);
+    return ESP_OK;
+err:
+    esp_dte->quiesce = false;
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Free the buffers of the multiplexer and leave it
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_cmux_release(esp_modem_dte_t *esp_dte)
+{
+    esp_dte->cmux = false;
+    esp_dte->cmux_data = false;
+    esp_dte->cmux_wait_dlci = ESP_MODEM_CMUX_DLC_NONE;
+    free(esp_dte->cmux_buffer);
+    esp_dte->cmux_buffer = NULL;
+}
+
+/**
+ * @brief Open a channel of the multiplexer
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci channel
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_cmux_open(esp_modem_dte_t *esp_dte, uint8_t dlci)
+{
+    esp_err_t ret = ESP_FAIL;
+    uint8_t frame[ESP_MODEM_CMUX_FRAME_OVERHEAD];
+    xSemaphoreTake(esp_dte->cmd_lock, portMAX_DELAY);
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    esp_dte->cmux_ack = false;
+    esp_dte->cmux_wait_dlci = dlci;
+    size_t len = esp_modem_cmux_encode(dlci, ESP_MODEM_CMUX_SABM | ESP_MODEM_CMUX_PF, true, NULL, 0, frame);
+    uart_write_bytes(esp_dte->uart_port, (const char *)frame, len);
+    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(ESP_MODEM_CMUX_TIMEOUT_MS)) == pdTRUE,
+                "channel %d not answering", err, dlci);
+    MODEM_CHECK(esp_dte->cmux_ack, "channel %d refused", err, dlci);
+    if (dlci != ESP_MODEM_CMUX_DLC_CONTROL) {
+        /* Assert the virtual DTR and RTS of the channel, some DCEs hold back data until then */
+        uint8_t msc[4] = {
+            ESP_MODEM_CMUX_MSC | ESP_MODEM_CMUX_CR | ESP_MODEM_CMUX_EA, (2 << 1) | ESP_MODEM_CMUX_EA,
+            (dlci << 2) | ESP_MODEM_CMUX_CR | ESP_MODEM_CMUX_EA,
+            ESP_MODEM_CMUX_V24_DV | ESP_MODEM_CMUX_V24_RTR | ESP_MODEM_CMUX_V24_RTC | ESP_MODEM_CMUX_EA
+        };
+        esp_dte_cmux_write(esp_dte, ESP_MODEM_CMUX_DLC_CONTROL, msc, sizeof(msc));
+    }
+    ret = ESP_OK;
+err:
+    esp_dte->cmux_wait_dlci = ESP_MODEM_CMUX_DLC_NONE;
+    xSemaphoreGive(esp_dte->cmd_lock);
+    return ret;
+}
+
+/**
+ * @brief Close the multiplexer down and go back to line mode
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_cmux_close(esp_modem_dte_t *esp_dte)
+{
+    uint8_t cld[2] = {ESP_MODEM_CMUX_CLD | ESP_MODEM_CMUX_CR | ESP_MODEM_CMUX_EA, ESP_MODEM_CMUX_EA};
+    xSemaphoreTake(esp_dte->cmd_lock, portMAX_DELAY);
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    esp_dte->cmux_ack = false;
+    esp_dte->cmux_wait_dlci = ESP_MODEM_CMUX_DLC_CONTROL;
+    esp_dte_cmux_write(esp_dte, ESP_MODEM_CMUX_DLC_CONTROL, cld, sizeof(cld));
+    /* The DCE leaves the multiplexer whether it answers or not */
+    if (xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(ESP_MODEM_CMUX_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(MODEM_TAG, "cmux close down not acknowledged");
+    }
+    esp_dte->cmux_wait_dlci = ESP_MODEM_CMUX_DLC_NONE;
+    xSemaphoreGive(esp_dte->cmd_lock);
+    MODEM_CHECK(esp_modem_dte_quiesce(esp_dte) == ESP_OK, "quiesce failed", err);
+    esp_dte_enter_line_mode(esp_dte);
+    esp_dte_cmux_release(esp_dte);
+    esp_dte->quiesce = false;
+    xTaskNotifyGive(esp_dte->uart_event_task_hdl);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Reset a Modem DTE object after the DCE has restarted
+ *
+ * The UART driver, the event loop with its registered handlers and the buffers are kept.
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_reset(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    modem_dce_t *dce = dte->dce;
+    bool was_ppp = dce && dce->mode == MODEM_PPP_MODE;
+    MODEM_CHECK(esp_modem_dte_quiesce(esp_dte) == ESP_OK, "quiesce failed", err);
+    /* Drop whatever the previous life of the DCE left, and go back to line mode */
+    esp_dte_enter_line_mode(esp_dte);
+    esp_dte->buffer[0] = '\0';
+    /* The multiplexer did not survive the restart */
+    esp_dte_cmux_release(esp_dte);
+    if (esp_dte->dtr_pin >= 0) {
+        gpio_set_level(esp_dte->dtr_pin, 0);
+    }
+    /* The answer to an asynchronous command in flight will not come, let the task expire it as it holds the lock */
+    if (esp_dte->async_active) {
+        esp_dte->async_deadline = xTaskGetTickCount();
+    }
+    if (dce) {
+        /* Settings of the DCE are lost with its restart */
+        dce->mode = MODEM_COMMAND_MODE;
+        dce->dtr_switch = false;
+        dce->data_suspended = false;
+        /* Contexts may not have been stored, define them again on dial */
+        dce->pdp_defined = 0;
+    }
+    esp_dte->dcd_follows_carrier = false;
+    esp_dte->quiesce = false;
+    xTaskNotifyGive(esp_dte->uart_event_task_hdl);
+    if (was_ppp) {
+        esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_STOP, NULL, 0, 0);
+    }
+    ESP_LOGD(MODEM_TAG, "dte reset ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 static esp_err_t esp_modem_dte_process_cmd_done(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
@@ -343,16 +1240,26 @@ static esp_err_t esp_modem_dte_process_cmd_done(modem_dte_t *dte)
 static esp_err_t esp_modem_dte_deinit(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    /* Delete UART event task */
+    if (esp_dte->dcd_pin >= 0) {
+        gpio_isr_handler_remove(esp_dte->dcd_pin);
+        esp_dte_give_isr_service();
+    }
+    /* Delete UART event task, once parked so that it holds nothing */
+    esp_modem_dte_quiesce(esp_dte);
     vTaskDelete(esp_dte->uart_event_task_hdl);
     /* Delete semaphore */
     vSemaphoreDelete(esp_dte->process_sem);
+    vSemaphoreDelete(esp_dte->quiesce_sem);
+    vSemaphoreDelete(esp_dte->cmd_lock);
+    vSemaphoreDelete(esp_dte->urc_lock);
+    vQueueDelete(esp_dte->async_queue);
     /* Delete event loop */
     esp_event_loop_delete(esp_dte->event_loop_hdl);
     /* Uninstall UART Driver */
     uart_driver_delete(esp_dte->uart_port);
     /* Free memory */
     free(esp_dte->buffer);
+    free(esp_dte->cmux_buffer);
     if (dte->dce) {
         dte->dce->dte = NULL;
     }
@@ -367,16 +1274,23 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     esp_modem_dte_t *esp_dte = calloc(1, sizeof(esp_modem_dte_t));
     MODEM_CHECK(esp_dte, "calloc esp_dte failed", err_dte_mem);
     /* malloc memory to storing lines from modem dce */
-    esp_dte->buffer = calloc(1, ESP_MODEM_LINE_BUFFER_SIZE);
+    esp_dte->line_buffer_size = config->line_buffer_size;
+    esp_dte->pattern_queue_size = config->pattern_queue_size;
+    esp_dte->buffer = calloc(1, esp_dte->line_buffer_size);
     MODEM_CHECK(esp_dte->buffer, "calloc line memory failed", err_line_mem);
     /* Set attributes */
     esp_dte->uart_port = config->port_num;
+    esp_dte->baud_rate = config->baud_rate;
+    esp_dte->cmux_wait_dlci = ESP_MODEM_CMUX_DLC_NONE;
     esp_dte->parent.flow_ctrl = config->flow_control;
     /* Bind methods */
     esp_dte->parent.send_cmd = esp_modem_dte_send_cmd;
     esp_dte->parent.send_data = esp_modem_dte_send_data;
     esp_dte->parent.send_wait = esp_modem_dte_send_wait;
+    esp_dte->parent.send_cmd_async = esp_modem_dte_send_cmd_async;
+    esp_dte->parent.pulse_dtr = esp_modem_dte_pulse_dtr;
     esp_dte->parent.change_mode = esp_modem_dte_change_mode;
+    esp_dte->parent.reset = esp_modem_dte_reset;
     esp_dte->parent.process_cmd_done = esp_modem_dte_process_cmd_done;
     esp_dte->parent.deinit = esp_modem_dte_deinit;
 
@@ -390,32 +1304,48 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
         .flow_ctrl = (config->flow_control == MODEM_FLOW_CONTROL_HW) ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE
     };
     /* Install UART driver and get event queue used inside driver */
-    res = uart_driver_install(esp_dte->uart_port, CONFIG_EXAMPLE_UART_RX_BUFFER_SIZE, CONFIG_EXAMPLE_UART_TX_BUFFER_SIZE,
-                              CONFIG_EXAMPLE_UART_EVENT_QUEUE_SIZE, &(esp_dte->event_queue), 0);
+    res = uart_driver_install(esp_dte->uart_port, config->rx_buffer_size, config->tx_buffer_size,
+                              config->event_queue_size, &(esp_dte->event_queue), 0);
     MODEM_CHECK(res == ESP_OK, "install uart driver failed", err_uart_config);
 
     MODEM_CHECK(uart_param_config(esp_dte->uart_port, &uart_config) == ESP_OK, "config uart parameter failed", err_uart_config);
     if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
         ESP_LOGD(MODEM_TAG, "flow control is HW");
-        res = uart_set_pin(esp_dte->uart_port, CONFIG_EXAMPLE_UART_MODEM_TX_PIN, CONFIG_EXAMPLE_UART_MODEM_RX_PIN,
-                           CONFIG_EXAMPLE_UART_MODEM_RTS_PIN, CONFIG_EXAMPLE_UART_MODEM_CTS_PIN);
+        res = uart_set_pin(esp_dte->uart_port, config->tx_io_num, config->rx_io_num,
+                           config->rts_io_num, config->cts_io_num);
     } else {
         ESP_LOGD(MODEM_TAG, "flow control is DISABLE");
-        res = uart_set_pin(esp_dte->uart_port, CONFIG_EXAMPLE_UART_MODEM_TX_PIN, CONFIG_EXAMPLE_UART_MODEM_RX_PIN,
+        res = uart_set_pin(esp_dte->uart_port, config->tx_io_num, config->rx_io_num,
                            UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
     }
     MODEM_CHECK(res == ESP_OK, "config uart gpio failed", err_uart_config);
+    esp_dte->dtr_pin = config->dtr_io_num;
+    if (esp_dte->dtr_pin >= 0) {
+        /* Keep DTR asserted, it is only dropped to leave data mode */
+        gpio_pad_select_gpio(esp_dte->dtr_pin);
+        gpio_set_direction(esp_dte->dtr_pin, GPIO_MODE_OUTPUT);
+        gpio_set_level(esp_dte->dtr_pin, 0);
+    }
+    esp_dte->dcd_pin = config->dcd_io_num;
+    if (esp_dte->dcd_pin >= 0) {
+        /* DCD is active low, a rising edge in data mode means the carrier is gone */
+        gpio_pad_select_gpio(esp_dte->dcd_pin);
+        gpio_set_direction(esp_dte->dcd_pin, GPIO_MODE_INPUT);
+        gpio_set_pull_mode(esp_dte->dcd_pin, GPIO_PULLUP_ONLY);
+        gpio_set_intr_type(esp_dte->dcd_pin, GPIO_INTR_POSEDGE);
+        MODEM_CHECK(esp_dte_take_isr_service() == ESP_OK, "take gpio isr service failed", err_uart_config);
+    }
     /* Set flow control threshold */
     if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
         res = uart_set_hw_flow_ctrl(esp_dte->uart_port, UART_HW_FLOWCTRL_CTS_RTS, UART_FIFO_LEN - 8);
     } else if (config->flow_control == MODEM_FLOW_CONTROL_SW) {
         res = uart_set_sw_flow_ctrl(esp_dte->uart_port, true, 8, UART_FIFO_LEN - 8);
     }
-    MODEM_CHECK(res == ESP_OK, "config uart flow control failed", err_uart_config);
+    MODEM_CHECK(res == ESP_OK, "config uart flow control failed", err_uart_pattern);
     /* Set pattern interrupt, used to detect the end of a line. */
     res = uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
     /* Set pattern queue size */
-    res |= uart_pattern_queue_reset(esp_dte->uart_port, CONFIG_EXAMPLE_UART_PATTERN_QUEUE_SIZE);
+    res |= uart_pattern_queue_reset(esp_dte->uart_port, esp_dte->pattern_queue_size);
     MODEM_CHECK(res == ESP_OK, "config uart pattern failed", err_uart_pattern);
     /* Create Event loop */
     esp_event_loop_args_t loop_args = {
@@ -426,24 +1356,49 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     /* Create semaphore */
     esp_dte->process_sem = xSemaphoreCreateBinary();
     MODEM_CHECK(esp_dte->process_sem, "create process semaphore failed", err_sem);
+    esp_dte->quiesce_sem = xSemaphoreCreateBinary();
+    MODEM_CHECK(esp_dte->quiesce_sem, "create quiesce semaphore failed", err_quiesce_sem);
+    esp_dte->cmd_lock = xSemaphoreCreateMutex();
+    MODEM_CHECK(esp_dte->cmd_lock, "create command lock failed", err_lock);
+    esp_dte->urc_lock = xSemaphoreCreateRecursiveMutex();
+    MODEM_CHECK(esp_dte->urc_lock, "create urc lock failed", err_urc_lock);
+    esp_dte->async_queue = xQueueCreate(ESP_MODEM_ASYNC_QUEUE_SIZE, sizeof(esp_modem_async_cmd_t));
+    MODEM_CHECK(esp_dte->async_queue, "create async queue failed", err_async_queue);
     /* Create UART Event task */
     BaseType_t ret = xTaskCreate(uart_event_task_entry,             //Task Entry
                                  "uart_event",                      //Task Name
-                                 CONFIG_EXAMPLE_UART_EVENT_TASK_STACK_SIZE, //Task Stack Size(Bytes)
+                                 config->event_task_stack_size,     //Task Stack Size(Bytes)
                                  esp_dte,                           //Task Parameter
-                                 CONFIG_EXAMPLE_UART_EVENT_TASK_PRIORITY,   //Task Priority
+                                 config->event_task_priority,       //Task Priority
                                  & (esp_dte->uart_event_task_hdl)   //Task Handler
                                 );
     MODEM_CHECK(ret == pdTRUE, "create uart event task failed", err_tsk_create);
+    if (esp_dte->dcd_pin >= 0) {
+        MODEM_CHECK(gpio_isr_handler_add(esp_dte->dcd_pin, esp_dte_dcd_isr_handler, esp_dte) == ESP_OK,
+                    "add dcd isr handler failed", err_dcd_isr);
+    }
     return &(esp_dte->parent);
     /* Error handling */
+err_dcd_isr:
+    vTaskDelete(esp_dte->uart_event_task_hdl);
 err_tsk_create:
+    vQueueDelete(esp_dte->async_queue);
+err_async_queue:
+    vSemaphoreDelete(esp_dte->urc_lock);
+err_urc_lock:
+    vSemaphoreDelete(esp_dte->cmd_lock);
+err_lock:
+    vSemaphoreDelete(esp_dte->quiesce_sem);
+err_quiesce_sem:
     vSemaphoreDelete(esp_dte->process_sem);
 err_sem:
     esp_event_loop_delete(esp_dte->event_loop_hdl);
 err_eloop:
     uart_disable_pattern_det_intr(esp_dte->uart_port);
 err_uart_pattern:
+    if (esp_dte->dcd_pin >= 0) {
+        esp_dte_give_isr_service();
+    }
     uart_driver_delete(esp_dte->uart_port);
 err_uart_config:
     free(esp_dte->buffer);
@@ -465,15 +1420,146 @@ esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t h
     return esp_event_handler_unregister_with(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_EVENT_ANY_ID, handler);
 }
 
+esp_err_t esp_modem_post_event(modem_dte_t *dte, int32_t event_id, const void *event_data, size_t event_data_size)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, event_id, (void *)event_data, event_data_size,
+                             pdMS_TO_TICKS(100));
+}
+
+esp_err_t esp_modem_register_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_handler_t handler, void *context)
+{
+    MODEM_CHECK(prefix && handler, "invalid argument", err);
+    MODEM_CHECK(strlen(prefix) < ESP_MODEM_URC_PREFIX_MAX_LENGTH, "prefix too long: %s", err, prefix);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    xSemaphoreTakeRecursive(esp_dte->urc_lock, portMAX_DELAY);
+    for (int i = 0; i < ESP_MODEM_URC_HANDLER_MAX; i++) {
+        esp_modem_urc_entry_t *entry = &esp_dte->urc[i];
+        if (!entry->handler) {
+            strcpy(entry->prefix, prefix);
+            entry->context = context;
+            entry->handler = handler;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(esp_dte->urc_lock);
+    if (ret != ESP_OK) {
+        ESP_LOGE(MODEM_TAG, "no room for urc handler: %s", prefix);
+    }
+    return ret;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_unregister_urc_handler(modem_dte_t *dte, esp_modem_urc_handler_t handler, void *context)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    /* Waits for a dispatch in progress, the context may be freed once this returned */
+    xSemaphoreTakeRecursive(esp_dte->urc_lock, portMAX_DELAY);
+    for (int i = 0; i < ESP_MODEM_URC_HANDLER_MAX; i++) {
+        esp_modem_urc_entry_t *entry = &esp_dte->urc[i];
+        if (entry->handler == handler && entry->context == context) {
+            entry->handler = NULL;
+            ret = ESP_OK;
+        }
+    }
+    xSemaphoreGiveRecursive(esp_dte->urc_lock);
+    return ret;
+}
+
+esp_err_t esp_modem_send_payload(modem_dte_t *dte, const char *command, const char *prompt, const void *data,
+                                 size_t length, uint32_t timeout, modem_line_handler_t handler, void *context)
+{
+    MODEM_CHECK(dte->dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(command && prompt && (data || !length) && handler, "invalid argument", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (esp_dte->cmux) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    esp_dte_begin_cmd(esp_dte, handler, context);
+    /* The prompt does not end with a line feed, it is read here rather than by the UART event task */
+    uart_disable_pattern_det_intr(esp_dte->uart_port);
+    uart_write_bytes(esp_dte->uart_port, command, strlen(command));
+    ESP_LOGD(MODEM_TAG, "modem<<: %s", command);
+    esp_err_t prompted = esp_dte_wait_prompt(esp_dte, prompt, timeout);
+    if (prompted == ESP_OK) {
+        /* Through the ring buffer of the UART driver, which blocks while it is full */
+        uart_write_bytes(esp_dte->uart_port, data, length);
+        ESP_LOGD(MODEM_TAG, "modem<<: %d bytes of payload", length);
+    } else if (prompted == ESP_ERR_TIMEOUT) {
+        /* A late prompt would take the next command as payload, ESC cancels the input */
+        const char escape = ESP_MODEM_PROMPT_ESCAPE;
+        uart_write_bytes(esp_dte->uart_port, &escape, 1);
+    }
+    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    if (prompted != ESP_OK) {
+        ESP_LOGE(MODEM_TAG, "wait prompt [%s] failed", prompt);
+        esp_dte_end_cmd(esp_dte, false);
+        return prompted;
+    }
+    bool done = xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE;
+    if (!done) {
+        ESP_LOGE(MODEM_TAG, "process payload timeout");
+    }
+    return esp_dte_end_cmd(esp_dte, done);
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_expect_payload(modem_dte_t *dte, esp_modem_payload_t *payload)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (esp_dte->cmux) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (payload) {
+        MODEM_CHECK(payload->prefix && (payload->buffer || !payload->size), "invalid argument", err);
+        payload->length = 0;
+        payload->received = 0;
+    }
+    esp_dte->payload = payload;
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
 esp_err_t esp_modem_start_ppp(modem_dte_t *dte)
 {
     modem_dce_t *dce = dte->dce;
     MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    /* Set PDP Context */
-    MODEM_CHECK(dce->define_pdp_context(dce, 1, "IP", CONFIG_EXAMPLE_MODEM_APN) == ESP_OK, "set MODEM APN failed", err);
-    /* Enter PPP mode */
-    MODEM_CHECK(dte->change_mode(dte, MODEM_PPP_MODE) == ESP_OK, "enter ppp mode failed", err);
+    esp_modem_timeline_begin(dte, ESP_MODEM_PHASE_DIAL);
+    /* Set PDP Context, unless defined in a batch or a suspended data call already uses it */
+    if (!dce->data_suspended && !(dce->pdp_defined & (1U << dce->cid))) {
+        MODEM_CHECK(dce->define_pdp_context(dce, dce->cid, "IP", dce->apn) == ESP_OK, "set MODEM APN failed", err);
+    }
+    /* Leave data mode by DTR when wired, the escape sequence is the fallback */
+    if (esp_dte->dtr_pin >= 0 && !esp_dte->cmux && !dce->dtr_switch && esp_modem_dce_set_dtr_switch(dce, true) != ESP_OK) {
+        ESP_LOGW(MODEM_TAG, "dtr switch not supported, fall back to escape sequence");
+    }
+    /* Let DCD follow the carrier when wired, NO CARRIER in the data stream is the fallback */
+    if (esp_dte->dcd_pin >= 0 && !esp_dte->cmux && !esp_dte->dcd_follows_carrier) {
+        esp_dte->dcd_follows_carrier = esp_modem_dce_set_dcd_mode(dce, true) == ESP_OK;
+        if (!esp_dte->dcd_follows_carrier) {
+            ESP_LOGW(MODEM_TAG, "dcd mode not supported");
+        }
+    }
+    /* Enter PPP mode, dialing again if the suspended data call of a restored session was lost */
+    if (dte->change_mode(dte, MODEM_PPP_MODE) != ESP_OK) {
+        MODEM_CHECK(dce->data_suspended, "enter ppp mode failed", err);
+        ESP_LOGW(MODEM_TAG, "suspended data call lost, dial again");
+        dce->data_suspended = false;
+        if (!(dce->pdp_defined & (1U << dce->cid))) {
+            MODEM_CHECK(dce->define_pdp_context(dce, dce->cid, "IP", dce->apn) == ESP_OK, "set MODEM APN failed", err);
+        }
+        MODEM_CHECK(dte->change_mode(dte, MODEM_PPP_MODE) == ESP_OK, "enter ppp mode failed", err);
+    }
+    esp_modem_timeline_end(dte, ESP_MODEM_PHASE_DIAL);
+    /* PPP negotiation ends with the IP address, see esp_modem_netif */
+    esp_modem_timeline_begin(dte, ESP_MODEM_PHASE_PPP);
 
     /* post PPP mode started event */
     esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_START, NULL, 0, 0);
@@ -482,6 +1568,22 @@ err:
     return ESP_FAIL;
 }
 
+esp_err_t esp_modem_select_pdp_context(modem_dte_t *dte, uint32_t cid, const char *apn)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(cid >= 1 && cid <= MODEM_MAX_PDP_CID, "invalid cid: %d", err, cid);
+    MODEM_CHECK(!apn || strlen(apn) < MODEM_MAX_APN_LENGTH, "apn too long: %s", err, apn);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE && !dce->data_suspended, "data call up", err);
+    dce->cid = cid;
+    if (apn) {
+        strcpy(dce->apn, apn);
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 esp_err_t esp_modem_stop_ppp(modem_dte_t *dte)
 {
     modem_dce_t *dce = dte->dce;
@@ -490,11 +1592,227 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte)
 
     /* post PPP mode stopped event */
     esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_STOP, NULL, 0, 0);
-    /* Enter command mode */
-    MODEM_CHECK(dte->change_mode(dte, MODEM_COMMAND_MODE) == ESP_OK, "enter command mode failed", err);
+    /* Enter command mode, unless already there with the session suspended */
+    bool hung_up = false;
+    if (dce->mode != MODEM_COMMAND_MODE) {
+        MODEM_CHECK(dte->change_mode(dte, MODEM_COMMAND_MODE) == ESP_OK, "enter command mode failed", err);
+        /* Under the multiplexer, leaving data mode is the hang up */
+        hung_up = esp_dte->cmux;
+    }
+    dce->data_suspended = false;
     /* Hang up */
-    MODEM_CHECK(dce->hang_up(dce) == ESP_OK, "hang up failed", err);
+    if (!hung_up) {
+        MODEM_CHECK(dce->hang_up(dce) == ESP_OK, "hang up failed", err);
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_suspend_ppp(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dce->mode == MODEM_PPP_MODE, "not in ppp mode", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(!esp_dte->cmux, "not needed with cmux, commands have their own channel", err);
+    /* Hold back PPP frames from now on, they would be taken for commands */
+    dce->data_suspended = true;
+    MODEM_CHECK(dte->change_mode(dte, MODEM_COMMAND_MODE) == ESP_OK, "enter command mode failed", err_mode);
+    return ESP_OK;
+err_mode:
+    dce->data_suspended = false;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_resume_ppp(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dce->data_suspended, "ppp session not suspended", err);
+    if (dte->change_mode(dte, MODEM_PPP_MODE) == ESP_OK) {
+        return ESP_OK;
+    }
+    ESP_LOGW(MODEM_TAG, "suspended data call lost, dial again");
+    /* lwIP still holds the session of the lost call, stop it so that the new call negotiates from scratch */
+    esp_modem_post_event(dte, ESP_MODEM_EVENT_PPP_STOP, NULL, 0);
+    dce->data_suspended = false;
+    MODEM_CHECK(esp_modem_start_ppp(dte) == ESP_OK, "dial again failed", err);
     return ESP_OK;
 err:
     return ESP_FAIL;
 }
+
+esp_err_t esp_modem_release_connection(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    if (!dce->release_connection) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    /* Leaving data mode for the request would cost more than the release saves */
+    if (dce->mode == MODEM_PPP_MODE && !esp_dte->cmux) {
+        ESP_LOGD(MODEM_TAG, "no AT channel while ppp runs, release left to the network");
+        return ESP_ERR_INVALID_STATE;
+    }
+    MODEM_CHECK(dce->release_connection(dce) == ESP_OK, "release connection failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_start_cmux(modem_dte_t *dte)
+{
+    static const uint32_t port_speeds[] = {9600, 19200, 38400, 57600, 115200, 230400};
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(!esp_dte->cmux, "cmux already started", err);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE && !dce->data_suspended, "not in command mode", err);
+    /* Information field, then one line per channel able to carry commands */
+    esp_dte->cmux_buffer = calloc(1, ESP_MODEM_CMUX_N1 + (ESP_MODEM_CMUX_DLC_MAX - 1) * esp_dte->line_buffer_size);
+    MODEM_CHECK(esp_dte->cmux_buffer, "calloc cmux memory failed", err);
+    esp_modem_cmux_decoder_init(&esp_dte->cmux_decoder, esp_dte->cmux_buffer, ESP_MODEM_CMUX_N1);
+    for (int i = ESP_MODEM_CMUX_DLC_DATA; i < ESP_MODEM_CMUX_DLC_MAX; i++) {
+        esp_dte->cmux_line[i] = (char *)esp_dte->cmux_buffer + ESP_MODEM_CMUX_N1 +
+                                (i - ESP_MODEM_CMUX_DLC_DATA) * esp_dte->line_buffer_size;
+        esp_dte->cmux_line_len[i] = 0;
+    }
+    /* Basic option with UIH frames, the port speed is only given when the baud rate has a code */
+    char command[32] = "AT+CMUX=0\r";
+    esp_dte->cmux_n1 = ESP_MODEM_CMUX_N1_DEFAULT;
+    for (int i = 0; i < sizeof(port_speeds) / sizeof(port_speeds[0]); i++) {
+        if (port_speeds[i] == esp_dte->baud_rate) {
+            snprintf(command, sizeof(command), "AT+CMUX=0,0,%d,%d\r", i + 1, ESP_MODEM_CMUX_N1);
+            esp_dte->cmux_n1 = ESP_MODEM_CMUX_N1;
+        }
+    }
+    MODEM_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT, esp_modem_dce_handle_response_default,
+                              NULL) == ESP_OK, "enter cmux failed", err_free);
+    /* Only frames from now on */
+    MODEM_CHECK(esp_modem_dte_quiesce(esp_dte) == ESP_OK, "quiesce failed", err_free);
+    uart_disable_pattern_det_intr(esp_dte->uart_port);
+    uart_flush_input(esp_dte->uart_port);
+    xQueueReset(esp_dte->event_queue);
+    uart_enable_rx_intr(esp_dte->uart_port);
+    esp_dte->cmux_dial_task = NULL;
+    esp_dte->cmux = true;
+    esp_dte->quiesce = false;
+    xTaskNotifyGive(esp_dte->uart_event_task_hdl);
+    for (int i = ESP_MODEM_CMUX_DLC_CONTROL; i < ESP_MODEM_CMUX_DLC_MAX; i++) {
+        MODEM_CHECK(esp_dte_cmux_open(esp_dte, i) == ESP_OK, "open channel %d failed", err_open, i);
+    }
+    ESP_LOGD(MODEM_TAG, "cmux started, n1 %d", esp_dte->cmux_n1);
+    return ESP_OK;
+err_open:
+    esp_dte_cmux_close(esp_dte);
+    return ESP_FAIL;
+err_free:
+    esp_dte_cmux_release(esp_dte);
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_stop_cmux(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(esp_dte->cmux, "cmux not started", err);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE, "stop ppp first", err);
+    return esp_dte_cmux_close(esp_dte);
+err:
+    return ESP_FAIL;
+}
+
+bool esp_modem_is_cmux(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_dte->cmux;
+}
+
+esp_err_t esp_modem_hold_pins(modem_dte_t *dte, bool hold)
+{
+    MODEM_CHECK(dte, "invalid argument", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (esp_dte->dtr_pin >= 0) {
+        MODEM_CHECK((hold ? gpio_hold_en(esp_dte->dtr_pin) : gpio_hold_dis(esp_dte->dtr_pin)) == ESP_OK,
+                    "hold DTR failed", err);
+    }
+    if (dte->dce && dte->dce->hold_pins) {
+        MODEM_CHECK(dte->dce->hold_pins(dte->dce, hold) == ESP_OK, "hold DCE pins failed", err);
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+void esp_modem_timeline_begin(modem_dte_t *dte, esp_modem_phase_t phase)
+{
+    MODEM_CHECK(phase < ESP_MODEM_PHASE_MAX, "invalid phase: %d", err, phase);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_phase_span_t *span = &esp_dte->timeline.phases[phase];
+    if (span->start) {
+        esp_dte->timeline.retries[phase]++;
+    }
+    span->start = esp_timer_get_time();
+    span->end = 0;
+err:
+    return;
+}
+
+void esp_modem_timeline_end(modem_dte_t *dte, esp_modem_phase_t phase)
+{
+    MODEM_CHECK(phase < ESP_MODEM_PHASE_MAX, "invalid phase: %d", err, phase);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_phase_span_t *span = &esp_dte->timeline.phases[phase];
+    if (span->start && !span->end) {
+        span->end = esp_timer_get_time();
+        ESP_LOGD(MODEM_TAG, "phase %d done in %d ms", phase, (int)((span->end - span->start) / 1000));
+    }
+err:
+    return;
+}
+
+esp_err_t esp_modem_timeline_get(modem_dte_t *dte, esp_modem_timeline_t *timeline)
+{
+    MODEM_CHECK(dte && timeline, "invalid argument", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    *timeline = esp_dte->timeline;
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_timeline_publish(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_TIMELINE,
+                                  &esp_dte->timeline, sizeof(esp_modem_timeline_t), pdMS_TO_TICKS(100)) == ESP_OK,
+                "post timeline failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+int esp_modem_timeline_format(const esp_modem_timeline_t *timeline, char *buffer, size_t len)
+{
+    static const char *const names[ESP_MODEM_PHASE_MAX] = {"power_up", "open", "attach", "dial", "ppp"};
+    int pos = 0;
+    buffer[0] = '\0';
+    for (int i = 0; i < ESP_MODEM_PHASE_MAX && pos < len; i++) {
+        const esp_modem_phase_span_t *span = &timeline->phases[i];
+        if (!span->start) {
+            continue;
+        }
+        int64_t end = span->end ? span->end : span->start;
+        pos += snprintf(buffer + pos, len - pos, "%s%s=%d+%d", pos ? " " : "", names[i],
+                        (int)(span->start / 1000), (int)((end - span->start) / 1000));
+        if (timeline->retries[i] && pos < len) {
+            pos += snprintf(buffer + pos, len - pos, "/%d", timeline->retries[i]);
+        }
+    }
+    return MIN(pos, (int)len - 1);
+}
@@ -36,9 +36,97 @@ ESP_EVENT_DECLARE_BASE(ESP_MODEM_EVENT);
 typedef enum {
     ESP_MODEM_EVENT_PPP_START = 0,       /*!< ESP Modem Start PPP Session */
     ESP_MODEM_EVENT_PPP_STOP  = 3,       /*!< ESP Modem Stop PPP Session*/
-    ESP_MODEM_EVENT_UNKNOWN   = 4        /*!< ESP Modem Unknown Response */
+    ESP_MODEM_EVENT_UNKNOWN   = 4,       /*!< ESP Modem Unknown Response */
+    ESP_MODEM_EVENT_TIMELINE  = 5,       /*!< ESP Modem Boot to IP Timeline, data is esp_modem_timeline_t */
+    ESP_MODEM_EVENT_LINK_DOWN = 6,       /*!< ESP Modem Link Lost, recovery started */
+    ESP_MODEM_EVENT_LINK_RECOVERED = 7,  /*!< ESP Modem Link Recovered, data is esp_modem_recovery_t */
+    ESP_MODEM_EVENT_CARRIER_LOST = 8,    /*!< ESP Modem Carrier Lost in PPP mode, data is esp_modem_carrier_loss_t */
+    ESP_MODEM_EVENT_LINK_STALLED = 9,    /*!< ESP Modem PPP Link not answering LCP echo requests */
+    ESP_MODEM_EVENT_RADIO_CHANGED = 10,  /*!< ESP Modem Radio Status Changed, data is esp_modem_radio_event_t */
+    ESP_MODEM_EVENT_BOND_SWITCHED = 11,  /*!< ESP Modem Bond Active Link Changed, data is esp_modem_bond_switch_t */
+    ESP_MODEM_EVENT_SLEEP_CHANGED = 12,  /*!< ESP Modem Sleep State Changed, data is modem_power_save_t */
+    ESP_MODEM_EVENT_CONNECTION_CHANGED = 13, /*!< ESP Modem RRC Connection State Changed, data is modem_power_save_t */
+    ESP_MODEM_EVENT_SOCKET = 14,         /*!< ESP Modem Socket Readable or Closed, data is modem_socket_event_t */
+    ESP_MODEM_EVENT_MQTT = 15,           /*!< ESP Modem MQTT Message or Session Change, data is modem_mqtt_event_t */
+    ESP_MODEM_EVENT_RECOVERY_FAILED = 16 /*!< ESP Modem Link Recovery Given Up, data is esp_modem_recovery_t */
 } esp_modem_event_t;
 
+/**
+ * @brief How the loss of the carrier has been detected
+ *
+ */
+typedef enum {
+    ESP_MODEM_CARRIER_LOSS_NO_CARRIER = 0, /*!< NO CARRIER result code between PPP frames */
+    ESP_MODEM_CARRIER_LOSS_DCD,            /*!< DCD line dropped */
+    ESP_MODEM_CARRIER_LOSS_MSC             /*!< Data valid cleared in the modem status of the data channel (CMUX) */
+} esp_modem_carrier_loss_t;
+
+/**
+ * @brief Virtual channels of the multiplexer, see esp_modem_start_cmux()
+ *
+ */
+#define ESP_MODEM_CMUX_DLC_CONTROL (0) /*!< Multiplexer control channel */
+#define ESP_MODEM_CMUX_DLC_DATA (1)    /*!< Channel of the data call */
+#define ESP_MODEM_CMUX_DLC_AT (2)      /*!< Channel of AT commands */
+
+/**
+ * @brief Handler for unsolicited result codes
+ *
+ * @note Called from the DTE task, for every line starting with the registered prefix, also when
+ *       the line is part of the answer to a command
+ */
+typedef void (*esp_modem_urc_handler_t)(modem_dce_t *dce, const char *line, void *context);
+
+/**
+ * @brief Payload announced by a header line, e.g. "+CARECV: <length>,<payload>", see esp_modem_expect_payload()
+ *
+ */
+typedef struct {
+    const char *prefix; /*!< Start of the header line, followed by the length of the payload */
+    bool same_line;     /*!< Payload after the comma following the length, otherwise after the header line */
+    uint8_t *buffer;    /*!< Buffer of the payload */
+    size_t size;        /*!< Size of buffer, the rest of a longer payload is dropped */
+    size_t length;      /*!< Length announced, set by the DTE task */
+    size_t received;    /*!< Bytes stored in buffer, set by the DTE task */
+} esp_modem_payload_t;
+
+/**
+ * @brief Phases of the bring-up, from power up to IP address
+ *
+ */
+typedef enum {
+    ESP_MODEM_PHASE_POWER_UP = 0, /*!< Power up of the module, until it is ready */
+    ESP_MODEM_PHASE_OPEN,         /*!< Synchronization with the module and identity */
+    ESP_MODEM_PHASE_ATTACH,       /*!< Network registration */
+    ESP_MODEM_PHASE_DIAL,         /*!< PDP context definition and dial, until CONNECT */
+    ESP_MODEM_PHASE_PPP,          /*!< PPP negotiation, until IP address */
+    ESP_MODEM_PHASE_MAX
+} esp_modem_phase_t;
+
+/**
+ * @brief Span of one phase, timestamps since boot, unit: us
+ *
+ */
+typedef struct {
+    int64_t start; /*!< Start of the phase, 0 if not reached */
+    int64_t end;   /*!< End of the phase, 0 if not completed */
+} esp_modem_phase_span_t;
+
+/**
+ * @brief Boot to IP timeline
+ *
+ */
+typedef struct {
+    esp_modem_phase_span_t phases[ESP_MODEM_PHASE_MAX]; /*!< Span of each phase */
+    uint32_t retries[ESP_MODEM_PHASE_MAX];              /*!< Number of times a phase has been started again */
+} esp_modem_timeline_t;
+
+/**
+ * @brief Max length of a formatted timeline
+ *
+ */
+#define ESP_MODEM_TIMELINE_MAX_LENGTH (160)
+
 /**
  * @brief ESP Modem DTE Configuration
  *
@@ -50,6 +138,19 @@ typedef struct {
     uart_parity_t parity;           /*!< Parity type */
     modem_flow_ctrl_t flow_control; /*!< Flow control type */
     uint32_t baud_rate;             /*!< Communication baud rate */
+    int tx_io_num;                  /*!< TXD pin */
+    int rx_io_num;                  /*!< RXD pin */
+    int rts_io_num;                 /*!< RTS pin, used with hardware flow control */
+    int cts_io_num;                 /*!< CTS pin, used with hardware flow control */
+    int dtr_io_num;                 /*!< DTR pin, -1 if not wired */
+    int dcd_io_num;                 /*!< DCD pin, -1 if not wired */
+    int rx_buffer_size;             /*!< UART RX ring buffer size */
+    int tx_buffer_size;             /*!< UART TX ring buffer size, 0 for blocking writes */
+    int event_queue_size;           /*!< UART event queue size */
+    int pattern_queue_size;         /*!< UART pattern queue size, lines received and not yet read */
+    int line_buffer_size;           /*!< Longest line from the DCE, also the chunk of data read at once */
+    uint32_t event_task_stack_size; /*!< Stack size of the UART event task */
+    int event_task_priority;        /*!< Priority of the UART event task */
 } esp_modem_dte_config_t;
 
 /**
@@ -62,14 +163,52 @@ typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *contex
  * @brief ESP Modem DTE Default Configuration
  *
  */
-#define ESP_MODEM_DTE_DEFAULT_CONFIG()          \
-    {                                           \
-        .port_num = UART_NUM_1,                 \
-        .data_bits = UART_DATA_8_BITS,          \
-        .stop_bits = UART_STOP_BITS_1,          \
-        .parity = UART_PARITY_DISABLE,          \
-        .baud_rate = 115200,                    \
-        .flow_control = MODEM_FLOW_CONTROL_NONE \
+#define ESP_MODEM_DTE_DEFAULT_CONFIG()           \
+    {                                            \
+        .port_num = UART_NUM_1,                  \
+        .data_bits = UART_DATA_8_BITS,           \
+        .stop_bits = UART_STOP_BITS_1,           \
+        .parity = UART_PARITY_DISABLE,           \
+        .baud_rate = 115200,                     \
+        .flow_control = MODEM_FLOW_CONTROL_NONE, \
+        .tx_io_num = 25,                         \
+        .rx_io_num = 26,                         \
+        .rts_io_num = 27,                        \
+        .cts_io_num = 23,                        \
+        .dtr_io_num = -1,                        \
+        .dcd_io_num = -1,                        \
+        .rx_buffer_size = 1024,                  \
+        .tx_buffer_size = 512,                   \
+        .event_queue_size = 30,                  \
+        .pattern_queue_size = 20,                \
+        .line_buffer_size = 512,                 \
+        .event_task_stack_size = 2048,           \
+        .event_task_priority = 5                 \
+    }
+
+/**
+ * @brief ESP Modem DCE Configuration, GPIOs of the module and data call
+ *
+ */
+typedef struct {
+    int pwrkey_io_num;  /*!< PWRKEY pin, -1 if not wired */
+    int reset_io_num;   /*!< RESET pin, -1 if not wired */
+    int status_io_num;  /*!< STATUS pin, -1 if not wired */
+    const char *apn;    /*!< Access point name of the data call, copied */
+    uint32_t cid;       /*!< PDP context of the data call, defined with apn on dial unless defined in a batch */
+} esp_modem_dce_config_t;
+
+/**
+ * @brief ESP Modem DCE Default Configuration
+ *
+ */
+#define ESP_MODEM_DCE_DEFAULT_CONFIG(access_point) \
+    {                                              \
+        .pwrkey_io_num = -1,                       \
+        .reset_io_num = -1,                        \
+        .status_io_num = -1,                       \
+        .apn = access_point,                       \
+        .cid = 1                                   \
     }
 
 /**
@@ -105,6 +244,86 @@ esp_err_t esp_modem_set_event_handler(modem_dte_t *dte, esp_event_handler_t hand
  */
 esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t handler);
 
+/**
+ * @brief Post an event to the ESP Modem event loop
+ *
+ * @param dte Modem DTE object
+ * @param event_id event to post
+ * @param event_data data of the event, copied
+ * @param event_data_size size of the data
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the event queue is full
+ */
+esp_err_t esp_modem_post_event(modem_dte_t *dte, int32_t event_id, const void *event_data, size_t event_data_size);
+
+/**
+ * @brief Register handler for unsolicited result codes
+ *
+ * @param dte Modem DTE object
+ * @param prefix start of the lines to handle, e.g. "+CREG:"
+ * @param handler handler to register
+ * @param context context passed to handler
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NO_MEM if all handler slots are used
+ *      - ESP_ERR_INVALID_ARG on wrong parameter
+ */
+esp_err_t esp_modem_register_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_handler_t handler, void *context);
+
+/**
+ * @brief Unregister handler for unsolicited result codes
+ *
+ * Waits for the handler to return if the DTE task is running it, its context may be freed afterwards.
+ *
+ * @param dte Modem DTE object
+ * @param handler handler to unregister
+ * @param context context the handler was registered with
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the handler was not registered
+ */
+esp_err_t esp_modem_unregister_urc_handler(modem_dte_t *dte, esp_modem_urc_handler_t handler, void *context);
+
+/**
+ * @brief Send a command which prompts for a payload, then the payload as is
+ *
+ * The payload is written once the prompt arrived, straight from data, with no copy and no escaping.
+ * The result code after the payload goes to handler, as with send_cmd.
+ *
+ * @param dte Modem DTE object
+ * @param command command string, e.g. "AT+CASEND=0,5\r"
+ * @param prompt prompt of the DCE, e.g. ">", echo before it is skipped and unsolicited result codes dispatched
+ * @param data payload
+ * @param length length of payload
+ * @param timeout timeout value of the prompt and of the result code, unit: ms
+ * @param handler handler for response lines, called from the DTE task
+ * @param context context of handler, as dce->handle_line_ctx
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED with the multiplexer
+ *      - ESP_ERR_TIMEOUT if the prompt or the result code did not arrive in time, the prompt cancelled with ESC
+ *      - ESP_FAIL on error or if the command was refused
+ */
+esp_err_t esp_modem_send_payload(modem_dte_t *dte, const char *command, const char *prompt, const void *data,
+                                 size_t length, uint32_t timeout, modem_line_handler_t handler, void *context);
+
+/**
+ * @brief Read the payload announced by the next line starting with payload->prefix as is
+ *
+ * The payload is read by length, line feeds in it do not end lines. Handlers only get the header
+ * line, cut before the payload. Armed for one header line, to be set before the command and
+ * cleared with NULL once the command returned.
+ *
+ * @param dte Modem DTE object
+ * @param payload payload to read, valid until cleared, NULL to clear
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED with the multiplexer
+ *      - ESP_ERR_INVALID_ARG on wrong parameter
+ */
+esp_err_t esp_modem_expect_payload(modem_dte_t *dte, esp_modem_payload_t *payload);
+
 /**
  * @brief Setup PPP Session
  *
@@ -115,6 +334,22 @@ esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t h
  */
 esp_err_t esp_modem_start_ppp(modem_dte_t *dte);
 
+/**
+ * @brief Select the PDP context dialed by the next esp_modem_start_ppp()
+ *
+ * Contexts defined in one batch by esp_modem_dce_define_pdp_contexts() are dialed as they are,
+ * others are defined first with apn. A modem carries one data call at a time, traffic of other
+ * contexts needs another PPP session, on another modem.
+ *
+ * @param dte Modem DTE object
+ * @param cid PDP context identifier
+ * @param apn access point name of the context, NULL to keep the current one
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on invalid argument, or if a data call is up or suspended
+ */
+esp_err_t esp_modem_select_pdp_context(modem_dte_t *dte, uint32_t cid, const char *apn);
+
 /**
  * @brief Exit PPP Session
  *
@@ -125,6 +360,149 @@ esp_err_t esp_modem_start_ppp(modem_dte_t *dte);
  */
 esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
 
+/**
+ * @brief Suspend PPP Session
+ *
+ * Switch to command mode keeping the data call and the PDP context up, so that AT commands
+ * can be sent. PPP frames from the network interface are dropped until the session is resumed.
+ * DTR is dropped when wired (AT&D1), otherwise the escape sequence is sent.
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_suspend_ppp(modem_dte_t *dte);
+
+/**
+ * @brief Resume PPP Session suspended by esp_modem_suspend_ppp()
+ *
+ * Return to the data call (ATO). If the call has been dropped meanwhile, the PPP session of the
+ * network interface is stopped (ESP_MODEM_EVENT_PPP_STOP) and the call dialed again, as by
+ * esp_modem_start_ppp(), which starts a new session.
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_resume_ppp(modem_dte_t *dte);
+
+/**
+ * @brief Mark the end of an uplink burst, the module asks the network to release the connection
+ *
+ * The module can then enter idle, and PSM, without waiting for the inactivity timer of the network.
+ * The request needs an AT channel: command mode, or the multiplexer while PPP runs. The release
+ * is confirmed by ESP_MODEM_EVENT_CONNECTION_CHANGED, with the time the connection lasted.
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK if requested
+ *      - ESP_ERR_NOT_SUPPORTED if the DCE cannot request early release
+ *      - ESP_ERR_INVALID_STATE if PPP runs without the multiplexer, nothing is sent
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_release_connection(modem_dte_t *dte);
+
+/**
+ * @brief Start the 3GPP TS 27.010 multiplexer (AT+CMUX, basic option)
+ *
+ * The UART is split in virtual channels: PPP runs on ESP_MODEM_CMUX_DLC_DATA, AT commands and
+ * unsolicited result codes on ESP_MODEM_CMUX_DLC_AT, so that the line handlers keep working while
+ * the data call is up, with no need to suspend it. To be called in command mode, before
+ * esp_modem_start_ppp().
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_start_cmux(modem_dte_t *dte);
+
+/**
+ * @brief Close the multiplexer and go back to a single AT channel
+ *
+ * The data call has to be stopped first.
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_stop_cmux(modem_dte_t *dte);
+
+/**
+ * @brief Whether the multiplexer is running
+ *
+ * @param dte Modem DTE Object
+ * @return true if AT commands can be sent in PPP mode
+ */
+bool esp_modem_is_cmux(modem_dte_t *dte);
+
+/**
+ * @brief Hold the levels of the control pins of the modem, DTR and those of the DCE, or release them
+ *
+ * Each pin wired is held with gpio_hold_en(), RTC pads included, so that the module is neither
+ * reset nor powered off while the ESP32 is in deep sleep. Digital pads also need
+ * gpio_deep_sleep_hold_en().
+ *
+ * @param dte Modem DTE Object
+ * @param hold true to hold, false to release
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_hold_pins(modem_dte_t *dte, bool hold);
+
+/**
+ * @brief Mark the start of a bring-up phase
+ *
+ * @param dte Modem DTE object
+ * @param phase bring-up phase
+ */
+void esp_modem_timeline_begin(modem_dte_t *dte, esp_modem_phase_t phase);
+
+/**
+ * @brief Mark the end of a bring-up phase
+ *
+ * @param dte Modem DTE object
+ * @param phase bring-up phase
+ */
+void esp_modem_timeline_end(modem_dte_t *dte, esp_modem_phase_t phase);
+
+/**
+ * @brief Get the boot to IP timeline
+ *
+ * @param dte Modem DTE object
+ * @param timeline copy of the timeline
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on wrong parameter
+ */
+esp_err_t esp_modem_timeline_get(modem_dte_t *dte, esp_modem_timeline_t *timeline);
+
+/**
+ * @brief Post the timeline as ESP_MODEM_EVENT_TIMELINE
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_timeline_publish(modem_dte_t *dte);
+
+/**
+ * @brief Format a timeline as "<phase>=<start>+<duration>" tokens, unit: ms
+ *
+ * This is the format parsed by tools/modem_timeline.py
+ *
+ * @param timeline timeline to format
+ * @param buffer output buffer, ESP_MODEM_TIMELINE_MAX_LENGTH is enough
+ * @param len length of buffer
+ * @return int length of the formatted string
+ */
+int esp_modem_timeline_format(const esp_modem_timeline_t *timeline, char *buffer, size_t len);
+
 /**
  * @brief Setup on reception callback
  *
@@ -0,0 +1,185 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_modem_download.h"
+#include "esp_modem_agnss.h"
+
+#define ESP_MODEM_AGNSS_US_PER_MIN (60 * 1000000LL)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *AGNSS_TAG = "esp-modem-agnss";
+#define AGNSS_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(a))                                                                       \
+        {                                                                               \
+            ESP_LOGE(AGNSS_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                              \
+        }                                                                               \
+    } while (0)
+
+/**
+ * @brief A-GNSS manager of a module
+ *
+ */
+struct esp_modem_agnss {
+    modem_dce_t *dce;                /*!< Module of the receiver */
+    esp_modem_agnss_config_t config; /*!< Configuration */
+    uint32_t valid_min;              /*!< Validity left when last asked to the module, unit: minute */
+    int64_t checked;                 /*!< Last asked to the module, unit: us since boot */
+    esp_modem_agnss_stats_t stats;   /*!< Statistics */
+};
+
+/**
+ * @brief Ask the module the validity left of its assistance data, none if it cannot tell
+ */
+static void esp_modem_agnss_check(struct esp_modem_agnss *agnss)
+{
+    if (agnss->dce->get_gnss_assist(agnss->dce, &agnss->valid_min) != ESP_OK) {
+        agnss->valid_min = 0;
+    }
+    agnss->checked = esp_timer_get_time();
+}
+
+/**
+ * @brief Validity left, estimated from the last answer of the module
+ */
+static uint32_t esp_modem_agnss_valid_min(struct esp_modem_agnss *agnss)
+{
+    int64_t elapsed_min = (esp_timer_get_time() - agnss->checked) / ESP_MODEM_AGNSS_US_PER_MIN;
+    return elapsed_min < agnss->valid_min ? agnss->valid_min - elapsed_min : 0;
+}
+
+/**
+ * @brief Storage of the download, each chunk written to the module as it is read
+ */
+static esp_err_t esp_modem_agnss_write(void *context, size_t offset, const void *data, size_t length)
+{
+    modem_dce_t *dce = context;
+    return dce->gnss_assist_write(dce, offset, data, length);
+}
+
+/**
+ * @brief Write the local copy of the assistance file to the module
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the file cannot be opened
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_agnss_write_file(struct esp_modem_agnss *agnss, size_t *size)
+{
+    esp_err_t ret = ESP_FAIL;
+    FILE *file = fopen(agnss->config.file, "rb");
+    AGNSS_CHECK(file, "open %s failed", err_open, agnss->config.file);
+    uint8_t *chunk = malloc(agnss->config.chunk_size);
+    AGNSS_CHECK(chunk, "malloc chunk failed", err_mem);
+    size_t offset = 0;
+    size_t len;
+    while ((len = fread(chunk, 1, agnss->config.chunk_size, file)) > 0) {
+        AGNSS_CHECK(esp_modem_agnss_write(agnss->dce, offset, chunk, len) == ESP_OK, "write at %d failed", err_write,
+                    offset);
+        offset += len;
+    }
+    AGNSS_CHECK(!ferror(file) && offset, "read %s failed", err_write, agnss->config.file);
+    *size = offset;
+    ret = ESP_OK;
+err_write:
+    free(chunk);
+err_mem:
+    fclose(file);
+    return ret;
+err_open:
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_modem_agnss_handle_t esp_modem_agnss_init(modem_dce_t *dce, const esp_modem_agnss_config_t *config)
+{
+    AGNSS_CHECK(dce && config && (config->url || config->file) && config->chunk_size, "invalid argument", err);
+    AGNSS_CHECK(dce->gnss_assist_write && dce->gnss_assist_load && dce->get_gnss_assist, "a-gnss not supported", err);
+    struct esp_modem_agnss *agnss = calloc(1, sizeof(struct esp_modem_agnss));
+    AGNSS_CHECK(agnss, "calloc agnss failed", err);
+    agnss->dce = dce;
+    agnss->config = *config;
+    esp_modem_agnss_check(agnss);
+    ESP_LOGI(AGNSS_TAG, "assistance data valid for %d min", agnss->valid_min);
+    return agnss;
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_agnss_deinit(esp_modem_agnss_handle_t agnss)
+{
+    AGNSS_CHECK(agnss, "invalid argument", err);
+    free(agnss);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_agnss_refresh(esp_modem_agnss_handle_t agnss, bool force)
+{
+    esp_err_t ret = ESP_FAIL;
+    AGNSS_CHECK(agnss, "invalid argument", err_arg);
+    uint32_t valid_min = esp_modem_agnss_valid_min(agnss);
+    if (!force && valid_min > agnss->config.refresh_margin_min) {
+        agnss->stats.skipped++;
+        return ESP_OK;
+    }
+    ESP_LOGI(AGNSS_TAG, "refresh assistance data, valid for %d min", valid_min);
+    int64_t start = esp_timer_get_time();
+    size_t size = 0;
+    if (agnss->config.file) {
+        ret = esp_modem_agnss_write_file(agnss, &size);
+    } else {
+        esp_modem_download_config_t download_config = ESP_MODEM_DOWNLOAD_DEFAULT_CONFIG();
+        esp_modem_download_stats_t download_stats;
+        download_config.url = agnss->config.url;
+        download_config.chunk_size = agnss->config.chunk_size;
+        ret = esp_modem_download(agnss->dce, &download_config, esp_modem_agnss_write, agnss->dce, &download_stats);
+        size = download_stats.offset;
+    }
+    AGNSS_CHECK(ret == ESP_OK, "fetch assistance file failed", err);
+    ret = ESP_FAIL;
+    AGNSS_CHECK(agnss->dce->gnss_assist_load(agnss->dce) == ESP_OK, "load assistance data failed", err);
+    esp_modem_agnss_check(agnss);
+    agnss->stats.refreshes++;
+    agnss->stats.bytes = size;
+    agnss->stats.duration_ms = (esp_timer_get_time() - start) / 1000;
+    ESP_LOGI(AGNSS_TAG, "%d bytes loaded in %d ms, valid for %d min", size, agnss->stats.duration_ms,
+             agnss->valid_min);
+    return ESP_OK;
+err:
+    agnss->stats.failures++;
+    return ret == ESP_ERR_NOT_FOUND ? ESP_ERR_NOT_FOUND : ESP_FAIL;
+err_arg:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_agnss_get_stats(esp_modem_agnss_handle_t agnss, esp_modem_agnss_stats_t *stats)
+{
+    AGNSS_CHECK(agnss && stats, "invalid argument", err);
+    *stats = agnss->stats;
+    stats->valid_min = esp_modem_agnss_valid_min(agnss);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
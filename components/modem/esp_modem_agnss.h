@@ -0,0 +1,113 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief A-GNSS configuration
+ *
+ */
+typedef struct {
+    const char *url;             /*!< Assistance file, "http://host[:port]/path", fetched by the HTTP client of the module */
+    const char *file;            /*!< Local copy of the assistance file used instead of url, NULL for none */
+    uint32_t refresh_margin_min; /*!< Refreshed once less validity than this is left, unit: minute */
+    size_t chunk_size;           /*!< Bytes per read and per write to the module, at most 2048 on SIM7000 */
+} esp_modem_agnss_config_t;
+
+/**
+ * @brief A-GNSS default configuration
+ *
+ */
+#define ESP_MODEM_AGNSS_DEFAULT_CONFIG()                     \
+    {                                                        \
+        .url = "http://iot1.xtracloud.net/xtra3grc.bin",     \
+        .file = NULL,                                        \
+        .refresh_margin_min = 24 * 60,                       \
+        .chunk_size = 2048                                   \
+    }
+
+/**
+ * @brief A-GNSS statistics
+ *
+ */
+typedef struct {
+    uint32_t valid_min;   /*!< Validity left of the assistance data loaded, estimated since last asked to the module, unit: minute */
+    uint32_t refreshes;   /*!< Assistance files loaded */
+    uint32_t failures;    /*!< Refreshes failed */
+    uint32_t skipped;     /*!< Refreshes skipped, the data loaded still valid for longer than the margin */
+    size_t bytes;         /*!< Size of the last assistance file */
+    uint32_t duration_ms; /*!< Duration of the last refresh, fetch and load */
+} esp_modem_agnss_stats_t;
+
+typedef struct esp_modem_agnss *esp_modem_agnss_handle_t;
+
+/**
+ * @brief Create the A-GNSS manager of a module, asking it the validity left of its assistance data
+ *
+ * @param dce Modem DCE object, with the A-GNSS operations
+ * @param config A-GNSS configuration
+ * @return esp_modem_agnss_handle_t A-GNSS handle, NULL on error
+ */
+esp_modem_agnss_handle_t esp_modem_agnss_init(modem_dce_t *dce, const esp_modem_agnss_config_t *config);
+
+/**
+ * @brief Delete the A-GNSS manager, the assistance data stays in the module
+ *
+ * @param agnss A-GNSS handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_agnss_deinit(esp_modem_agnss_handle_t agnss);
+
+/**
+ * @brief Refresh the assistance data if it expires within the margin, to be called whenever a data
+ * session is up anyway
+ *
+ * Costs nothing while the data is fresh, the validity estimated without command. Otherwise the
+ * assistance file is streamed chunk by chunk to the file system of the module, fetched by its
+ * HTTP client as esp_modem_download() does, or read from the local file, then loaded into the
+ * receiver, used from its next start. The receiver has to be powered off. The IP stack of the
+ * module is brought up if not already, and left up for the caller to bring down with the rest of
+ * its session.
+ *
+ * @param agnss A-GNSS handle
+ * @param force refresh whatever the validity left
+ * @return esp_err_t
+ *      - ESP_OK on success, or if the data is still fresh
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_NOT_FOUND if the server or the file system refused the file
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_agnss_refresh(esp_modem_agnss_handle_t agnss, bool force);
+
+/**
+ * @brief Get the A-GNSS statistics
+ *
+ * @param agnss A-GNSS handle
+ * @param stats statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_agnss_get_stats(esp_modem_agnss_handle_t agnss, esp_modem_agnss_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,323 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_attach.h"
+#include "esp_modem_time.h"
+
+#define ESP_MODEM_ATTACH_NAMESPACE "modem_attach"
+#define ESP_MODEM_ATTACH_VERSION (1)
+#define ESP_MODEM_ATTACH_KEY_LENGTH (15)
+#define ESP_MODEM_ATTACH_POLL_INTERVAL_MS (500)
+#define ESP_MODEM_ATTACH_ACT_UNKNOWN (-1)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *ATTACH_TAG = "esp-modem-attach";
+#define ATTACH_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                   \
+    {                                                                                    \
+        if (!(a))                                                                        \
+        {                                                                                \
+            ESP_LOGE(ATTACH_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                               \
+        }                                                                                \
+    } while (0)
+
+/**
+ * @brief Attach record, stored as NVS blob keyed by ICCID
+ *
+ */
+typedef struct {
+    uint32_t version;                           /*!< Layout version of the record */
+    char plmn[MODEM_PLMN_LENGTH + 1];           /*!< Last serving operator, numeric format */
+    int32_t act;                                /*!< Last access technology, as reported by +COPS */
+    char band[MODEM_MAX_BAND_HINT_LENGTH];      /*!< Band configuration restricted to the last serving band */
+    esp_modem_attach_metrics_t metrics;         /*!< Attach time metrics */
+} esp_modem_attach_record_t;
+
+/**
+ * @brief Serving operator, filled by the response of AT+COPS?
+ *
+ */
+typedef struct {
+    char plmn[MODEM_PLMN_LENGTH + 1]; /*!< Numeric operator */
+    int32_t act;                      /*!< Access technology */
+} esp_modem_attach_operator_t;
+
+static const char *esp_modem_attach_key(const char *iccid)
+{
+    size_t len = strlen(iccid);
+    return len > ESP_MODEM_ATTACH_KEY_LENGTH ? iccid + len - ESP_MODEM_ATTACH_KEY_LENGTH : iccid;
+}
+
+static esp_err_t esp_modem_attach_load(modem_dce_t *dce, esp_modem_attach_record_t *record)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(*record);
+    memset(record, 0, sizeof(*record));
+    record->version = ESP_MODEM_ATTACH_VERSION;
+    record->act = ESP_MODEM_ATTACH_ACT_UNKNOWN;
+    if (!dce->iccid[0] && (!dce->get_iccid_number || dce->get_iccid_number(dce) != ESP_OK)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (nvs_open(ESP_MODEM_ATTACH_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_modem_attach_record_t stored;
+    esp_err_t res = nvs_get_blob(handle, esp_modem_attach_key(dce->iccid), &stored, &len);
+    nvs_close(handle);
+    if (res != ESP_OK || len != sizeof(stored) || stored.version != ESP_MODEM_ATTACH_VERSION) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *record = stored;
+    return ESP_OK;
+}
+
+static esp_err_t esp_modem_attach_store(modem_dce_t *dce, const esp_modem_attach_record_t *record)
+{
+    nvs_handle_t handle;
+    ATTACH_CHECK(dce->iccid[0], "iccid is unknown", err);
+    ATTACH_CHECK(nvs_open(ESP_MODEM_ATTACH_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK, "open nvs failed", err);
+    ATTACH_CHECK(nvs_set_blob(handle, esp_modem_attach_key(dce->iccid), record, sizeof(*record)) == ESP_OK,
+                 "write record failed", err_nvs);
+    ATTACH_CHECK(nvs_commit(handle) == ESP_OK, "commit record failed", err_nvs);
+    nvs_close(handle);
+    return ESP_OK;
+err_nvs:
+    nvs_close(handle);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Handle response from AT+COPS? in numeric format
+ */
+static esp_err_t esp_modem_attach_handle_cops(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    esp_modem_attach_operator_t *oper = dce->handle_line_ctx;
+    if (!strncmp(line, "+COPS", strlen("+COPS"))) {
+        /* +COPS: <mode>,2,"<plmn>"[,<AcT>] */
+        int mode = 0, format = 0;
+        if (sscanf(line, "%*s%d,%d,\"%6[0-9]\",%d", &mode, &format, oper->plmn, &oper->act) >= 3) {
+            err = ESP_OK;
+        }
+    } else if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+/**
+ * @brief Send a command only answered by OK or ERROR
+ */
+static esp_err_t esp_modem_attach_command(modem_dce_t *dce, const char *command, uint32_t timeout)
+{
+    modem_dte_t *dte = dce->dte;
+    ATTACH_CHECK(dte->send_cmd(dte, command, timeout, esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+                 "command failed: %s", err, command);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Restore the long alphanumeric operator format, expected by get_operator_name()
+ */
+static void esp_modem_attach_restore_format(modem_dce_t *dce)
+{
+    if (esp_modem_attach_command(dce, "AT+COPS=3,0\r", MODEM_COMMAND_TIMEOUT_DEFAULT) != ESP_OK) {
+        ESP_LOGW(ATTACH_TAG, "restore operator format failed");
+    }
+}
+
+/**
+ * @brief Get serving operator in numeric format and its access technology
+ */
+static esp_err_t esp_modem_attach_get_operator(modem_dce_t *dce, esp_modem_attach_operator_t *oper)
+{
+    modem_dte_t *dte = dce->dte;
+    oper->plmn[0] = '\0';
+    oper->act = ESP_MODEM_ATTACH_ACT_UNKNOWN;
+    ATTACH_CHECK(esp_modem_attach_command(dce, "AT+COPS=3,2\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK,
+                 "set operator format failed", err);
+    esp_err_t ret = dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR, esp_modem_attach_handle_cops, oper);
+    esp_modem_attach_restore_format(dce);
+    ATTACH_CHECK(ret == ESP_OK && oper->plmn[0], "get serving operator failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Poll network registration until registered or deadline
+ */
+static bool esp_modem_attach_wait_registered(modem_dce_t *dce, int64_t deadline_us)
+{
+    modem_reg_status_t status = MODEM_REG_UNKNOWN;
+    do {
+        if (esp_modem_dce_get_network_registration(dce, &status) == ESP_OK &&
+                (status == MODEM_REG_HOME || status == MODEM_REG_ROAMING)) {
+            return true;
+        }
+        if (status == MODEM_REG_DENIED) {
+            ESP_LOGW(ATTACH_TAG, "registration denied");
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(ESP_MODEM_ATTACH_POLL_INTERVAL_MS));
+    } while (esp_timer_get_time() < deadline_us);
+    return false;
+}
+
+/**
+ * @brief Exponential moving average, weight 1/4 for the new sample
+ */
+static uint32_t esp_modem_attach_average(uint32_t avg, uint32_t sample)
+{
+    return avg ? (avg * 3 + sample) / 4 : sample;
+}
+
+esp_err_t esp_modem_attach_network(modem_dce_t *dce, uint32_t timeout)
+{
+    esp_modem_attach_record_t record;
+    esp_modem_attach_operator_t oper;
+    char command[48];
+    bool hinted = false;
+    bool registered = false;
+    bool steered = true;
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + (int64_t)timeout * 1000;
+    bool has_record = esp_modem_attach_load(dce, &record) == ESP_OK;
+    record.metrics.attempts++;
+    esp_modem_timeline_begin(dce->dte, ESP_MODEM_PHASE_ATTACH);
+
+    modem_reg_status_t status = MODEM_REG_UNKNOWN;
+    if (esp_modem_dce_get_network_registration(dce, &status) == ESP_OK &&
+            (status == MODEM_REG_HOME || status == MODEM_REG_ROAMING)) {
+        /* The module attached on its own while powering up, nothing to steer */
+        registered = true;
+        steered = false;
+    } else if (has_record && record.plmn[0]) {
+        /* Restrict the search to what worked last time, giving it half of the time budget */
+        ESP_LOGI(ATTACH_TAG, "attach hint: plmn %s, act %d, band %s", record.plmn, record.act,
+                 record.band[0] ? record.band : "any");
+        if (record.band[0] && dce->set_band_config) {
+            dce->set_band_config(dce, record.band);
+        }
+        if (record.act != ESP_MODEM_ATTACH_ACT_UNKNOWN) {
+            snprintf(command, sizeof(command), "AT+COPS=4,2,\"%s\",%d\r", record.plmn, record.act);
+        } else {
+            snprintf(command, sizeof(command), "AT+COPS=4,2,\"%s\"\r", record.plmn);
+        }
+        if (esp_modem_attach_command(dce, command, MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK) {
+            hinted = esp_modem_attach_wait_registered(dce, start + (int64_t)timeout * 500);
+        }
+        registered = hinted;
+        if (!hinted) {
+            ESP_LOGW(ATTACH_TAG, "attach on hint failed, fall back to full search");
+            if (record.band[0] && dce->set_band_config) {
+                dce->set_band_config(dce, NULL);
+            }
+        }
+    }
+    if (!registered) {
+        ATTACH_CHECK(esp_modem_attach_command(dce, "AT+COPS=0\r", MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK,
+                     "automatic operator selection failed", err_select);
+        registered = esp_modem_attach_wait_registered(dce, deadline);
+    }
+    ATTACH_CHECK(registered, "network registration timeout", err_timeout);
+    esp_modem_timeline_end(dce->dte, ESP_MODEM_PHASE_ATTACH);
+    if (hinted && record.band[0] && dce->set_band_config) {
+        /* The band restriction is stored by the module, it would hold for later reselections */
+        dce->set_band_config(dce, NULL);
+    }
+
+    uint32_t elapsed_ms = (esp_timer_get_time() - start) / 1000;
+    record.metrics.last_ms = elapsed_ms;
+    if (!steered) {
+        /* Not an attach time, keep it out of the averages */
+    } else if (hinted) {
+        record.metrics.hinted++;
+        record.metrics.hinted_avg_ms = esp_modem_attach_average(record.metrics.hinted_avg_ms, elapsed_ms);
+    } else {
+        record.metrics.full_search++;
+        record.metrics.full_search_avg_ms = esp_modem_attach_average(record.metrics.full_search_avg_ms, elapsed_ms);
+    }
+    /* Record the serving cell for the next attach */
+    if (esp_modem_attach_get_operator(dce, &oper) == ESP_OK) {
+        strcpy(record.plmn, oper.plmn);
+        record.act = oper.act;
+    }
+    if (!dce->get_band_hint || dce->get_band_hint(dce, record.band, sizeof(record.band)) != ESP_OK) {
+        record.band[0] = '\0';
+    }
+    esp_modem_attach_store(dce, &record);
+    /* Network time came with the registration, the system clock is set before any IP */
+    esp_modem_time_sync(dce);
+    ESP_LOGI(ATTACH_TAG, "attached to %s (act %d) in %d ms, %s", record.plmn, record.act, elapsed_ms,
+             !steered ? "already registered" : hinted ? "hinted" : "full search");
+    return ESP_OK;
+err_timeout:
+    /* The hinted selection left the operator format numeric */
+    if (has_record && record.plmn[0]) {
+        esp_modem_attach_restore_format(dce);
+    }
+    record.metrics.failures++;
+    record.metrics.last_ms = (esp_timer_get_time() - start) / 1000;
+    esp_modem_attach_store(dce, &record);
+    return ESP_ERR_TIMEOUT;
+err_select:
+    record.metrics.failures++;
+    record.metrics.last_ms = (esp_timer_get_time() - start) / 1000;
+    esp_modem_attach_store(dce, &record);
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_attach_get_metrics(modem_dce_t *dce, esp_modem_attach_metrics_t *metrics)
+{
+    esp_modem_attach_record_t record;
+    if (esp_modem_attach_load(dce, &record) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *metrics = record.metrics;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_attach_clear_hints(modem_dce_t *dce)
+{
+    esp_modem_attach_record_t record;
+    /* A band restriction left by a hinted attach is lifted with the hints */
+    if (dce->set_band_config && dce->set_band_config(dce, NULL) != ESP_OK) {
+        ESP_LOGW(ATTACH_TAG, "restore all bands failed");
+    }
+    if (esp_modem_attach_load(dce, &record) != ESP_OK) {
+        return ESP_OK;
+    }
+    record.plmn[0] = '\0';
+    record.act = ESP_MODEM_ATTACH_ACT_UNKNOWN;
+    record.band[0] = '\0';
+    return esp_modem_attach_store(dce, &record);
+}
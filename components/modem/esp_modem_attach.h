@@ -0,0 +1,83 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Specific Length Constraint
+ *
+ */
+#define MODEM_PLMN_LENGTH (6)         /*!< Max numeric operator (MCC + MNC) Length */
+#define MODEM_MAX_BAND_HINT_LENGTH (48) /*!< Max band configuration Length */
+
+/**
+ * @brief Attach time metrics, kept per SIM card
+ *
+ */
+typedef struct {
+    uint32_t attempts;           /*!< Number of attach attempts */
+    uint32_t hinted;             /*!< Attaches completed on the cached operator, RAT and band */
+    uint32_t full_search;        /*!< Attaches that needed a full network search */
+    uint32_t failures;           /*!< Attaches that failed */
+    uint32_t last_ms;            /*!< Duration of the last attach */
+    uint32_t hinted_avg_ms;      /*!< Moving average duration of hinted attaches */
+    uint32_t full_search_avg_ms; /*!< Moving average duration of full search attaches */
+} esp_modem_attach_metrics_t;
+
+/**
+ * @brief Attach to the network, using the hints recorded on the last successful attach
+ *
+ * The search is first restricted to the last operator (AT+COPS manual-automatic), radio access
+ * technology and band. A full automatic search is only started if this fails. On success, the
+ * serving operator, RAT and band are recorded in NVS for the next attach, and the system clock is
+ * set from the clock of the module, see esp_modem_time_sync().
+ *
+ * @param dce Modem DCE object
+ * @param timeout Overall timeout value, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the modem did not register
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_attach_network(modem_dce_t *dce, uint32_t timeout);
+
+/**
+ * @brief Get attach time metrics of the SIM card in use
+ *
+ * @param dce Modem DCE object
+ * @param metrics Attach time metrics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if nothing was recorded yet
+ */
+esp_err_t esp_modem_attach_get_metrics(modem_dce_t *dce, esp_modem_attach_metrics_t *metrics);
+
+/**
+ * @brief Forget the recorded operator, RAT and band and lift any band restriction, the next attach will do a full search
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_attach_clear_hints(modem_dce_t *dce);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,591 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "lwip/sockets.h"
+#include "net/if.h"
+#include "esp_modem.h"
+#include "esp_modem_netif.h"
+#include "esp_modem_bond.h"
+
+#define ESP_MODEM_BOND_SCORE_MAX (1000)
+#define ESP_MODEM_BOND_POLL_MS (10) /*!< Reply poll period while a probe of the echo server is in flight */
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *BOND_TAG = "esp-modem-bond";
+#define BOND_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(a))                                                                      \
+        {                                                                              \
+            ESP_LOGE(BOND_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                             \
+        }                                                                              \
+    } while (0)
+
+struct esp_modem_bond;
+
+/**
+ * @brief Link of the bond
+ *
+ */
+typedef struct {
+    struct esp_modem_bond *bond;           /*!< Bond of the link, for the event handlers */
+    esp_modem_bond_link_t link;            /*!< Link given on start */
+    volatile bool has_ip;                  /*!< Address obtained and not lost since */
+    volatile bool failed;                  /*!< Carrier lost, stalled or PPP stopped since the address */
+    esp_modem_netif_stats_t last;          /*!< Adapter statistics of the previous evaluation */
+    int64_t last_probe;                    /*!< Time of the last probe sent by the bond */
+    int probe_sock;                        /*!< UDP socket bound to the link for the echo server, -1 if none */
+    uint32_t probe_seq;                    /*!< Sequence number of the last probe of the echo server */
+    int64_t probe_sent;                    /*!< Time the probe in flight was sent, 0 if none */
+    uint32_t probe_rtt_ms;                 /*!< Smoothed round trip of the echo server, 0 if not measured yet */
+    uint32_t probe_misses;                 /*!< Probes of the echo server lost in a row */
+    uint32_t probe_count;                  /*!< Probes of the echo server sent */
+    uint32_t probe_lost;                   /*!< Probes of the echo server lost */
+    uint32_t last_probe_count;             /*!< probe_count of the previous evaluation */
+    uint32_t last_probe_lost;              /*!< probe_lost of the previous evaluation */
+    int32_t wrr_current;                   /*!< Smooth weighted round robin counter, under lock */
+    esp_modem_bond_link_status_t status;   /*!< Health, under lock */
+} esp_modem_bond_member_t;
+
+/**
+ * @brief Bond of cellular links
+ *
+ */
+struct esp_modem_bond {
+    esp_modem_bond_config_t config;                             /*!< Configuration */
+    esp_modem_bond_member_t members[ESP_MODEM_BOND_MAX_LINKS];  /*!< Links */
+    int count;                                                  /*!< Number of links */
+    int active;                                                 /*!< Active link, -1 if all are down, under lock */
+    int64_t last_eval;                                          /*!< Time of the last evaluation */
+    struct sockaddr_in probe_addr;                              /*!< Echo server, if config.probe_host is set */
+    TaskHandle_t task;                                          /*!< Bond task */
+    SemaphoreHandle_t exit_sem;                                 /*!< Given by the bond task on exit */
+    volatile bool stop;                                         /*!< Request the bond task to exit */
+    portMUX_TYPE lock;                                          /*!< Protects active and the status of the links */
+};
+
+static esp_modem_bond_member_t *esp_modem_bond_find(struct esp_modem_bond *bond, esp_netif_t *netif)
+{
+    for (int i = 0; i < bond->count; i++) {
+        if (bond->members[i].link.netif == netif) {
+            return &bond->members[i];
+        }
+    }
+    return NULL;
+}
+
+static void esp_modem_bond_on_ip_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    struct esp_modem_bond *bond = arg;
+    ip_event_got_ip_t *event = event_data;
+    esp_modem_bond_member_t *member = esp_modem_bond_find(bond, event->esp_netif);
+    if (!member) {
+        return;
+    }
+    if (event_id == IP_EVENT_PPP_GOT_IP) {
+        member->failed = false;
+        member->has_ip = true;
+    } else if (event_id == IP_EVENT_PPP_LOST_IP) {
+        member->has_ip = false;
+    }
+    xTaskNotifyGive(bond->task);
+}
+
+/**
+ * @brief Carrier loss, stall or end of the session, called from the DTE task of the link
+ *
+ */
+static void esp_modem_bond_on_link_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    esp_modem_bond_member_t *member = arg;
+    if (event_id == ESP_MODEM_EVENT_CARRIER_LOST || event_id == ESP_MODEM_EVENT_LINK_STALLED ||
+            event_id == ESP_MODEM_EVENT_LINK_DOWN || event_id == ESP_MODEM_EVENT_PPP_STOP) {
+        member->failed = true;
+        xTaskNotifyGive(member->bond->task);
+    }
+}
+
+/**
+ * @brief Link has an address, is not stalled and, with an echo server, answers it
+ */
+static bool esp_modem_bond_is_up(struct esp_modem_bond *bond, esp_modem_bond_member_t *member)
+{
+    return member->has_ip && !member->failed &&
+           (!bond->config.probe_host || member->probe_misses < bond->config.probe_max_misses);
+}
+
+/**
+ * @brief Score of a link: round trip and loss of the probes, weighted by the peak throughput
+ *
+ * score = 1000 * ref / (ref + rtt) * (1 - loss) * (1 + min(peak, ref_bps) / ref_bps) / 2
+ */
+static uint32_t esp_modem_bond_score(const esp_modem_bond_config_t *config, const esp_modem_bond_link_status_t *status)
+{
+    if (!status->up) {
+        return 0;
+    }
+    /* Not measured yet, taken as the reference */
+    uint64_t rtt = status->rtt_ms ? status->rtt_ms : config->rtt_ref_ms;
+    uint64_t score = (uint64_t)ESP_MODEM_BOND_SCORE_MAX * config->rtt_ref_ms / (config->rtt_ref_ms + rtt);
+    score = score * (100 - MIN(status->loss_pct, 100)) / 100;
+    uint64_t peak = MIN(status->peak_bps, config->throughput_ref_bps);
+    score = score * (config->throughput_ref_bps + peak) / (2 * (uint64_t)config->throughput_ref_bps);
+    /* A link that is up never scores 0, it still beats a link that is down */
+    return MAX(score, 1);
+}
+
+/**
+ * @brief Update the health of a link from the statistics of its adapter
+ */
+static void esp_modem_bond_measure(struct esp_modem_bond *bond, esp_modem_bond_member_t *member, uint32_t elapsed_ms,
+                                   esp_modem_bond_link_status_t *status)
+{
+    esp_modem_netif_stats_t stats;
+    esp_modem_netif_get_stats(member->link.netif_adapter, &stats);
+    uint32_t echoes = stats.keepalive_echoes - member->last.keepalive_echoes;
+    uint32_t misses = stats.keepalive_misses - member->last.keepalive_misses;
+    if (bond->config.probe_host) {
+        echoes = member->probe_count - member->last_probe_count;
+        misses = member->probe_lost - member->last_probe_lost;
+        member->last_probe_count = member->probe_count;
+        member->last_probe_lost = member->probe_lost;
+    }
+    if (echoes) {
+        uint32_t sample = MIN(misses * 100 / echoes, 100);
+        status->loss_pct = (3 * status->loss_pct + sample) / 4;
+    }
+    if (elapsed_ms) {
+        status->rx_bps = (uint64_t)(stats.rx_bytes - member->last.rx_bytes) * 1000 / elapsed_ms;
+        status->tx_bps = (uint64_t)(stats.tx_bytes - member->last.tx_bytes) * 1000 / elapsed_ms;
+    }
+    status->peak_bps = MAX(status->rx_bps + status->tx_bps, status->peak_bps - status->peak_bps / 64);
+    status->rtt_ms = bond->config.probe_host ? member->probe_rtt_ms : stats.keepalive_rtt_ms;
+    status->up = esp_modem_bond_is_up(bond, member);
+    if (!status->up) {
+        /* Loss starts over with the next session */
+        status->loss_pct = 0;
+    }
+    status->score = esp_modem_bond_score(&bond->config, status);
+    member->last = stats;
+}
+
+static void esp_modem_bond_post_switch(struct esp_modem_bond *bond, int from, int to, esp_modem_bond_reason_t reason)
+{
+    esp_modem_bond_switch_t event = {
+        .from = from,
+        .to = to,
+        .reason = reason
+    };
+    ESP_LOGI(BOND_TAG, "active link %d -> %d", from, to);
+    esp_modem_post_event(bond->members[to >= 0 ? to : from].link.dte, ESP_MODEM_EVENT_BOND_SWITCHED, &event,
+                         sizeof(event));
+}
+
+/**
+ * @brief Score all links and move the active link if needed
+ *
+ * @param full measure throughput and loss, false when woken up by a link event
+ */
+static void esp_modem_bond_evaluate(struct esp_modem_bond *bond, bool full)
+{
+    esp_modem_bond_link_status_t status[ESP_MODEM_BOND_MAX_LINKS];
+    int64_t now = esp_timer_get_time();
+    uint32_t elapsed_ms = full ? (now - bond->last_eval) / 1000 : 0;
+    int best = -1;
+    portENTER_CRITICAL(&bond->lock);
+    for (int i = 0; i < bond->count; i++) {
+        status[i] = bond->members[i].status;
+    }
+    int active = bond->active;
+    portEXIT_CRITICAL(&bond->lock);
+    for (int i = 0; i < bond->count; i++) {
+        esp_modem_bond_member_t *member = &bond->members[i];
+        if (full) {
+            esp_modem_bond_measure(bond, member, elapsed_ms, &status[i]);
+        } else {
+            status[i].up = esp_modem_bond_is_up(bond, member);
+            status[i].score = esp_modem_bond_score(&bond->config, &status[i]);
+        }
+        if (status[i].up && (best < 0 || status[i].score > status[best].score)) {
+            best = i;
+        }
+    }
+    if (full) {
+        bond->last_eval = now;
+    }
+    int next = active;
+    esp_modem_bond_reason_t reason = ESP_MODEM_BOND_SWITCH_SCORE;
+    if (active < 0) {
+        next = best;
+        reason = ESP_MODEM_BOND_SWITCH_UP;
+    } else if (!status[active].up) {
+        next = best;
+        reason = ESP_MODEM_BOND_SWITCH_FAILOVER;
+    } else if (best >= 0 && (uint64_t)status[best].score * 100 >
+               (uint64_t)status[active].score * (100 + bond->config.hysteresis_pct)) {
+        next = best;
+    }
+    if (next >= 0 && next != active) {
+        esp_netif_set_default_netif(bond->members[next].link.netif);
+    }
+    portENTER_CRITICAL(&bond->lock);
+    for (int i = 0; i < bond->count; i++) {
+        /* Flows are counted by the bind calls, not here */
+        status[i].flows = bond->members[i].status.flows;
+        bond->members[i].status = status[i];
+    }
+    bond->active = next;
+    portEXIT_CRITICAL(&bond->lock);
+    if (next != active) {
+        esp_modem_bond_post_switch(bond, active, next, reason);
+    }
+}
+
+static void esp_modem_bond_close_probe(esp_modem_bond_member_t *member)
+{
+    if (member->probe_sock >= 0) {
+        close(member->probe_sock);
+        member->probe_sock = -1;
+    }
+    member->probe_sent = 0;
+    member->probe_misses = 0;
+    member->probe_rtt_ms = 0;
+}
+
+/**
+ * @brief Open a non-blocking UDP socket bound to the link, for the echo server
+ */
+static esp_err_t esp_modem_bond_open_probe(esp_modem_bond_member_t *member)
+{
+    struct ifreq ifr = {0};
+    member->probe_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    BOND_CHECK(member->probe_sock >= 0, "create probe socket failed", err);
+    BOND_CHECK(esp_netif_get_netif_impl_name(member->link.netif, ifr.ifr_name) == ESP_OK,
+               "get interface name failed", err_sock);
+    BOND_CHECK(setsockopt(member->probe_sock, SOL_SOCKET, SO_BINDTODEVICE, &ifr, sizeof(ifr)) == 0,
+               "bind probe socket failed", err_sock);
+    BOND_CHECK(fcntl(member->probe_sock, F_SETFL, O_NONBLOCK) == 0, "set probe socket non-blocking failed", err_sock);
+    return ESP_OK;
+err_sock:
+    esp_modem_bond_close_probe(member);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Probe the links whose round trip is due, busy links included
+ */
+static void esp_modem_bond_probe(struct esp_modem_bond *bond)
+{
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < bond->count; i++) {
+        esp_modem_bond_member_t *member = &bond->members[i];
+        if (!member->has_ip || member->failed) {
+            /* The netif of the next session may differ, and so may the round trip */
+            esp_modem_bond_close_probe(member);
+            continue;
+        }
+        if (member->probe_sent || now - member->last_probe < (int64_t)bond->config.probe_interval_ms * 1000) {
+            continue;
+        }
+        member->last_probe = now;
+        if (!bond->config.probe_host) {
+            /* Refused while an echo request of the keepalive is in flight, which measures as well */
+            esp_modem_netif_probe(member->link.netif_adapter);
+            continue;
+        }
+        if (member->probe_sock < 0 && esp_modem_bond_open_probe(member) != ESP_OK) {
+            continue;
+        }
+        uint32_t seq = ++member->probe_seq;
+        member->probe_count++;
+        member->probe_sent = now;
+        if (sendto(member->probe_sock, &seq, sizeof(seq), 0, (struct sockaddr *)&bond->probe_addr,
+                   sizeof(bond->probe_addr)) != sizeof(seq)) {
+            /* No route or no buffer, lost as well, accounted for on timeout */
+            ESP_LOGD(BOND_TAG, "probe of link %d not sent", i);
+        }
+    }
+}
+
+/**
+ * @brief Collect the replies of the echo server and expire the probes in flight
+ *
+ * @return true if a link went up or down
+ */
+static bool esp_modem_bond_poll(struct esp_modem_bond *bond)
+{
+    bool changed = false;
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < bond->count; i++) {
+        esp_modem_bond_member_t *member = &bond->members[i];
+        if (member->probe_sock < 0) {
+            continue;
+        }
+        bool was_up = esp_modem_bond_is_up(bond, member);
+        uint32_t seq;
+        while (recv(member->probe_sock, &seq, sizeof(seq), 0) == sizeof(seq)) {
+            /* Late replies of expired probes are dropped, they were counted as lost */
+            if (member->probe_sent && seq == member->probe_seq) {
+                uint32_t rtt_ms = (now - member->probe_sent) / 1000;
+                member->probe_rtt_ms = member->probe_rtt_ms ? (3 * member->probe_rtt_ms + rtt_ms) / 4 : rtt_ms;
+                member->probe_sent = 0;
+                member->probe_misses = 0;
+            }
+        }
+        if (member->probe_sent && now - member->probe_sent >= (int64_t)bond->config.probe_timeout_ms * 1000) {
+            member->probe_sent = 0;
+            member->probe_lost++;
+            member->probe_misses++;
+            ESP_LOGD(BOND_TAG, "probe of link %d lost, %u in a row", i, member->probe_misses);
+        }
+        changed |= was_up != esp_modem_bond_is_up(bond, member);
+    }
+    return changed;
+}
+
+static bool esp_modem_bond_in_flight(struct esp_modem_bond *bond)
+{
+    for (int i = 0; i < bond->count; i++) {
+        if (bond->members[i].probe_sent) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void esp_modem_bond_task(void *param)
+{
+    struct esp_modem_bond *bond = param;
+    TickType_t period = pdMS_TO_TICKS(bond->config.eval_period_ms);
+    TickType_t next = xTaskGetTickCount() + period;
+    while (!bond->stop) {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = (int32_t)(next - now) > 0 ? next - now : 0;
+        if (esp_modem_bond_in_flight(bond)) {
+            /* lwIP cannot wake the task up, poll for the reply while the probe is in flight */
+            wait = MIN(wait, pdMS_TO_TICKS(ESP_MODEM_BOND_POLL_MS));
+        }
+        if (ulTaskNotifyTake(pdTRUE, wait)) {
+            /* A link changed state, fail over now and leave the measures to the period */
+            esp_modem_bond_evaluate(bond, false);
+            continue;
+        }
+        if (esp_modem_bond_poll(bond)) {
+            /* A link stopped or started answering the echo server */
+            esp_modem_bond_evaluate(bond, false);
+        }
+        if ((int32_t)(next - xTaskGetTickCount()) > 0) {
+            continue;
+        }
+        next += period;
+        if (bond->config.probe_interval_ms) {
+            esp_modem_bond_probe(bond);
+        }
+        esp_modem_bond_evaluate(bond, true);
+    }
+    for (int i = 0; i < bond->count; i++) {
+        esp_modem_bond_close_probe(&bond->members[i]);
+    }
+    xSemaphoreGive(bond->exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void esp_modem_bond_unregister(struct esp_modem_bond *bond, int count)
+{
+    for (int i = 0; i < count; i++) {
+        esp_modem_remove_event_handler(bond->members[i].link.dte, esp_modem_bond_on_link_event);
+    }
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_LOST_IP, esp_modem_bond_on_ip_event);
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_modem_bond_on_ip_event);
+}
+
+esp_modem_bond_handle_t esp_modem_bond_start(const esp_modem_bond_link_t *links, int count,
+                                             const esp_modem_bond_config_t *config)
+{
+    esp_netif_ip_info_t ip_info;
+    int registered = 0;
+    BOND_CHECK(links && count > 0 && count <= ESP_MODEM_BOND_MAX_LINKS && config, "invalid argument", err);
+    BOND_CHECK(config->eval_period_ms && config->rtt_ref_ms && config->throughput_ref_bps, "invalid configuration", err);
+    BOND_CHECK(!config->probe_host || (config->probe_interval_ms && config->probe_port && config->probe_timeout_ms &&
+                                       config->probe_max_misses), "invalid probe configuration", err);
+    struct esp_modem_bond *bond = calloc(1, sizeof(struct esp_modem_bond));
+    BOND_CHECK(bond, "calloc bond failed", err);
+    bond->config = *config;
+    if (config->probe_host) {
+        bond->probe_addr.sin_family = AF_INET;
+        bond->probe_addr.sin_port = htons(config->probe_port);
+        BOND_CHECK(inet_aton(config->probe_host, &bond->probe_addr.sin_addr), "invalid probe host %s", err_link,
+                   config->probe_host);
+    }
+    bond->count = count;
+    bond->active = -1;
+    bond->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    for (int i = 0; i < count; i++) {
+        esp_modem_bond_member_t *member = &bond->members[i];
+        BOND_CHECK(links[i].dte && links[i].netif_adapter && links[i].netif, "invalid link %d", err_link, i);
+        member->bond = bond;
+        member->link = links[i];
+        member->probe_sock = -1;
+        /* Links may be up before the bond */
+        member->has_ip = esp_netif_get_ip_info(links[i].netif, &ip_info) == ESP_OK && ip_info.ip.addr;
+        esp_modem_netif_get_stats(links[i].netif_adapter, &member->last);
+    }
+    bond->last_eval = esp_timer_get_time();
+    bond->exit_sem = xSemaphoreCreateBinary();
+    BOND_CHECK(bond->exit_sem, "create exit semaphore failed", err_link);
+    /* The task exists before the handlers that notify it, and waits for the first period */
+    BaseType_t ret = xTaskCreate(esp_modem_bond_task, "bond", config->task_stack_size, bond,
+                                 config->task_priority, &bond->task);
+    BOND_CHECK(ret == pdTRUE, "create bond task failed", err_task);
+    BOND_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_modem_bond_on_ip_event, bond) == ESP_OK,
+               "register got ip handler failed", err_handler);
+    BOND_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_LOST_IP, esp_modem_bond_on_ip_event, bond) == ESP_OK,
+               "register lost ip handler failed", err_handler);
+    for (; registered < count; registered++) {
+        /* Registered for any event, esp_modem_remove_event_handler() only removes those */
+        BOND_CHECK(esp_modem_set_event_handler(links[registered].dte, esp_modem_bond_on_link_event, ESP_EVENT_ANY_ID,
+                                               &bond->members[registered]) == ESP_OK,
+                   "register link handler failed", err_handler);
+    }
+    /* Pick the active link among those already up */
+    xTaskNotifyGive(bond->task);
+    return bond;
+err_handler:
+    esp_modem_bond_unregister(bond, registered);
+    bond->stop = true;
+    xTaskNotifyGive(bond->task);
+    xSemaphoreTake(bond->exit_sem, portMAX_DELAY);
+err_task:
+    vSemaphoreDelete(bond->exit_sem);
+err_link:
+    free(bond);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_bond_stop(esp_modem_bond_handle_t bond)
+{
+    BOND_CHECK(bond, "invalid argument", err);
+    esp_modem_bond_unregister(bond, bond->count);
+    bond->stop = true;
+    xTaskNotifyGive(bond->task);
+    xSemaphoreTake(bond->exit_sem, portMAX_DELAY);
+    vSemaphoreDelete(bond->exit_sem);
+    free(bond);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+int esp_modem_bond_get_active(esp_modem_bond_handle_t bond)
+{
+    BOND_CHECK(bond, "invalid argument", err);
+    portENTER_CRITICAL(&bond->lock);
+    int active = bond->active;
+    portEXIT_CRITICAL(&bond->lock);
+    return active;
+err:
+    return -1;
+}
+
+/**
+ * @brief Pick the link of a new flow, under lock
+ *
+ * Smooth weighted round robin: every link that is up gains its score, the one ahead is picked and
+ * pays back the total, so that links get flows in proportion to their score, evenly interleaved.
+ */
+static int esp_modem_bond_pick(struct esp_modem_bond *bond)
+{
+    if (bond->config.mode == ESP_MODEM_BOND_ACTIVE_BACKUP) {
+        return bond->active;
+    }
+    int32_t total = 0;
+    int pick = -1;
+    for (int i = 0; i < bond->count; i++) {
+        esp_modem_bond_member_t *member = &bond->members[i];
+        if (!member->status.up) {
+            member->wrr_current = 0;
+            continue;
+        }
+        member->wrr_current += member->status.score;
+        total += member->status.score;
+        if (pick < 0 || member->wrr_current > bond->members[pick].wrr_current) {
+            pick = i;
+        }
+    }
+    if (pick >= 0) {
+        bond->members[pick].wrr_current -= total;
+    }
+    return pick;
+}
+
+int esp_modem_bond_bind_socket(esp_modem_bond_handle_t bond, int sock)
+{
+    struct ifreq ifr = {0};
+    BOND_CHECK(bond && sock >= 0, "invalid argument", err);
+    portENTER_CRITICAL(&bond->lock);
+    int link = esp_modem_bond_pick(bond);
+    if (link >= 0) {
+        bond->members[link].status.flows++;
+    }
+    portEXIT_CRITICAL(&bond->lock);
+    BOND_CHECK(link >= 0, "no link up", err);
+    BOND_CHECK(esp_netif_get_netif_impl_name(bond->members[link].link.netif, ifr.ifr_name) == ESP_OK,
+               "get interface name failed", err_bind);
+    BOND_CHECK(setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, &ifr, sizeof(ifr)) == 0, "bind to link %d failed",
+               err_bind, link);
+    return link;
+err_bind:
+    esp_modem_bond_release_socket(bond, link);
+err:
+    return -1;
+}
+
+esp_err_t esp_modem_bond_release_socket(esp_modem_bond_handle_t bond, int link)
+{
+    BOND_CHECK(bond && link >= 0 && link < bond->count, "invalid argument", err);
+    portENTER_CRITICAL(&bond->lock);
+    if (bond->members[link].status.flows) {
+        bond->members[link].status.flows--;
+    }
+    portEXIT_CRITICAL(&bond->lock);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_bond_get_status(esp_modem_bond_handle_t bond, int link, esp_modem_bond_link_status_t *status)
+{
+    BOND_CHECK(bond && link >= 0 && link < bond->count && status, "invalid argument", err);
+    portENTER_CRITICAL(&bond->lock);
+    *status = bond->members[link].status;
+    portEXIT_CRITICAL(&bond->lock);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,209 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_netif.h"
+#include "esp_modem_dte.h"
+
+/**
+ * @brief Specific Length Constraint
+ *
+ */
+#define ESP_MODEM_BOND_MAX_LINKS (3) /*!< Max links in a bond */
+
+/**
+ * @brief How new flows are spread over the links
+ *
+ */
+typedef enum {
+    ESP_MODEM_BOND_ACTIVE_BACKUP = 0, /*!< All flows on the best link, the others stand by */
+    ESP_MODEM_BOND_SPREAD             /*!< Flows bound with esp_modem_bond_bind_socket() spread by score */
+} esp_modem_bond_mode_t;
+
+/**
+ * @brief Why the active link changed
+ *
+ */
+typedef enum {
+    ESP_MODEM_BOND_SWITCH_FAILOVER = 0, /*!< The active link went down, stalled or stopped answering the probes */
+    ESP_MODEM_BOND_SWITCH_SCORE,        /*!< Another link scored better by more than the hysteresis */
+    ESP_MODEM_BOND_SWITCH_UP            /*!< First link up, or a link up again after all were down */
+} esp_modem_bond_reason_t;
+
+/**
+ * @brief Data of ESP_MODEM_EVENT_BOND_SWITCHED
+ *
+ */
+typedef struct {
+    int from;                       /*!< Previous active link, -1 if none */
+    int to;                         /*!< New active link, -1 if all links are down */
+    esp_modem_bond_reason_t reason; /*!< Why the active link changed */
+} esp_modem_bond_switch_t;
+
+/**
+ * @brief One link of the bond
+ *
+ */
+typedef struct {
+    modem_dte_t *dte;    /*!< Modem DTE object */
+    void *netif_adapter; /*!< Adapter from esp_modem_netif_setup(), its keepalive started */
+    esp_netif_t *netif;  /*!< esp-netif the adapter is attached to */
+} esp_modem_bond_link_t;
+
+/**
+ * @brief Bond configuration
+ *
+ */
+typedef struct {
+    esp_modem_bond_mode_t mode;   /*!< How new flows are spread */
+    uint32_t eval_period_ms;      /*!< Scoring period */
+    uint32_t probe_interval_ms;   /*!< Probe period of each link, busy or not, 0 to rely on the keepalive */
+    const char *probe_host;       /*!< IPv4 address of a UDP echo server probed over each link, NULL to probe with LCP echo requests */
+    uint16_t probe_port;          /*!< UDP port of the echo server */
+    uint32_t probe_timeout_ms;    /*!< Time after which a probe of the echo server counts as lost */
+    uint32_t probe_max_misses;    /*!< Probes of the echo server lost in a row that take the link down */
+    uint32_t rtt_ref_ms;          /*!< Round trip that halves the score */
+    uint32_t throughput_ref_bps;  /*!< Peak throughput from which a link gets its full score, unit: bytes/s */
+    uint32_t hysteresis_pct;      /*!< Score advantage needed to move the active link off a working one */
+    uint32_t task_stack_size;     /*!< Stack size of the bond task */
+    uint32_t task_priority;       /*!< Priority of the bond task */
+} esp_modem_bond_config_t;
+
+/**
+ * @brief Bond default configuration
+ *
+ */
+#define ESP_MODEM_BOND_DEFAULT_CONFIG()          \
+    {                                            \
+        .mode = ESP_MODEM_BOND_ACTIVE_BACKUP,    \
+        .eval_period_ms = 500,                   \
+        .probe_interval_ms = 2000,               \
+        .probe_host = NULL,                      \
+        .probe_port = 7,                         \
+        .probe_timeout_ms = 1000,                \
+        .probe_max_misses = 2,                   \
+        .rtt_ref_ms = 300,                       \
+        .throughput_ref_bps = 20000,             \
+        .hysteresis_pct = 25,                    \
+        .task_stack_size = 3072,                 \
+        .task_priority = 6                       \
+    }
+
+/**
+ * @brief Health of one link, as of the last evaluation
+ *
+ */
+typedef struct {
+    bool up;              /*!< Link has an address, is not stalled and answers the probes */
+    uint32_t score;       /*!< Health score, 0 (down) to 1000 */
+    uint32_t rtt_ms;      /*!< Smoothed round trip of the probes, 0 if not measured yet */
+    uint32_t loss_pct;    /*!< Smoothed share of unanswered probes */
+    uint32_t rx_bps;      /*!< Receive throughput of the last period, unit: bytes/s */
+    uint32_t tx_bps;      /*!< Transmit throughput of the last period, unit: bytes/s */
+    uint32_t peak_bps;    /*!< Slowly decaying peak of rx_bps + tx_bps, unit: bytes/s */
+    uint32_t flows;       /*!< Sockets bound to the link */
+} esp_modem_bond_link_status_t;
+
+typedef struct esp_modem_bond *esp_modem_bond_handle_t;
+
+/**
+ * @brief Bond cellular links, steer new flows to the best one and fail over when it goes down
+ *
+ * Each link is scored from the round trip and loss of its probes and from its peak throughput. The
+ * best link becomes the default netif, which carries the flows opened afterwards. Carrier loss,
+ * keepalive stall, end of the PPP session or loss of the address of the active link moves the
+ * default netif to the next best link right away, without waiting for the scoring period.
+ * Changes of the active link are posted as ESP_MODEM_EVENT_BOND_SWITCHED on the event loop of the
+ * new active link, or of the former one if no link is left.
+ *
+ * With config->probe_host set, each link probes a UDP echo server through the carrier. A link whose
+ * last config->probe_max_misses probes were lost is down, which catches a carrier that stopped
+ * forwarding while the PPP session stays up. Probes go out on the evaluation period, one at a time
+ * per link, so with eval_period_ms and probe_interval_ms below probe_timeout_ms a black hole is
+ * detected within about probe_max_misses * probe_timeout_ms, e.g. 800 ms with 250, 250, 400 and 2.
+ * Without it, the probes are the LCP echo requests of the keepalive. The module answers those
+ * itself, so they only measure the UART and the module, and only carrier loss, keepalive stall, end
+ * of the PPP session and loss of the address trigger a failover.
+ *
+ * The keepalive should be started on each link with a short reply timeout so that a stall is
+ * detected within a second. Flows already open stay on their link, lwIP has no policy routing.
+ *
+ * @param links links to bond
+ * @param count number of links, at most ESP_MODEM_BOND_MAX_LINKS
+ * @param config bond configuration
+ * @return esp_modem_bond_handle_t bond handle, NULL on error
+ */
+esp_modem_bond_handle_t esp_modem_bond_start(const esp_modem_bond_link_t *links, int count,
+                                             const esp_modem_bond_config_t *config);
+
+/**
+ * @brief Stop bonding, the default netif is left as is
+ *
+ * @param bond bond handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_bond_stop(esp_modem_bond_handle_t bond);
+
+/**
+ * @brief Get the active link
+ *
+ * @param bond bond handle
+ * @return index of the active link, -1 if all links are down
+ */
+int esp_modem_bond_get_active(esp_modem_bond_handle_t bond);
+
+/**
+ * @brief Bind a socket to a link before it connects or sends
+ *
+ * In ESP_MODEM_BOND_ACTIVE_BACKUP mode the socket goes to the active link. In ESP_MODEM_BOND_SPREAD
+ * mode sockets are dealt over the links that are up by weighted round robin on their score, for
+ * more aggregate uplink throughput. The socket stays on the link if it goes down.
+ *
+ * @param bond bond handle
+ * @param sock socket to bind
+ * @return index of the link, -1 on error or if all links are down
+ */
+int esp_modem_bond_bind_socket(esp_modem_bond_handle_t bond, int sock);
+
+/**
+ * @brief Release a socket bound with esp_modem_bond_bind_socket(), before it is closed
+ *
+ * @param bond bond handle
+ * @param link index of the link returned on bind
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_bond_release_socket(esp_modem_bond_handle_t bond, int link);
+
+/**
+ * @brief Get the health of a link, without blocking
+ *
+ * @param bond bond handle
+ * @param link index of the link
+ * @param status health of the link
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_bond_get_status(esp_modem_bond_handle_t bond, int link, esp_modem_bond_link_status_t *status);
+
+#ifdef __cplusplus
+}
+#endif
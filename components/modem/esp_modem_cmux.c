@@ -0,0 +1,149 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_modem_cmux.h"
+
+#define CMUX_FCS_GOOD (0xCF)
+
+/**
+ * @brief Decoder states, one per field
+ *
+ */
+enum {
+    CMUX_STATE_SYNC = 0, /*!< Looking for an opening flag */
+    CMUX_STATE_ADDRESS,
+    CMUX_STATE_CONTROL,
+    CMUX_STATE_LENGTH,
+    CMUX_STATE_LENGTH_EXT,
+    CMUX_STATE_INFO,
+    CMUX_STATE_FCS,
+    CMUX_STATE_CLOSE
+};
+
+/**
+ * @brief CRC-8 of 27.010 (x^8 + x^2 + x + 1, reflected)
+ *
+ */
+static uint8_t esp_modem_cmux_crc(uint8_t crc, const uint8_t *data, size_t len)
+{
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xE0 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+void esp_modem_cmux_decoder_init(esp_modem_cmux_decoder_t *decoder, uint8_t *buffer, size_t size)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->info = buffer;
+    decoder->size = size;
+}
+
+void esp_modem_cmux_decode(esp_modem_cmux_decoder_t *decoder, const uint8_t *data, size_t len,
+                           esp_modem_cmux_frame_cb_t frame_cb, void *context)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        switch (decoder->state) {
+        case CMUX_STATE_SYNC:
+            if (c == ESP_MODEM_CMUX_FLAG) {
+                decoder->state = CMUX_STATE_ADDRESS;
+            }
+            break;
+        case CMUX_STATE_ADDRESS:
+            /* Flags may repeat between frames */
+            if (c == ESP_MODEM_CMUX_FLAG) {
+                break;
+            }
+            decoder->header[0] = c;
+            decoder->header_len = 1;
+            decoder->state = (c & ESP_MODEM_CMUX_EA) ? CMUX_STATE_CONTROL : CMUX_STATE_SYNC;
+            break;
+        case CMUX_STATE_CONTROL:
+            decoder->header[decoder->header_len++] = c;
+            decoder->state = CMUX_STATE_LENGTH;
+            break;
+        case CMUX_STATE_LENGTH:
+            decoder->header[decoder->header_len++] = c;
+            decoder->length = c >> 1;
+            decoder->received = 0;
+            if (!(c & ESP_MODEM_CMUX_EA)) {
+                decoder->state = CMUX_STATE_LENGTH_EXT;
+            } else {
+                decoder->state = decoder->length ? CMUX_STATE_INFO : CMUX_STATE_FCS;
+            }
+            break;
+        case CMUX_STATE_LENGTH_EXT:
+            decoder->header[decoder->header_len++] = c;
+            decoder->length |= (uint16_t)c << 7;
+            decoder->state = decoder->length ? CMUX_STATE_INFO : CMUX_STATE_FCS;
+            break;
+        case CMUX_STATE_INFO:
+            if (decoder->received < decoder->size) {
+                decoder->info[decoder->received] = c;
+            }
+            if (++decoder->received == decoder->length) {
+                decoder->state = CMUX_STATE_FCS;
+            }
+            break;
+        case CMUX_STATE_FCS:
+            decoder->fcs = c;
+            decoder->state = CMUX_STATE_CLOSE;
+            break;
+        case CMUX_STATE_CLOSE:
+            if (c != ESP_MODEM_CMUX_FLAG) {
+                decoder->state = CMUX_STATE_SYNC;
+                break;
+            }
+            /* The closing flag may open the next frame */
+            decoder->state = CMUX_STATE_ADDRESS;
+            /* The FCS of UIH frames only covers the header, other frames have no information field */
+            if (esp_modem_cmux_crc(esp_modem_cmux_crc(0xFF, decoder->header, decoder->header_len), &decoder->fcs, 1) !=
+                    CMUX_FCS_GOOD || decoder->length > decoder->size) {
+                break;
+            }
+            frame_cb(context, decoder->header[0] >> 2, decoder->header[1], decoder->info, decoder->length);
+            break;
+        default:
+            decoder->state = CMUX_STATE_SYNC;
+            break;
+        }
+    }
+}
+
+size_t esp_modem_cmux_encode(uint8_t dlci, uint8_t control, bool command, const uint8_t *info, size_t len,
+                             uint8_t *frame)
+{
+    size_t pos = 0;
+    frame[pos++] = ESP_MODEM_CMUX_FLAG;
+    frame[pos++] = (dlci << 2) | (command ? ESP_MODEM_CMUX_CR : 0) | ESP_MODEM_CMUX_EA;
+    frame[pos++] = control;
+    if (len < 128) {
+        frame[pos++] = (len << 1) | ESP_MODEM_CMUX_EA;
+    } else {
+        frame[pos++] = (len & 0x7F) << 1;
+        frame[pos++] = len >> 7;
+    }
+    uint8_t fcs = 0xFF - esp_modem_cmux_crc(0xFF, frame + 1, pos - 1);
+    if (len) {
+        memcpy(frame + pos, info, len);
+        pos += len;
+    }
+    frame[pos++] = fcs;
+    frame[pos++] = ESP_MODEM_CMUX_FLAG;
+    return pos;
+}
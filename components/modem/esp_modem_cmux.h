@@ -0,0 +1,108 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 3GPP TS 27.010 basic option framing
+ *
+ */
+#define ESP_MODEM_CMUX_FLAG (0xF9)          /*!< Opening and closing flag */
+#define ESP_MODEM_CMUX_EA (0x01)            /*!< Extension bit, set on the last byte of a field */
+#define ESP_MODEM_CMUX_CR (0x02)            /*!< Command/response bit */
+#define ESP_MODEM_CMUX_PF (0x10)            /*!< Poll/final bit */
+#define ESP_MODEM_CMUX_SABM (0x2F)          /*!< Set asynchronous balanced mode, opens a channel */
+#define ESP_MODEM_CMUX_UA (0x63)            /*!< Unnumbered acknowledgement */
+#define ESP_MODEM_CMUX_DM (0x0F)            /*!< Disconnected mode */
+#define ESP_MODEM_CMUX_DISC (0x43)          /*!< Disconnect, closes a channel */
+#define ESP_MODEM_CMUX_UIH (0xEF)           /*!< Unnumbered information with header check */
+#define ESP_MODEM_CMUX_UI (0x03)            /*!< Unnumbered information */
+#define ESP_MODEM_CMUX_MSC (0xE0)           /*!< Modem status command, on the control channel */
+#define ESP_MODEM_CMUX_CLD (0xC0)           /*!< Multiplexer close down, on the control channel */
+#define ESP_MODEM_CMUX_V24_RTC (0x04)       /*!< Ready to communicate (DTR) in the V.24 signals of MSC */
+#define ESP_MODEM_CMUX_V24_RTR (0x08)       /*!< Ready to receive (RTS) in the V.24 signals of MSC */
+#define ESP_MODEM_CMUX_V24_DV (0x80)        /*!< Data valid (DCD) in the V.24 signals of MSC */
+#define ESP_MODEM_CMUX_FRAME_OVERHEAD (7)   /*!< Flags, address, control, two length bytes and FCS */
+
+/**
+ * @brief Called for each frame received with a valid FCS
+ *
+ * @param context context given to esp_modem_cmux_decode()
+ * @param dlci channel of the frame
+ * @param control control field, poll/final bit included
+ * @param info information field
+ * @param len length of the information field
+ */
+typedef void (*esp_modem_cmux_frame_cb_t)(void *context, uint8_t dlci, uint8_t control, const uint8_t *info, size_t len);
+
+/**
+ * @brief Frame decoder, resumable across reads
+ *
+ */
+typedef struct {
+    uint8_t state;      /*!< Field being received */
+    uint8_t header[4];  /*!< Address, control and length fields, for the FCS */
+    uint8_t header_len; /*!< Bytes in header */
+    uint16_t length;    /*!< Length of the information field */
+    uint16_t received;  /*!< Bytes of the information field received */
+    uint8_t fcs;        /*!< Received FCS */
+    uint8_t *info;      /*!< Buffer of the information field */
+    size_t size;        /*!< Size of info, longer frames are dropped */
+} esp_modem_cmux_decoder_t;
+
+/**
+ * @brief Initialize a frame decoder
+ *
+ * @param decoder frame decoder
+ * @param buffer buffer of the information field, at least N1 bytes
+ * @param size size of buffer
+ */
+void esp_modem_cmux_decoder_init(esp_modem_cmux_decoder_t *decoder, uint8_t *buffer, size_t size);
+
+/**
+ * @brief Decode received bytes
+ *
+ * @param decoder frame decoder
+ * @param data received bytes
+ * @param len number of bytes
+ * @param frame_cb called for each complete frame
+ * @param context passed to frame_cb
+ */
+void esp_modem_cmux_decode(esp_modem_cmux_decoder_t *decoder, const uint8_t *data, size_t len,
+                           esp_modem_cmux_frame_cb_t frame_cb, void *context);
+
+/**
+ * @brief Encode a frame sent by the initiator of the multiplexer
+ *
+ * @param dlci channel
+ * @param control control field
+ * @param command true for a command frame, false for a response
+ * @param info information field, may be NULL if len is 0
+ * @param len length of the information field, at most 32767
+ * @param frame output, len + ESP_MODEM_CMUX_FRAME_OVERHEAD bytes
+ * @return length of the frame
+ */
+size_t esp_modem_cmux_encode(uint8_t dlci, uint8_t control, bool command, const uint8_t *info, size_t len,
+                             uint8_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
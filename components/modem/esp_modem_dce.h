@@ -45,6 +45,10 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_MAX_OPERATOR_LENGTH (32) /*!< Max Operator Name Length */
 #define MODEM_IMEI_LENGTH (15)         /*!< IMEI Number Length */
 #define MODEM_IMSI_LENGTH (15)         /*!< IMSI Number Length */
+#define MODEM_ICCID_LENGTH (20)        /*!< Max ICCID Number Length */
+#define MODEM_MAX_APN_LENGTH (64)      /*!< Max Access Point Name Length */
+#define MODEM_MAX_PDP_CONTEXTS (4)     /*!< Max PDP Contexts Defined in One Batch */
+#define MODEM_MAX_PDP_CID (31)         /*!< Max PDP Context Identifier */
 
 /**
  * @brief Specific Timeout Constraint, Unit: millisecond
@@ -55,6 +59,15 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_COMMAND_TIMEOUT_MODE_CHANGE (3000) /*!< Timeout value for changing working mode */
 #define MODEM_COMMAND_TIMEOUT_HANG_UP (90000)    /*!< Timeout value for hang up */
 #define MODEM_COMMAND_TIMEOUT_POWEROFF (1000)    /*!< Timeout value for power down */
+#define MODEM_COMMAND_TIMEOUT_FUNCTIONALITY (15000) /*!< Timeout value for changing phone functionality */
+#define MODEM_COMMAND_TIMEOUT_SOCKET (150000)       /*!< Timeout value for bringing up the IP stack of the module or connecting a socket */
+#define MODEM_COMMAND_TIMEOUT_SOCKET_DATA (10000)   /*!< Timeout value for sending, reading or closing a socket */
+
+/**
+ * @brief Socket offload limits
+ *
+ */
+#define MODEM_SOCKET_PAYLOAD_MAX (1460) /*!< Max payload of one send or read command */
 
 /**
  * @brief Working state of DCE
@@ -66,6 +79,143 @@ typedef enum {
     MODEM_STATE_FAIL        /*!< Process failed */
 } modem_state_t;
 
+/**
+ * @brief Network registration status, as reported by +CREG/+CEREG
+ *
+ */
+typedef enum {
+    MODEM_REG_NOT_REGISTERED = 0, /*!< Not registered, not searching */
+    MODEM_REG_HOME = 1,           /*!< Registered, home network */
+    MODEM_REG_SEARCHING = 2,      /*!< Not registered, searching */
+    MODEM_REG_DENIED = 3,         /*!< Registration denied */
+    MODEM_REG_UNKNOWN = 4,        /*!< Unknown */
+    MODEM_REG_ROAMING = 5         /*!< Registered, roaming */
+} modem_reg_status_t;
+
+/**
+ * @brief PDP context, see esp_modem_dce_define_pdp_contexts()
+ *
+ */
+typedef struct {
+    uint32_t cid;     /*!< Context identifier, 1 to MODEM_MAX_PDP_CID */
+    const char *type; /*!< Protocol type, e.g. "IP" */
+    const char *apn;  /*!< Access point name */
+} modem_pdp_context_t;
+
+/**
+ * @brief Access technology of eDRX settings, see AT+CEDRXS
+ *
+ */
+typedef enum {
+    MODEM_EDRX_ACT_LTE_M = 4, /*!< E-UTRAN, LTE-M */
+    MODEM_EDRX_ACT_NB_IOT = 5 /*!< E-UTRAN, NB-IoT */
+} modem_edrx_act_t;
+
+/**
+ * @brief Radio access technology
+ *
+ */
+typedef enum {
+    MODEM_RAT_AUTO = 0, /*!< Chosen by the module */
+    MODEM_RAT_GSM,      /*!< GSM */
+    MODEM_RAT_LTE_M,    /*!< LTE-M */
+    MODEM_RAT_NB_IOT,   /*!< NB-IoT */
+    MODEM_RAT_MAX
+} modem_rat_t;
+
+/**
+ * @brief Socket of the IP stack of the module
+ *
+ */
+typedef enum {
+    MODEM_SOCKET_TCP = 0, /*!< TCP client */
+    MODEM_SOCKET_UDP      /*!< UDP, to one peer */
+} modem_socket_type_t;
+
+/**
+ * @brief Socket event, as reported by the unsolicited result codes of the module
+ *
+ */
+typedef struct {
+    int id;      /*!< Socket of the module, -1 for all sockets when the IP stack went down */
+    bool closed; /*!< Closed by the peer or the network, otherwise data arrived */
+} modem_socket_event_t;
+
+/**
+ * @brief Session of the MQTT client of the module
+ *
+ */
+typedef struct {
+    const char *host;      /*!< Broker host name or address */
+    uint16_t port;         /*!< Broker port */
+    const char *client_id; /*!< Client identifier */
+    const char *username;  /*!< User name, NULL for none */
+    const char *password;  /*!< Password, NULL for none */
+    uint32_t keepalive_s;  /*!< Keep alive interval, unit: s */
+    bool clean_session;    /*!< Start without the subscriptions of a previous session */
+} modem_mqtt_config_t;
+
+/**
+ * @brief MQTT event, as reported by the unsolicited result codes of the module
+ *
+ */
+typedef struct {
+    bool connected;     /*!< Session up, false once the module lost the broker */
+    bool truncated;     /*!< Message cut by the line buffer or a line break of its own, topic and message left out */
+    uint16_t topic_len; /*!< Length of the topic of a message, 0 for a session change */
+    uint16_t data_len;  /*!< Length of the message */
+    char content[];     /*!< Topic then message, not terminated */
+} modem_mqtt_event_t;
+
+/**
+ * @brief Response of the HTTP client of the module, its body held by the module
+ *
+ */
+typedef struct {
+    int status;    /*!< HTTP status code */
+    size_t length; /*!< Length of the body, read with http_read */
+} modem_http_response_t;
+
+/**
+ * @brief Position output of the GNSS receiver of the module, on the AT port
+ *
+ */
+typedef enum {
+    MODEM_GNSS_OFF = 0,  /*!< Receiver powered off */
+    MODEM_GNSS_NAV_INFO, /*!< Navigation information line per report, e.g. +UGNSINF */
+    MODEM_GNSS_NMEA      /*!< NMEA sentences */
+} modem_gnss_output_t;
+
+/**
+ * @brief Sleep state of the module, as reported by its unsolicited result codes
+ *
+ */
+typedef enum {
+    MODEM_SLEEP_AWAKE = 0, /*!< Connected, or idle and reachable by paging */
+    MODEM_SLEEP_PSM        /*!< Power saving mode, unreachable until the periodic TAU or uplink data */
+} modem_sleep_state_t;
+
+/**
+ * @brief PSM and eDRX granted by the network, sleep and connection state
+ *
+ */
+typedef struct {
+    bool psm;                        /*!< PSM granted */
+    uint32_t periodic_tau_s;         /*!< Granted periodic TAU (T3412), unit: s */
+    uint32_t active_time_s;          /*!< Granted active time (T3324), reachable time once idle, unit: s */
+    bool edrx;                       /*!< eDRX granted */
+    uint32_t edrx_cycle_ms;          /*!< Granted eDRX cycle, unit: ms */
+    uint32_t paging_window_ms;       /*!< Granted paging time window, unit: ms */
+    modem_sleep_state_t sleep_state; /*!< Sleep state */
+    int64_t sleep_state_since;       /*!< Time of the last sleep state change, since boot, unit: us */
+    bool connected;                  /*!< RRC connected, as reported by +CSCON */
+    int64_t connected_since;         /*!< Time of the last connection state change, since boot, unit: us */
+    uint32_t last_connected_ms;      /*!< Length of the last connected period, unit: ms */
+    uint64_t connected_total_ms;     /*!< Time spent connected since tracking started, unit: ms */
+    int64_t release_requested;       /*!< Time early release was requested in the current connection, 0 if not, unit: us */
+    uint32_t last_release_ms;        /*!< Request to idle delay of the last connection, 0 if released by the network alone, unit: ms */
+} modem_power_save_t;
+
 /**
  * @brief DCE(Data Communication Equipment)
  *
@@ -75,10 +225,18 @@ struct modem_dce {
     char imsi[MODEM_IMSI_LENGTH + 1];                                                 /*!< IMSI number */
     char name[MODEM_MAX_NAME_LENGTH];                                                 /*!< Module name */
     char oper[MODEM_MAX_OPERATOR_LENGTH];                                             /*!< Operator name */
+    char iccid[MODEM_ICCID_LENGTH + 1];                                               /*!< ICCID number of the SIM */
+    char apn[MODEM_MAX_APN_LENGTH];                                                   /*!< Access point name of the data call */
+    uint32_t cid;                                                                     /*!< PDP context dialed by the data call */
+    uint32_t pdp_defined;                                                             /*!< Contexts defined by esp_modem_dce_define_pdp_contexts(), bit per cid */
     modem_state_t state;                                                              /*!< Modem working state */
     modem_mode_t mode;                                                                /*!< Working mode */
+    bool dtr_switch;                                                                  /*!< Data mode is left by dropping DTR (AT&D1) */
+    bool data_suspended;                                                              /*!< Data call kept up in command mode, resumed by ATO */
+    modem_power_save_t power_save;                                                    /*!< PSM and eDRX granted, sleep and connection state, see esp_modem_dce_read_power_save() */
     modem_dte_t *dte;                                                                 /*!< DTE which connect to DCE */
-    esp_err_t (*handle_line)(modem_dce_t *dce, const char *line);                     /*!< Handle line strategy */
+    modem_line_handler_t handle_line;                                                 /*!< Handle line strategy, set by the DTE for the command in flight */
+    void *handle_line_ctx;                                                            /*!< Context of handle line strategy */
     esp_err_t (*sync)(modem_dce_t *dce);                                              /*!< Synchronization */
     esp_err_t (*echo_mode)(modem_dce_t *dce, bool on);                                /*!< Echo command on or off */
     esp_err_t (*store_profile)(modem_dce_t *dce);                                     /*!< Store user settings */
@@ -90,9 +248,54 @@ struct modem_dce {
                                     const char *type, const char *apn); /*!< Set PDP Contex */
     esp_err_t (*set_working_mode)(modem_dce_t *dce, modem_mode_t mode); /*!< Set working mode */
     esp_err_t (*hang_up)(modem_dce_t *dce);                             /*!< Hang up */
-    esp_err_t (*power_up)();                                            /*!< Normal power up */
+    esp_err_t (*get_module_name)(modem_dce_t *dce);                     /*!< Query module name */
+    esp_err_t (*get_imei_number)(modem_dce_t *dce);                     /*!< Query IMEI number */
+    esp_err_t (*get_imsi_number)(modem_dce_t *dce);                     /*!< Query IMSI number */
+    esp_err_t (*get_iccid_number)(modem_dce_t *dce);                    /*!< Query ICCID number */
+    esp_err_t (*get_operator_name)(modem_dce_t *dce);                   /*!< Query operator name */
+    esp_err_t (*get_band_hint)(modem_dce_t *dce, char *hint, size_t len); /*!< Band configuration restricted to the serving band */
+    esp_err_t (*set_band_config)(modem_dce_t *dce, const char *config);   /*!< Apply band configuration, NULL for all bands */
+    esp_err_t (*set_rat)(modem_dce_t *dce, modem_rat_t rat);              /*!< Restrict to one radio access technology, NULL if not supported */
+    esp_err_t (*get_serving_cell)(modem_dce_t *dce, modem_rat_t *rat,
+                                  uint32_t *cell_id);                     /*!< Query serving technology and cell, NULL if not supported */
+    esp_err_t (*set_psm)(modem_dce_t *dce, bool on, uint32_t periodic_tau_s,
+                         uint32_t active_time_s);                       /*!< Request PSM timers, NULL if not supported */
+    esp_err_t (*set_edrx)(modem_dce_t *dce, bool on, modem_edrx_act_t act,
+                          uint32_t cycle_ms);                           /*!< Request eDRX cycle, NULL if not supported */
+    esp_err_t (*get_power_save)(modem_dce_t *dce);                      /*!< Query PSM and eDRX granted, NULL if not supported */
+    esp_err_t (*release_connection)(modem_dce_t *dce);                  /*!< Request early release of the connection, NULL if not supported */
+    esp_err_t (*set_socket_stack)(modem_dce_t *dce, bool on);           /*!< Bring the IP stack of the module up or down, NULL without socket offload */
+    esp_err_t (*socket_open)(modem_dce_t *dce, int id, modem_socket_type_t type,
+                             const char *host, uint16_t port);         /*!< Connect a socket of the module */
+    int (*socket_send)(modem_dce_t *dce, int id, const void *data,
+                       size_t length);                                  /*!< Send at most MODEM_SOCKET_PAYLOAD_MAX bytes, -1 on error */
+    int (*socket_recv)(modem_dce_t *dce, int id, void *buffer,
+                       size_t length);                                  /*!< Read at most MODEM_SOCKET_PAYLOAD_MAX bytes, 0 if none arrived, -1 on error */
+    esp_err_t (*socket_close)(modem_dce_t *dce, int id);                /*!< Close a socket of the module */
+    esp_err_t (*mqtt_connect)(modem_dce_t *dce,
+                              const modem_mqtt_config_t *config);      /*!< Connect the MQTT client of the module, NULL without MQTT offload */
+    esp_err_t (*mqtt_publish)(modem_dce_t *dce, const char *topic, const void *data,
+                              size_t length, int qos, bool retain);   /*!< Publish a message, of a length limited by the module */
+    esp_err_t (*mqtt_subscribe)(modem_dce_t *dce, const char *topic, int qos); /*!< Subscribe to a topic */
+    esp_err_t (*mqtt_unsubscribe)(modem_dce_t *dce, const char *topic);        /*!< Unsubscribe from a topic */
+    esp_err_t (*mqtt_disconnect)(modem_dce_t *dce);                     /*!< Disconnect the MQTT client of the module */
+    esp_err_t (*http_open)(modem_dce_t *dce, const char *server);       /*!< Connect the HTTP client of the module, "http://host[:port]", NULL without HTTP offload */
+    esp_err_t (*http_get)(modem_dce_t *dce, const char *path, size_t offset, size_t length,
+                          modem_http_response_t *response);            /*!< GET bytes offset to offset + length - 1, length 0 for the rest */
+    int (*http_read)(modem_dce_t *dce, size_t offset, void *buffer,
+                     size_t length);                                    /*!< Read the body from offset, as is, -1 on error */
+    esp_err_t (*http_close)(modem_dce_t *dce);                          /*!< Disconnect the HTTP client of the module */
+    esp_err_t (*set_gnss)(modem_dce_t *dce, modem_gnss_output_t output,
+                          uint32_t report_every);                       /*!< Power the GNSS receiver and select its output, navigation information every report_every fixes, NULL without GNSS */
+    esp_err_t (*gnss_assist_write)(modem_dce_t *dce, size_t offset, const void *data,
+                                   size_t length);                      /*!< Write assistance data to the module, offset 0 starting a new file, NULL without A-GNSS */
+    esp_err_t (*gnss_assist_load)(modem_dce_t *dce);                    /*!< Load the assistance data written into the receiver, powered off, used from the next start */
+    esp_err_t (*get_gnss_assist)(modem_dce_t *dce, uint32_t *valid_min); /*!< Validity left of the assistance data loaded, unit: minute, 0 if none or expired */
+    esp_err_t (*power_up)(modem_dce_t *dce);                            /*!< Normal power up */
     esp_err_t (*open)(modem_dce_t *dce);                                /*!< Opening device */
     esp_err_t (*power_down)(modem_dce_t *dce);                          /*!< Normal power down */
+    esp_err_t (*reset)(modem_dce_t *dce);                               /*!< Hardware reset, NULL if the reset pin is not wired */
+    esp_err_t (*hold_pins)(modem_dce_t *dce, bool hold);                /*!< Hold or release the levels of the output pins wired, NULL if none */
     esp_err_t (*deinit)(modem_dce_t *dce);                              /*!< Deinitialize */
 };
 
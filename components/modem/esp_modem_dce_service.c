@@ -11,9 +11,14 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <stdio.h>
 #include <string.h>
+#include <ctype.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
+#include "esp_modem.h"
 #include "esp_modem_dce_service.h"
 
 /**
@@ -44,12 +49,64 @@ esp_err_t esp_modem_dce_handle_response_default(modem_dce_t *dce, const char *li
     return err;
 }
 
+/**
+ * @brief Handle response from AT+CCID
+ */
+static esp_err_t esp_modem_dce_handle_ccid(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else {
+        /* [+CCID: ]<iccid>, some SIMs pad the number with a trailing 'F' */
+        const char *p = strchr(line, ':');
+        p = p ? p + 1 : line;
+        while (*p == ' ' || *p == '"') {
+            p++;
+        }
+        int len = 0;
+        while (isalnum((unsigned char)p[len]) && len < MODEM_ICCID_LENGTH) {
+            dce->iccid[len] = p[len];
+            len++;
+        }
+        dce->iccid[len] = '\0';
+        if (len > 0) {
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CREG? and AT+CEREG?
+ */
+static esp_err_t esp_modem_dce_handle_creg(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    modem_reg_status_t *status = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CREG", strlen("+CREG")) || !strncmp(line, "+CEREG", strlen("+CEREG"))) {
+        /* +CREG: <n>,<stat>[,<lac>,<ci>] */
+        int n = 0, stat = MODEM_REG_UNKNOWN;
+        if (sscanf(line, "%*s%d,%d", &n, &stat) == 2) {
+            *status = stat;
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
 esp_err_t esp_modem_dce_sync(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
-    dce->handle_line = esp_modem_dce_handle_response_default;
-    DCE_CHECK(dte->send_cmd(dte, "AT\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "sync failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "sync failed", err);
     ESP_LOGD(DCE_TAG, "sync ok");
     return ESP_OK;
 err:
@@ -59,14 +116,15 @@ err:
 esp_err_t esp_modem_dce_echo(modem_dce_t *dce, bool on)
 {
     modem_dte_t *dte = dce->dte;
-    dce->handle_line = esp_modem_dce_handle_response_default;
     if (on) {
-        DCE_CHECK(dte->send_cmd(dte, "ATE1\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-        DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "enable echo failed", err);
+        DCE_CHECK(dte->send_cmd(dte, "ATE1\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                                esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+                  "enable echo failed", err);
         ESP_LOGD(DCE_TAG, "enable echo ok");
     } else {
-        DCE_CHECK(dte->send_cmd(dte, "ATE0\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-        DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "disable echo failed", err);
+        DCE_CHECK(dte->send_cmd(dte, "ATE0\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                                esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+                  "disable echo failed", err);
         ESP_LOGD(DCE_TAG, "disable echo ok");
     }
     return ESP_OK;
@@ -77,9 +135,9 @@ err:
 esp_err_t esp_modem_dce_store_profile(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
-    dce->handle_line = esp_modem_dce_handle_response_default;
-    DCE_CHECK(dte->send_cmd(dte, "AT&W\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "save settings failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT&W\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "save settings failed", err);
     ESP_LOGD(DCE_TAG, "save settings ok");
     return ESP_OK;
 err:
@@ -92,9 +150,9 @@ esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_c
     char command[16];
     int len = snprintf(command, sizeof(command), "AT+IFC=%d,%d\r", dte->flow_ctrl, flow_ctrl);
     DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
-    dce->handle_line = esp_modem_dce_handle_response_default;
-    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set flow control failed", err);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set flow control failed", err);
     ESP_LOGD(DCE_TAG, "set flow control ok");
     return ESP_OK;
 err:
@@ -107,21 +165,577 @@ esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const
     char command[64];
     int len = snprintf(command, sizeof(command), "AT+CGDCONT=%d,\"%s\",\"%s\"\r", cid, type, apn);
     DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
-    dce->handle_line = esp_modem_dce_handle_response_default;
-    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "define pdp context failed", err);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "define pdp context failed", err);
     ESP_LOGD(DCE_TAG, "define pdp context ok");
     return ESP_OK;
 err:
     return ESP_FAIL;
 }
 
+esp_err_t esp_modem_dce_define_pdp_contexts(modem_dce_t *dce, const modem_pdp_context_t *contexts, int count)
+{
+    modem_dte_t *dte = dce->dte;
+    /* ";+CGDCONT=<cid>,"<type>","<apn>"" per context, with room for the type */
+    char command[MODEM_MAX_PDP_CONTEXTS * (MODEM_MAX_APN_LENGTH + 32) + 4];
+    uint32_t defined = 0;
+    int len = snprintf(command, sizeof(command), "AT");
+    DCE_CHECK(contexts && count > 0 && count <= MODEM_MAX_PDP_CONTEXTS, "invalid argument", err);
+    for (int i = 0; i < count; i++) {
+        DCE_CHECK(contexts[i].cid >= 1 && contexts[i].cid <= MODEM_MAX_PDP_CID && contexts[i].type && contexts[i].apn,
+                  "invalid context %d", err, i);
+        len += snprintf(command + len, sizeof(command) - len, "%s+CGDCONT=%d,\"%s\",\"%s\"", i ? ";" : "",
+                        contexts[i].cid, contexts[i].type, contexts[i].apn);
+        DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+        defined |= 1U << contexts[i].cid;
+    }
+    len += snprintf(command + len, sizeof(command) - len, "\r");
+    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "define pdp contexts failed", err);
+    dce->pdp_defined |= defined;
+    ESP_LOGD(DCE_TAG, "define pdp contexts ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_get_iccid_number(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CCID\r", MODEM_COMMAND_TIMEOUT_DEFAULT, esp_modem_dce_handle_ccid, NULL) == ESP_OK,
+              "get iccid number failed", err);
+    ESP_LOGD(DCE_TAG, "get iccid number ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_get_network_registration(modem_dce_t *dce, modem_reg_status_t *status)
+{
+    modem_dte_t *dte = dce->dte;
+    modem_reg_status_t stat = MODEM_REG_UNKNOWN;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CREG?\r", MODEM_COMMAND_TIMEOUT_DEFAULT, esp_modem_dce_handle_creg, &stat) == ESP_OK,
+              "get network registration failed", err);
+    if (stat != MODEM_REG_HOME && stat != MODEM_REG_ROAMING) {
+        /* LTE only modules may be registered for EPS services alone, GSM modules do not know +CEREG */
+        modem_reg_status_t eps_stat = MODEM_REG_UNKNOWN;
+        if (dte->send_cmd(dte, "AT+CEREG?\r", MODEM_COMMAND_TIMEOUT_DEFAULT, esp_modem_dce_handle_creg, &eps_stat) == ESP_OK &&
+                (eps_stat == MODEM_REG_HOME || eps_stat == MODEM_REG_ROAMING)) {
+            stat = eps_stat;
+        }
+    }
+    *status = stat;
+    ESP_LOGD(DCE_TAG, "get network registration ok: %d", stat);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_set_registration_urc(modem_dce_t *dce, bool on)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, on ? "AT+CREG=1\r" : "AT+CREG=0\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set registration urc failed", err);
+    /* Modules with PSM report the timers granted in +CEREG (mode 4) */
+    if (!(on && dce->set_psm && dte->send_cmd(dte, "AT+CEREG=4\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                                              esp_modem_dce_handle_response_default, NULL) == ESP_OK)) {
+        /* GSM modules do not know +CEREG */
+        if (dte->send_cmd(dte, on ? "AT+CEREG=1\r" : "AT+CEREG=0\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                          esp_modem_dce_handle_response_default, NULL) != ESP_OK) {
+            ESP_LOGD(DCE_TAG, "eps registration urc not supported");
+        }
+    }
+    /* LTE modules report the connection state in +CSCON, which also confirms an early release */
+    if ((dce->release_connection || dce->set_psm) &&
+            (dte->send_cmd(dte, on ? "AT+CSCON=1\r" : "AT+CSCON=0\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                           esp_modem_dce_handle_response_default, NULL) != ESP_OK)) {
+        ESP_LOGD(DCE_TAG, "connection urc not supported");
+    }
+    ESP_LOGD(DCE_TAG, "set registration urc ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_set_functionality(modem_dce_t *dce, uint32_t fun)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[16];
+    snprintf(command, sizeof(command), "AT+CFUN=%d\r", fun);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_FUNCTIONALITY,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set functionality failed", err);
+    ESP_LOGD(DCE_TAG, "set functionality ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Handle response from ATO
+ */
+static esp_err_t esp_modem_dce_handle_ato(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_CONNECT)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_NO_CARRIER) || strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+esp_err_t esp_modem_dce_set_dtr_switch(modem_dce_t *dce, bool on)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, on ? "AT&D1\r" : "AT&D0\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set dtr switch failed", err);
+    dce->dtr_switch = on;
+    ESP_LOGD(DCE_TAG, "set dtr switch ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_set_dcd_mode(modem_dce_t *dce, bool follow_carrier)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, follow_carrier ? "AT&C1\r" : "AT&C0\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set dcd mode failed", err);
+    ESP_LOGD(DCE_TAG, "set dcd mode ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_suspend_data_mode(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dce->dtr_switch, "dtr switch not enabled", err);
+    DCE_CHECK(dte->pulse_dtr(dte, MODEM_COMMAND_TIMEOUT_MODE_CHANGE,
+                             esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "suspend data mode failed", err);
+    ESP_LOGD(DCE_TAG, "suspend data mode ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_resume_data_mode(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "ATO\r", MODEM_COMMAND_TIMEOUT_MODE_CHANGE, esp_modem_dce_handle_ato, NULL) == ESP_OK,
+              "resume data mode failed", err);
+    ESP_LOGD(DCE_TAG, "resume data mode ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Unit of a 3GPP timer, the 3 high bits of the timer octet (TS 24.008 10.5.7.4 and 10.5.7.4a)
+ *
+ */
+typedef struct {
+    uint8_t unit;     /*!< Unit bits */
+    uint32_t seconds; /*!< Unit length, unit: s */
+} esp_modem_timer_unit_t;
+
+#define ESP_MODEM_TIMER_DEACTIVATED (0x7)  /*!< Unit bits of a deactivated timer */
+#define ESP_MODEM_TIMER_VALUE_MAX (31)     /*!< Largest value, the 5 low bits of the timer octet */
+#define ESP_MODEM_CEREG_MAX_FIELDS (10)    /*!< [<n>,]<stat> and the 8 optional fields of +CEREG */
+#define ESP_MODEM_CEREG_MAX_LENGTH (96)    /*!< Longest +CEREG parameter list */
+
+/* Periodic TAU (T3412 extended), GPRS timer 3, shortest unit first */
+static const esp_modem_timer_unit_t s_tau_units[] = {
+    {0x3, 2}, {0x4, 30}, {0x5, 60}, {0x0, 600}, {0x1, 3600}, {0x2, 36000}, {0x6, 1152000}
+};
+/* Active time (T3324), GPRS timer 2, shortest unit first */
+static const esp_modem_timer_unit_t s_active_time_units[] = {
+    {0x0, 2}, {0x1, 60}, {0x2, 360}
+};
+/* eDRX cycles of E-UTRAN by value (TS 24.008 10.5.5.32), unit: ms */
+static const uint32_t s_edrx_cycles_ms[16] = {
+    5120, 10240, 20480, 40960, 61440, 81920, 102400, 122880,
+    143360, 163840, 327680, 655360, 1310720, 2621440, 5242880, 10485760
+};
+
+static portMUX_TYPE s_power_save_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Encode a timer as the 8 bit string of AT+CPSMS, with the shortest duration not below seconds
+ */
+static void esp_modem_dce_encode_timer(const esp_modem_timer_unit_t *units, int count, uint32_t seconds, char *bits)
+{
+    uint8_t octet = (units[count - 1].unit << 5) | ESP_MODEM_TIMER_VALUE_MAX;
+    uint64_t best = (uint64_t)units[count - 1].seconds * ESP_MODEM_TIMER_VALUE_MAX;
+    for (int i = 0; i < count; i++) {
+        uint32_t value = (seconds + units[i].seconds - 1) / units[i].seconds;
+        if (value <= ESP_MODEM_TIMER_VALUE_MAX && (uint64_t)value * units[i].seconds < best) {
+            best = (uint64_t)value * units[i].seconds;
+            octet = (units[i].unit << 5) | value;
+        }
+    }
+    for (int i = 0; i < 8; i++) {
+        bits[i] = (octet & (0x80 >> i)) ? '1' : '0';
+    }
+    bits[8] = '\0';
+}
+
+/**
+ * @brief Decode a quoted or bare bit string, e.g. "00100001"
+ *
+ * @return number of bits, 0 if not a bit string
+ */
+static int esp_modem_dce_parse_bits(const char *field, uint32_t *value)
+{
+    int bits = 0;
+    *value = 0;
+    if (*field == '"') {
+        field++;
+    }
+    while (field[bits] == '0' || field[bits] == '1') {
+        *value = (*value << 1) | (field[bits] - '0');
+        bits++;
+    }
+    return bits;
+}
+
+/**
+ * @brief Decode a timer reported in +CEREG
+ *
+ * @return true if the timer is running, false if deactivated or malformed
+ */
+static bool esp_modem_dce_decode_timer(const esp_modem_timer_unit_t *units, int count, const char *field, uint32_t *seconds)
+{
+    uint32_t octet = 0;
+    if (esp_modem_dce_parse_bits(field, &octet) != 8 || (octet >> 5) == ESP_MODEM_TIMER_DEACTIVATED) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (units[i].unit == octet >> 5) {
+            *seconds = units[i].seconds * (octet & ESP_MODEM_TIMER_VALUE_MAX);
+            return true;
+        }
+    }
+    /* Other units of the active time are read as minutes */
+    *seconds = 60 * (octet & ESP_MODEM_TIMER_VALUE_MAX);
+    return true;
+}
+
+/**
+ * @brief Track the PSM timers granted, from the unsolicited +CEREG and the answer to AT+CEREG?
+ *
+ * +CEREG: [<n>,]<stat>[,[<tac>],[<ci>],[<AcT>][,[<cause_type>],[<reject_cause>][,[<Active-Time>],[<Periodic-TAU>]]]]
+ */
+static void esp_modem_dce_handle_cereg_urc(modem_dce_t *dce, const char *line, void *context)
+{
+    char params[ESP_MODEM_CEREG_MAX_LENGTH];
+    char *fields[ESP_MODEM_CEREG_MAX_FIELDS];
+    int count = 0;
+    const char *colon = strchr(line, ':');
+    if (!colon || strlen(colon + 1) >= sizeof(params)) {
+        return;
+    }
+    strcpy(params, colon + 1);
+    params[strcspn(params, "\r\n")] = '\0';
+    for (char *p = params; p && count < ESP_MODEM_CEREG_MAX_FIELDS; count++) {
+        fields[count] = p;
+        p = strchr(p, ',');
+        if (p) {
+            *p++ = '\0';
+        }
+    }
+    /* The answer to AT+CEREG? starts with <n>, the unsolicited form has a quoted <tac> after <stat> */
+    int first = (count > 1 && fields[1][0] != '"' && fields[1][0] != '\0') ? 1 : 0;
+    if (count <= first + 7) {
+        /* Timers not reported, e.g. not registered or another +CEREG mode */
+        return;
+    }
+    uint32_t active_time_s = 0;
+    uint32_t periodic_tau_s = 0;
+    bool psm = esp_modem_dce_decode_timer(s_active_time_units, sizeof(s_active_time_units) / sizeof(s_active_time_units[0]),
+                                          fields[first + 6], &active_time_s) &&
+               esp_modem_dce_decode_timer(s_tau_units, sizeof(s_tau_units) / sizeof(s_tau_units[0]),
+                                          fields[first + 7], &periodic_tau_s);
+    portENTER_CRITICAL(&s_power_save_lock);
+    dce->power_save.psm = psm;
+    dce->power_save.active_time_s = psm ? active_time_s : 0;
+    dce->power_save.periodic_tau_s = psm ? periodic_tau_s : 0;
+    portEXIT_CRITICAL(&s_power_save_lock);
+    ESP_LOGD(DCE_TAG, "psm %s, tau %d s, active time %d s", psm ? "granted" : "off", periodic_tau_s, active_time_s);
+}
+
+/**
+ * @brief Track the eDRX granted, from +CEDRXP and the answer to AT+CEDRXRDP
+ *
+ * +CEDRXP: <AcT-type>[,<Requested_eDRX_value>[,<NW-provided_eDRX_value>[,<Paging_time_window>]]]
+ */
+static void esp_modem_dce_handle_cedrx_urc(modem_dce_t *dce, const char *line, void *context)
+{
+    const char *params = strchr(line, ':');
+    int act = 0;
+    char requested[5] = {0};
+    char provided[5] = {0};
+    char window[5] = {0};
+    if (!params) {
+        return;
+    }
+    int fields = sscanf(params + 1, "%d,\"%4[01]\",\"%4[01]\",\"%4[01]\"", &act, requested, provided, window);
+    if (fields < 1 || (act != 0 && fields < 3)) {
+        /* Requested value only, e.g. +CEDRXS: */
+        return;
+    }
+    uint32_t cycle = 0;
+    uint32_t ptw = 0;
+    bool edrx = act != 0 && esp_modem_dce_parse_bits(provided, &cycle) == 4;
+    if (fields == 4 && esp_modem_dce_parse_bits(window, &ptw) == 4) {
+        /* Paging time window steps are 1.28 s on LTE-M, 2.56 s on NB-IoT */
+        ptw = (ptw + 1) * (act == MODEM_EDRX_ACT_NB_IOT ? 2560 : 1280);
+    } else {
+        ptw = 0;
+    }
+    portENTER_CRITICAL(&s_power_save_lock);
+    dce->power_save.edrx = edrx;
+    dce->power_save.edrx_cycle_ms = edrx ? s_edrx_cycles_ms[cycle] : 0;
+    dce->power_save.paging_window_ms = edrx ? ptw : 0;
+    portEXIT_CRITICAL(&s_power_save_lock);
+    ESP_LOGD(DCE_TAG, "edrx %s, cycle %d ms", edrx ? "granted" : "off", edrx ? s_edrx_cycles_ms[cycle] : 0);
+}
+
+/**
+ * @brief Record a connection state change, posts ESP_MODEM_EVENT_CONNECTION_CHANGED
+ */
+static void esp_modem_dce_set_connection_state(modem_dce_t *dce, bool connected)
+{
+    modem_power_save_t power_save;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_power_save_lock);
+    bool changed = dce->power_save.connected != connected;
+    if (changed) {
+        if (!connected) {
+            uint32_t connected_ms = (now - dce->power_save.connected_since) / 1000;
+            dce->power_save.last_connected_ms = connected_ms;
+            dce->power_save.connected_total_ms += connected_ms;
+            dce->power_save.last_release_ms = dce->power_save.release_requested ?
+                                              (now - dce->power_save.release_requested) / 1000 : 0;
+        }
+        dce->power_save.connected = connected;
+        dce->power_save.connected_since = now;
+        dce->power_save.release_requested = 0;
+    }
+    power_save = dce->power_save;
+    portEXIT_CRITICAL(&s_power_save_lock);
+    if (!changed) {
+        return;
+    }
+    if (connected) {
+        ESP_LOGD(DCE_TAG, "connected");
+    } else if (power_save.last_release_ms) {
+        ESP_LOGI(DCE_TAG, "idle after %d ms connected, released %d ms after request",
+                 power_save.last_connected_ms, power_save.last_release_ms);
+    } else {
+        ESP_LOGI(DCE_TAG, "idle after %d ms connected, released by the network", power_save.last_connected_ms);
+    }
+    esp_modem_post_event(dce->dte, ESP_MODEM_EVENT_CONNECTION_CHANGED, &power_save, sizeof(power_save));
+}
+
+/**
+ * @brief Track the connection state, from the unsolicited +CSCON and the answer to AT+CSCON?
+ *
+ * +CSCON: <mode>[,<state>[,<access>]] unsolicited, +CSCON: <n>,<mode>[,<state>[,<access>]] answered
+ */
+static void esp_modem_dce_handle_cscon_urc(modem_dce_t *dce, const char *line, void *context)
+{
+    int first = 0;
+    int second = -1;
+    if (sscanf(line, "+CSCON: %d,%d", &first, &second) < 1) {
+        return;
+    }
+    /* Only the unsolicited form with <n>=1 is asked for, a second field is the <mode> of the answer */
+    bool connected = (second >= 0 ? second : first) == 1;
+    esp_modem_dce_set_connection_state(dce, connected);
+}
+
+esp_err_t esp_modem_dce_track_power_save(modem_dce_t *dce)
+{
+    DCE_CHECK(esp_modem_register_urc_handler(dce->dte, "+CEREG:", esp_modem_dce_handle_cereg_urc, dce) == ESP_OK,
+              "register +CEREG handler failed", err);
+    /* +CEDRXP: and +CEDRXRDP: */
+    DCE_CHECK(esp_modem_register_urc_handler(dce->dte, "+CEDRX", esp_modem_dce_handle_cedrx_urc, dce) == ESP_OK,
+              "register +CEDRXP handler failed", err);
+    DCE_CHECK(esp_modem_register_urc_handler(dce->dte, "+CSCON:", esp_modem_dce_handle_cscon_urc, dce) == ESP_OK,
+              "register +CSCON handler failed", err);
+    return ESP_OK;
+err:
+    esp_modem_dce_untrack_power_save(dce);
+    return ESP_ERR_NO_MEM;
+}
+
+void esp_modem_dce_untrack_power_save(modem_dce_t *dce)
+{
+    esp_modem_unregister_urc_handler(dce->dte, esp_modem_dce_handle_cereg_urc, dce);
+    esp_modem_unregister_urc_handler(dce->dte, esp_modem_dce_handle_cedrx_urc, dce);
+    esp_modem_unregister_urc_handler(dce->dte, esp_modem_dce_handle_cscon_urc, dce);
+}
+
+esp_err_t esp_modem_dce_set_psm(modem_dce_t *dce, bool on, uint32_t periodic_tau_s, uint32_t active_time_s)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[48];
+    char tau[9];
+    char active_time[9];
+    if (on) {
+        esp_modem_dce_encode_timer(s_tau_units, sizeof(s_tau_units) / sizeof(s_tau_units[0]), periodic_tau_s, tau);
+        esp_modem_dce_encode_timer(s_active_time_units, sizeof(s_active_time_units) / sizeof(s_active_time_units[0]),
+                                   active_time_s, active_time);
+        snprintf(command, sizeof(command), "AT+CPSMS=1,,,\"%s\",\"%s\";+CEREG=4\r", tau, active_time);
+    } else {
+        snprintf(command, sizeof(command), "AT+CPSMS=0\r");
+    }
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set psm failed", err);
+    if (!on) {
+        portENTER_CRITICAL(&s_power_save_lock);
+        dce->power_save.psm = false;
+        dce->power_save.periodic_tau_s = 0;
+        dce->power_save.active_time_s = 0;
+        portEXIT_CRITICAL(&s_power_save_lock);
+    }
+    ESP_LOGD(DCE_TAG, "set psm ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_set_edrx(modem_dce_t *dce, bool on, modem_edrx_act_t act, uint32_t cycle_ms)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[32];
+    if (on) {
+        int value = 0;
+        while (value < 15 && s_edrx_cycles_ms[value] < cycle_ms) {
+            value++;
+        }
+        /* Mode 2 reports the cycle granted in +CEDRXP */
+        snprintf(command, sizeof(command), "AT+CEDRXS=2,%d,\"%d%d%d%d\"\r", act,
+                 (value >> 3) & 1, (value >> 2) & 1, (value >> 1) & 1, value & 1);
+    } else {
+        snprintf(command, sizeof(command), "AT+CEDRXS=0,%d\r", act);
+    }
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set edrx failed", err);
+    if (!on) {
+        portENTER_CRITICAL(&s_power_save_lock);
+        dce->power_save.edrx = false;
+        dce->power_save.edrx_cycle_ms = 0;
+        dce->power_save.paging_window_ms = 0;
+        portEXIT_CRITICAL(&s_power_save_lock);
+    }
+    ESP_LOGD(DCE_TAG, "set edrx ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_get_power_save(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    /* The answers go through the +CEREG and +CEDRX handlers */
+    DCE_CHECK(dte->send_cmd(dte, "AT+CEREG?\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "get psm failed", err);
+    /* Modules without eDRX do not know +CEDRXRDP */
+    if (dte->send_cmd(dte, "AT+CEDRXRDP\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                      esp_modem_dce_handle_response_default, NULL) != ESP_OK) {
+        ESP_LOGD(DCE_TAG, "edrx not supported");
+    }
+    ESP_LOGD(DCE_TAG, "get power save ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+void esp_modem_dce_read_power_save(modem_dce_t *dce, modem_power_save_t *power_save)
+{
+    portENTER_CRITICAL(&s_power_save_lock);
+    *power_save = dce->power_save;
+    portEXIT_CRITICAL(&s_power_save_lock);
+}
+
+void esp_modem_dce_set_sleep_state(modem_dce_t *dce, modem_sleep_state_t state)
+{
+    modem_power_save_t power_save;
+    portENTER_CRITICAL(&s_power_save_lock);
+    bool changed = dce->power_save.sleep_state != state;
+    if (changed) {
+        dce->power_save.sleep_state = state;
+        dce->power_save.sleep_state_since = esp_timer_get_time();
+    }
+    power_save = dce->power_save;
+    portEXIT_CRITICAL(&s_power_save_lock);
+    if (changed) {
+        ESP_LOGI(DCE_TAG, "%s psm", state == MODEM_SLEEP_PSM ? "enter" : "exit");
+        esp_modem_post_event(dce->dte, ESP_MODEM_EVENT_SLEEP_CHANGED, &power_save, sizeof(power_save));
+    }
+}
+
+void esp_modem_dce_wake_up(modem_dce_t *dce)
+{
+    esp_modem_dce_set_sleep_state(dce, MODEM_SLEEP_AWAKE);
+}
+
+esp_err_t esp_modem_dce_get_next_reachable(modem_dce_t *dce, int64_t *at_us, uint32_t *paging_delay_ms)
+{
+    modem_power_save_t power_save;
+    int64_t now = esp_timer_get_time();
+    esp_modem_dce_read_power_save(dce, &power_save);
+    *paging_delay_ms = power_save.edrx ? power_save.edrx_cycle_ms : 0;
+    if (power_save.sleep_state != MODEM_SLEEP_PSM) {
+        *at_us = now;
+        return ESP_OK;
+    }
+    DCE_CHECK(power_save.psm, "psm timers not reported", err);
+    /* T3412 and T3324 both start on release of the connection, PSM starts when T3324 expires */
+    uint32_t psm_s = power_save.periodic_tau_s > power_save.active_time_s ?
+                     power_save.periodic_tau_s - power_save.active_time_s : 0;
+    int64_t wake_up = power_save.sleep_state_since + (int64_t)psm_s * 1000000;
+    *at_us = wake_up > now ? wake_up : now;
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_modem_dce_release_connection(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CNMPSD\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "release connection failed", err);
+    /* Confirmed by +CSCON: 0, the delay from now is reported then */
+    portENTER_CRITICAL(&s_power_save_lock);
+    dce->power_save.release_requested = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_power_save_lock);
+    ESP_LOGD(DCE_TAG, "release connection ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 esp_err_t esp_modem_dce_hang_up(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
-    dce->handle_line = esp_modem_dce_handle_response_default;
-    DCE_CHECK(dte->send_cmd(dte, "ATH\r", MODEM_COMMAND_TIMEOUT_HANG_UP) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "hang up failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "ATH\r", MODEM_COMMAND_TIMEOUT_HANG_UP,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "hang up failed", err);
     ESP_LOGD(DCE_TAG, "hang up ok");
     return ESP_OK;
 err:
@@ -116,6 +116,224 @@ esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_c
  */
 esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const char *type, const char *apn);
 
+/**
+ * @brief Define several PDP contexts in one command line
+ *
+ * The contexts are not defined again when dialed, see esp_modem_select_pdp_context().
+ *
+ * @param dce Modem DCE object
+ * @param contexts contexts to define
+ * @param count number of contexts, at most MODEM_MAX_PDP_CONTEXTS
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error, none of the contexts is taken as defined
+ */
+esp_err_t esp_modem_dce_define_pdp_contexts(modem_dce_t *dce, const modem_pdp_context_t *contexts, int count);
+
+/**
+ * @brief Get ICCID number of the SIM card
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_get_iccid_number(modem_dce_t *dce);
+
+/**
+ * @brief Get network registration status, of circuit switched or EPS domain
+ *
+ * @param dce Modem DCE object
+ * @param status Registration status, registered if any of the domains is registered
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_get_network_registration(modem_dce_t *dce, modem_reg_status_t *status);
+
+/**
+ * @brief Enable or not network registration unsolicited result codes, +CREG and +CEREG
+ *
+ * +CEREG carries the PSM timers granted on modules with PSM. Modules with early release of the
+ * connection also report its state in +CSCON.
+ *
+ * @param dce Modem DCE object
+ * @param on true to report registration changes
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_registration_urc(modem_dce_t *dce, bool on);
+
+/**
+ * @brief Set phone functionality
+ *
+ * @param dce Modem DCE object
+ * @param fun 0 for minimum functionality (radio off), 1 for full functionality
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_functionality(modem_dce_t *dce, uint32_t fun);
+
+/**
+ * @brief Let DTR drop switch from data mode to command mode, keeping the call (AT&D1)
+ *
+ * @param dce Modem DCE object
+ * @param on true to switch on DTR drop, false to ignore DTR
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_dtr_switch(modem_dce_t *dce, bool on);
+
+/**
+ * @brief Let DCD follow the carrier, or keep it always on (AT&C1/AT&C0)
+ *
+ * @param dce Modem DCE object
+ * @param follow_carrier true to drop DCD when the carrier is lost
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_dcd_mode(modem_dce_t *dce, bool follow_carrier);
+
+/**
+ * @brief Leave data mode by dropping DTR, the data call is kept
+ *
+ * @note DTR switch must have been enabled with esp_modem_dce_set_dtr_switch()
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_suspend_data_mode(modem_dce_t *dce);
+
+/**
+ * @brief Return to the data call kept in command mode (ATO)
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error, e.g. the call has been dropped meanwhile
+ */
+esp_err_t esp_modem_dce_resume_data_mode(modem_dce_t *dce);
+
+/**
+ * @brief Start tracking PSM, eDRX, sleep and connection state of the DCE, from +CEREG, +CEDRXP and +CSCON lines
+ *
+ * To be called by drivers on init, before any of the power saving services.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NO_MEM if all unsolicited result code handler slots are used
+ */
+esp_err_t esp_modem_dce_track_power_save(modem_dce_t *dce);
+
+/**
+ * @brief Stop tracking PSM, eDRX, sleep and connection state, to be called by drivers on deinit
+ *
+ * @param dce Modem DCE object
+ */
+void esp_modem_dce_untrack_power_save(modem_dce_t *dce);
+
+/**
+ * @brief Request PSM (AT+CPSMS), granted timers are reported in +CEREG from then on (AT+CEREG=4)
+ *
+ * Timers are rounded up to what the 3GPP timer encoding can carry. The network may grant other
+ * values, see esp_modem_dce_read_power_save().
+ *
+ * @param dce Modem DCE object
+ * @param on true to request PSM, false to leave it
+ * @param periodic_tau_s periodic tracking area update (T3412), unit: s
+ * @param active_time_s time the module stays reachable once idle (T3324), unit: s
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_psm(modem_dce_t *dce, bool on, uint32_t periodic_tau_s, uint32_t active_time_s);
+
+/**
+ * @brief Request eDRX (AT+CEDRXS), the granted cycle is reported in +CEDRXP
+ *
+ * @param dce Modem DCE object
+ * @param on true to request eDRX, false to leave it
+ * @param act access technology the cycle applies to
+ * @param cycle_ms eDRX cycle, rounded up to the next cycle 3GPP defines, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_edrx(modem_dce_t *dce, bool on, modem_edrx_act_t act, uint32_t cycle_ms);
+
+/**
+ * @brief Query PSM and eDRX granted by the network (AT+CEREG? and AT+CEDRXRDP)
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_get_power_save(modem_dce_t *dce);
+
+/**
+ * @brief Get PSM and eDRX granted, sleep and connection state, as last reported, without blocking
+ *
+ * @param dce Modem DCE object
+ * @param power_save copy of the power saving state
+ */
+void esp_modem_dce_read_power_save(modem_dce_t *dce, modem_power_save_t *power_save);
+
+/**
+ * @brief Record a sleep state change, posts ESP_MODEM_EVENT_SLEEP_CHANGED
+ *
+ * Called by drivers from the handlers of their sleep unsolicited result codes.
+ *
+ * @param dce Modem DCE object
+ * @param state new sleep state
+ */
+void esp_modem_dce_set_sleep_state(modem_dce_t *dce, modem_sleep_state_t state);
+
+/**
+ * @brief Record that the module left PSM, as any line from it means it is awake
+ *
+ * Called by the DTE for every line received, before the unsolicited result code handlers.
+ *
+ * @param dce Modem DCE object
+ */
+void esp_modem_dce_wake_up(modem_dce_t *dce);
+
+/**
+ * @brief When the network can next reach the module
+ *
+ * In PSM, this is the end of the periodic TAU, the module can be woken earlier by uplink data
+ * or its PWRKEY. Otherwise this is now, with paging up to one eDRX cycle late.
+ *
+ * @param dce Modem DCE object
+ * @param at_us time the module is reachable from, since boot, unit: us
+ * @param paging_delay_ms longest paging delay once reachable, 0 without eDRX, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE in PSM with timers not reported by the network
+ */
+esp_err_t esp_modem_dce_get_next_reachable(modem_dce_t *dce, int64_t *at_us, uint32_t *paging_delay_ms);
+
+/**
+ * @brief Tell the network no more data is expected, so that the connection is released early (AT+CNMPSD)
+ *
+ * The release is confirmed by +CSCON, see esp_modem_dce_read_power_save().
+ *
+ * @note SIMCom command, only for the release_connection of SIMCom drivers
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_release_connection(modem_dce_t *dce);
+
 /**
  * @brief Hang up
  *
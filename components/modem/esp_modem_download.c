@@ -0,0 +1,215 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_modem_download.h"
+
+#define ESP_MODEM_DOWNLOAD_SERVER_MAX_LENGTH (128) /*!< "http://host:port" of the URL */
+#define ESP_MODEM_HTTP_PARTIAL_CONTENT (206)       /*!< Range request answered */
+#define ESP_MODEM_HTTP_RANGE_NOT_SATISFIABLE (416) /*!< Range request past the end */
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *DOWNLOAD_TAG = "esp-modem-download";
+#define DOWNLOAD_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                     \
+    {                                                                                      \
+        if (!(a))                                                                          \
+        {                                                                                  \
+            ESP_LOGE(DOWNLOAD_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                                 \
+        }                                                                                  \
+    } while (0)
+
+/**
+ * @brief Read the body of a response held by the module, as it lands after the bytes stored
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the storage failed
+ *      - ESP_FAIL if a read failed
+ */
+static esp_err_t esp_modem_download_body(modem_dce_t *dce, const esp_modem_download_config_t *config,
+                                         const modem_http_response_t *response, size_t body_start, uint8_t *chunk,
+                                         esp_modem_download_write_t write, void *context,
+                                         esp_modem_download_stats_t *stats)
+{
+    size_t end = body_start + response->length;
+    while (stats->offset < end) {
+        size_t length = MIN(config->chunk_size, end - stats->offset);
+        int len = dce->http_read(dce, stats->offset - body_start, chunk, length);
+        stats->read_commands++;
+        DOWNLOAD_CHECK(len > 0, "read at %d failed", err, stats->offset);
+        DOWNLOAD_CHECK(write(context, stats->offset, chunk, len) == ESP_OK, "store at %d failed", err_store,
+                       stats->offset);
+        stats->offset += len;
+    }
+    return ESP_OK;
+err_store:
+    return ESP_ERR_INVALID_STATE;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_download(modem_dce_t *dce, const esp_modem_download_config_t *config,
+                             esp_modem_download_write_t write, void *context, esp_modem_download_stats_t *stats)
+{
+    esp_modem_download_stats_t local_stats;
+    char server[ESP_MODEM_DOWNLOAD_SERVER_MAX_LENGTH];
+    esp_err_t ret = ESP_FAIL;
+    DOWNLOAD_CHECK(dce && config && config->url && config->chunk_size && write, "invalid argument", err_arg);
+    DOWNLOAD_CHECK(dce->set_socket_stack && dce->http_open && dce->http_get && dce->http_read && dce->http_close,
+                   "http offload not supported", err_support);
+    DOWNLOAD_CHECK(!strncmp(config->url, "http://", strlen("http://")), "only http is supported: %s", err_arg,
+                   config->url);
+    /* The module connects to the server, then requests the path */
+    const char *path = strchr(config->url + strlen("http://"), '/');
+    size_t server_len = path ? path - config->url : strlen(config->url);
+    DOWNLOAD_CHECK(server_len < sizeof(server) && !strchr(config->url, '"'), "invalid url: %s", err_arg, config->url);
+    memcpy(server, config->url, server_len);
+    server[server_len] = '\0';
+    path = path ? path : "/";
+    if (!stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(esp_modem_download_stats_t));
+    stats->offset = config->offset;
+    uint8_t *chunk = malloc(config->chunk_size);
+    DOWNLOAD_CHECK(chunk, "malloc chunk failed", err_mem);
+    TickType_t start = xTaskGetTickCount();
+    bool open = false;
+    bool done = false;
+    uint32_t failures = 0;
+    while (!done) {
+        if (failures) {
+            DOWNLOAD_CHECK(failures <= config->max_retries, "given up at %d bytes", err, stats->offset);
+            ESP_LOGW(DOWNLOAD_TAG, "retry %d at %d bytes", failures, stats->offset);
+            stats->retries++;
+            if (open) {
+                dce->http_close(dce);
+                open = false;
+            }
+            vTaskDelay(pdMS_TO_TICKS(config->retry_delay_ms));
+        }
+        if (!open) {
+            if (dce->set_socket_stack(dce, true) != ESP_OK || dce->http_open(dce, server) != ESP_OK) {
+                failures++;
+                continue;
+            }
+            open = true;
+        }
+        modem_http_response_t response = { 0 };
+        if (dce->http_get(dce, path, stats->offset, config->window_size, &response) != ESP_OK) {
+            failures++;
+            continue;
+        }
+        stats->requests++;
+        size_t body_start = stats->offset;
+        if (response.status == ESP_MODEM_HTTP_RANGE_NOT_SATISFIABLE && stats->offset) {
+            /* The last window ended with the resource */
+            break;
+        } else if (response.status == 200) {
+            /* The whole resource, ranges not supported; what is stored is read past */
+            body_start = 0;
+            DOWNLOAD_CHECK(response.length >= stats->offset, "resource shorter than %d bytes stored", err,
+                           stats->offset);
+        } else if (response.status != ESP_MODEM_HTTP_PARTIAL_CONTENT) {
+            /* Above 599, errors of the module, such as a lost connection */
+            DOWNLOAD_CHECK(response.status >= 500, "request refused: %d", err_refused, response.status);
+            ESP_LOGW(DOWNLOAD_TAG, "request failed: %d", response.status);
+            failures++;
+            continue;
+        }
+        ret = esp_modem_download_body(dce, config, &response, body_start, chunk, write, context, stats);
+        DOWNLOAD_CHECK(ret != ESP_ERR_INVALID_STATE, "storage failed", err);
+        if (ret != ESP_OK) {
+            failures++;
+            continue;
+        }
+        failures = 0;
+        ESP_LOGD(DOWNLOAD_TAG, "%d bytes stored", stats->offset);
+        done = response.status == 200 || !config->window_size || response.length < config->window_size;
+    }
+    ret = ESP_OK;
+    stats->duration_ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+    ESP_LOGI(DOWNLOAD_TAG, "%d bytes in %d ms, %d requests, %d retries", stats->offset, stats->duration_ms,
+             stats->requests, stats->retries);
+    goto out;
+err_refused:
+    ret = ESP_ERR_NOT_FOUND;
+    goto out;
+err:
+    ret = ESP_FAIL;
+out:
+    if (open) {
+        dce->http_close(dce);
+    }
+    free(chunk);
+    return ret;
+err_mem:
+    return ESP_FAIL;
+err_support:
+    return ESP_ERR_NOT_SUPPORTED;
+err_arg:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_download_partition_init(esp_modem_download_partition_t *storage, const esp_partition_t *partition,
+                                            size_t offset)
+{
+    DOWNLOAD_CHECK(storage && partition && offset <= partition->size, "invalid argument", err);
+    storage->partition = partition;
+    /* The sector of the resume point was erased with the bytes stored before it */
+    storage->erased = (offset + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_download_partition_write(void *context, size_t offset, const void *data, size_t length)
+{
+    esp_modem_download_partition_t *storage = context;
+    DOWNLOAD_CHECK(offset + length <= storage->partition->size, "%d bytes past the end of %s", err_size,
+                   offset + length - storage->partition->size, storage->partition->label);
+    if (offset + length > storage->erased) {
+        size_t erase = (offset + length - storage->erased + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+        erase = MIN(erase, storage->partition->size - storage->erased);
+        DOWNLOAD_CHECK(esp_partition_erase_range(storage->partition, storage->erased, erase) == ESP_OK,
+                       "erase at %d failed", err, storage->erased);
+        storage->erased += erase;
+    }
+    DOWNLOAD_CHECK(esp_partition_write(storage->partition, offset, data, length) == ESP_OK, "write at %d failed", err,
+                   offset);
+    return ESP_OK;
+err_size:
+    return ESP_ERR_INVALID_SIZE;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_download_file_write(void *context, size_t offset, const void *data, size_t length)
+{
+    FILE *file = context;
+    DOWNLOAD_CHECK(fseek(file, offset, SEEK_SET) == 0, "seek to %d failed", err, offset);
+    DOWNLOAD_CHECK(fwrite(data, 1, length, file) == length, "write at %d failed", err, offset);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
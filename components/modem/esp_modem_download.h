@@ -0,0 +1,149 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include "esp_partition.h"
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Download configuration
+ *
+ */
+typedef struct {
+    const char *url;         /*!< Resource, "http://host[:port]/path" */
+    size_t offset;           /*!< Bytes already stored by an earlier attempt, resumed from there */
+    size_t window_size;      /*!< Bytes per range request, held by the module until read, 0 for the whole resource */
+    size_t chunk_size;       /*!< Bytes per read command, buffered on the ESP32 then written, at most 2048 on SIM7000 */
+    uint32_t max_retries;    /*!< Failed requests in a row before giving up */
+    uint32_t retry_delay_ms; /*!< Delay before a retry, the HTTP client of the module reconnected */
+} esp_modem_download_config_t;
+
+/**
+ * @brief Download default configuration
+ *
+ */
+#define ESP_MODEM_DOWNLOAD_DEFAULT_CONFIG() \
+    {                                       \
+        .url = NULL,                        \
+        .offset = 0,                        \
+        .window_size = 32768,               \
+        .chunk_size = 1024,                 \
+        .max_retries = 5,                   \
+        .retry_delay_ms = 5000              \
+    }
+
+/**
+ * @brief Download statistics
+ *
+ */
+typedef struct {
+    size_t offset;          /*!< Bytes stored, where to resume after a failure */
+    uint32_t requests;      /*!< Range requests answered */
+    uint32_t read_commands; /*!< Read commands */
+    uint32_t retries;       /*!< Retries after a failed request or read */
+    uint32_t duration_ms;   /*!< Duration of the download */
+} esp_modem_download_stats_t;
+
+/**
+ * @brief Storage of the body, written in order
+ *
+ * @param context context given to esp_modem_download()
+ * @param offset offset of data in the resource
+ * @param data chunk of the body
+ * @param length length of the chunk
+ * @return esp_err_t ESP_OK to continue, the download is given up otherwise
+ */
+typedef esp_err_t (*esp_modem_download_write_t)(void *context, size_t offset, const void *data, size_t length);
+
+/**
+ * @brief Flash partition storage, context of esp_modem_download_partition_write()
+ *
+ */
+typedef struct {
+    const esp_partition_t *partition; /*!< Partition written from its start */
+    size_t erased;                    /*!< Erased up to, sector aligned */
+} esp_modem_download_partition_t;
+
+/**
+ * @brief Download a resource with the HTTP client of the module, streamed to storage
+ *
+ * The module fetches the resource window_size bytes at a time with range requests and holds each
+ * window; the ESP32 reads it chunk_size bytes at a time, each read taken by its announced length
+ * whatever the bytes, and writes each chunk before reading the next. Neither PPP nor lwIP run, the
+ * heap used is one chunk. A failed request or read is retried from the last byte stored, the
+ * server answering 200 to a range request is read past the bytes already stored.
+ *
+ * @param dce Modem DCE object, in command mode, with set_socket_stack and the HTTP operations
+ * @param config download configuration
+ * @param write storage of the body
+ * @param context context of write
+ * @param stats statistics, offset holds the resume point on failure, may be NULL
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_NOT_SUPPORTED without HTTP offload
+ *      - ESP_ERR_NOT_FOUND if the server refused the request
+ *      - ESP_FAIL on error, after max_retries
+ */
+esp_err_t esp_modem_download(modem_dce_t *dce, const esp_modem_download_config_t *config,
+                             esp_modem_download_write_t write, void *context, esp_modem_download_stats_t *stats);
+
+/**
+ * @brief Prepare a partition storage, resuming at offset
+ *
+ * @param storage partition storage
+ * @param partition partition written from its start
+ * @param offset bytes already stored
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_download_partition_init(esp_modem_download_partition_t *storage, const esp_partition_t *partition,
+                                            size_t offset);
+
+/**
+ * @brief Write a chunk to a partition, erasing sector by sector ahead of the data
+ *
+ * @param context esp_modem_download_partition_t
+ * @param offset offset in the partition
+ * @param data chunk
+ * @param length length of the chunk
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_SIZE if past the end of the partition
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_download_partition_write(void *context, size_t offset, const void *data, size_t length);
+
+/**
+ * @brief Write a chunk to a file, opened "wb" or, to resume, "r+b"
+ *
+ * @param context FILE of the file
+ * @param offset offset in the file
+ * @param data chunk
+ * @param length length of the chunk
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_download_file_write(void *context, size_t offset, const void *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -43,6 +43,21 @@ typedef enum {
     MODEM_FLOW_CONTROL_HW
 } modem_flow_ctrl_t;
 
+/**
+ * @brief Handler for lines answering an asynchronous command
+ *
+ * @note Called from the DTE task, line is NULL when the command timed out
+ * @return true once the final result code of the command has been consumed
+ */
+typedef bool (*modem_async_handler_t)(modem_dce_t *dce, const char *line, void *context);
+
+/**
+ * @brief Handler for lines answering a command
+ *
+ * @note Called from the DTE task, with the context of the command in dce->handle_line_ctx
+ */
+typedef esp_err_t (*modem_line_handler_t)(modem_dce_t *dce, const char *line);
+
 /**
  * @brief DTE(Data Terminal Equipment)
  *
@@ -50,12 +65,18 @@ typedef enum {
 struct modem_dte {
     modem_flow_ctrl_t flow_ctrl;                                                    /*!< Flow control of DTE */
     modem_dce_t *dce;                                                               /*!< DCE which connected to the DTE */
-    esp_err_t (*send_cmd)(modem_dte_t *dte, const char *command, uint32_t timeout); /*!< Send command to DCE */
+    esp_err_t (*send_cmd)(modem_dte_t *dte, const char *command, uint32_t timeout,
+                          modem_line_handler_t handler, void *context); /*!< Send command to DCE */
     int (*send_data)(modem_dte_t *dte, const char *data, uint32_t length);          /*!< Send data to DCE */
     esp_err_t (*send_wait)(modem_dte_t *dte, const char *data, uint32_t length,
                            const char *prompt, uint32_t timeout);      /*!< Wait for specific prompt */
+    esp_err_t (*send_cmd_async)(modem_dte_t *dte, const char *command, uint32_t timeout,
+                                modem_async_handler_t handler, void *context); /*!< Queue command without blocking */
+    esp_err_t (*pulse_dtr)(modem_dte_t *dte, uint32_t timeout,
+                           modem_line_handler_t handler, void *context); /*!< Drop DTR and wait for the result code */
     esp_err_t (*change_mode)(modem_dte_t *dte, modem_mode_t new_mode); /*!< Changing working mode */
     esp_err_t (*process_cmd_done)(modem_dte_t *dte);                   /*!< Callback when DCE process command done */
+    esp_err_t (*reset)(modem_dte_t *dte);                              /*!< Warm restart after DCE reboot, keeping driver and handlers */
     esp_err_t (*deinit)(modem_dte_t *dte);                             /*!< Deinitialize */
 };
 
@@ -0,0 +1,437 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_gnss.h"
+
+#define ESP_MODEM_GNSS_FIELDS_MAX (22) /*!< Fields of the longest line parsed, +UGNSINF */
+#define ESP_MODEM_GNSS_SENTENCE_GGA (1 << 0)
+#define ESP_MODEM_GNSS_SENTENCE_RMC (1 << 1)
+#define ESP_MODEM_GNSS_SENTENCE_ALL (ESP_MODEM_GNSS_SENTENCE_GGA | ESP_MODEM_GNSS_SENTENCE_RMC)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *GNSS_TAG = "esp-modem-gnss";
+#define GNSS_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(a))                                                                      \
+        {                                                                              \
+            ESP_LOGE(GNSS_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                             \
+        }                                                                              \
+    } while (0)
+
+/**
+ * @brief GNSS receiver of a module
+ *
+ */
+struct esp_modem_gnss {
+    modem_dce_t *dce;                /*!< Module of the receiver */
+    esp_modem_gnss_config_t config;  /*!< Configuration */
+    uint32_t sequence;               /*!< Fixes published times two, odd while slot 0 is written */
+    esp_modem_gnss_fix_t slot[2];    /*!< Latest fix, slot 0 read while the sequence is even */
+    /* Written by the DTE task only */
+    esp_modem_gnss_fix_t work;       /*!< Fix of the current NMEA epoch */
+    int32_t epoch_ms;                /*!< Time of day of the current NMEA epoch, unit: ms, -1 if none */
+    uint32_t epoch_sentences;        /*!< Sentences of the current NMEA epoch */
+    uint32_t epochs;                 /*!< NMEA epochs started */
+    bool epoch_kept;                 /*!< Current NMEA epoch kept by the decimation */
+    bool epoch_fixed;                /*!< Current NMEA epoch reports a fix in all its sentences */
+    int64_t date_ms;                 /*!< Date of the last RMC sentence, unit: ms since 1970, 0 if none */
+    int64_t started;                 /*!< Start of the receiver, unit: us since boot */
+    portMUX_TYPE lock;               /*!< Protects the fields below */
+    esp_modem_gnss_stats_t stats;    /*!< Statistics */
+};
+
+#define GNSS_STATS_INC(gnss, field)         \
+    do                                      \
+    {                                       \
+        portENTER_CRITICAL(&(gnss)->lock);  \
+        (gnss)->stats.field++;              \
+        portEXIT_CRITICAL(&(gnss)->lock);   \
+    } while (0)
+
+/**
+ * @brief Publish a fix, readers copy the slot not being written
+ */
+static void esp_modem_gnss_publish(struct esp_modem_gnss *gnss, const esp_modem_gnss_fix_t *fix)
+{
+    uint32_t sequence = gnss->sequence;
+    if (!sequence) {
+        portENTER_CRITICAL(&gnss->lock);
+        gnss->stats.ttff_ms = (fix->received - gnss->started) / 1000;
+        portEXIT_CRITICAL(&gnss->lock);
+    }
+    __atomic_store_n(&gnss->sequence, sequence + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    gnss->slot[0] = *fix;
+    __atomic_store_n(&gnss->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    gnss->slot[1] = *fix;
+    GNSS_STATS_INC(gnss, fixes);
+}
+
+/**
+ * @brief Days from 1970-01-01 to a civil date
+ */
+static int64_t esp_modem_gnss_days(int year, int month, int day)
+{
+    year -= month <= 2;
+    int era = year / 400;
+    int year_of_era = year - era * 400;
+    int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return (int64_t)era * 146097 + day_of_era - 719468;
+}
+
+/**
+ * @brief Split the fields of a line in place, NULL past the last one
+ */
+static int esp_modem_gnss_split(const char *line, const char **fields, int max)
+{
+    int count = 0;
+    while (line && count < max) {
+        fields[count++] = line;
+        while (*line && *line != ',' && *line != '*' && *line != '\r' && *line != '\n') {
+            line++;
+        }
+        line = *line == ',' ? line + 1 : NULL;
+    }
+    for (int i = count; i < max; i++) {
+        fields[i] = NULL;
+    }
+    return count;
+}
+
+/**
+ * @brief Whether a field is empty
+ */
+static bool esp_modem_gnss_empty(const char *field)
+{
+    return !field || *field == ',' || *field == '*' || *field == '\r' || *field == '\n' || !*field;
+}
+
+/**
+ * @brief Parse a decimal field in fixed point, "-12.345" with 2 digits is -1234, extra digits cut
+ */
+static bool esp_modem_gnss_fixed(const char *field, int digits, int64_t *value)
+{
+    if (esp_modem_gnss_empty(field)) {
+        return false;
+    }
+    bool negative = *field == '-';
+    field += negative || *field == '+';
+    int64_t result = 0;
+    bool any = false;
+    for (; *field >= '0' && *field <= '9'; field++) {
+        result = result * 10 + (*field - '0');
+        any = true;
+    }
+    int fraction = 0;
+    if (*field == '.') {
+        for (field++; *field >= '0' && *field <= '9'; field++) {
+            if (fraction < digits) {
+                result = result * 10 + (*field - '0');
+                fraction++;
+            }
+            any = true;
+        }
+    }
+    for (; fraction < digits; fraction++) {
+        result *= 10;
+    }
+    *value = negative ? -result : result;
+    return any;
+}
+
+/**
+ * @brief Parse a field of a fixed number of digits
+ */
+static bool esp_modem_gnss_digits(const char *field, int count, int *value)
+{
+    *value = 0;
+    for (int i = 0; i < count; i++) {
+        if (field[i] < '0' || field[i] > '9') {
+            return false;
+        }
+        *value = *value * 10 + (field[i] - '0');
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a time of day, "hhmmss.sss", in ms
+ */
+static bool esp_modem_gnss_time(const char *field, int32_t *time_ms)
+{
+    int hours, minutes;
+    int64_t seconds;
+    if (esp_modem_gnss_empty(field) || !esp_modem_gnss_digits(field, 2, &hours) ||
+        !esp_modem_gnss_digits(field + 2, 2, &minutes) || !esp_modem_gnss_fixed(field + 4, 3, &seconds)) {
+        return false;
+    }
+    *time_ms = (hours * 60 + minutes) * 60000 + seconds;
+    return true;
+}
+
+/**
+ * @brief Parse an NMEA coordinate, "ddmm.mmmm" or "dddmm.mmmm" then the hemisphere, in 1e-7 degree
+ */
+static bool esp_modem_gnss_coordinate(const char *field, const char *hemisphere, int32_t *coordinate)
+{
+    int64_t value;
+    if (!esp_modem_gnss_fixed(field, 6, &value) || esp_modem_gnss_empty(hemisphere)) {
+        return false;
+    }
+    /* Degrees, then minutes in 1e-6 */
+    int64_t degrees = value / 100000000;
+    int64_t minutes = value % 100000000;
+    *coordinate = degrees * 10000000 + minutes * 10 / 60;
+    if (*hemisphere == 'S' || *hemisphere == 'W') {
+        *coordinate = -*coordinate;
+    }
+    return true;
+}
+
+/**
+ * @brief Verify the checksum of an NMEA sentence, "$...*hh"
+ */
+static bool esp_modem_gnss_checksum(const char *line)
+{
+    uint8_t sum = 0;
+    for (line++; *line && *line != '*'; line++) {
+        sum ^= *line;
+    }
+    if (*line != '*') {
+        return false;
+    }
+    char *end = NULL;
+    long expected = strtol(line + 1, &end, 16);
+    return end == line + 3 && expected == sum;
+}
+
+/**
+ * @brief Start an NMEA epoch, the decimation deciding whether it is parsed at all
+ */
+static void esp_modem_gnss_new_epoch(struct esp_modem_gnss *gnss, int32_t time_ms)
+{
+    if (gnss->epoch_ms >= 0 && gnss->epoch_kept && gnss->epoch_sentences != ESP_MODEM_GNSS_SENTENCE_ALL) {
+        GNSS_STATS_INC(gnss, parse_errors);
+    }
+    gnss->epoch_ms = time_ms;
+    gnss->epoch_sentences = 0;
+    gnss->epoch_fixed = true;
+    gnss->epoch_kept = gnss->epochs++ % gnss->config.decimation == 0;
+    if (!gnss->epoch_kept) {
+        GNSS_STATS_INC(gnss, decimated);
+    }
+    memset(&gnss->work, 0, sizeof(esp_modem_gnss_fix_t));
+}
+
+/**
+ * @brief GGA and RMC sentences of any talker, parsed in place
+ */
+static void esp_modem_gnss_on_nmea(modem_dce_t *dce, const char *line, void *context)
+{
+    struct esp_modem_gnss *gnss = context;
+    const char *fields[ESP_MODEM_GNSS_FIELDS_MAX];
+    int32_t time_ms;
+    int64_t value;
+    GNSS_STATS_INC(gnss, lines);
+    if (!esp_modem_gnss_checksum(line)) {
+        GNSS_STATS_INC(gnss, checksum_errors);
+        return;
+    }
+    int count = esp_modem_gnss_split(line + 1, fields, ESP_MODEM_GNSS_FIELDS_MAX);
+    uint32_t sentence;
+    /* Two letter talkers, GP, GL, GA, GN, BD, GB, GQ, ..., $P starts proprietary sentences */
+    if (fields[0][0] == 'P' || strcspn(fields[0], ",*") != 5) {
+        return;
+    }
+    if (!strncmp(fields[0] + 2, "GGA,", 4) && count >= 10) {
+        sentence = ESP_MODEM_GNSS_SENTENCE_GGA;
+    } else if (!strncmp(fields[0] + 2, "RMC,", 4) && count >= 10) {
+        sentence = ESP_MODEM_GNSS_SENTENCE_RMC;
+    } else {
+        return;
+    }
+    if (!esp_modem_gnss_time(fields[1], &time_ms)) {
+        /* No time before the first fix */
+        GNSS_STATS_INC(gnss, no_fix);
+        return;
+    }
+    if (time_ms != gnss->epoch_ms) {
+        esp_modem_gnss_new_epoch(gnss, time_ms);
+    }
+    if (!gnss->epoch_kept || (gnss->epoch_sentences & sentence)) {
+        return;
+    }
+    gnss->epoch_sentences |= sentence;
+    esp_modem_gnss_fix_t *fix = &gnss->work;
+    if (sentence == ESP_MODEM_GNSS_SENTENCE_GGA) {
+        int quality = atoi(fields[6]);
+        gnss->epoch_fixed &= quality > 0 && esp_modem_gnss_coordinate(fields[2], fields[3], &fix->latitude) &&
+                             esp_modem_gnss_coordinate(fields[4], fields[5], &fix->longitude);
+        fix->satellites = atoi(fields[7]);
+        fix->hdop = esp_modem_gnss_fixed(fields[8], 2, &value) ? value : 0;
+        fix->altitude = esp_modem_gnss_fixed(fields[9], 2, &value) ? value : 0;
+    } else {
+        int day, month, year;
+        gnss->epoch_fixed &= *fields[2] == 'A';
+        /* Knots to cm/s */
+        fix->speed = esp_modem_gnss_fixed(fields[7], 3, &value) ? value * 514444 / 10000000 : 0;
+        fix->course = esp_modem_gnss_fixed(fields[8], 2, &value) ? value : 0;
+        if (esp_modem_gnss_digits(fields[9], 2, &day) && esp_modem_gnss_digits(fields[9] + 2, 2, &month) &&
+            esp_modem_gnss_digits(fields[9] + 4, 2, &year)) {
+            gnss->date_ms = esp_modem_gnss_days(2000 + year, month, day) * 86400000;
+        }
+    }
+    if (gnss->epoch_sentences != ESP_MODEM_GNSS_SENTENCE_ALL) {
+        return;
+    }
+    if (!gnss->epoch_fixed) {
+        GNSS_STATS_INC(gnss, no_fix);
+        return;
+    }
+    fix->utc_ms = gnss->date_ms ? gnss->date_ms + time_ms : 0;
+    fix->received = esp_timer_get_time();
+    esp_modem_gnss_publish(gnss, fix);
+}
+
+/**
+ * @brief Navigation information, "+UGNSINF: <run>,<fix>,<utc>,<lat>,<lon>,<alt>,<speed>,<course>,..."
+ * as reported or "+CGNSINF: ..." as answered, parsed in place
+ */
+static void esp_modem_gnss_on_nav_info(modem_dce_t *dce, const char *line, void *context)
+{
+    struct esp_modem_gnss *gnss = context;
+    const char *fields[ESP_MODEM_GNSS_FIELDS_MAX];
+    esp_modem_gnss_fix_t fix = { 0 };
+    int64_t value;
+    int64_t latitude, longitude;
+    int year, month, day;
+    int32_t time_ms;
+    GNSS_STATS_INC(gnss, lines);
+    const char *start = strchr(line, ':');
+    int count = esp_modem_gnss_split(start ? start + 1 : line, fields, ESP_MODEM_GNSS_FIELDS_MAX);
+    if (count < 16) {
+        GNSS_STATS_INC(gnss, parse_errors);
+        return;
+    }
+    while (*fields[0] == ' ') {
+        fields[0]++;
+    }
+    if (atoi(fields[1]) != 1 || !esp_modem_gnss_fixed(fields[3], 7, &latitude) ||
+        !esp_modem_gnss_fixed(fields[4], 7, &longitude)) {
+        GNSS_STATS_INC(gnss, no_fix);
+        return;
+    }
+    fix.latitude = latitude;
+    fix.longitude = longitude;
+    fix.altitude = esp_modem_gnss_fixed(fields[5], 2, &value) ? value : 0;
+    /* km/h to cm/s */
+    fix.speed = esp_modem_gnss_fixed(fields[6], 3, &value) ? value / 36 : 0;
+    fix.course = esp_modem_gnss_fixed(fields[7], 2, &value) ? value : 0;
+    fix.hdop = esp_modem_gnss_fixed(fields[10], 2, &value) ? value : 0;
+    fix.satellites = atoi(fields[15]);
+    /* yyyyMMddhhmmss.sss */
+    if (esp_modem_gnss_digits(fields[2], 4, &year) && esp_modem_gnss_digits(fields[2] + 4, 2, &month) &&
+        esp_modem_gnss_digits(fields[2] + 6, 2, &day) && esp_modem_gnss_time(fields[2] + 8, &time_ms)) {
+        fix.utc_ms = esp_modem_gnss_days(year, month, day) * 86400000 + time_ms;
+    }
+    fix.received = esp_timer_get_time();
+    esp_modem_gnss_publish(gnss, &fix);
+}
+
+esp_modem_gnss_handle_t esp_modem_gnss_start(modem_dce_t *dce, const esp_modem_gnss_config_t *config)
+{
+    GNSS_CHECK(dce && dce->dte && config && config->decimation && config->output != MODEM_GNSS_OFF, "invalid argument",
+               err);
+    GNSS_CHECK(dce->set_gnss, "gnss not supported", err);
+    struct esp_modem_gnss *gnss = calloc(1, sizeof(struct esp_modem_gnss));
+    GNSS_CHECK(gnss, "calloc gnss failed", err);
+    gnss->dce = dce;
+    gnss->config = *config;
+    gnss->epoch_ms = -1;
+    gnss->started = esp_timer_get_time();
+    gnss->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    uint32_t report_every = 1;
+    if (config->output == MODEM_GNSS_NMEA) {
+        GNSS_CHECK(esp_modem_register_urc_handler(dce->dte, "$", esp_modem_gnss_on_nmea, gnss) == ESP_OK,
+                   "register nmea handler failed", err_urc);
+    } else {
+        /* The module reports one fix out of decimation, the UART carries no more */
+        report_every = config->decimation;
+        gnss->config.decimation = 1;
+    }
+    /* Answers to AT+CGNSINF are taken too, whatever the output */
+    GNSS_CHECK(esp_modem_register_urc_handler(dce->dte, "+UGNSINF:", esp_modem_gnss_on_nav_info, gnss) == ESP_OK &&
+               esp_modem_register_urc_handler(dce->dte, "+CGNSINF:", esp_modem_gnss_on_nav_info, gnss) == ESP_OK,
+               "register navigation information handler failed", err_urc);
+    GNSS_CHECK(dce->set_gnss(dce, config->output, report_every) == ESP_OK, "start gnss failed", err_urc);
+    ESP_LOGI(GNSS_TAG, "gnss started, one fix out of %d", config->decimation);
+    return gnss;
+err_urc:
+    esp_modem_unregister_urc_handler(dce->dte, esp_modem_gnss_on_nmea, gnss);
+    esp_modem_unregister_urc_handler(dce->dte, esp_modem_gnss_on_nav_info, gnss);
+    free(gnss);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_gnss_stop(esp_modem_gnss_handle_t gnss)
+{
+    GNSS_CHECK(gnss, "invalid argument", err);
+    esp_err_t ret = gnss->dce->set_gnss(gnss->dce, MODEM_GNSS_OFF, 0);
+    esp_modem_unregister_urc_handler(gnss->dce->dte, esp_modem_gnss_on_nmea, gnss);
+    esp_modem_unregister_urc_handler(gnss->dce->dte, esp_modem_gnss_on_nav_info, gnss);
+    free(gnss);
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_gnss_get_fix(esp_modem_gnss_handle_t gnss, esp_modem_gnss_fix_t *fix)
+{
+    GNSS_CHECK(gnss && fix, "invalid argument", err);
+    uint32_t sequence;
+    do {
+        /* Retried only if the DTE task published meanwhile */
+        sequence = __atomic_load_n(&gnss->sequence, __ATOMIC_ACQUIRE);
+        *fix = gnss->slot[sequence & 1];
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    } while (sequence != __atomic_load_n(&gnss->sequence, __ATOMIC_ACQUIRE));
+    /* Slot 1 is only written once the first publish completed */
+    return sequence >= 2 ? ESP_OK : ESP_ERR_NOT_FOUND;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_gnss_get_stats(esp_modem_gnss_handle_t gnss, esp_modem_gnss_stats_t *stats)
+{
+    GNSS_CHECK(gnss && stats, "invalid argument", err);
+    portENTER_CRITICAL(&gnss->lock);
+    *stats = gnss->stats;
+    portEXIT_CRITICAL(&gnss->lock);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
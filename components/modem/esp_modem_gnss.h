@@ -0,0 +1,123 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief GNSS configuration
+ *
+ */
+typedef struct {
+    modem_gnss_output_t output; /*!< Navigation information or NMEA sentences */
+    uint32_t decimation;        /*!< Keep one fix out of decimation, by the module for navigation information */
+} esp_modem_gnss_config_t;
+
+/**
+ * @brief GNSS default configuration
+ *
+ */
+#define ESP_MODEM_GNSS_DEFAULT_CONFIG() \
+    {                                   \
+        .output = MODEM_GNSS_NAV_INFO,  \
+        .decimation = 1                 \
+    }
+
+/**
+ * @brief Position fix, in fixed point
+ *
+ */
+typedef struct {
+    int32_t latitude;   /*!< Latitude, north positive, unit: 1e-7 degree */
+    int32_t longitude;  /*!< Longitude, east positive, unit: 1e-7 degree */
+    int32_t altitude;   /*!< Altitude above mean sea level, unit: cm */
+    uint32_t speed;     /*!< Speed over ground, unit: cm/s */
+    uint16_t course;    /*!< Course over ground, unit: 0.01 degree */
+    uint16_t hdop;      /*!< Horizontal dilution of precision, unit: 0.01 */
+    uint8_t satellites; /*!< Satellites used */
+    int64_t utc_ms;     /*!< Time of the fix, unit: ms since 1970-01-01 UTC, 0 if the date is not known yet */
+    int64_t received;   /*!< Reception of the fix, unit: us since boot */
+} esp_modem_gnss_fix_t;
+
+/**
+ * @brief GNSS statistics
+ *
+ */
+typedef struct {
+    uint32_t lines;           /*!< Lines of the receiver */
+    uint32_t fixes;           /*!< Fixes published */
+    uint32_t no_fix;          /*!< Reports without a fix */
+    uint32_t decimated;       /*!< Epochs dropped by the decimation */
+    uint32_t checksum_errors; /*!< NMEA sentences with a wrong checksum */
+    uint32_t parse_errors;    /*!< Lines with missing fields */
+    uint32_t ttff_ms;         /*!< Time to first fix from the start of the receiver, 0 until the first fix */
+} esp_modem_gnss_stats_t;
+
+typedef struct esp_modem_gnss *esp_modem_gnss_handle_t;
+
+/**
+ * @brief Power the GNSS receiver of the module and parse its output as it arrives
+ *
+ * The lines are parsed in place by the DTE task as unsolicited result codes, without copy nor
+ * event post: +UGNSINF and +CGNSINF for navigation information, GGA and RMC sentences of any
+ * talker for NMEA, an epoch published once both arrived. The latest fix is kept in two slots
+ * behind a sequence counter, read without lock nor command to the module.
+ *
+ * @param dce Modem DCE object, with set_gnss
+ * @param config GNSS configuration
+ * @return esp_modem_gnss_handle_t GNSS handle, NULL on error
+ */
+esp_modem_gnss_handle_t esp_modem_gnss_start(modem_dce_t *dce, const esp_modem_gnss_config_t *config);
+
+/**
+ * @brief Power off the GNSS receiver and stop parsing
+ *
+ * @param gnss GNSS handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_FAIL if the module did not power off the receiver
+ */
+esp_err_t esp_modem_gnss_stop(esp_modem_gnss_handle_t gnss);
+
+/**
+ * @brief Get the latest fix, from any task, without blocking
+ *
+ * @param gnss GNSS handle
+ * @param fix latest fix, its age given by received
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_NOT_FOUND if no fix yet, or the first one is being published
+ */
+esp_err_t esp_modem_gnss_get_fix(esp_modem_gnss_handle_t gnss, esp_modem_gnss_fix_t *fix);
+
+/**
+ * @brief Get the GNSS statistics
+ *
+ * @param gnss GNSS handle
+ * @param stats statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_gnss_get_stats(esp_modem_gnss_handle_t gnss, esp_modem_gnss_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,228 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
+#include "esp_log.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_identity.h"
+
+#define ESP_MODEM_IDENTITY_NAMESPACE "modem_id"
+#define ESP_MODEM_IDENTITY_VERSION (1)
+#define ESP_MODEM_IDENTITY_KEY_LENGTH (15)
+#define ESP_MODEM_IDENTITY_SAVE_STACK_SIZE (3072)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *IDENTITY_TAG = "esp-modem-identity";
+#define IDENTITY_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                     \
+    {                                                                                      \
+        if (!(a))                                                                          \
+        {                                                                                  \
+            ESP_LOGE(IDENTITY_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                                 \
+        }                                                                                  \
+    } while (0)
+
+/**
+ * @brief Identity cache entry, stored as NVS blob keyed by ICCID
+ *
+ */
+typedef struct {
+    uint32_t version;                     /*!< Layout version of the entry */
+    char iccid[MODEM_ICCID_LENGTH + 1];   /*!< ICCID the entry belongs to */
+    char name[MODEM_MAX_NAME_LENGTH];     /*!< Module name */
+    char imei[MODEM_IMEI_LENGTH + 1];     /*!< IMEI number */
+    char imsi[MODEM_IMSI_LENGTH + 1];     /*!< IMSI number */
+    char oper[MODEM_MAX_OPERATOR_LENGTH]; /*!< Last known operator name */
+} esp_modem_identity_cache_t;
+
+/* Protects the operator name, written in the background */
+static portMUX_TYPE s_identity_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief NVS keys are limited to 15 characters, use the tail of the ICCID which holds the serial number
+ */
+static const char *esp_modem_identity_key(const char *iccid)
+{
+    size_t len = strlen(iccid);
+    return len > ESP_MODEM_IDENTITY_KEY_LENGTH ? iccid + len - ESP_MODEM_IDENTITY_KEY_LENGTH : iccid;
+}
+
+esp_err_t esp_modem_identity_save(modem_dce_t *dce)
+{
+    nvs_handle_t handle;
+    esp_modem_identity_cache_t cache = {
+        .version = ESP_MODEM_IDENTITY_VERSION
+    };
+    if (!dce->iccid[0]) {
+        /* Without ICCID there is no key to store the entry */
+        return ESP_ERR_INVALID_STATE;
+    }
+    strcpy(cache.iccid, dce->iccid);
+    strcpy(cache.name, dce->name);
+    strcpy(cache.imei, dce->imei);
+    strcpy(cache.imsi, dce->imsi);
+    esp_modem_identity_copy_operator(dce, cache.oper, sizeof(cache.oper));
+    IDENTITY_CHECK(nvs_open(ESP_MODEM_IDENTITY_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK, "open nvs failed", err);
+    IDENTITY_CHECK(nvs_set_blob(handle, esp_modem_identity_key(dce->iccid), &cache, sizeof(cache)) == ESP_OK,
+                   "write cache failed", err_nvs);
+    IDENTITY_CHECK(nvs_commit(handle) == ESP_OK, "commit cache failed", err_nvs);
+    nvs_close(handle);
+    ESP_LOGD(IDENTITY_TAG, "identity of %s saved", dce->iccid);
+    return ESP_OK;
+err_nvs:
+    nvs_close(handle);
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_identity_restore(modem_dce_t *dce)
+{
+    nvs_handle_t handle;
+    esp_modem_identity_cache_t cache;
+    size_t len = sizeof(cache);
+    IDENTITY_CHECK(dce->get_iccid_number, "iccid query not supported", err);
+    IDENTITY_CHECK(dce->get_iccid_number(dce) == ESP_OK, "get iccid failed", err);
+    if (nvs_open(ESP_MODEM_IDENTITY_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        ESP_LOGI(IDENTITY_TAG, "no identity cache");
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t res = nvs_get_blob(handle, esp_modem_identity_key(dce->iccid), &cache, &len);
+    nvs_close(handle);
+    /* A different SIM or a layout change invalidates the entry */
+    if (res != ESP_OK || len != sizeof(cache) || cache.version != ESP_MODEM_IDENTITY_VERSION ||
+            strcmp(cache.iccid, dce->iccid)) {
+        ESP_LOGI(IDENTITY_TAG, "no cached identity for %s", dce->iccid);
+        return ESP_ERR_NOT_FOUND;
+    }
+    strcpy(dce->name, cache.name);
+    strcpy(dce->imei, cache.imei);
+    strcpy(dce->imsi, cache.imsi);
+    esp_modem_identity_set_operator(dce, cache.oper);
+    ESP_LOGD(IDENTITY_TAG, "identity of %s restored", dce->iccid);
+    if (cache.oper[0]) {
+        esp_modem_identity_refresh_operator(dce);
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+bool esp_modem_identity_set_operator(modem_dce_t *dce, const char *oper)
+{
+    portENTER_CRITICAL(&s_identity_lock);
+    bool changed = strncmp(dce->oper, oper, MODEM_MAX_OPERATOR_LENGTH - 1);
+    if (changed) {
+        strncpy(dce->oper, oper, MODEM_MAX_OPERATOR_LENGTH - 1);
+        dce->oper[MODEM_MAX_OPERATOR_LENGTH - 1] = '\0';
+    }
+    portEXIT_CRITICAL(&s_identity_lock);
+    return changed;
+}
+
+void esp_modem_identity_copy_operator(modem_dce_t *dce, char *oper, size_t size)
+{
+    if (!size) {
+        return;
+    }
+    portENTER_CRITICAL(&s_identity_lock);
+    strncpy(oper, dce->oper, size - 1);
+    portEXIT_CRITICAL(&s_identity_lock);
+    oper[size - 1] = '\0';
+}
+
+/**
+ * @brief Save the refreshed operator name, NVS is neither written from the DTE task nor the timer task
+ */
+static void esp_modem_identity_save_task(void *param)
+{
+    esp_modem_identity_save(param);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Handle response from AT+COPS? sent in the background
+ */
+static bool esp_modem_identity_handle_cops(modem_dce_t *dce, const char *line, void *context)
+{
+    if (!line) {
+        return true;
+    }
+    if (!strncmp(line, "+COPS", strlen("+COPS"))) {
+        /* +COPS: <mode>[, <format>[, <oper>]], operator name may contain spaces but no comma */
+        const char *p = strchr(line, ',');
+        p = p ? strchr(p + 1, ',') : NULL;
+        char oper[MODEM_MAX_OPERATOR_LENGTH];
+        if (p && snprintf(oper, sizeof(oper), "%.*s", (int)strcspn(p + 1, ",\r\n"), p + 1) > 0 &&
+                esp_modem_identity_set_operator(dce, oper)) {
+            ESP_LOGD(IDENTITY_TAG, "operator refreshed: %s", oper);
+            /* Lines would pile up on the DTE task meanwhile */
+            if (xTaskCreate(esp_modem_identity_save_task, "modem_id_save", ESP_MODEM_IDENTITY_SAVE_STACK_SIZE, dce,
+                            uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+                ESP_LOGW(IDENTITY_TAG, "operator not saved");
+            }
+        }
+        return false;
+    }
+    return strstr(line, MODEM_RESULT_CODE_SUCCESS) || strstr(line, MODEM_RESULT_CODE_ERROR);
+}
+
+esp_err_t esp_modem_identity_refresh_operator(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    return dte->send_cmd_async(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR,
+                               esp_modem_identity_handle_cops, NULL);
+}
+
+/**
+ * @brief Fill one identity field on first access
+ */
+static const char *esp_modem_identity_get(modem_dce_t *dce, char *field, esp_err_t (*query)(modem_dce_t *dce))
+{
+    if (!field[0] && query) {
+        if (query(dce) == ESP_OK) {
+            esp_modem_identity_save(dce);
+        } else {
+            field[0] = '\0';
+        }
+    }
+    return field;
+}
+
+const char *esp_modem_identity_get_module_name(modem_dce_t *dce)
+{
+    return esp_modem_identity_get(dce, dce->name, dce->get_module_name);
+}
+
+const char *esp_modem_identity_get_imei(modem_dce_t *dce)
+{
+    return esp_modem_identity_get(dce, dce->imei, dce->get_imei_number);
+}
+
+const char *esp_modem_identity_get_imsi(modem_dce_t *dce)
+{
+    return esp_modem_identity_get(dce, dce->imsi, dce->get_imsi_number);
+}
+
+const char *esp_modem_identity_get_operator(modem_dce_t *dce)
+{
+    return esp_modem_identity_get(dce, dce->oper, dce->get_operator_name);
+}
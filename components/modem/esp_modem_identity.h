@@ -0,0 +1,119 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Restore identity of the DCE from the NVS cache
+ *
+ * Reads the ICCID of the SIM card, which is a local query, and fills module name, IMEI, IMSI and
+ * operator name from the cache entry stored for this ICCID. The operator name is then refreshed
+ * in the background. Fields without cache entry are left empty and queried on first access.
+ *
+ * @note NVS must have been initialized by the application
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if no cache entry matches the SIM card
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_identity_restore(modem_dce_t *dce);
+
+/**
+ * @brief Store current identity of the DCE in the NVS cache
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_identity_save(modem_dce_t *dce);
+
+/**
+ * @brief Refresh operator name in the background
+ *
+ * The query is sent once the AT channel is idle and does not block the caller. A new name is
+ * stored in the DCE, then in the NVS cache from a short lived task.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_identity_refresh_operator(modem_dce_t *dce);
+
+/**
+ * @brief Set the operator name of the DCE, under the lock of the name
+ *
+ * Called by drivers from the handlers of +COPS, the name may be read by other tasks meanwhile.
+ *
+ * @param dce Modem DCE object
+ * @param oper operator name, truncated to MODEM_MAX_OPERATOR_LENGTH - 1 characters
+ * @return true if the name changed
+ */
+bool esp_modem_identity_set_operator(modem_dce_t *dce, const char *oper);
+
+/**
+ * @brief Copy the operator name of the DCE, under the lock of the name
+ *
+ * @param dce Modem DCE object
+ * @param oper buffer for the operator name, empty string if unknown
+ * @param size size of the buffer
+ */
+void esp_modem_identity_copy_operator(modem_dce_t *dce, char *oper, size_t size);
+
+/**
+ * @brief Get module name, querying the module on first access
+ *
+ * @param dce Modem DCE object
+ * @return const char* module name, empty string if unknown
+ */
+const char *esp_modem_identity_get_module_name(modem_dce_t *dce);
+
+/**
+ * @brief Get IMEI number, querying the module on first access
+ *
+ * @param dce Modem DCE object
+ * @return const char* IMEI number, empty string if unknown
+ */
+const char *esp_modem_identity_get_imei(modem_dce_t *dce);
+
+/**
+ * @brief Get IMSI number, querying the module on first access
+ *
+ * @param dce Modem DCE object
+ * @return const char* IMSI number, empty string if unknown
+ */
+const char *esp_modem_identity_get_imsi(modem_dce_t *dce);
+
+/**
+ * @brief Get operator name, querying the module on first access
+ *
+ * @note A cached name is returned as is, it is refreshed in the background by esp_modem_identity_restore().
+ *       The buffer may then be rewritten while read, other tasks use esp_modem_identity_copy_operator().
+ *
+ * @param dce Modem DCE object
+ * @return const char* operator name, empty string if unknown
+ */
+const char *esp_modem_identity_get_operator(modem_dce_t *dce);
+
+#ifdef __cplusplus
+}
+#endif
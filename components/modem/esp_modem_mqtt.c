@@ -0,0 +1,450 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_mqtt.h"
+
+#define ESP_MODEM_MQTT_DEFAULT_PORT (1883) /*!< Port of a URI without one */
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *MQTT_TAG = "esp-modem-mqtt";
+#define MQTT_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(a))                                                                      \
+        {                                                                              \
+            ESP_LOGE(MQTT_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                             \
+        }                                                                              \
+    } while (0)
+
+/**
+ * @brief MQTT client on the MQTT client of a module
+ *
+ */
+struct esp_modem_mqtt_client {
+    modem_dce_t *dce;                /*!< Module carrying the session */
+    esp_modem_mqtt_config_t config;  /*!< Configuration */
+    modem_mqtt_config_t session;     /*!< Session of the module, from the configuration */
+    char *host;                      /*!< Broker host, parsed from the URI */
+    SemaphoreHandle_t command_lock;  /*!< Serializes the commands of the client task and of the callers */
+    QueueHandle_t queue;             /*!< Events for the callback, a NULL entry wakes the task up */
+    TaskHandle_t task;               /*!< Client task, NULL if not started */
+    SemaphoreHandle_t exit_sem;      /*!< Given by the client task on exit */
+    volatile bool stop;              /*!< Request the client task to exit */
+    portMUX_TYPE lock;               /*!< Protects the fields below */
+    bool connected;                  /*!< Session up */
+    bool stack_up;                   /*!< IP stack of the module up */
+    int msg_id;                      /*!< Last message identifier */
+    esp_modem_mqtt_stats_t stats;    /*!< Traffic */
+};
+
+/**
+ * @brief Create an event, topic and data copied after it
+ */
+static esp_modem_mqtt_event_t *esp_modem_mqtt_event_new(struct esp_modem_mqtt_client *client,
+                                                        esp_modem_mqtt_event_id_t event_id, const char *topic,
+                                                        size_t topic_len, const char *data, size_t data_len,
+                                                        int msg_id)
+{
+    esp_modem_mqtt_event_t *event = malloc(sizeof(esp_modem_mqtt_event_t) + topic_len + data_len + 2);
+    MQTT_CHECK(event, "malloc event failed", err);
+    event->event_id = event_id;
+    event->client = client;
+    event->user_context = client->config.user_context;
+    event->topic = (char *)(event + 1);
+    event->topic_len = topic_len;
+    event->data = event->topic + topic_len + 1;
+    event->data_len = data_len;
+    event->msg_id = msg_id;
+    if (topic_len) {
+        memcpy(event->topic, topic, topic_len);
+    }
+    event->topic[topic_len] = '\0';
+    if (data_len) {
+        memcpy(event->data, data, data_len);
+    }
+    event->data[data_len] = '\0';
+    return event;
+err:
+    return NULL;
+}
+
+/**
+ * @brief Queue an event for the callback, dropped if the queue is full
+ */
+static void esp_modem_mqtt_post(struct esp_modem_mqtt_client *client, esp_modem_mqtt_event_t *event)
+{
+    if (!event || xQueueSend(client->queue, &event, 0) != pdTRUE) {
+        free(event);
+        portENTER_CRITICAL(&client->lock);
+        client->stats.dropped++;
+        portEXIT_CRITICAL(&client->lock);
+        ESP_LOGW(MQTT_TAG, "event dropped");
+    }
+}
+
+/**
+ * @brief Next message identifier, 1 to 65535
+ */
+static int esp_modem_mqtt_next_msg_id(struct esp_modem_mqtt_client *client)
+{
+    portENTER_CRITICAL(&client->lock);
+    client->msg_id = client->msg_id % 65535 + 1;
+    int msg_id = client->msg_id;
+    portEXIT_CRITICAL(&client->lock);
+    return msg_id;
+}
+
+static bool esp_modem_mqtt_is_connected(struct esp_modem_mqtt_client *client)
+{
+    portENTER_CRITICAL(&client->lock);
+    bool connected = client->connected;
+    portEXIT_CRITICAL(&client->lock);
+    return connected;
+}
+
+/**
+ * @brief MQTT and socket events of the module, posted by its unsolicited result code handlers
+ *
+ * Runs on the DTE task, where no command can be sent; events are handed to the client task.
+ */
+static void esp_modem_mqtt_on_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    struct esp_modem_mqtt_client *client = arg;
+    if (event_id == ESP_MODEM_EVENT_SOCKET) {
+        const modem_socket_event_t *socket = event_data;
+        if (socket->id < 0) {
+            /* The session went down with the IP stack */
+            portENTER_CRITICAL(&client->lock);
+            client->stack_up = false;
+            portEXIT_CRITICAL(&client->lock);
+            esp_modem_mqtt_post(client, esp_modem_mqtt_event_new(client, ESP_MODEM_MQTT_EVENT_DISCONNECTED,
+                                                                 NULL, 0, NULL, 0, 0));
+        }
+    } else if (event_id == ESP_MODEM_EVENT_MQTT) {
+        const modem_mqtt_event_t *mqtt = event_data;
+        if (!mqtt->connected) {
+            esp_modem_mqtt_post(client, esp_modem_mqtt_event_new(client, ESP_MODEM_MQTT_EVENT_DISCONNECTED,
+                                                                 NULL, 0, NULL, 0, 0));
+        } else if (mqtt->truncated) {
+            portENTER_CRITICAL(&client->lock);
+            client->stats.truncated++;
+            portEXIT_CRITICAL(&client->lock);
+        } else if (mqtt->topic_len) {
+            portENTER_CRITICAL(&client->lock);
+            client->stats.received++;
+            client->stats.rx_bytes += mqtt->data_len;
+            portEXIT_CRITICAL(&client->lock);
+            esp_modem_mqtt_post(client, esp_modem_mqtt_event_new(client, ESP_MODEM_MQTT_EVENT_DATA, mqtt->content,
+                                                                 mqtt->topic_len, mqtt->content + mqtt->topic_len,
+                                                                 mqtt->data_len, 0));
+        }
+    }
+}
+
+/**
+ * @brief Hand an event to the callback and free it
+ */
+static void esp_modem_mqtt_dispatch(struct esp_modem_mqtt_client *client, esp_modem_mqtt_event_t *event)
+{
+    if (event && client->config.event_handle) {
+        client->config.event_handle(event);
+    }
+    free(event);
+}
+
+/**
+ * @brief Bring up the IP stack of the module if down, then connect to the broker
+ */
+static bool esp_modem_mqtt_connect(struct esp_modem_mqtt_client *client)
+{
+    modem_dce_t *dce = client->dce;
+    xSemaphoreTake(client->command_lock, portMAX_DELAY);
+    portENTER_CRITICAL(&client->lock);
+    bool stack_up = client->stack_up;
+    portEXIT_CRITICAL(&client->lock);
+    if (!stack_up) {
+        stack_up = dce->set_socket_stack(dce, true) == ESP_OK;
+    }
+    bool connected = stack_up && dce->mqtt_connect(dce, &client->session) == ESP_OK;
+    xSemaphoreGive(client->command_lock);
+    portENTER_CRITICAL(&client->lock);
+    /* Checked again by the next connect after a failure */
+    client->stack_up = connected;
+    client->connected = connected;
+    if (connected) {
+        client->stats.connects++;
+    }
+    portEXIT_CRITICAL(&client->lock);
+    return connected;
+}
+
+static void esp_modem_mqtt_task(void *param)
+{
+    struct esp_modem_mqtt_client *client = param;
+    TickType_t retry_at = xTaskGetTickCount();
+    while (!client->stop) {
+        TickType_t ticks = portMAX_DELAY;
+        if (!esp_modem_mqtt_is_connected(client)) {
+            TickType_t now = xTaskGetTickCount();
+            if ((int32_t)(retry_at - now) <= 0) {
+                bool connected = esp_modem_mqtt_connect(client);
+                if (connected) {
+                    ESP_LOGI(MQTT_TAG, "connected to %s:%d", client->session.host, client->session.port);
+                } else {
+                    ESP_LOGW(MQTT_TAG, "connect to %s:%d failed, retry in %d ms", client->session.host,
+                             client->session.port, client->config.reconnect_timeout_ms);
+                }
+                esp_modem_mqtt_dispatch(client, esp_modem_mqtt_event_new(client, connected ? ESP_MODEM_MQTT_EVENT_CONNECTED :
+                                        ESP_MODEM_MQTT_EVENT_ERROR, NULL, 0, NULL, 0, 0));
+                retry_at = xTaskGetTickCount() + pdMS_TO_TICKS(client->config.reconnect_timeout_ms);
+                continue;
+            }
+            ticks = retry_at - now;
+        }
+        esp_modem_mqtt_event_t *event = NULL;
+        if (xQueueReceive(client->queue, &event, ticks) != pdTRUE || !event) {
+            continue;
+        }
+        if (event->event_id == ESP_MODEM_MQTT_EVENT_DISCONNECTED) {
+            portENTER_CRITICAL(&client->lock);
+            bool was_connected = client->connected;
+            client->connected = false;
+            portEXIT_CRITICAL(&client->lock);
+            if (!was_connected) {
+                free(event);
+                continue;
+            }
+            ESP_LOGW(MQTT_TAG, "disconnected, reconnect in %d ms", client->config.reconnect_timeout_ms);
+            retry_at = xTaskGetTickCount() + pdMS_TO_TICKS(client->config.reconnect_timeout_ms);
+        }
+        esp_modem_mqtt_dispatch(client, event);
+    }
+    xSemaphoreTake(client->command_lock, portMAX_DELAY);
+    if (esp_modem_mqtt_is_connected(client)) {
+        client->dce->mqtt_disconnect(client->dce);
+    }
+    client->dce->set_socket_stack(client->dce, false);
+    xSemaphoreGive(client->command_lock);
+    portENTER_CRITICAL(&client->lock);
+    client->connected = false;
+    client->stack_up = false;
+    portEXIT_CRITICAL(&client->lock);
+    esp_modem_mqtt_event_t *event = NULL;
+    while (xQueueReceive(client->queue, &event, 0) == pdTRUE) {
+        free(event);
+    }
+    xSemaphoreGive(client->exit_sem);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Parse the broker of a URI, "mqtt://host:port"
+ */
+static esp_err_t esp_modem_mqtt_parse_uri(struct esp_modem_mqtt_client *client, const char *uri)
+{
+    const char *host = strstr(uri, "://");
+    host = host ? host + strlen("://") : uri;
+    size_t host_len = strcspn(host, ":/");
+    MQTT_CHECK(host_len, "no host in %s", err, uri);
+    client->host = strndup(host, host_len);
+    MQTT_CHECK(client->host, "strndup host failed", err);
+    client->session.host = client->host;
+    client->session.port = ESP_MODEM_MQTT_DEFAULT_PORT;
+    if (host[host_len] == ':') {
+        char *end = NULL;
+        long port = strtol(host + host_len + 1, &end, 10);
+        MQTT_CHECK(end != host + host_len + 1 && port > 0 && port <= 65535, "invalid port in %s", err_port, uri);
+        client->session.port = port;
+    }
+    return ESP_OK;
+err_port:
+    free(client->host);
+    client->host = NULL;
+err:
+    return ESP_FAIL;
+}
+
+esp_modem_mqtt_client_handle_t esp_modem_mqtt_client_init(modem_dce_t *dce, const esp_modem_mqtt_config_t *config)
+{
+    MQTT_CHECK(dce && dce->dte && config && config->uri && config->client_id, "invalid argument", err);
+    MQTT_CHECK(dce->set_socket_stack && dce->mqtt_connect && dce->mqtt_publish && dce->mqtt_subscribe &&
+               dce->mqtt_unsubscribe && dce->mqtt_disconnect, "mqtt offload not supported", err);
+    struct esp_modem_mqtt_client *client = calloc(1, sizeof(struct esp_modem_mqtt_client));
+    MQTT_CHECK(client, "calloc client failed", err);
+    client->dce = dce;
+    client->config = *config;
+    client->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    MQTT_CHECK(esp_modem_mqtt_parse_uri(client, config->uri) == ESP_OK, "parse uri failed", err_uri);
+    client->session.client_id = config->client_id;
+    client->session.username = config->username;
+    client->session.password = config->password;
+    client->session.keepalive_s = config->keepalive;
+    client->session.clean_session = !config->disable_clean_session;
+    client->command_lock = xSemaphoreCreateMutex();
+    MQTT_CHECK(client->command_lock, "create command lock failed", err_lock);
+    client->queue = xQueueCreate(ESP_MODEM_MQTT_QUEUE_SIZE, sizeof(esp_modem_mqtt_event_t *));
+    MQTT_CHECK(client->queue, "create event queue failed", err_queue);
+    client->exit_sem = xSemaphoreCreateBinary();
+    MQTT_CHECK(client->exit_sem, "create exit semaphore failed", err_sem);
+    return client;
+err_sem:
+    vQueueDelete(client->queue);
+err_queue:
+    vSemaphoreDelete(client->command_lock);
+err_lock:
+    free(client->host);
+err_uri:
+    free(client);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_mqtt_client_start(esp_modem_mqtt_client_handle_t client)
+{
+    MQTT_CHECK(client, "invalid argument", err);
+    MQTT_CHECK(!client->task, "client already started", err_state);
+    client->stop = false;
+    /* Registered for any event, esp_modem_remove_event_handler() only removes those */
+    MQTT_CHECK(esp_modem_set_event_handler(client->dce->dte, esp_modem_mqtt_on_event, ESP_EVENT_ANY_ID, client) == ESP_OK,
+               "register event handler failed", err_start);
+    BaseType_t ret = xTaskCreate(esp_modem_mqtt_task, "modem_mqtt", client->config.task_stack, client,
+                                 client->config.task_prio, &client->task);
+    MQTT_CHECK(ret == pdTRUE, "create client task failed", err_task);
+    return ESP_OK;
+err_task:
+    client->task = NULL;
+    esp_modem_remove_event_handler(client->dce->dte, esp_modem_mqtt_on_event);
+err_start:
+    return ESP_FAIL;
+err_state:
+    return ESP_ERR_INVALID_STATE;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_mqtt_client_stop(esp_modem_mqtt_client_handle_t client)
+{
+    MQTT_CHECK(client, "invalid argument", err);
+    MQTT_CHECK(client->task, "client not started", err_state);
+    esp_modem_remove_event_handler(client->dce->dte, esp_modem_mqtt_on_event);
+    client->stop = true;
+    esp_modem_mqtt_event_t *wake = NULL;
+    xQueueSend(client->queue, &wake, portMAX_DELAY);
+    xSemaphoreTake(client->exit_sem, portMAX_DELAY);
+    client->task = NULL;
+    return ESP_OK;
+err_state:
+    return ESP_ERR_INVALID_STATE;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_mqtt_client_destroy(esp_modem_mqtt_client_handle_t client)
+{
+    MQTT_CHECK(client, "invalid argument", err);
+    if (client->task) {
+        esp_modem_mqtt_client_stop(client);
+    }
+    vSemaphoreDelete(client->exit_sem);
+    vQueueDelete(client->queue);
+    vSemaphoreDelete(client->command_lock);
+    free(client->host);
+    free(client);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+int esp_modem_mqtt_client_subscribe(esp_modem_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    MQTT_CHECK(client && topic && !strchr(topic, '"') && qos >= 0 && qos <= 2, "invalid argument", err);
+    MQTT_CHECK(esp_modem_mqtt_is_connected(client), "client not connected", err);
+    xSemaphoreTake(client->command_lock, portMAX_DELAY);
+    esp_err_t ret = client->dce->mqtt_subscribe(client->dce, topic, qos);
+    xSemaphoreGive(client->command_lock);
+    MQTT_CHECK(ret == ESP_OK, "subscribe to %s failed", err, topic);
+    /* The module answers once the broker acknowledged */
+    int msg_id = esp_modem_mqtt_next_msg_id(client);
+    esp_modem_mqtt_post(client, esp_modem_mqtt_event_new(client, ESP_MODEM_MQTT_EVENT_SUBSCRIBED, NULL, 0, NULL, 0,
+                                                         msg_id));
+    return msg_id;
+err:
+    return -1;
+}
+
+int esp_modem_mqtt_client_unsubscribe(esp_modem_mqtt_client_handle_t client, const char *topic)
+{
+    MQTT_CHECK(client && topic && !strchr(topic, '"'), "invalid argument", err);
+    MQTT_CHECK(esp_modem_mqtt_is_connected(client), "client not connected", err);
+    xSemaphoreTake(client->command_lock, portMAX_DELAY);
+    esp_err_t ret = client->dce->mqtt_unsubscribe(client->dce, topic);
+    xSemaphoreGive(client->command_lock);
+    MQTT_CHECK(ret == ESP_OK, "unsubscribe from %s failed", err, topic);
+    int msg_id = esp_modem_mqtt_next_msg_id(client);
+    esp_modem_mqtt_post(client, esp_modem_mqtt_event_new(client, ESP_MODEM_MQTT_EVENT_UNSUBSCRIBED, NULL, 0, NULL, 0,
+                                                         msg_id));
+    return msg_id;
+err:
+    return -1;
+}
+
+int esp_modem_mqtt_client_publish(esp_modem_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                                  int qos, int retain)
+{
+    MQTT_CHECK(client && topic && !strchr(topic, '"') && (data || !len) && len >= 0 && qos >= 0 && qos <= 2,
+               "invalid argument", err);
+    MQTT_CHECK(esp_modem_mqtt_is_connected(client), "client not connected", err);
+    if (!len && data) {
+        len = strlen(data);
+    }
+    xSemaphoreTake(client->command_lock, portMAX_DELAY);
+    esp_err_t ret = client->dce->mqtt_publish(client->dce, topic, data, len, qos, retain);
+    xSemaphoreGive(client->command_lock);
+    MQTT_CHECK(ret == ESP_OK, "publish to %s failed", err, topic);
+    portENTER_CRITICAL(&client->lock);
+    client->stats.published++;
+    client->stats.tx_bytes += len;
+    portEXIT_CRITICAL(&client->lock);
+    if (!qos) {
+        return 0;
+    }
+    int msg_id = esp_modem_mqtt_next_msg_id(client);
+    esp_modem_mqtt_post(client, esp_modem_mqtt_event_new(client, ESP_MODEM_MQTT_EVENT_PUBLISHED, NULL, 0, NULL, 0,
+                                                         msg_id));
+    return msg_id;
+err:
+    return -1;
+}
+
+esp_err_t esp_modem_mqtt_client_get_stats(esp_modem_mqtt_client_handle_t client, esp_modem_mqtt_stats_t *stats)
+{
+    MQTT_CHECK(client && stats, "invalid argument", err);
+    portENTER_CRITICAL(&client->lock);
+    *stats = client->stats;
+    portEXIT_CRITICAL(&client->lock);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
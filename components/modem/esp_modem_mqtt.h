@@ -0,0 +1,212 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Specific Length Constraint
+ *
+ */
+#define ESP_MODEM_MQTT_QUEUE_SIZE (8) /*!< Events waiting for the callback, messages beyond are dropped */
+
+typedef struct esp_modem_mqtt_client *esp_modem_mqtt_client_handle_t;
+
+/**
+ * @brief MQTT client event, as in esp-mqtt
+ *
+ */
+typedef enum {
+    ESP_MODEM_MQTT_EVENT_ERROR = 0,    /*!< Connect failed, retried after reconnect_timeout_ms */
+    ESP_MODEM_MQTT_EVENT_CONNECTED,    /*!< Connected to the broker */
+    ESP_MODEM_MQTT_EVENT_DISCONNECTED, /*!< Broker lost, reconnected after reconnect_timeout_ms */
+    ESP_MODEM_MQTT_EVENT_SUBSCRIBED,   /*!< Subscription acknowledged, msg_id of the subscribe */
+    ESP_MODEM_MQTT_EVENT_UNSUBSCRIBED, /*!< Unsubscription acknowledged, msg_id of the unsubscribe */
+    ESP_MODEM_MQTT_EVENT_PUBLISHED,    /*!< Publish of QoS 1 or 2 acknowledged, msg_id of the publish */
+    ESP_MODEM_MQTT_EVENT_DATA          /*!< Message received, topic and data */
+} esp_modem_mqtt_event_id_t;
+
+/**
+ * @brief MQTT client event data
+ *
+ */
+typedef struct {
+    esp_modem_mqtt_event_id_t event_id;    /*!< Event */
+    esp_modem_mqtt_client_handle_t client; /*!< Client of the event */
+    void *user_context;                    /*!< User context of the configuration */
+    char *data;                            /*!< Message, terminated */
+    int data_len;                          /*!< Length of the message */
+    char *topic;                           /*!< Topic of the message, terminated */
+    int topic_len;                         /*!< Length of the topic */
+    int msg_id;                            /*!< Message identifier of the acknowledged command */
+} esp_modem_mqtt_event_t;
+
+typedef esp_modem_mqtt_event_t *esp_modem_mqtt_event_handle_t;
+
+/**
+ * @brief MQTT client event callback, runs on the client task and may call the client functions
+ *
+ */
+typedef esp_err_t (*esp_modem_mqtt_event_callback_t)(esp_modem_mqtt_event_handle_t event);
+
+/**
+ * @brief MQTT client configuration, close to esp_mqtt_client_config_t
+ *
+ */
+typedef struct {
+    const char *uri;                               /*!< Broker, "mqtt://host:port", port 1883 if left out */
+    const char *client_id;                         /*!< Client identifier */
+    const char *username;                          /*!< User name, NULL for none */
+    const char *password;                          /*!< Password, NULL for none */
+    uint32_t keepalive;                            /*!< Keep alive interval, unit: s */
+    bool disable_clean_session;                    /*!< Keep the subscriptions of the previous session */
+    uint32_t reconnect_timeout_ms;                 /*!< Delay before connecting again after an error or a disconnection */
+    esp_modem_mqtt_event_callback_t event_handle; /*!< Event callback */
+    void *user_context;                            /*!< Passed to the event callback */
+    uint32_t task_stack;                           /*!< Stack size of the client task, the event callback runs on it */
+    uint32_t task_prio;                            /*!< Priority of the client task */
+} esp_modem_mqtt_config_t;
+
+/**
+ * @brief MQTT client default configuration
+ *
+ */
+#define ESP_MODEM_MQTT_DEFAULT_CONFIG()     \
+    {                                       \
+        .uri = NULL,                        \
+        .client_id = "esp32",               \
+        .username = NULL,                   \
+        .password = NULL,                   \
+        .keepalive = 120,                   \
+        .disable_clean_session = false,     \
+        .reconnect_timeout_ms = 10000,      \
+        .event_handle = NULL,               \
+        .user_context = NULL,               \
+        .task_stack = 4096,                 \
+        .task_prio = 5                      \
+    }
+
+/**
+ * @brief Traffic of the client, messages only
+ *
+ */
+typedef struct {
+    uint32_t published;   /*!< Messages published */
+    uint32_t received;    /*!< Messages received */
+    uint32_t dropped;     /*!< Events dropped, the callback lagging behind */
+    uint32_t truncated;   /*!< Messages dropped, longer than the line buffer of the DTE or holding a line break */
+    uint32_t connects;    /*!< Successful connects */
+    uint64_t tx_bytes;    /*!< Bytes of the messages published */
+    uint64_t rx_bytes;    /*!< Bytes of the messages received */
+} esp_modem_mqtt_stats_t;
+
+/**
+ * @brief Create an MQTT client on the MQTT client of the module, in place of esp-mqtt over PPP
+ *
+ * The module keeps the TCP connection and the MQTT session, the ESP32 only sends the publish,
+ * subscribe and unsubscribe commands and takes the incoming messages from the unsolicited result
+ * codes of the module. Neither PPP nor the lwIP and esp-mqtt buffers are needed. An incoming
+ * message has to fit the line buffer of the DTE with its topic and hold no line break, others are
+ * dropped and counted as truncated.
+ *
+ * @param dce Modem DCE object, with set_socket_stack and the MQTT operations
+ * @param config client configuration, its strings referenced until the client is destroyed
+ * @return esp_modem_mqtt_client_handle_t client handle, NULL on error
+ */
+esp_modem_mqtt_client_handle_t esp_modem_mqtt_client_init(modem_dce_t *dce, const esp_modem_mqtt_config_t *config);
+
+/**
+ * @brief Start the client task, which brings up the IP stack of the module and connects
+ *
+ * @param client client handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_INVALID_STATE if already started
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_mqtt_client_start(esp_modem_mqtt_client_handle_t client);
+
+/**
+ * @brief Stop the client task, disconnecting and bringing down the IP stack of the module
+ *
+ * @param client client handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_INVALID_STATE if not started
+ */
+esp_err_t esp_modem_mqtt_client_stop(esp_modem_mqtt_client_handle_t client);
+
+/**
+ * @brief Delete the client, stopped first if started
+ *
+ * @param client client handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_mqtt_client_destroy(esp_modem_mqtt_client_handle_t client);
+
+/**
+ * @brief Subscribe to a topic
+ *
+ * @param client client handle
+ * @param topic topic filter, without quote
+ * @param qos quality of service, 0 to 2
+ * @return int message identifier, ESP_MODEM_MQTT_EVENT_SUBSCRIBED follows, -1 on error
+ */
+int esp_modem_mqtt_client_subscribe(esp_modem_mqtt_client_handle_t client, const char *topic, int qos);
+
+/**
+ * @brief Unsubscribe from a topic
+ *
+ * @param client client handle
+ * @param topic topic filter, without quote
+ * @return int message identifier, ESP_MODEM_MQTT_EVENT_UNSUBSCRIBED follows, -1 on error
+ */
+int esp_modem_mqtt_client_unsubscribe(esp_modem_mqtt_client_handle_t client, const char *topic);
+
+/**
+ * @brief Publish a message
+ *
+ * @param client client handle
+ * @param topic topic, without quote
+ * @param data message
+ * @param len length of the message, 0 for the length of a string
+ * @param qos quality of service, 0 to 2
+ * @param retain retained by the broker
+ * @return int message identifier, ESP_MODEM_MQTT_EVENT_PUBLISHED follows, 0 for QoS 0, -1 on error
+ */
+int esp_modem_mqtt_client_publish(esp_modem_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                                  int qos, int retain);
+
+/**
+ * @brief Get the traffic of the client
+ *
+ * @param client client handle
+ * @param stats traffic
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_mqtt_client_get_stats(esp_modem_mqtt_client_handle_t client, esp_modem_mqtt_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,21 +11,99 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 #include "esp_netif.h"
 #include "esp_modem.h"
+#include "esp_modem_netif.h"
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
 
+#define PPP_FLAG (0x7E)
+#define PPP_ESCAPE (0x7D)
+#define PPP_TRANS (0x20)
+#define PPP_LCP_ECHO_REQUEST (0x09)
+#define PPP_LCP_ECHO_REPLY (0x0A)
+#define KEEPALIVE_TICK_MS (500)
+
 static const char *TAG = "esp-modem-netif";
 
+/**
+ * @brief Start of an LCP packet: address, control and protocol fields, never compressed for LCP
+ *
+ */
+static const uint8_t s_lcp_header[] = {0xFF, 0x03, 0xC0, 0x21};
+
 /**
  * @brief ESP32 Modem handle to be used as netif IO object
  */
 typedef struct esp_modem_netif_driver_s {
     esp_netif_driver_base_t base;           /*!< base structure reserved as esp-netif driver */
     modem_dte_t            *dte;        /*!< ptr to the esp_modem objects (DTE) */
+    SemaphoreHandle_t tx_lock;              /*!< Keeps keepalive frames out of the frames of the stack */
+    bool tx_in_frame;                       /*!< Stack is in the middle of a frame */
+    uint8_t rx_frame[6];                    /*!< Start of the frame being received, unescaped */
+    uint8_t rx_len;                         /*!< Bytes of the frame being received */
+    bool rx_escape;                         /*!< Next byte is escaped */
+    esp_timer_handle_t keepalive_timer;     /*!< Keepalive tick, NULL if keepalive is off */
+    esp_modem_keepalive_config_t keepalive; /*!< Keepalive configuration */
+    volatile bool link_up;                  /*!< IP address given, keepalive may run */
+    volatile TickType_t last_rx;            /*!< Tick count of the last received data */
+    TickType_t echo_sent;                   /*!< Tick count of the echo request in flight */
+    int64_t echo_sent_us;                   /*!< Time of the echo request in flight, for the round trip */
+    bool echo_pending;                      /*!< Echo request in flight */
+    volatile bool echo_replied;             /*!< Echo reply received for the request in flight */
+    uint8_t echo_id;                        /*!< Identifier of the echo request in flight */
+    uint32_t misses;                        /*!< Consecutive echo requests without reply */
+    esp_modem_netif_stats_t stats;          /*!< Data usage and keepalive statistics */
 } esp_modem_netif_driver_t;
 
+/**
+ * @brief Update the PPP frame check sequence (RFC 1662)
+ *
+ */
+static uint16_t ppp_fcs16(uint16_t fcs, const uint8_t *data, size_t len)
+{
+    while (len--) {
+        fcs ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+        }
+    }
+    return fcs;
+}
+
+/**
+ * @brief Frame an LCP echo request with the default ACCM, the one LCP packets use
+ *
+ * The magic number is zero: lwIP does not expose the negotiated one, and zero is what
+ * RFC 1661 asks for when the option is not negotiated.
+ *
+ * @return length of the frame
+ */
+static size_t ppp_lcp_echo_request(uint8_t id, uint8_t *frame)
+{
+    uint8_t packet[14] = {0xFF, 0x03, 0xC0, 0x21, PPP_LCP_ECHO_REQUEST, id, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00};
+    uint16_t fcs = ~ppp_fcs16(0xFFFF, packet, 12);
+    packet[12] = fcs & 0xFF;
+    packet[13] = fcs >> 8;
+    size_t len = 0;
+    frame[len++] = PPP_FLAG;
+    for (size_t i = 0; i < sizeof(packet); i++) {
+        if (packet[i] < PPP_TRANS || packet[i] == PPP_FLAG || packet[i] == PPP_ESCAPE) {
+            frame[len++] = PPP_ESCAPE;
+            frame[len++] = packet[i] ^ PPP_TRANS;
+        } else {
+            frame[len++] = packet[i];
+        }
+    }
+    frame[len++] = PPP_FLAG;
+    return len;
+}
+
 /**
  * @brief Transmit function called from esp_netif to output network stack data
  *
@@ -39,11 +117,142 @@ typedef struct esp_modem_netif_driver_s {
  */
 static esp_err_t esp_modem_dte_transmit(void *h, void *buffer, size_t len)
 {
-    modem_dte_t *dte = h;
-    if (dte->send_data(dte, (const char *)buffer, len) > 0) {
+    esp_modem_netif_driver_t *driver = h;
+    modem_dte_t *dte = driver->dte;
+    if (dte->dce && dte->dce->data_suspended) {
+        /* Session suspended in command mode, lost frames are recovered by the upper layers */
         return ESP_OK;
     }
-    return ESP_FAIL;
+    xSemaphoreTake(driver->tx_lock, portMAX_DELAY);
+    int sent = dte->send_data(dte, (const char *)buffer, len);
+    if (len) {
+        /* Frames may be written in several chunks, the closing flag ends them */
+        driver->tx_in_frame = ((const uint8_t *)buffer)[len - 1] != PPP_FLAG;
+    }
+    if (sent > 0) {
+        driver->stats.tx_bytes += sent;
+    }
+    xSemaphoreGive(driver->tx_lock);
+    return sent > 0 ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Send an LCP echo request between two frames of the stack
+ *
+ * @return true if sent
+ */
+static bool esp_modem_netif_send_echo(esp_modem_netif_driver_t *driver)
+{
+    uint8_t frame[32];
+    bool sent = false;
+    size_t len = ppp_lcp_echo_request(driver->echo_id + 1, frame);
+    if (xSemaphoreTake(driver->tx_lock, 0) != pdTRUE) {
+        return false;
+    }
+    if (!driver->tx_in_frame && driver->dte->send_data(driver->dte, (const char *)frame, len) == len) {
+        driver->stats.tx_bytes += len;
+        driver->stats.keepalive_tx_bytes += len;
+        sent = true;
+    }
+    xSemaphoreGive(driver->tx_lock);
+    if (sent) {
+        driver->echo_id++;
+        driver->echo_replied = false;
+        driver->echo_pending = true;
+        driver->echo_sent = xTaskGetTickCount();
+        driver->echo_sent_us = esp_timer_get_time();
+        driver->stats.keepalive_echoes++;
+    }
+    return sent;
+}
+
+/**
+ * @brief Keepalive tick, probes the link once it has been idle for the current interval
+ *
+ * The interval grows by half while echoes are answered, so that an idle link costs less and less,
+ * and is halved after a miss. The link is declared stalled after max_misses echoes in a row are
+ * not answered.
+ *
+ * @param arg modem-netif driver
+ */
+static void esp_modem_netif_keepalive_tick(void *arg)
+{
+    esp_modem_netif_driver_t *driver = arg;
+    const esp_modem_keepalive_config_t *config = &driver->keepalive;
+    modem_dce_t *dce = driver->dte->dce;
+    TickType_t now = xTaskGetTickCount();
+    if (!driver->link_up || !dce || dce->mode != MODEM_PPP_MODE || dce->data_suspended) {
+        driver->echo_pending = false;
+        driver->misses = 0;
+        return;
+    }
+    if (driver->echo_pending) {
+        if (driver->echo_replied) {
+            driver->echo_pending = false;
+            uint32_t interval = driver->stats.keepalive_interval_ms;
+            interval = driver->misses ? interval / 2 : interval + interval / 2;
+            driver->stats.keepalive_interval_ms = MAX(config->interval_min_ms, MIN(config->interval_max_ms, interval));
+            driver->misses = 0;
+        } else if (now - driver->echo_sent >= pdMS_TO_TICKS(config->reply_timeout_ms)) {
+            driver->echo_pending = false;
+            driver->stats.keepalive_misses++;
+            if (++driver->misses >= config->max_misses) {
+                ESP_LOGW(TAG, "link stalled, %d echo requests not answered", driver->misses);
+                driver->link_up = false;
+                driver->misses = 0;
+                driver->stats.stalls++;
+                esp_modem_post_event(driver->dte, ESP_MODEM_EVENT_LINK_STALLED, NULL, 0);
+                return;
+            }
+            /* Probe again right away */
+            esp_modem_netif_send_echo(driver);
+        }
+        return;
+    }
+    if (driver->misses || now - driver->last_rx >= pdMS_TO_TICKS(driver->stats.keepalive_interval_ms)) {
+        esp_modem_netif_send_echo(driver);
+    }
+}
+
+/**
+ * @brief Follow the received frames, to account data and catch LCP echo replies
+ *
+ * @param driver modem-netif driver
+ * @param data received data
+ * @param len length of data
+ */
+static void esp_modem_netif_scan_rx(esp_modem_netif_driver_t *driver, const uint8_t *data, size_t len)
+{
+    driver->stats.rx_bytes += len;
+    driver->last_rx = xTaskGetTickCount();
+    if (!driver->keepalive_timer) {
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        if (c == PPP_FLAG) {
+            if (driver->rx_len == sizeof(driver->rx_frame) && driver->echo_pending &&
+                    !memcmp(driver->rx_frame, s_lcp_header, sizeof(s_lcp_header)) &&
+                    driver->rx_frame[4] == PPP_LCP_ECHO_REPLY && driver->rx_frame[5] == driver->echo_id) {
+                driver->echo_replied = true;
+                /* Smoothed as TCP does (RFC 6298), the first sample is taken as is */
+                uint32_t rtt = (esp_timer_get_time() - driver->echo_sent_us) / 1000;
+                uint32_t srtt = driver->stats.keepalive_rtt_ms;
+                driver->stats.keepalive_rtt_ms = srtt ? srtt - srtt / 8 + rtt / 8 : MAX(rtt, 1);
+                /* Header, identifier, length, magic number and FCS, escapes aside */
+                driver->stats.keepalive_rx_bytes += 16;
+            }
+            driver->rx_len = 0;
+            driver->rx_escape = false;
+        } else if (c == PPP_ESCAPE) {
+            driver->rx_escape = true;
+        } else if (driver->rx_len < sizeof(driver->rx_frame)) {
+            driver->rx_frame[driver->rx_len++] = driver->rx_escape ? c ^ PPP_TRANS : c;
+            driver->rx_escape = false;
+        } else {
+            driver->rx_escape = false;
+        }
+    }
 }
 
 /**
@@ -63,7 +272,7 @@ static esp_err_t esp_modem_post_attach_start(esp_netif_t * esp_netif, void * arg
     const esp_netif_driver_ifconfig_t driver_ifconfig = {
             .driver_free_rx_buffer = NULL,
             .transmit = esp_modem_dte_transmit,
-            .handle = dte
+            .handle = driver
     };
     driver->base.netif = esp_netif;
     ESP_ERROR_CHECK(esp_netif_set_driver_config(esp_netif, &driver_ifconfig));
@@ -85,11 +294,33 @@ static esp_err_t modem_netif_receive_cb(void *buffer, size_t len, void *context)
     ESP_LOGD(TAG, "modem_netif_receive_cb called");
     esp_modem_netif_driver_t *driver = context;
     ESP_LOGD(TAG, "modem_netif_receive_cb context setup");
+    esp_modem_netif_scan_rx(driver, buffer, len);
     esp_netif_receive(driver->base.netif, buffer, len, NULL);
     ESP_LOGD(TAG, "modem_netif_receive_cb call esp_netif_receive");
     return ESP_OK;
 }
 
+/**
+ * @brief Close the boot to IP timeline once PPP negotiation has given an address, and let keepalive run
+ *
+ * @param arg modem-netif driver
+ * @param event_base IP_EVENT
+ * @param event_id IP_EVENT_PPP_GOT_IP
+ * @param event_data ip_event_got_ip_t
+ */
+static void esp_modem_netif_on_got_ip(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    esp_modem_netif_driver_t *driver = arg;
+    ip_event_got_ip_t *event = event_data;
+    if (event->esp_netif != driver->base.netif) {
+        return;
+    }
+    esp_modem_timeline_end(driver->dte, ESP_MODEM_PHASE_PPP);
+    esp_modem_timeline_publish(driver->dte);
+    driver->last_rx = xTaskGetTickCount();
+    driver->link_up = true;
+}
+
 void *esp_modem_netif_setup(modem_dte_t *dte)
 {
     esp_modem_netif_driver_t *driver =  calloc(1, sizeof(esp_modem_netif_driver_t));
@@ -97,17 +328,26 @@ void *esp_modem_netif_setup(modem_dte_t *dte)
         ESP_LOGE(TAG, "Cannot allocate esp_modem_netif_driver_t");
         goto drv_create_failed;
     }
+    driver->tx_lock = xSemaphoreCreateMutex();
+    if (driver->tx_lock == NULL) {
+        ESP_LOGE(TAG, "Cannot create tx lock");
+        goto lock_create_failed;
+    }
     ESP_LOGD(TAG, "esp_modem_set_rx_cb set");
     esp_err_t err = esp_modem_set_rx_cb(dte, modem_netif_receive_cb, driver);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_modem_set_rx_cb failed with: %d", err);
-        goto drv_create_failed;
+        goto rx_cb_failed;
     }
 
     driver->base.post_attach = esp_modem_post_attach_start;
     driver->dte = dte;
     return driver;
 
+rx_cb_failed:
+    vSemaphoreDelete(driver->tx_lock);
+lock_create_failed:
+    free(driver);
 drv_create_failed:
     return NULL;
 }
@@ -115,10 +355,74 @@ drv_create_failed:
 void esp_modem_netif_teardown(void *h)
 {
     esp_modem_netif_driver_t *driver = h;
+    esp_modem_netif_stop_keepalive(driver);
     esp_netif_destroy(driver->base.netif);
+    vSemaphoreDelete(driver->tx_lock);
     free(driver);
 }
 
+esp_err_t esp_modem_netif_start_keepalive(void *h, const esp_modem_keepalive_config_t *config)
+{
+    esp_modem_netif_driver_t *driver = h;
+    if (driver->keepalive_timer || !config->interval_min_ms || config->interval_min_ms > config->interval_max_ms ||
+            !config->max_misses) {
+        ESP_LOGE(TAG, "Invalid keepalive configuration or already started");
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_timer_create_args_t timer_args = {
+        .callback = esp_modem_netif_keepalive_tick,
+        .arg = driver,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "modem_keepalive"
+    };
+    driver->keepalive = *config;
+    driver->stats.keepalive_interval_ms = config->interval_min_ms;
+    driver->echo_pending = false;
+    driver->misses = 0;
+    esp_timer_handle_t timer;
+    if (esp_timer_create(&timer_args, &timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot create keepalive timer");
+        return ESP_FAIL;
+    }
+    if (esp_timer_start_periodic(timer, KEEPALIVE_TICK_MS * 1000) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot start keepalive timer");
+        esp_timer_delete(timer);
+        return ESP_FAIL;
+    }
+    driver->keepalive_timer = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_netif_stop_keepalive(void *h)
+{
+    esp_modem_netif_driver_t *driver = h;
+    if (driver->keepalive_timer) {
+        esp_timer_stop(driver->keepalive_timer);
+        esp_timer_delete(driver->keepalive_timer);
+        driver->keepalive_timer = NULL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_netif_probe(void *h)
+{
+    esp_modem_netif_driver_t *driver = h;
+    modem_dce_t *dce = driver->dte->dce;
+    if (!driver->keepalive_timer || !driver->link_up || driver->echo_pending || !dce || dce->mode != MODEM_PPP_MODE ||
+            dce->data_suspended) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    /* A reply or a miss is handled by the keepalive tick as for any echo request */
+    return esp_modem_netif_send_echo(driver) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_modem_netif_get_stats(void *h, esp_modem_netif_stats_t *stats)
+{
+    esp_modem_netif_driver_t *driver = h;
+    *stats = driver->stats;
+    return ESP_OK;
+}
+
 esp_err_t esp_modem_netif_clear_default_handlers(void *h)
 {
     esp_modem_netif_driver_t *driver = h;
@@ -131,6 +435,10 @@ esp_err_t esp_modem_netif_clear_default_handlers(void *h)
     if (ret != ESP_OK) {
         goto clear_event_failed;
     }
+    ret = esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_modem_netif_on_got_ip);
+    if (ret != ESP_OK) {
+        goto clear_event_failed;
+    }
     return ESP_OK;
 
 clear_event_failed:
@@ -151,6 +459,10 @@ esp_err_t esp_modem_netif_set_default_handlers(void *h, esp_netif_t * esp_netif)
     if (ret != ESP_OK) {
         goto set_event_failed;
     }
+    ret = esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_modem_netif_on_got_ip, driver);
+    if (ret != ESP_OK) {
+        goto set_event_failed;
+    }
     return ESP_OK;
 
 set_event_failed:
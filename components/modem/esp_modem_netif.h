@@ -17,6 +17,45 @@
 extern "C" {
 #endif
 
+/**
+ * @brief PPP link keepalive configuration
+ *
+ */
+typedef struct {
+    uint32_t interval_min_ms;  /*!< Shortest idle time before an LCP echo request, also the initial one */
+    uint32_t interval_max_ms;  /*!< Longest idle time before an LCP echo request */
+    uint32_t reply_timeout_ms; /*!< Time allowed for the echo reply */
+    uint32_t max_misses;       /*!< Echo requests in a row without reply to declare the link stalled */
+} esp_modem_keepalive_config_t;
+
+/**
+ * @brief PPP link keepalive default configuration
+ *
+ */
+#define ESP_MODEM_KEEPALIVE_DEFAULT_CONFIG() \
+    {                                        \
+        .interval_min_ms = 15000,            \
+        .interval_max_ms = 240000,           \
+        .reply_timeout_ms = 3000,            \
+        .max_misses = 3                      \
+    }
+
+/**
+ * @brief Data usage and keepalive statistics of the PPP link
+ *
+ */
+typedef struct {
+    uint64_t rx_bytes;              /*!< Bytes received in PPP mode, keepalive included */
+    uint64_t tx_bytes;              /*!< Bytes sent in PPP mode, keepalive included */
+    uint32_t keepalive_rx_bytes;    /*!< Bytes of the echo replies */
+    uint32_t keepalive_tx_bytes;    /*!< Bytes of the echo requests */
+    uint32_t keepalive_echoes;      /*!< Echo requests sent */
+    uint32_t keepalive_misses;      /*!< Echo requests without reply */
+    uint32_t keepalive_interval_ms; /*!< Current idle time before an echo request */
+    uint32_t keepalive_rtt_ms;      /*!< Smoothed round trip of the echo requests, 0 before the first reply */
+    uint32_t stalls;                /*!< Times the link has been declared stalled */
+} esp_modem_netif_stats_t;
+
 /**
  * @brief Creates handle to esp_modem used as an esp-netif driver
  *
@@ -48,6 +87,54 @@ esp_err_t esp_modem_netif_clear_default_handlers(void *h);
  */
 esp_err_t esp_modem_netif_set_default_handlers(void *h, esp_netif_t * esp_netif);
 
+/**
+ * @brief Probe the PPP link with LCP echo requests while it is idle
+ *
+ * Echo requests are only sent when nothing has been received for the current interval, which adapts
+ * between the configured bounds. ESP_MODEM_EVENT_LINK_STALLED is posted when the link stops
+ * answering, the link supervisor takes it as a link loss.
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @param config keepalive configuration
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid configuration, or keepalive already started
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_netif_start_keepalive(void *h, const esp_modem_keepalive_config_t *config);
+
+/**
+ * @brief Stop probing the PPP link
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_netif_stop_keepalive(void *h);
+
+/**
+ * @brief Send an LCP echo request now, whether the link is idle or not
+ *
+ * Used to measure the round trip of a busy link. The reply, or its absence, is accounted as for
+ * the echo requests of the keepalive, which has to be started.
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the keepalive is off, the link is down or an echo request is in flight
+ */
+esp_err_t esp_modem_netif_probe(void *h);
+
+/**
+ * @brief Get data usage and keepalive statistics
+ *
+ * @param h pointer to the esp-netif adapter for esp-modem
+ * @param stats statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_netif_get_stats(void *h, esp_modem_netif_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
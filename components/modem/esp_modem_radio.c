@@ -0,0 +1,287 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_radio.h"
+
+#define ESP_MODEM_RADIO_COMMAND_MAX_LENGTH (64)
+#define ESP_MODEM_RADIO_PREFIX_MAX_LENGTH (16)
+#define ESP_MODEM_RADIO_TIMEOUT_MS (5000)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *RADIO_TAG = "esp-modem-radio";
+#define RADIO_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(a))                                                                       \
+        {                                                                               \
+            ESP_LOGE(RADIO_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                              \
+        }                                                                               \
+    } while (0)
+
+/**
+ * @brief Radio sampler
+ *
+ */
+struct esp_modem_radio {
+    modem_dte_t *dte;                                     /*!< Sampled modem */
+    esp_modem_radio_config_t config;                      /*!< Configuration */
+    char cell_prefix[ESP_MODEM_RADIO_PREFIX_MAX_LENGTH];  /*!< Start of the serving cell line, empty if not queried */
+    bool cell_setup_pending;                              /*!< cell_setup still to be sent */
+    TaskHandle_t task;                                    /*!< Sampler task */
+    SemaphoreHandle_t exit_sem;                           /*!< Given by the sampler task on exit */
+    volatile bool stop;                                   /*!< Request the sampler task to exit */
+    esp_modem_radio_status_t sample;                      /*!< Sample being collected, sampler task only */
+    portMUX_TYPE lock;                                    /*!< Protects cache and valid */
+    esp_modem_radio_status_t cache;                       /*!< Last complete sample */
+    bool valid;                                           /*!< Cache holds a sample */
+};
+
+/**
+ * @brief Handle the answer to the batched query
+ */
+static esp_err_t esp_modem_radio_handle_batch(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    struct esp_modem_radio *radio = dce->handle_line_ctx;
+    esp_modem_radio_status_t *sample = &radio->sample;
+    if (radio->cell_prefix[0] && !strncmp(line, radio->cell_prefix, strlen(radio->cell_prefix))) {
+        /* Keep the first line describing a cell, it is the serving one; status lines such as the
+         * "+CENG: <mode>,<ncell>" header have fewer fields */
+        const char *comma = strchr(line, ',');
+        if (!sample->cell[0] && comma && strchr(comma + 1, ',')) {
+            const char *info = line + strlen(radio->cell_prefix);
+            info += strspn(info, " ");
+            size_t len = strcspn(info, "\r\n");
+            len = MIN(len, sizeof(sample->cell) - 1);
+            memcpy(sample->cell, info, len);
+            sample->cell[len] = '\0';
+        }
+        err = ESP_OK;
+    } else if (!strncmp(line, "+CSQ", strlen("+CSQ"))) {
+        err = sscanf(line, "%*s%d,%d", &sample->rssi, &sample->ber) == 2 ? ESP_OK : ESP_FAIL;
+    } else if (!strncmp(line, "+CBC", strlen("+CBC"))) {
+        err = sscanf(line, "%*s%d,%d,%d", &sample->bcs, &sample->bcl, &sample->voltage) == 3 ? ESP_OK : ESP_FAIL;
+    } else if (!strncmp(line, "+CREG", strlen("+CREG"))) {
+        int stat = 0;
+        if (sscanf(line, "%*s%*d,%d", &stat) == 1) {
+            sample->registration = stat;
+            err = ESP_OK;
+        }
+    } else if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+/**
+ * @brief Send the batched query, the serving cell is dropped from it if the module rejects it
+ */
+static esp_err_t esp_modem_radio_query(struct esp_modem_radio *radio)
+{
+    modem_dte_t *dte = radio->dte;
+    char command[ESP_MODEM_RADIO_COMMAND_MAX_LENGTH];
+    if (radio->cell_setup_pending) {
+        radio->cell_setup_pending = false;
+        if (dte->send_cmd(dte, radio->config.cell_setup, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                          esp_modem_dce_handle_response_default, NULL) != ESP_OK) {
+            ESP_LOGW(RADIO_TAG, "cell setup failed");
+        }
+    }
+    while (true) {
+        memset(&radio->sample, 0, sizeof(radio->sample));
+        radio->sample.registration = MODEM_REG_UNKNOWN;
+        snprintf(command, sizeof(command), "AT+CSQ;+CBC;+CREG?%s%s\r", radio->cell_prefix[0] ? ";" : "",
+                 radio->cell_prefix[0] ? radio->config.cell_query : "");
+        esp_err_t res = dte->send_cmd(dte, command, ESP_MODEM_RADIO_TIMEOUT_MS, esp_modem_radio_handle_batch, radio);
+        if (res == ESP_OK) {
+            return ESP_OK;
+        }
+        RADIO_CHECK(res != ESP_ERR_TIMEOUT, "send command failed", err);
+        /* One unsupported command fails the whole line */
+        RADIO_CHECK(radio->cell_prefix[0], "query failed", err);
+        ESP_LOGW(RADIO_TAG, "%s not supported, serving cell dropped", radio->config.cell_query);
+        radio->cell_prefix[0] = '\0';
+    }
+err:
+    return ESP_FAIL;
+}
+
+static inline uint32_t esp_modem_radio_delta(uint32_t a, uint32_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+/**
+ * @brief Store the sample in the cache and notify what changed beyond the thresholds
+ */
+static void esp_modem_radio_publish(struct esp_modem_radio *radio)
+{
+    esp_modem_radio_event_t event = {
+        .status = radio->sample,
+        .changed = 0
+    };
+    esp_modem_radio_status_t *last = &radio->cache;
+    event.status.timestamp = esp_timer_get_time();
+    /* Only the sampler task writes the cache, reading it here needs no lock */
+    if (!radio->valid) {
+        event.changed = ESP_MODEM_RADIO_CHANGED_SIGNAL | ESP_MODEM_RADIO_CHANGED_BATTERY |
+                        ESP_MODEM_RADIO_CHANGED_REGISTRATION | ESP_MODEM_RADIO_CHANGED_CELL;
+    } else {
+        /* 99 means unknown, any move to or from it is a change */
+        if (esp_modem_radio_delta(event.status.rssi, last->rssi) >= radio->config.rssi_threshold ||
+                (event.status.rssi != last->rssi && (event.status.rssi == 99 || last->rssi == 99))) {
+            event.changed |= ESP_MODEM_RADIO_CHANGED_SIGNAL;
+        }
+        if (esp_modem_radio_delta(event.status.voltage, last->voltage) >= radio->config.voltage_threshold_mv ||
+                event.status.bcs != last->bcs) {
+            event.changed |= ESP_MODEM_RADIO_CHANGED_BATTERY;
+        }
+        if (event.status.registration != last->registration) {
+            event.changed |= ESP_MODEM_RADIO_CHANGED_REGISTRATION;
+        }
+        if (strcmp(event.status.cell, last->cell)) {
+            event.changed |= ESP_MODEM_RADIO_CHANGED_CELL;
+        }
+    }
+    portENTER_CRITICAL(&radio->lock);
+    radio->cache = event.status;
+    radio->valid = true;
+    portEXIT_CRITICAL(&radio->lock);
+    if (event.changed) {
+        esp_modem_post_event(radio->dte, ESP_MODEM_EVENT_RADIO_CHANGED, &event, sizeof(event));
+    }
+}
+
+static esp_err_t esp_modem_radio_sample(struct esp_modem_radio *radio)
+{
+    modem_dte_t *dte = radio->dte;
+    modem_dce_t *dce = dte->dce;
+    bool suspended = false;
+    RADIO_CHECK(dce, "DTE has not yet bind with DCE", err);
+    /* Under the multiplexer the query runs alongside the data call */
+    if (dce->mode == MODEM_PPP_MODE && !esp_modem_is_cmux(dte)) {
+        if (!radio->config.suspend_ppp) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        RADIO_CHECK(esp_modem_suspend_ppp(dte) == ESP_OK, "suspend ppp failed", err);
+        suspended = true;
+    }
+    esp_err_t ret = esp_modem_radio_query(radio);
+    if (suspended && esp_modem_resume_ppp(dte) != ESP_OK) {
+        /* Left to the link supervisor */
+        ESP_LOGE(RADIO_TAG, "resume ppp failed");
+    }
+    RADIO_CHECK(ret == ESP_OK, "sample failed", err);
+    esp_modem_radio_publish(radio);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+static void esp_modem_radio_task(void *param)
+{
+    struct esp_modem_radio *radio = param;
+    while (!radio->stop) {
+        esp_modem_radio_sample(radio);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(radio->config.period_ms));
+    }
+    xSemaphoreGive(radio->exit_sem);
+    vTaskDelete(NULL);
+}
+
+esp_modem_radio_handle_t esp_modem_radio_start(modem_dte_t *dte, const esp_modem_radio_config_t *config)
+{
+    RADIO_CHECK(dte && config && config->period_ms, "invalid argument", err);
+    struct esp_modem_radio *radio = calloc(1, sizeof(struct esp_modem_radio));
+    RADIO_CHECK(radio, "calloc radio failed", err);
+    radio->dte = dte;
+    radio->config = *config;
+    radio->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    if (config->cell_query) {
+        /* "+CPSI?" is answered by "+CPSI: ...", "+QENG=..." by "+QENG: ..." */
+        size_t len = strcspn(config->cell_query, "?=");
+        RADIO_CHECK(len && len < sizeof(radio->cell_prefix) - 1, "invalid cell query", err_prefix);
+        memcpy(radio->cell_prefix, config->cell_query, len);
+        radio->cell_prefix[len] = ':';
+        radio->cell_setup_pending = config->cell_setup != NULL;
+    }
+    radio->exit_sem = xSemaphoreCreateBinary();
+    RADIO_CHECK(radio->exit_sem, "create exit semaphore failed", err_prefix);
+    BaseType_t ret = xTaskCreate(esp_modem_radio_task, "radio", config->task_stack_size, radio,
+                                 config->task_priority, &radio->task);
+    RADIO_CHECK(ret == pdTRUE, "create radio task failed", err_task);
+    return radio;
+err_task:
+    vSemaphoreDelete(radio->exit_sem);
+err_prefix:
+    free(radio);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_radio_stop(esp_modem_radio_handle_t radio)
+{
+    RADIO_CHECK(radio, "invalid argument", err);
+    radio->stop = true;
+    xTaskNotifyGive(radio->task);
+    xSemaphoreTake(radio->exit_sem, portMAX_DELAY);
+    vSemaphoreDelete(radio->exit_sem);
+    free(radio);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_radio_get(esp_modem_radio_handle_t radio, esp_modem_radio_status_t *status, uint32_t max_age_ms)
+{
+    RADIO_CHECK(radio && status, "invalid argument", err);
+    portENTER_CRITICAL(&radio->lock);
+    bool valid = radio->valid;
+    *status = radio->cache;
+    portEXIT_CRITICAL(&radio->lock);
+    if (!valid) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (max_age_ms && esp_timer_get_time() - status->timestamp > (int64_t)max_age_ms * 1000) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_radio_refresh(esp_modem_radio_handle_t radio)
+{
+    RADIO_CHECK(radio, "invalid argument", err);
+    xTaskNotifyGive(radio->task);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
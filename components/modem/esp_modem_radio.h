@@ -0,0 +1,142 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+#include "esp_modem_dte.h"
+
+/**
+ * @brief Specific Length Constraint
+ *
+ */
+#define MODEM_MAX_CELL_INFO_LENGTH (96) /*!< Max serving cell information Length */
+
+/**
+ * @brief Fields of the radio status that changed, see esp_modem_radio_event_t
+ *
+ */
+#define ESP_MODEM_RADIO_CHANGED_SIGNAL (1 << 0)       /*!< Signal quality moved by rssi_threshold or more */
+#define ESP_MODEM_RADIO_CHANGED_BATTERY (1 << 1)      /*!< Battery voltage moved by voltage_threshold_mv or more */
+#define ESP_MODEM_RADIO_CHANGED_REGISTRATION (1 << 2) /*!< Registration status changed */
+#define ESP_MODEM_RADIO_CHANGED_CELL (1 << 3)         /*!< Serving cell information changed */
+
+/**
+ * @brief Radio status of the modem, as of the last sample
+ *
+ */
+typedef struct {
+    int64_t timestamp;                        /*!< Time of the sample, unit: us since boot */
+    uint32_t rssi;                            /*!< Signal strength, as reported by AT+CSQ */
+    uint32_t ber;                             /*!< Bit error rate, as reported by AT+CSQ */
+    uint32_t bcs;                             /*!< Battery charge status */
+    uint32_t bcl;                             /*!< Battery connection level */
+    uint32_t voltage;                         /*!< Battery voltage, unit: mV */
+    modem_reg_status_t registration;          /*!< Network registration status */
+    char cell[MODEM_MAX_CELL_INFO_LENGTH];    /*!< Serving cell information, empty if not queried */
+} esp_modem_radio_status_t;
+
+/**
+ * @brief Data of ESP_MODEM_EVENT_RADIO_CHANGED
+ *
+ */
+typedef struct {
+    esp_modem_radio_status_t status; /*!< New status */
+    uint32_t changed;                /*!< ESP_MODEM_RADIO_CHANGED_* bits */
+} esp_modem_radio_event_t;
+
+/**
+ * @brief Radio sampler configuration
+ *
+ */
+typedef struct {
+    uint32_t period_ms;            /*!< Sampling period */
+    bool suspend_ppp;              /*!< Leave data mode to sample in PPP mode, otherwise PPP mode is skipped, unused with cmux */
+    const char *cell_query;        /*!< Serving cell query appended to the batch, e.g. "+CPSI?", NULL for none */
+    const char *cell_setup;        /*!< Command sent once before the first cell query, e.g. "AT+CENG=1,0\r", may be NULL */
+    uint32_t rssi_threshold;       /*!< Signal change to notify, unit: CSQ steps (about 2 dBm) */
+    uint32_t voltage_threshold_mv; /*!< Battery voltage change to notify */
+    uint32_t task_stack_size;      /*!< Stack size of the sampler task */
+    uint32_t task_priority;        /*!< Priority of the sampler task */
+} esp_modem_radio_config_t;
+
+/**
+ * @brief Radio sampler default configuration
+ *
+ */
+#define ESP_MODEM_RADIO_DEFAULT_CONFIG() \
+    {                                    \
+        .period_ms = 60000,              \
+        .suspend_ppp = true,             \
+        .cell_query = NULL,              \
+        .cell_setup = NULL,              \
+        .rssi_threshold = 2,             \
+        .voltage_threshold_mv = 50,      \
+        .task_stack_size = 3072,         \
+        .task_priority = 4               \
+    }
+
+typedef struct esp_modem_radio *esp_modem_radio_handle_t;
+
+/**
+ * @brief Start sampling the radio status in the background
+ *
+ * Signal quality, battery status, registration and, if configured, serving cell are queried in one
+ * command line (AT+CSQ;+CBC;+CREG?...), so that the AT channel is taken once per sample, and data
+ * mode is left at most once. Changes beyond the thresholds are posted as ESP_MODEM_EVENT_RADIO_CHANGED
+ * on the modem event loop, the first sample always is.
+ *
+ * @param dte Modem DTE object
+ * @param config sampler configuration
+ * @return esp_modem_radio_handle_t sampler handle, NULL on error
+ */
+esp_modem_radio_handle_t esp_modem_radio_start(modem_dte_t *dte, const esp_modem_radio_config_t *config);
+
+/**
+ * @brief Stop sampling
+ *
+ * @param radio sampler handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_radio_stop(esp_modem_radio_handle_t radio);
+
+/**
+ * @brief Get the last sample, without blocking
+ *
+ * @param radio sampler handle
+ * @param status last sample
+ * @param max_age_ms age above which the sample is reported stale, 0 for any age
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the sample is older than max_age_ms, status is filled anyway
+ *      - ESP_ERR_NOT_FOUND if nothing has been sampled yet
+ */
+esp_err_t esp_modem_radio_get(esp_modem_radio_handle_t radio, esp_modem_radio_status_t *status, uint32_t max_age_ms);
+
+/**
+ * @brief Take a sample now rather than at the end of the period
+ *
+ * @param radio sampler handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_radio_refresh(esp_modem_radio_handle_t radio);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,393 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "nvs.h"
+#include "esp_log.h"
+#include "esp_modem_attach.h"
+#include "esp_modem_rat.h"
+
+#define ESP_MODEM_RAT_NAMESPACE "modem_rat"
+#define ESP_MODEM_RAT_VERSION (1)
+#define ESP_MODEM_RAT_KEY_LENGTH (15)
+#define ESP_MODEM_RAT_NO_SITE (-1)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *RAT_TAG = "esp-modem-rat";
+#define RAT_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                \
+    {                                                                                 \
+        if (!(a))                                                                     \
+        {                                                                             \
+            ESP_LOGE(RAT_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                            \
+        }                                                                             \
+    } while (0)
+
+static const char *const s_rat_names[MODEM_RAT_MAX] = {"auto", "GSM", "LTE-M", "NB-IoT"};
+/* Trial order at a new site */
+static const modem_rat_t s_rat_order[] = {MODEM_RAT_LTE_M, MODEM_RAT_NB_IOT, MODEM_RAT_GSM};
+
+/**
+ * @brief What is known of a site
+ *
+ */
+typedef struct {
+    uint32_t cell_id[MODEM_RAT_MAX];            /*!< Serving cell seen on each technology, 0 if not seen */
+    uint32_t last_seen;                         /*!< Session of the last attach at the site, 0 for a free slot */
+    uint32_t sessions_since_trial;              /*!< Sessions since a technology was last tried out */
+    uint8_t preferred;                          /*!< Preferred technology, MODEM_RAT_AUTO if none yet */
+    uint8_t serving;                            /*!< Technology of the last attach */
+    esp_modem_rat_stats_t stats[MODEM_RAT_MAX]; /*!< Performance per technology */
+} esp_modem_rat_site_t;
+
+/**
+ * @brief Sites, stored as NVS blob keyed by ICCID
+ *
+ */
+typedef struct {
+    uint32_t version;                                    /*!< Layout version of the table */
+    uint32_t sessions;                                   /*!< Attaches recorded, orders the sites by last use */
+    int32_t current;                                     /*!< Site of the last attach, ESP_MODEM_RAT_NO_SITE if none */
+    esp_modem_rat_site_t sites[ESP_MODEM_RAT_MAX_SITES]; /*!< Sites */
+} esp_modem_rat_table_t;
+
+/**
+ * @brief RAT policy
+ *
+ */
+struct esp_modem_rat {
+    modem_dce_t *dce;              /*!< Module steered */
+    esp_modem_rat_config_t config; /*!< Configuration */
+    esp_modem_rat_table_t table;   /*!< Sites */
+    modem_rat_t applied;           /*!< Technology of the next or current attach */
+};
+
+static const char *esp_modem_rat_key(const char *iccid)
+{
+    size_t len = strlen(iccid);
+    return len > ESP_MODEM_RAT_KEY_LENGTH ? iccid + len - ESP_MODEM_RAT_KEY_LENGTH : iccid;
+}
+
+static void esp_modem_rat_load(struct esp_modem_rat *rat)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(rat->table);
+    memset(&rat->table, 0, sizeof(rat->table));
+    rat->table.version = ESP_MODEM_RAT_VERSION;
+    rat->table.current = ESP_MODEM_RAT_NO_SITE;
+    modem_dce_t *dce = rat->dce;
+    if (!dce->iccid[0] && (!dce->get_iccid_number || dce->get_iccid_number(dce) != ESP_OK)) {
+        return;
+    }
+    if (nvs_open(ESP_MODEM_RAT_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    esp_modem_rat_table_t *stored = malloc(sizeof(esp_modem_rat_table_t));
+    if (stored) {
+        if (nvs_get_blob(handle, esp_modem_rat_key(dce->iccid), stored, &len) == ESP_OK &&
+                len == sizeof(*stored) && stored->version == ESP_MODEM_RAT_VERSION) {
+            rat->table = *stored;
+        }
+        free(stored);
+    }
+    nvs_close(handle);
+}
+
+static esp_err_t esp_modem_rat_store(struct esp_modem_rat *rat)
+{
+    nvs_handle_t handle;
+    RAT_CHECK(rat->dce->iccid[0], "iccid is unknown", err);
+    RAT_CHECK(nvs_open(ESP_MODEM_RAT_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK, "open nvs failed", err);
+    RAT_CHECK(nvs_set_blob(handle, esp_modem_rat_key(rat->dce->iccid), &rat->table, sizeof(rat->table)) == ESP_OK,
+              "write table failed", err_nvs);
+    RAT_CHECK(nvs_commit(handle) == ESP_OK, "commit table failed", err_nvs);
+    nvs_close(handle);
+    return ESP_OK;
+err_nvs:
+    nvs_close(handle);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Exponential moving average, weight 1/4 for the new sample
+ */
+static uint32_t esp_modem_rat_average(uint32_t avg, uint32_t sample)
+{
+    return avg ? (avg * 3 + sample) / 4 : sample;
+}
+
+static bool esp_modem_rat_allowed(struct esp_modem_rat *rat, modem_rat_t tech)
+{
+    return rat->config.rats & (1 << tech);
+}
+
+static esp_modem_rat_site_t *esp_modem_rat_current_site(struct esp_modem_rat *rat)
+{
+    return rat->table.current == ESP_MODEM_RAT_NO_SITE ? NULL : &rat->table.sites[rat->table.current];
+}
+
+/**
+ * @brief Estimated duration of a typical session on a technology, with the terms measured on both
+ */
+static uint64_t esp_modem_rat_cost(struct esp_modem_rat *rat, const esp_modem_rat_stats_t *stats,
+                                   const esp_modem_rat_stats_t *other)
+{
+    uint64_t cost = stats->attach_avg_ms;
+    if (stats->rtt_avg_ms && other->rtt_avg_ms) {
+        cost += (uint64_t)rat->config.round_trips * stats->rtt_avg_ms;
+    }
+    if (stats->throughput_avg_bps && other->throughput_avg_bps) {
+        cost += (uint64_t)rat->config.session_bytes * 1000 / stats->throughput_avg_bps;
+    }
+    return cost;
+}
+
+/**
+ * @brief Choose the preferred technology of a site again, with hysteresis
+ */
+static void esp_modem_rat_evaluate(struct esp_modem_rat *rat, esp_modem_rat_site_t *site)
+{
+    modem_rat_t incumbent = site->preferred != MODEM_RAT_AUTO ? site->preferred : site->serving;
+    const esp_modem_rat_stats_t *current = &site->stats[incumbent];
+    bool incumbent_failed = current->failed_in_row > 0;
+    modem_rat_t best = incumbent;
+    uint64_t best_cost = 0;
+    for (int i = 0; i < sizeof(s_rat_order) / sizeof(s_rat_order[0]); i++) {
+        modem_rat_t tech = s_rat_order[i];
+        const esp_modem_rat_stats_t *stats = &site->stats[tech];
+        if (tech == incumbent || !esp_modem_rat_allowed(rat, tech) || stats->failed_in_row ||
+                stats->attaches < rat->config.min_samples) {
+            continue;
+        }
+        uint64_t cost = esp_modem_rat_cost(rat, stats, current);
+        bool better = incumbent_failed ||
+                      cost * (100 + rat->config.hysteresis_pct) < esp_modem_rat_cost(rat, current, stats) * 100;
+        if (better && (best == incumbent || cost < best_cost)) {
+            best = tech;
+            best_cost = cost;
+        }
+    }
+    if (best == incumbent && incumbent_failed) {
+        /* No other technology to fall back on, left to the module */
+        best = MODEM_RAT_AUTO;
+    } else if (best == incumbent && current->attaches < rat->config.min_samples) {
+        /* Not measured well enough yet */
+        best = site->preferred;
+    }
+    if (best != site->preferred) {
+        ESP_LOGI(RAT_TAG, "cell %x: prefer %s over %s", site->cell_id[site->serving], s_rat_names[best],
+                 s_rat_names[site->preferred]);
+        site->preferred = best;
+    }
+}
+
+/**
+ * @brief Site of a serving cell, a new one if unknown
+ *
+ * A cell seen for the first time on a technology not seen yet at the site of the last session
+ * is taken as the same site, a stationary node attaching on another technology.
+ */
+static int esp_modem_rat_find_site(struct esp_modem_rat *rat, modem_rat_t tech, uint32_t cell_id)
+{
+    esp_modem_rat_table_t *table = &rat->table;
+    int oldest = 0;
+    for (int i = 0; i < ESP_MODEM_RAT_MAX_SITES; i++) {
+        if (table->sites[i].last_seen && table->sites[i].cell_id[tech] == cell_id) {
+            return i;
+        }
+        if (table->sites[i].last_seen < table->sites[oldest].last_seen) {
+            oldest = i;
+        }
+    }
+    if (table->current != ESP_MODEM_RAT_NO_SITE && !table->sites[table->current].cell_id[tech]) {
+        table->sites[table->current].cell_id[tech] = cell_id;
+        return table->current;
+    }
+    /* Forget the least recently seen site */
+    memset(&table->sites[oldest], 0, sizeof(table->sites[oldest]));
+    table->sites[oldest].cell_id[tech] = cell_id;
+    return oldest;
+}
+
+esp_modem_rat_handle_t esp_modem_rat_init(modem_dce_t *dce, const esp_modem_rat_config_t *config)
+{
+    RAT_CHECK(dce && config, "invalid argument", err);
+    RAT_CHECK(dce->set_rat && dce->get_serving_cell, "technology selection not supported", err);
+    struct esp_modem_rat *rat = calloc(1, sizeof(struct esp_modem_rat));
+    RAT_CHECK(rat, "calloc rat failed", err);
+    rat->dce = dce;
+    rat->config = *config;
+    rat->applied = MODEM_RAT_AUTO;
+    esp_modem_rat_load(rat);
+    return rat;
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_rat_deinit(esp_modem_rat_handle_t rat)
+{
+    RAT_CHECK(rat, "invalid argument", err);
+    free(rat);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_rat_apply(esp_modem_rat_handle_t rat, modem_rat_t *selected)
+{
+    RAT_CHECK(rat, "invalid argument", err);
+    esp_modem_rat_site_t *site = esp_modem_rat_current_site(rat);
+    modem_rat_t tech = MODEM_RAT_AUTO;
+    /* After a failed attach, the module searches on its own */
+    if (site && !(rat->applied != MODEM_RAT_AUTO && site->stats[rat->applied].failed_in_row)) {
+        modem_rat_t least_tried = MODEM_RAT_AUTO;
+        uint32_t least_attempts = UINT32_MAX;
+        for (int i = 0; i < sizeof(s_rat_order) / sizeof(s_rat_order[0]); i++) {
+            modem_rat_t candidate = s_rat_order[i];
+            const esp_modem_rat_stats_t *stats = &site->stats[candidate];
+            uint32_t attempts = stats->attaches + stats->failures;
+            if (!esp_modem_rat_allowed(rat, candidate) || candidate == site->preferred) {
+                continue;
+            }
+            if (!stats->failed_in_row && attempts < rat->config.min_samples && tech == MODEM_RAT_AUTO) {
+                /* Still learning the site */
+                tech = candidate;
+            }
+            if (attempts < least_attempts) {
+                least_tried = candidate;
+                least_attempts = attempts;
+            }
+        }
+        if (tech == MODEM_RAT_AUTO && rat->config.explore_interval &&
+                ++site->sessions_since_trial >= rat->config.explore_interval) {
+            tech = least_tried;
+        }
+        if (tech != MODEM_RAT_AUTO) {
+            site->sessions_since_trial = 0;
+        } else {
+            tech = site->preferred;
+        }
+    }
+    if (site && tech != MODEM_RAT_AUTO && tech != site->serving) {
+        /* The hints of the last attach are for another technology */
+        esp_modem_attach_clear_hints(rat->dce);
+    }
+    /* A technology not applied is not charged with the attach that follows */
+    rat->applied = MODEM_RAT_AUTO;
+    RAT_CHECK(rat->dce->set_rat(rat->dce, tech) == ESP_OK, "set %s failed", err_set, s_rat_names[tech]);
+    rat->applied = tech;
+    ESP_LOGI(RAT_TAG, "attach on %s", s_rat_names[tech]);
+    if (selected) {
+        *selected = tech;
+    }
+    return ESP_OK;
+err_set:
+    return ESP_FAIL;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_rat_record_attach(esp_modem_rat_handle_t rat, bool attached, uint32_t attach_ms)
+{
+    RAT_CHECK(rat, "invalid argument", err);
+    esp_modem_rat_site_t *site = esp_modem_rat_current_site(rat);
+    if (!attached) {
+        /* Charged to the technology tried, at the site of the last session */
+        if (site && rat->applied != MODEM_RAT_AUTO) {
+            site->stats[rat->applied].failures++;
+            site->stats[rat->applied].failed_in_row++;
+            esp_modem_rat_evaluate(rat, site);
+            esp_modem_rat_store(rat);
+        }
+        return ESP_OK;
+    }
+    modem_rat_t tech = MODEM_RAT_AUTO;
+    uint32_t cell_id = 0;
+    RAT_CHECK(rat->dce->get_serving_cell(rat->dce, &tech, &cell_id) == ESP_OK && tech != MODEM_RAT_AUTO,
+              "get serving cell failed", err_cell);
+    rat->table.current = esp_modem_rat_find_site(rat, tech, cell_id);
+    site = &rat->table.sites[rat->table.current];
+    site->last_seen = ++rat->table.sessions;
+    site->serving = tech;
+    esp_modem_rat_stats_t *stats = &site->stats[tech];
+    stats->attaches++;
+    stats->failed_in_row = 0;
+    stats->attach_avg_ms = esp_modem_rat_average(stats->attach_avg_ms, attach_ms);
+    stats->cost_ms = esp_modem_rat_cost(rat, stats, stats);
+    esp_modem_rat_evaluate(rat, site);
+    esp_modem_rat_store(rat);
+    ESP_LOGI(RAT_TAG, "cell %x on %s: attach %d ms (avg %d ms over %d)", cell_id, s_rat_names[tech], attach_ms,
+             stats->attach_avg_ms, stats->attaches);
+    return ESP_OK;
+err_cell:
+    return ESP_FAIL;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_rat_record_link(esp_modem_rat_handle_t rat, uint32_t throughput_bps, uint32_t rtt_ms)
+{
+    RAT_CHECK(rat, "invalid argument", err);
+    esp_modem_rat_site_t *site = esp_modem_rat_current_site(rat);
+    RAT_CHECK(site, "no attach recorded", err_state);
+    esp_modem_rat_stats_t *stats = &site->stats[site->serving];
+    if (throughput_bps) {
+        stats->throughput_avg_bps = esp_modem_rat_average(stats->throughput_avg_bps, throughput_bps);
+    }
+    if (rtt_ms) {
+        stats->rtt_avg_ms = esp_modem_rat_average(stats->rtt_avg_ms, rtt_ms);
+    }
+    stats->cost_ms = esp_modem_rat_cost(rat, stats, stats);
+    esp_modem_rat_evaluate(rat, site);
+    esp_modem_rat_store(rat);
+    return ESP_OK;
+err_state:
+    return ESP_ERR_INVALID_STATE;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_rat_get_stats(esp_modem_rat_handle_t rat, modem_rat_t tech, esp_modem_rat_stats_t *stats,
+                                  modem_rat_t *preferred)
+{
+    RAT_CHECK(rat && tech < MODEM_RAT_MAX && stats, "invalid argument", err);
+    esp_modem_rat_site_t *site = esp_modem_rat_current_site(rat);
+    if (!site) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *stats = site->stats[tech];
+    if (preferred) {
+        *preferred = site->preferred;
+    }
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_rat_clear(esp_modem_rat_handle_t rat)
+{
+    RAT_CHECK(rat, "invalid argument", err);
+    memset(&rat->table, 0, sizeof(rat->table));
+    rat->table.version = ESP_MODEM_RAT_VERSION;
+    rat->table.current = ESP_MODEM_RAT_NO_SITE;
+    rat->applied = MODEM_RAT_AUTO;
+    return esp_modem_rat_store(rat);
+err:
+    return ESP_FAIL;
+}
@@ -0,0 +1,169 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Specific Length Constraint
+ *
+ */
+#define ESP_MODEM_RAT_MAX_SITES (8) /*!< Sites remembered, the least recently seen is forgotten first */
+
+/**
+ * @brief RAT policy configuration
+ *
+ */
+typedef struct {
+    uint32_t rats;             /*!< Technologies to choose from, bit (1 << modem_rat_t) each */
+    uint32_t hysteresis_pct;   /*!< Margin by which another technology has to be better to take over, unit: % */
+    uint32_t min_samples;      /*!< Attaches on a technology before it is compared with the others */
+    uint32_t explore_interval; /*!< Sessions at a site between trials of the least tried technology, 0 for never */
+    uint32_t round_trips;      /*!< Round trips of a typical session, weight of the round trip time */
+    uint32_t session_bytes;    /*!< Bytes of a typical session, weight of the throughput */
+} esp_modem_rat_config_t;
+
+/**
+ * @brief RAT policy default configuration
+ *
+ */
+#define ESP_MODEM_RAT_DEFAULT_CONFIG()                                                          \
+    {                                                                                           \
+        .rats = (1 << MODEM_RAT_GSM) | (1 << MODEM_RAT_LTE_M) | (1 << MODEM_RAT_NB_IOT),        \
+        .hysteresis_pct = 30,                                                                   \
+        .min_samples = 2,                                                                       \
+        .explore_interval = 20,                                                                 \
+        .round_trips = 10,                                                                      \
+        .session_bytes = 10240                                                                  \
+    }
+
+/**
+ * @brief Performance of a technology at a site
+ *
+ */
+typedef struct {
+    uint32_t attaches;           /*!< Successful attaches */
+    uint32_t failures;           /*!< Failed attaches */
+    uint32_t failed_in_row;      /*!< Failed attaches since the last success, the technology is only tried again to explore */
+    uint32_t attach_avg_ms;      /*!< Moving average attach time */
+    uint32_t rtt_avg_ms;         /*!< Moving average round trip time, 0 if not measured */
+    uint32_t throughput_avg_bps; /*!< Moving average throughput, unit: bytes/s, 0 if not measured */
+    uint32_t cost_ms;            /*!< Estimated duration of a typical session, from the averages */
+} esp_modem_rat_stats_t;
+
+typedef struct esp_modem_rat *esp_modem_rat_handle_t;
+
+/**
+ * @brief Create the RAT policy of a module, loading what was learned of the sites from NVS
+ *
+ * A site is known by the serving cell on each technology. Each attach and link measurement is
+ * recorded for the serving technology at the serving site. Each technology is scored by the
+ * estimated duration of a typical session: attach time, round_trips times the round trip time
+ * and session_bytes at the throughput, the terms measured on both technologies compared only.
+ * Another technology is preferred once cheaper by hysteresis_pct, or at once if the preferred one
+ * fails to attach.
+ *
+ * @param dce Modem DCE object, with set_rat and get_serving_cell
+ * @param config policy configuration
+ * @return esp_modem_rat_handle_t policy handle, NULL on error
+ */
+esp_modem_rat_handle_t esp_modem_rat_init(modem_dce_t *dce, const esp_modem_rat_config_t *config);
+
+/**
+ * @brief Delete the RAT policy
+ *
+ * @param rat policy handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_rat_deinit(esp_modem_rat_handle_t rat);
+
+/**
+ * @brief Select the technology of the next attach, at the site of the last session
+ *
+ * The preferred technology, a technology with fewer than min_samples attaches, or the least tried
+ * one every explore_interval sessions. Attach hints are cleared when the technology changes, see
+ * esp_modem_attach_clear_hints(). Left to the module at an unknown site or after a failed attach.
+ *
+ * @param rat policy handle
+ * @param selected technology selected, may be NULL
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_FAIL if the module refused the technology
+ */
+esp_err_t esp_modem_rat_apply(esp_modem_rat_handle_t rat, modem_rat_t *selected);
+
+/**
+ * @brief Record an attach, finding the site from the serving cell
+ *
+ * @param rat policy handle
+ * @param attached true if registered
+ * @param attach_ms attach time, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_FAIL if the serving cell is unknown
+ */
+esp_err_t esp_modem_rat_record_attach(esp_modem_rat_handle_t rat, bool attached, uint32_t attach_ms);
+
+/**
+ * @brief Record a link measurement of the current session
+ *
+ * @param rat policy handle
+ * The measures should be end to end, through the radio: the LCP echo requests of the keepalive
+ * are answered by the module and only measure the UART.
+ *
+ * @param throughput_bps achieved throughput, 0 if not measured, unit: bytes/s
+ * @param rtt_ms round trip time to a server, 0 if not measured
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_INVALID_STATE if no attach was recorded
+ */
+esp_err_t esp_modem_rat_record_link(esp_modem_rat_handle_t rat, uint32_t throughput_bps, uint32_t rtt_ms);
+
+/**
+ * @brief Get the performance of a technology at the current site
+ *
+ * @param rat policy handle
+ * @param tech technology
+ * @param stats performance
+ * @param preferred technology preferred at the site, may be NULL
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_NOT_FOUND if the site is unknown
+ */
+esp_err_t esp_modem_rat_get_stats(esp_modem_rat_handle_t rat, modem_rat_t tech, esp_modem_rat_stats_t *stats,
+                                  modem_rat_t *preferred);
+
+/**
+ * @brief Forget all sites
+ *
+ * @param rat policy handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_rat_clear(esp_modem_rat_handle_t rat);
+
+#ifdef __cplusplus
+}
+#endif
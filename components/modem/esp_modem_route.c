@@ -0,0 +1,87 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "net/if.h"
+#include "esp_modem_route.h"
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *ROUTE_TAG = "esp-modem-route";
+#define ROUTE_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(a))                                                                       \
+        {                                                                               \
+            ESP_LOGE(ROUTE_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                              \
+        }                                                                               \
+    } while (0)
+
+static esp_netif_t *s_routes[ESP_MODEM_TRAFFIC_MAX];
+static portMUX_TYPE s_routes_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t esp_modem_route_set(esp_modem_traffic_class_t traffic_class, esp_netif_t *netif)
+{
+    ROUTE_CHECK(traffic_class < ESP_MODEM_TRAFFIC_MAX, "invalid traffic class: %d", err, traffic_class);
+    portENTER_CRITICAL(&s_routes_lock);
+    s_routes[traffic_class] = netif;
+    portEXIT_CRITICAL(&s_routes_lock);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_netif_t *esp_modem_route_get(esp_modem_traffic_class_t traffic_class)
+{
+    esp_netif_t *routes[ESP_MODEM_TRAFFIC_MAX];
+    ROUTE_CHECK(traffic_class < ESP_MODEM_TRAFFIC_MAX, "invalid traffic class: %d", err, traffic_class);
+    portENTER_CRITICAL(&s_routes_lock);
+    for (int i = 0; i < ESP_MODEM_TRAFFIC_MAX; i++) {
+        routes[i] = s_routes[i];
+    }
+    portEXIT_CRITICAL(&s_routes_lock);
+    if (routes[traffic_class] && esp_netif_is_netif_up(routes[traffic_class])) {
+        return routes[traffic_class];
+    }
+    for (int i = 0; i < ESP_MODEM_TRAFFIC_MAX; i++) {
+        if (routes[i] && esp_netif_is_netif_up(routes[i])) {
+            ESP_LOGD(ROUTE_TAG, "traffic class %d falls back to the route of %d", traffic_class, i);
+            return routes[i];
+        }
+    }
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_route_bind_socket(esp_modem_traffic_class_t traffic_class, int sock)
+{
+    struct ifreq ifr = {0};
+    ROUTE_CHECK(traffic_class < ESP_MODEM_TRAFFIC_MAX && sock >= 0, "invalid argument", err_arg);
+    esp_netif_t *netif = esp_modem_route_get(traffic_class);
+    if (!netif) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ROUTE_CHECK(esp_netif_get_netif_impl_name(netif, ifr.ifr_name) == ESP_OK, "get interface name failed", err);
+    ROUTE_CHECK(setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, &ifr, sizeof(ifr)) == 0, "bind to %s failed", err,
+                ifr.ifr_name);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+err_arg:
+    return ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,72 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_netif.h"
+
+/**
+ * @brief Traffic classes, each routed to the netif of its own PDP context
+ *
+ */
+typedef enum {
+    ESP_MODEM_TRAFFIC_CONTROL = 0, /*!< Telemetry and control, latency sensitive */
+    ESP_MODEM_TRAFFIC_BULK,        /*!< Firmware and file downloads, throughput bound */
+    ESP_MODEM_TRAFFIC_MAX
+} esp_modem_traffic_class_t;
+
+/**
+ * @brief Route a traffic class to a netif
+ *
+ * The netif is usually the PPP session of a modem dialing the PDP context of the class, see
+ * esp_modem_select_pdp_context().
+ *
+ * @param traffic_class traffic class
+ * @param netif netif of the class, NULL to remove the route
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid traffic class
+ */
+esp_err_t esp_modem_route_set(esp_modem_traffic_class_t traffic_class, esp_netif_t *netif);
+
+/**
+ * @brief Get the netif of a traffic class
+ *
+ * If the netif of the class is down, the netif of another class that is up is returned, so that
+ * traffic still flows, at the cost of latency.
+ *
+ * @param traffic_class traffic class
+ * @return esp_netif_t netif, NULL if no route is up
+ */
+esp_netif_t *esp_modem_route_get(esp_modem_traffic_class_t traffic_class);
+
+/**
+ * @brief Bind a socket to the netif of a traffic class, before it connects or sends
+ *
+ * @param traffic_class traffic class
+ * @param sock socket to bind
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_NOT_FOUND if no route is up
+ *      - ESP_FAIL if the socket could not be bound
+ */
+esp_err_t esp_modem_route_bind_socket(esp_modem_traffic_class_t traffic_class, int sock);
+
+#ifdef __cplusplus
+}
+#endif
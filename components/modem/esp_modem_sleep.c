@@ -0,0 +1,141 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_identity.h"
+#include "esp_modem_sleep.h"
+
+#define ESP_MODEM_SLEEP_MAGIC (0x4d534c31) /* "MSL1", bump on layout change */
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *SLEEP_TAG = "esp-modem-sleep";
+#define SLEEP_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(a))                                                                       \
+        {                                                                               \
+            ESP_LOGE(SLEEP_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                              \
+        }                                                                               \
+    } while (0)
+
+/**
+ * @brief Session kept across deep sleep, in RTC slow memory
+ *
+ */
+typedef struct {
+    uint32_t magic;                       /*!< Valid session marker */
+    char iccid[MODEM_ICCID_LENGTH + 1];   /*!< SIM card of the session */
+    char name[MODEM_MAX_NAME_LENGTH];     /*!< Module name */
+    char imei[MODEM_IMEI_LENGTH + 1];     /*!< IMEI number */
+    char imsi[MODEM_IMSI_LENGTH + 1];     /*!< IMSI number */
+    char oper[MODEM_MAX_OPERATOR_LENGTH]; /*!< Operator name */
+    bool dtr_switch;                      /*!< Data mode is left by dropping DTR */
+    esp_netif_ip_info_t ip_info;          /*!< Addresses negotiated by IPCP */
+    uint32_t sleeps;                      /*!< Consecutive deep sleeps with the session kept */
+} esp_modem_sleep_session_t;
+
+static RTC_DATA_ATTR esp_modem_sleep_session_t s_session;
+static bool s_restored;
+
+esp_err_t esp_modem_sleep_prepare(modem_dte_t *dte, esp_netif_t *netif)
+{
+    modem_dce_t *dce = dte->dce;
+    SLEEP_CHECK(dce, "DTE has not yet bind with DCE", err);
+    SLEEP_CHECK(dce->mode == MODEM_PPP_MODE || dce->data_suspended, "no data call to keep", err);
+    /* The session is restored on a single AT channel */
+    SLEEP_CHECK(!esp_modem_is_cmux(dte), "not supported with cmux", err);
+    if (dce->mode == MODEM_PPP_MODE) {
+        SLEEP_CHECK(esp_modem_suspend_ppp(dte) == ESP_OK, "suspend ppp failed", err);
+    }
+    s_session.magic = 0;
+    strcpy(s_session.iccid, dce->iccid);
+    strcpy(s_session.name, dce->name);
+    strcpy(s_session.imei, dce->imei);
+    strcpy(s_session.imsi, dce->imsi);
+    esp_modem_identity_copy_operator(dce, s_session.oper, sizeof(s_session.oper));
+    s_session.dtr_switch = dce->dtr_switch;
+    if (!netif || esp_netif_get_ip_info(netif, &s_session.ip_info) != ESP_OK) {
+        memset(&s_session.ip_info, 0, sizeof(s_session.ip_info));
+    }
+    s_session.sleeps++;
+    /* Pads would float in deep sleep, which could reset or power off the module. RTC pads are
+     * only held by gpio_hold_en(), digital pads also need the deep sleep hold */
+    SLEEP_CHECK(esp_modem_hold_pins(dte, true) == ESP_OK, "hold pins failed", err_hold);
+    gpio_deep_sleep_hold_en();
+    s_session.magic = ESP_MODEM_SLEEP_MAGIC;
+    ESP_LOGD(SLEEP_TAG, "session saved, sleep %d", s_session.sleeps);
+    return ESP_OK;
+err_hold:
+    esp_modem_hold_pins(dte, false);
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_sleep_restore(modem_dce_t *dce)
+{
+    esp_modem_sleep_session_t session = s_session;
+    /* Sessions are one-shot, saved again before the next sleep */
+    s_session.magic = 0;
+    s_restored = false;
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED || session.magic != ESP_MODEM_SLEEP_MAGIC) {
+        s_session.sleeps = 0;
+        return ESP_ERR_NOT_FOUND;
+    }
+    gpio_deep_sleep_hold_dis();
+    esp_modem_hold_pins(dce->dte, false);
+    /* The module stayed in command mode with the data call suspended */
+    SLEEP_CHECK(esp_modem_dce_sync(dce) == ESP_OK, "module not responding", err);
+    SLEEP_CHECK(dce->get_iccid_number && dce->get_iccid_number(dce) == ESP_OK, "get iccid failed", err);
+    SLEEP_CHECK(!strcmp(dce->iccid, session.iccid), "sim card changed", err);
+    strcpy(dce->name, session.name);
+    strcpy(dce->imei, session.imei);
+    strcpy(dce->imsi, session.imsi);
+    esp_modem_identity_set_operator(dce, session.oper);
+    dce->dtr_switch = session.dtr_switch;
+    dce->mode = MODEM_COMMAND_MODE;
+    dce->data_suspended = true;
+    s_session.ip_info = session.ip_info;
+    s_restored = true;
+    ESP_LOGI(SLEEP_TAG, "session restored after %d sleeps", session.sleeps);
+    return ESP_OK;
+err:
+    s_session.sleeps = 0;
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_sleep_get_ip_info(esp_netif_ip_info_t *ip_info)
+{
+    if (!s_restored) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *ip_info = s_session.ip_info;
+    return ESP_OK;
+}
+
+void esp_modem_sleep_invalidate(void)
+{
+    s_session.magic = 0;
+    s_session.sleeps = 0;
+    s_restored = false;
+}
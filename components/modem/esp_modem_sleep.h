@@ -0,0 +1,73 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_netif.h"
+#include "esp_modem_dce.h"
+#include "esp_modem_dte.h"
+
+/**
+ * @brief Keep the data call of the modem up while the ESP32 is in deep sleep
+ *
+ * The PPP session is suspended (see esp_modem_suspend_ppp()) so that the module keeps its PDP
+ * context, and the DCE state is saved in RTC memory together with the negotiated addresses.
+ * DTR, PWRKEY and RESET are held during deep sleep, see esp_modem_hold_pins(), so that the module
+ * is neither reset nor powered off.
+ *
+ * @param dte Modem DTE object
+ * @param netif PPP network interface, used to save the negotiated addresses, may be NULL
+ * @return esp_err_t
+ *      - ESP_OK on success, esp_deep_sleep() may be called
+ *      - ESP_FAIL on error, the module has to be powered down as usual
+ */
+esp_err_t esp_modem_sleep_prepare(modem_dte_t *dte, esp_netif_t *netif);
+
+/**
+ * @brief Restore the DCE state saved by esp_modem_sleep_prepare()
+ *
+ * To be called on wake up right after the DCE object has been created, in place of power up and
+ * open. On success the data call is resumed (ATO) by esp_modem_start_ppp(), without dialing and
+ * defining the PDP context again.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if no session was saved, e.g. on cold boot
+ *      - ESP_FAIL if the module or the SIM card does not match the saved session, a full bring-up is needed
+ */
+esp_err_t esp_modem_sleep_restore(modem_dce_t *dce);
+
+/**
+ * @brief Get the addresses negotiated before deep sleep
+ *
+ * @param ip_info addresses of the saved session
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if no session was restored
+ */
+esp_err_t esp_modem_sleep_get_ip_info(esp_netif_ip_info_t *ip_info);
+
+/**
+ * @brief Discard the saved session, the next wake up does a full bring-up
+ *
+ */
+void esp_modem_sleep_invalidate(void);
+
+#ifdef __cplusplus
+}
+#endif
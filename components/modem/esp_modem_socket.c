@@ -0,0 +1,266 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_socket.h"
+
+#define ESP_MODEM_SOCKET_READABLE_BIT(s) (1 << (s))                        /*!< Data arrived on the socket */
+#define ESP_MODEM_SOCKET_CLOSED_BIT(s) (1 << ((s) + ESP_MODEM_SOCKET_MAX)) /*!< Socket closed by the peer or the network */
+#define ESP_MODEM_SOCKET_ALL_CLOSED_BITS (((1 << ESP_MODEM_SOCKET_MAX) - 1) << ESP_MODEM_SOCKET_MAX)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *SOCKET_TAG = "esp-modem-socket";
+#define SOCKET_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                   \
+    {                                                                                    \
+        if (!(a))                                                                        \
+        {                                                                                \
+            ESP_LOGE(SOCKET_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                               \
+        }                                                                                \
+    } while (0)
+
+/**
+ * @brief State of a socket
+ *
+ */
+typedef enum {
+    ESP_MODEM_SOCKET_FREE = 0,  /*!< Not in use */
+    ESP_MODEM_SOCKET_CREATED,   /*!< Created, not connected */
+    ESP_MODEM_SOCKET_CONNECTED  /*!< Connected on the module */
+} esp_modem_socket_state_t;
+
+/**
+ * @brief Sockets on the IP stack of a module
+ *
+ */
+struct esp_modem_socket_layer {
+    modem_dce_t *dce;                                    /*!< Module carrying the sockets */
+    EventGroupHandle_t events;                           /*!< Readable and closed bits of the sockets */
+    portMUX_TYPE lock;                                   /*!< Protects the fields below */
+    esp_modem_socket_state_t state[ESP_MODEM_SOCKET_MAX]; /*!< State of each socket */
+    modem_socket_type_t type[ESP_MODEM_SOCKET_MAX];       /*!< Type of each socket */
+    esp_modem_socket_stats_t stats;                      /*!< Traffic */
+};
+
+/**
+ * @brief Socket events of the module, posted by its unsolicited result code handlers
+ */
+static void esp_modem_socket_on_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    struct esp_modem_socket_layer *layer = arg;
+    const modem_socket_event_t *event = event_data;
+    if (event_id != ESP_MODEM_EVENT_SOCKET) {
+        return;
+    }
+    if (event->id < 0) {
+        ESP_LOGW(SOCKET_TAG, "ip stack of the module went down");
+        xEventGroupSetBits(layer->events, ESP_MODEM_SOCKET_ALL_CLOSED_BITS);
+    } else if (event->id < ESP_MODEM_SOCKET_MAX) {
+        ESP_LOGD(SOCKET_TAG, "socket %d %s", event->id, event->closed ? "closed" : "readable");
+        xEventGroupSetBits(layer->events, event->closed ? ESP_MODEM_SOCKET_CLOSED_BIT(event->id) :
+                           ESP_MODEM_SOCKET_READABLE_BIT(event->id));
+    }
+}
+
+/**
+ * @brief Whether a socket is in a state
+ */
+static bool esp_modem_socket_is(struct esp_modem_socket_layer *layer, int s, esp_modem_socket_state_t state)
+{
+    if (s < 0 || s >= ESP_MODEM_SOCKET_MAX) {
+        return false;
+    }
+    portENTER_CRITICAL(&layer->lock);
+    bool is = layer->state[s] == state;
+    portEXIT_CRITICAL(&layer->lock);
+    return is;
+}
+
+esp_modem_socket_layer_handle_t esp_modem_socket_init(modem_dce_t *dce)
+{
+    SOCKET_CHECK(dce && dce->dte, "invalid argument", err);
+    SOCKET_CHECK(dce->set_socket_stack && dce->socket_open && dce->socket_send && dce->socket_recv && dce->socket_close,
+                 "socket offload not supported", err);
+    SOCKET_CHECK(dce->mode == MODEM_COMMAND_MODE, "module not in command mode", err);
+    struct esp_modem_socket_layer *layer = calloc(1, sizeof(struct esp_modem_socket_layer));
+    SOCKET_CHECK(layer, "calloc layer failed", err);
+    layer->dce = dce;
+    layer->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    layer->events = xEventGroupCreate();
+    SOCKET_CHECK(layer->events, "create event group failed", err_events);
+    /* Registered for any event, esp_modem_remove_event_handler() only removes those */
+    SOCKET_CHECK(esp_modem_set_event_handler(dce->dte, esp_modem_socket_on_event, ESP_EVENT_ANY_ID, layer) == ESP_OK,
+                 "set event handler failed", err_handler);
+    SOCKET_CHECK(dce->set_socket_stack(dce, true) == ESP_OK, "bring up ip stack failed", err_stack);
+    ESP_LOGI(SOCKET_TAG, "ip stack of the module up");
+    return layer;
+err_stack:
+    esp_modem_remove_event_handler(dce->dte, esp_modem_socket_on_event);
+err_handler:
+    vEventGroupDelete(layer->events);
+err_events:
+    free(layer);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_socket_deinit(esp_modem_socket_layer_handle_t layer)
+{
+    SOCKET_CHECK(layer, "invalid argument", err);
+    for (int s = 0; s < ESP_MODEM_SOCKET_MAX; s++) {
+        if (!esp_modem_socket_is(layer, s, ESP_MODEM_SOCKET_FREE)) {
+            esp_modem_socket_close(layer, s);
+        }
+    }
+    esp_err_t ret = layer->dce->set_socket_stack(layer->dce, false);
+    esp_modem_remove_event_handler(layer->dce->dte, esp_modem_socket_on_event);
+    vEventGroupDelete(layer->events);
+    free(layer);
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+int esp_modem_socket_open(esp_modem_socket_layer_handle_t layer, modem_socket_type_t type)
+{
+    SOCKET_CHECK(layer, "invalid argument", err);
+    portENTER_CRITICAL(&layer->lock);
+    for (int s = 0; s < ESP_MODEM_SOCKET_MAX; s++) {
+        if (layer->state[s] == ESP_MODEM_SOCKET_FREE) {
+            layer->state[s] = ESP_MODEM_SOCKET_CREATED;
+            layer->type[s] = type;
+            portEXIT_CRITICAL(&layer->lock);
+            return s;
+        }
+    }
+    portEXIT_CRITICAL(&layer->lock);
+    ESP_LOGE(SOCKET_TAG, "all %d sockets in use", ESP_MODEM_SOCKET_MAX);
+err:
+    return -1;
+}
+
+esp_err_t esp_modem_socket_connect(esp_modem_socket_layer_handle_t layer, int s, const char *host, uint16_t port)
+{
+    SOCKET_CHECK(layer && host, "invalid argument", err);
+    if (!esp_modem_socket_is(layer, s, ESP_MODEM_SOCKET_CREATED)) {
+        SOCKET_CHECK(esp_modem_socket_is(layer, s, ESP_MODEM_SOCKET_CONNECTED), "invalid socket %d", err, s);
+        return ESP_ERR_INVALID_STATE;
+    }
+    xEventGroupClearBits(layer->events, ESP_MODEM_SOCKET_READABLE_BIT(s) | ESP_MODEM_SOCKET_CLOSED_BIT(s));
+    SOCKET_CHECK(layer->dce->socket_open(layer->dce, s, layer->type[s], host, port) == ESP_OK,
+                 "connect socket %d to %s:%d failed", err_open, s, host, port);
+    portENTER_CRITICAL(&layer->lock);
+    layer->state[s] = ESP_MODEM_SOCKET_CONNECTED;
+    portEXIT_CRITICAL(&layer->lock);
+    ESP_LOGD(SOCKET_TAG, "socket %d connected to %s:%d", s, host, port);
+    return ESP_OK;
+err_open:
+    return ESP_FAIL;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+int esp_modem_socket_send(esp_modem_socket_layer_handle_t layer, int s, const void *data, size_t len)
+{
+    SOCKET_CHECK(layer && (data || !len), "invalid argument", err);
+    SOCKET_CHECK(esp_modem_socket_is(layer, s, ESP_MODEM_SOCKET_CONNECTED), "socket %d not connected", err, s);
+    const uint8_t *pos = data;
+    size_t left = len;
+    while (left) {
+        size_t chunk = MIN(left, MODEM_SOCKET_PAYLOAD_MAX);
+        SOCKET_CHECK(layer->dce->socket_send(layer->dce, s, pos, chunk) == chunk, "send on socket %d failed", err, s);
+        portENTER_CRITICAL(&layer->lock);
+        layer->stats.tx_bytes += chunk;
+        layer->stats.tx_commands++;
+        portEXIT_CRITICAL(&layer->lock);
+        pos += chunk;
+        left -= chunk;
+    }
+    return len;
+err:
+    return -1;
+}
+
+int esp_modem_socket_recv(esp_modem_socket_layer_handle_t layer, int s, void *buffer, size_t len, uint32_t timeout_ms)
+{
+    SOCKET_CHECK(layer && buffer && len, "invalid argument", err);
+    SOCKET_CHECK(esp_modem_socket_is(layer, s, ESP_MODEM_SOCKET_CONNECTED), "socket %d not connected", err, s);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t ticks = pdMS_TO_TICKS(timeout_ms);
+    while (true) {
+        /* Cleared before reading, data arriving meanwhile is announced again */
+        xEventGroupClearBits(layer->events, ESP_MODEM_SOCKET_READABLE_BIT(s));
+        int received = layer->dce->socket_recv(layer->dce, s, buffer, MIN(len, MODEM_SOCKET_PAYLOAD_MAX));
+        SOCKET_CHECK(received >= 0, "read socket %d failed", err, s);
+        portENTER_CRITICAL(&layer->lock);
+        layer->stats.rx_bytes += received;
+        layer->stats.rx_commands++;
+        portEXIT_CRITICAL(&layer->lock);
+        if (received) {
+            return received;
+        }
+        /* What arrived before the peer closed has been read */
+        if (xEventGroupGetBits(layer->events) & ESP_MODEM_SOCKET_CLOSED_BIT(s)) {
+            return 0;
+        }
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= ticks) {
+            return -1;
+        }
+        EventBits_t bits = xEventGroupWaitBits(layer->events, ESP_MODEM_SOCKET_READABLE_BIT(s) | ESP_MODEM_SOCKET_CLOSED_BIT(s),
+                                               pdFALSE, pdFALSE, ticks - elapsed);
+        if (!(bits & (ESP_MODEM_SOCKET_READABLE_BIT(s) | ESP_MODEM_SOCKET_CLOSED_BIT(s)))) {
+            return -1;
+        }
+    }
+err:
+    return -1;
+}
+
+esp_err_t esp_modem_socket_close(esp_modem_socket_layer_handle_t layer, int s)
+{
+    SOCKET_CHECK(layer && s >= 0 && s < ESP_MODEM_SOCKET_MAX, "invalid argument", err);
+    SOCKET_CHECK(!esp_modem_socket_is(layer, s, ESP_MODEM_SOCKET_FREE), "socket %d not open", err, s);
+    esp_err_t ret = ESP_OK;
+    if (esp_modem_socket_is(layer, s, ESP_MODEM_SOCKET_CONNECTED)) {
+        ret = layer->dce->socket_close(layer->dce, s) == ESP_OK ? ESP_OK : ESP_FAIL;
+    }
+    portENTER_CRITICAL(&layer->lock);
+    layer->state[s] = ESP_MODEM_SOCKET_FREE;
+    portEXIT_CRITICAL(&layer->lock);
+    xEventGroupClearBits(layer->events, ESP_MODEM_SOCKET_READABLE_BIT(s) | ESP_MODEM_SOCKET_CLOSED_BIT(s));
+    return ret;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_socket_get_stats(esp_modem_socket_layer_handle_t layer, esp_modem_socket_stats_t *stats)
+{
+    SOCKET_CHECK(layer && stats, "invalid argument", err);
+    portENTER_CRITICAL(&layer->lock);
+    *stats = layer->stats;
+    portEXIT_CRITICAL(&layer->lock);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,136 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Specific Length Constraint
+ *
+ */
+#define ESP_MODEM_SOCKET_MAX (6) /*!< Sockets open at the same time, numbered as the connections of the module */
+
+/**
+ * @brief Traffic through the sockets, payload only
+ *
+ */
+typedef struct {
+    uint64_t tx_bytes;    /*!< Bytes sent */
+    uint64_t rx_bytes;    /*!< Bytes received */
+    uint32_t tx_commands; /*!< Send commands */
+    uint32_t rx_commands; /*!< Read commands */
+} esp_modem_socket_stats_t;
+
+typedef struct esp_modem_socket_layer *esp_modem_socket_layer_handle_t;
+
+/**
+ * @brief Bring up the IP stack of the module, for sockets in place of PPP
+ *
+ * The module carries TCP and UDP, the ESP32 only sends and reads the payloads with AT commands,
+ * each send streamed after the prompt of the module and each read taken by its announced length.
+ * The module has to be attached and in command mode; PPP does not run meanwhile.
+ *
+ * @param dce Modem DCE object, with set_socket_stack and the socket operations
+ * @return esp_modem_socket_layer_handle_t socket layer handle, NULL on error
+ */
+esp_modem_socket_layer_handle_t esp_modem_socket_init(modem_dce_t *dce);
+
+/**
+ * @brief Close the sockets left open and bring down the IP stack of the module
+ *
+ * @param layer socket layer handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_FAIL if the module did not bring down its IP stack
+ */
+esp_err_t esp_modem_socket_deinit(esp_modem_socket_layer_handle_t layer);
+
+/**
+ * @brief Create a socket
+ *
+ * @param layer socket layer handle
+ * @param type TCP or UDP
+ * @return int socket, -1 if all ESP_MODEM_SOCKET_MAX sockets are in use
+ */
+int esp_modem_socket_open(esp_modem_socket_layer_handle_t layer, modem_socket_type_t type);
+
+/**
+ * @brief Connect a socket to its peer, the only peer of a UDP socket
+ *
+ * @param layer socket layer handle
+ * @param s socket
+ * @param host host name or address of the peer, resolved by the module
+ * @param port port of the peer
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_INVALID_STATE if already connected
+ *      - ESP_FAIL if the module failed to connect
+ */
+esp_err_t esp_modem_socket_connect(esp_modem_socket_layer_handle_t layer, int s, const char *host, uint16_t port);
+
+/**
+ * @brief Send on a connected socket
+ *
+ * @param layer socket layer handle
+ * @param s socket
+ * @param data data to send
+ * @param len length of data, sent in commands of at most MODEM_SOCKET_PAYLOAD_MAX bytes
+ * @return int length of data sent, -1 on error
+ */
+int esp_modem_socket_send(esp_modem_socket_layer_handle_t layer, int s, const void *data, size_t len);
+
+/**
+ * @brief Receive from a connected socket, waiting for data to arrive
+ *
+ * @param layer socket layer handle
+ * @param s socket
+ * @param buffer buffer of the data
+ * @param len size of buffer
+ * @param timeout_ms longest wait for data, 0 to return at once
+ * @return int length of data received, 0 once closed by the peer, -1 on error or if no data arrived in time
+ */
+int esp_modem_socket_recv(esp_modem_socket_layer_handle_t layer, int s, void *buffer, size_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Close a socket
+ *
+ * @param layer socket layer handle
+ * @param s socket
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_FAIL if the module failed to close the connection, the socket is free anyway
+ */
+esp_err_t esp_modem_socket_close(esp_modem_socket_layer_handle_t layer, int s);
+
+/**
+ * @brief Get the traffic through the sockets
+ *
+ * @param layer socket layer handle
+ * @param stats traffic
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_socket_get_stats(esp_modem_socket_layer_handle_t layer, esp_modem_socket_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,451 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_supervisor.h"
+
+#define SUPERVISOR_LINK_DOWN_BIT BIT0
+#define SUPERVISOR_GOT_IP_BIT BIT1
+#define SUPERVISOR_STOP_BIT BIT2
+#define SUPERVISOR_EXIT_BIT BIT3
+#define SUPERVISOR_POLL_MS (1000)
+#define SUPERVISOR_SYNC_RETRIES (10)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *SUPERVISOR_TAG = "esp-modem-supervisor";
+#define SUPERVISOR_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                       \
+    {                                                                                        \
+        if (!(a))                                                                            \
+        {                                                                                    \
+            ESP_LOGE(SUPERVISOR_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                                   \
+        }                                                                                    \
+    } while (0)
+
+static const char *const s_level_names[ESP_MODEM_RECOVERY_MAX] = {"redial", "cfun", "reset pin", "power cycle"};
+
+/**
+ * @brief Link supervisor
+ *
+ */
+struct esp_modem_supervisor {
+    modem_dte_t *dte;                      /*!< Supervised modem */
+    esp_modem_supervisor_config_t config;  /*!< Configuration */
+    EventGroupHandle_t events;             /*!< Link down, got IP, stop */
+    modem_reg_status_t cs_status;          /*!< Last +CREG status */
+    modem_reg_status_t eps_status;         /*!< Last +CEREG status */
+    int64_t unregistered_since;            /*!< Registration loss time, 0 while registered */
+    int64_t down_since;                    /*!< Link loss time, 0 while the link is up */
+    volatile bool recovering;              /*!< Recovery in progress, link losses are expected */
+    volatile bool failed;                  /*!< Recovery given up, until the application reports a link loss */
+    esp_modem_supervisor_stats_t stats;    /*!< Statistics */
+};
+
+static inline bool esp_modem_supervisor_is_registered(modem_reg_status_t status)
+{
+    return status == MODEM_REG_HOME || status == MODEM_REG_ROAMING;
+}
+
+/**
+ * @brief Track +CREG/+CEREG, called from the DTE task
+ *
+ * Both the unsolicited form "+CREG: <stat>[,<lac>,<ci>...]" and the answer to a query
+ * "+CREG: <n>,<stat>[,...]" end up here.
+ */
+static void esp_modem_supervisor_handle_registration(modem_dce_t *dce, const char *line, void *context)
+{
+    esp_modem_supervisor_handle_t sup = context;
+    const char *params = strchr(line, ':');
+    int first = 0;
+    int stat = 0;
+    char next = 0;
+    if (!params) {
+        return;
+    }
+    int fields = sscanf(params + 1, "%d,%c", &first, &next);
+    if (fields < 1) {
+        return;
+    }
+    stat = first;
+    if (fields == 2 && next != '"' && sscanf(params + 1, "%*d,%d", &stat) != 1) {
+        return;
+    }
+    if (!strncmp(line, "+CEREG", strlen("+CEREG"))) {
+        sup->eps_status = stat;
+    } else {
+        sup->cs_status = stat;
+    }
+    sup->stats.registration = stat;
+    bool registered = esp_modem_supervisor_is_registered(sup->cs_status) ||
+                      esp_modem_supervisor_is_registered(sup->eps_status);
+    if (registered) {
+        sup->unregistered_since = 0;
+    } else if (!sup->unregistered_since) {
+        sup->unregistered_since = esp_timer_get_time();
+        ESP_LOGW(SUPERVISOR_TAG, "registration lost (%s)", line);
+    }
+}
+
+/**
+ * @brief Link loss seen by the supervisor itself, ignored once it gave up
+ *
+ */
+static void esp_modem_supervisor_link_down(esp_modem_supervisor_handle_t sup)
+{
+    if (!sup->failed) {
+        esp_modem_supervisor_notify_link_down(sup);
+    }
+}
+
+static void esp_modem_supervisor_on_ip_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    esp_modem_supervisor_handle_t sup = arg;
+    if (event_id == IP_EVENT_PPP_GOT_IP) {
+        ip_event_got_ip_t *event = event_data;
+        if (event->esp_netif == sup->config.netif) {
+            xEventGroupSetBits(sup->events, SUPERVISOR_GOT_IP_BIT);
+        }
+    } else if (event_id == IP_EVENT_PPP_LOST_IP) {
+        ip_event_got_ip_t *event = event_data;
+        if (event->esp_netif == sup->config.netif) {
+            esp_modem_supervisor_link_down(sup);
+        }
+    }
+}
+
+/**
+ * @brief Carrier loss or stall reported by the DTE or the netif keepalive, recover without waiting for LCP
+ *
+ */
+static void esp_modem_supervisor_on_link_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_id == ESP_MODEM_EVENT_CARRIER_LOST || event_id == ESP_MODEM_EVENT_LINK_STALLED) {
+        esp_modem_supervisor_link_down(arg);
+    }
+}
+
+/**
+ * @brief Next delay: exponential, bounded, with jitter in [delay / 2, delay]
+ *
+ * Jitter keeps a fleet that lost the same cell from redialing in lockstep.
+ */
+static uint32_t esp_modem_supervisor_backoff(const esp_modem_supervisor_config_t *config, uint32_t attempt)
+{
+    uint64_t delay = config->backoff_min_ms;
+    if (attempt > 16) {
+        attempt = 16;
+    }
+    delay <<= attempt;
+    if (delay > config->backoff_max_ms) {
+        delay = config->backoff_max_ms;
+    }
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+static bool esp_modem_supervisor_level_available(modem_dce_t *dce, esp_modem_recovery_level_t level)
+{
+    switch (level) {
+    case ESP_MODEM_RECOVERY_RESET_PIN:
+        return dce->reset != NULL;
+    case ESP_MODEM_RECOVERY_POWER_CYCLE:
+        return dce->power_down != NULL && dce->power_up != NULL;
+    default:
+        return true;
+    }
+}
+
+static esp_modem_recovery_level_t esp_modem_supervisor_escalate(modem_dce_t *dce, esp_modem_recovery_level_t level)
+{
+    for (int next = level + 1; next < ESP_MODEM_RECOVERY_MAX; next++) {
+        if (esp_modem_supervisor_level_available(dce, next)) {
+            return next;
+        }
+    }
+    return level;
+}
+
+static esp_err_t esp_modem_supervisor_wait_registered(esp_modem_supervisor_handle_t sup)
+{
+    modem_dce_t *dce = sup->dte->dce;
+    modem_reg_status_t status = MODEM_REG_UNKNOWN;
+    int64_t deadline = esp_timer_get_time() + (int64_t)sup->config.registration_timeout_ms * 1000;
+    do {
+        if (esp_modem_dce_get_network_registration(dce, &status) == ESP_OK &&
+                esp_modem_supervisor_is_registered(status)) {
+            return ESP_OK;
+        }
+        if (xEventGroupWaitBits(sup->events, SUPERVISOR_STOP_BIT, pdFALSE, pdFALSE,
+                                pdMS_TO_TICKS(SUPERVISOR_POLL_MS)) & SUPERVISOR_STOP_BIT) {
+            break;
+        }
+    } while (esp_timer_get_time() < deadline);
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Bring the module back to command mode after it rebooted
+ *
+ */
+static esp_err_t esp_modem_supervisor_reopen(modem_dce_t *dce)
+{
+    if (dce->open) {
+        SUPERVISOR_CHECK(dce->open(dce) == ESP_OK, "open failed", err);
+    } else {
+        int retry = 0;
+        while (dce->sync(dce) != ESP_OK) {
+            SUPERVISOR_CHECK(++retry < SUPERVISOR_SYNC_RETRIES, "module not responding", err);
+            vTaskDelay(pdMS_TO_TICKS(SUPERVISOR_POLL_MS));
+        }
+        SUPERVISOR_CHECK(dce->echo_mode(dce, false) == ESP_OK, "echo off failed", err);
+    }
+    /* Settings are lost with the reboot */
+    esp_modem_dce_set_registration_urc(dce, true);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+static esp_err_t esp_modem_supervisor_try(esp_modem_supervisor_handle_t sup, esp_modem_recovery_level_t level)
+{
+    modem_dte_t *dte = sup->dte;
+    modem_dce_t *dce = dte->dce;
+    if (dce->mode == MODEM_PPP_MODE || dce->data_suspended) {
+        if (esp_modem_stop_ppp(dte) != ESP_OK) {
+            /* The module does not answer in data mode, resynchronize the line anyway */
+            dte->reset(dte);
+        }
+    }
+    switch (level) {
+    case ESP_MODEM_RECOVERY_REDIAL:
+        break;
+    case ESP_MODEM_RECOVERY_CFUN:
+        SUPERVISOR_CHECK(esp_modem_dce_set_functionality(dce, 0) == ESP_OK, "radio off failed", err);
+        SUPERVISOR_CHECK(esp_modem_dce_set_functionality(dce, 1) == ESP_OK, "radio on failed", err);
+        break;
+    case ESP_MODEM_RECOVERY_RESET_PIN:
+        SUPERVISOR_CHECK(dce->reset(dce) == ESP_OK, "reset failed", err);
+        dte->reset(dte);
+        SUPERVISOR_CHECK(esp_modem_supervisor_reopen(dce) == ESP_OK, "reopen failed", err);
+        break;
+    case ESP_MODEM_RECOVERY_POWER_CYCLE:
+        /* A module that hangs does not answer AT+CPOWD, PWRKEY still works */
+        dce->power_down(dce);
+        dte->reset(dte);
+        SUPERVISOR_CHECK(dce->power_up(dce) == ESP_OK, "power up failed", err);
+        SUPERVISOR_CHECK(esp_modem_supervisor_reopen(dce) == ESP_OK, "reopen failed", err);
+        break;
+    default:
+        goto err;
+    }
+    SUPERVISOR_CHECK(esp_modem_supervisor_wait_registered(sup) == ESP_OK, "not registered", err);
+    xEventGroupClearBits(sup->events, SUPERVISOR_GOT_IP_BIT);
+    SUPERVISOR_CHECK(esp_modem_start_ppp(dte) == ESP_OK, "start ppp failed", err);
+    EventBits_t bits = xEventGroupWaitBits(sup->events, SUPERVISOR_GOT_IP_BIT | SUPERVISOR_STOP_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(sup->config.ppp_timeout_ms));
+    SUPERVISOR_CHECK(bits & SUPERVISOR_GOT_IP_BIT, "no ip address", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+static void esp_modem_supervisor_recover(esp_modem_supervisor_handle_t sup)
+{
+    modem_dce_t *dce = sup->dte->dce;
+    esp_modem_recovery_level_t level = ESP_MODEM_RECOVERY_REDIAL;
+    uint32_t attempts = 0;
+    uint32_t level_attempts = 0;
+    sup->recovering = true;
+    if (!sup->down_since) {
+        sup->down_since = esp_timer_get_time();
+    }
+    sup->stats.outages++;
+    esp_modem_post_event(sup->dte, ESP_MODEM_EVENT_LINK_DOWN, NULL, 0);
+    while (true) {
+        uint32_t delay = esp_modem_supervisor_backoff(&sup->config, attempts);
+        if (xEventGroupWaitBits(sup->events, SUPERVISOR_STOP_BIT, pdFALSE, pdFALSE,
+                                pdMS_TO_TICKS(delay)) & SUPERVISOR_STOP_BIT) {
+            break;
+        }
+        attempts++;
+        ESP_LOGI(SUPERVISOR_TAG, "attempt %d: %s", attempts, s_level_names[level]);
+        if (esp_modem_supervisor_try(sup, level) == ESP_OK) {
+            esp_modem_recovery_t recovery = {
+                .level = level,
+                .attempts = attempts,
+                .time_to_recover_ms = (esp_timer_get_time() - sup->down_since) / 1000
+            };
+            sup->stats.recoveries[level]++;
+            sup->stats.last_recover_ms = recovery.time_to_recover_ms;
+            if (recovery.time_to_recover_ms > sup->stats.max_recover_ms) {
+                sup->stats.max_recover_ms = recovery.time_to_recover_ms;
+            }
+            sup->stats.downtime_ms += recovery.time_to_recover_ms;
+            ESP_LOGI(SUPERVISOR_TAG, "link recovered by %s after %d attempts, %d ms",
+                     s_level_names[level], attempts, recovery.time_to_recover_ms);
+            esp_modem_post_event(sup->dte, ESP_MODEM_EVENT_LINK_RECOVERED, &recovery, sizeof(recovery));
+            break;
+        }
+        level_attempts++;
+        esp_modem_recovery_level_t next = esp_modem_supervisor_escalate(dce, level);
+        if (next != level && level_attempts >= sup->config.attempts_per_level) {
+            ESP_LOGW(SUPERVISOR_TAG, "escalating from %s to %s", s_level_names[level], s_level_names[next]);
+            level = next;
+            level_attempts = 0;
+        } else if (next == level && sup->config.last_level_attempts &&
+                   level_attempts >= sup->config.last_level_attempts) {
+            esp_modem_recovery_t recovery = {
+                .level = level,
+                .attempts = attempts,
+                .time_to_recover_ms = (esp_timer_get_time() - sup->down_since) / 1000
+            };
+            sup->stats.failures++;
+            sup->stats.downtime_ms += recovery.time_to_recover_ms;
+            ESP_LOGE(SUPERVISOR_TAG, "giving up after %d attempts, %s included", attempts, s_level_names[level]);
+            sup->failed = true;
+            esp_modem_post_event(sup->dte, ESP_MODEM_EVENT_RECOVERY_FAILED, &recovery, sizeof(recovery));
+            break;
+        }
+    }
+    sup->down_since = 0;
+    sup->unregistered_since = 0;
+    /* Link losses reported while recovering were caused by the recovery itself */
+    xEventGroupClearBits(sup->events, SUPERVISOR_LINK_DOWN_BIT);
+    sup->recovering = false;
+}
+
+static void esp_modem_supervisor_task(void *param)
+{
+    esp_modem_supervisor_handle_t sup = param;
+    while (1) {
+        EventBits_t bits = xEventGroupWaitBits(sup->events, SUPERVISOR_LINK_DOWN_BIT | SUPERVISOR_STOP_BIT,
+                                               pdFALSE, pdFALSE, pdMS_TO_TICKS(SUPERVISOR_POLL_MS));
+        if (bits & SUPERVISOR_STOP_BIT) {
+            break;
+        }
+        int64_t unregistered_since = sup->unregistered_since;
+        if (!(bits & SUPERVISOR_LINK_DOWN_BIT) && unregistered_since && !sup->failed &&
+                esp_timer_get_time() - unregistered_since > (int64_t)sup->config.registration_timeout_ms * 1000) {
+            ESP_LOGW(SUPERVISOR_TAG, "not registered for %d ms", sup->config.registration_timeout_ms);
+            sup->down_since = unregistered_since;
+            bits |= SUPERVISOR_LINK_DOWN_BIT;
+        }
+        if (bits & SUPERVISOR_LINK_DOWN_BIT) {
+            esp_modem_supervisor_recover(sup);
+        }
+    }
+    xEventGroupSetBits(sup->events, SUPERVISOR_EXIT_BIT);
+    vTaskDelete(NULL);
+}
+
+esp_modem_supervisor_handle_t esp_modem_supervisor_start(modem_dte_t *dte, const esp_modem_supervisor_config_t *config)
+{
+    modem_reg_status_t status = MODEM_REG_UNKNOWN;
+    SUPERVISOR_CHECK(dte && dte->dce && config, "invalid argument", err);
+    SUPERVISOR_CHECK(dte->dce->mode == MODEM_COMMAND_MODE, "dce not in command mode", err);
+    esp_modem_supervisor_handle_t sup = calloc(1, sizeof(struct esp_modem_supervisor));
+    SUPERVISOR_CHECK(sup, "calloc supervisor failed", err);
+    sup->dte = dte;
+    sup->config = *config;
+    sup->cs_status = MODEM_REG_UNKNOWN;
+    sup->eps_status = MODEM_REG_UNKNOWN;
+    sup->stats.registration = MODEM_REG_UNKNOWN;
+    sup->events = xEventGroupCreate();
+    SUPERVISOR_CHECK(sup->events, "create event group failed", err_events);
+    SUPERVISOR_CHECK(esp_modem_register_urc_handler(dte, "+CREG:", esp_modem_supervisor_handle_registration, sup) == ESP_OK,
+                     "register +CREG handler failed", err_urc);
+    SUPERVISOR_CHECK(esp_modem_register_urc_handler(dte, "+CEREG:", esp_modem_supervisor_handle_registration, sup) == ESP_OK,
+                     "register +CEREG handler failed", err_urc);
+    SUPERVISOR_CHECK(esp_modem_dce_set_registration_urc(dte->dce, true) == ESP_OK, "enable registration urc failed", err_urc);
+    /* Answer lands in the handler above as well */
+    esp_modem_dce_get_network_registration(dte->dce, &status);
+    SUPERVISOR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_modem_supervisor_on_ip_event, sup) == ESP_OK,
+                     "register got ip handler failed", err_urc);
+    SUPERVISOR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_LOST_IP, esp_modem_supervisor_on_ip_event, sup) == ESP_OK,
+                     "register lost ip handler failed", err_lost_ip);
+    /* Registered for any event, esp_modem_remove_event_handler() only removes those */
+    SUPERVISOR_CHECK(esp_modem_set_event_handler(dte, esp_modem_supervisor_on_link_event, ESP_EVENT_ANY_ID, sup) == ESP_OK,
+                     "register link event handler failed", err_link_event);
+    BaseType_t ret = xTaskCreate(esp_modem_supervisor_task, "supervisor", config->task_stack_size, sup,
+                                 config->task_priority, NULL);
+    SUPERVISOR_CHECK(ret == pdTRUE, "create supervisor task failed", err_task);
+    ESP_LOGI(SUPERVISOR_TAG, "started, registration %d", status);
+    return sup;
+err_task:
+    esp_modem_remove_event_handler(dte, esp_modem_supervisor_on_link_event);
+err_link_event:
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_LOST_IP, esp_modem_supervisor_on_ip_event);
+err_lost_ip:
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_modem_supervisor_on_ip_event);
+err_urc:
+    esp_modem_unregister_urc_handler(dte, esp_modem_supervisor_handle_registration, sup);
+    vEventGroupDelete(sup->events);
+err_events:
+    free(sup);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_supervisor_stop(esp_modem_supervisor_handle_t supervisor)
+{
+    SUPERVISOR_CHECK(supervisor, "invalid argument", err);
+    xEventGroupSetBits(supervisor->events, SUPERVISOR_STOP_BIT);
+    xEventGroupWaitBits(supervisor->events, SUPERVISOR_EXIT_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    esp_modem_remove_event_handler(supervisor->dte, esp_modem_supervisor_on_link_event);
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_LOST_IP, esp_modem_supervisor_on_ip_event);
+    esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_GOT_IP, esp_modem_supervisor_on_ip_event);
+    esp_modem_unregister_urc_handler(supervisor->dte, esp_modem_supervisor_handle_registration, supervisor);
+    vEventGroupDelete(supervisor->events);
+    free(supervisor);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_supervisor_notify_link_down(esp_modem_supervisor_handle_t supervisor)
+{
+    SUPERVISOR_CHECK(supervisor, "invalid argument", err);
+    supervisor->failed = false;
+    if (!supervisor->recovering) {
+        if (!supervisor->down_since) {
+            supervisor->down_since = esp_timer_get_time();
+        }
+        xEventGroupSetBits(supervisor->events, SUPERVISOR_LINK_DOWN_BIT);
+    }
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_supervisor_get_stats(esp_modem_supervisor_handle_t supervisor, esp_modem_supervisor_stats_t *stats)
+{
+    SUPERVISOR_CHECK(supervisor && stats, "invalid argument", err);
+    *stats = supervisor->stats;
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
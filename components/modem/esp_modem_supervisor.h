@@ -0,0 +1,147 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_netif.h"
+#include "esp_modem_dce.h"
+#include "esp_modem_dte.h"
+
+/**
+ * @brief Recovery actions, in escalation order
+ *
+ */
+typedef enum {
+    ESP_MODEM_RECOVERY_REDIAL = 0,   /*!< Hang up and dial again */
+    ESP_MODEM_RECOVERY_CFUN,         /*!< Radio off and on (AT+CFUN=0, AT+CFUN=1) */
+    ESP_MODEM_RECOVERY_RESET_PIN,    /*!< Hardware reset by the reset pin */
+    ESP_MODEM_RECOVERY_POWER_CYCLE,  /*!< Power down and up again by PWRKEY */
+    ESP_MODEM_RECOVERY_MAX
+} esp_modem_recovery_level_t;
+
+/**
+ * @brief Data of ESP_MODEM_EVENT_LINK_RECOVERED and ESP_MODEM_EVENT_RECOVERY_FAILED
+ *
+ */
+typedef struct {
+    esp_modem_recovery_level_t level; /*!< Action that brought the link back, or the last one tried */
+    uint32_t attempts;                /*!< Attempts, all levels included */
+    uint32_t time_to_recover_ms;      /*!< From link loss to IP address, or to giving up */
+} esp_modem_recovery_t;
+
+/**
+ * @brief Link supervisor statistics
+ *
+ */
+typedef struct {
+    uint32_t outages;                               /*!< Number of link losses */
+    uint32_t recoveries[ESP_MODEM_RECOVERY_MAX];    /*!< Recoveries per action */
+    uint32_t failures;                              /*!< Outages given up */
+    uint32_t last_recover_ms;                       /*!< Time to recover of the last outage */
+    uint32_t max_recover_ms;                        /*!< Longest time to recover */
+    uint64_t downtime_ms;                           /*!< Cumulated time without link */
+    modem_reg_status_t registration;                /*!< Last reported registration status */
+} esp_modem_supervisor_stats_t;
+
+/**
+ * @brief Link supervisor configuration
+ *
+ */
+typedef struct {
+    esp_netif_t *netif;               /*!< PPP network interface of the modem */
+    uint32_t backoff_min_ms;          /*!< Delay before the first attempt */
+    uint32_t backoff_max_ms;          /*!< Upper bound of the delay between attempts */
+    uint32_t attempts_per_level;      /*!< Failed attempts before escalating to the next action */
+    uint32_t last_level_attempts;     /*!< Failed attempts of the last action before giving up, 0 to never give up */
+    uint32_t registration_timeout_ms; /*!< Time allowed to register, also grace time after a registration loss */
+    uint32_t ppp_timeout_ms;          /*!< Time allowed from dial to IP address */
+    uint32_t task_stack_size;         /*!< Stack size of the supervisor task */
+    uint32_t task_priority;           /*!< Priority of the supervisor task */
+} esp_modem_supervisor_config_t;
+
+/**
+ * @brief Link supervisor default configuration
+ *
+ */
+#define ESP_MODEM_SUPERVISOR_DEFAULT_CONFIG(esp_netif) \
+    {                                                  \
+        .netif = esp_netif,                            \
+        .backoff_min_ms = 1000,                        \
+        .backoff_max_ms = 120000,                      \
+        .attempts_per_level = 2,                       \
+        .last_level_attempts = 4,                      \
+        .registration_timeout_ms = 60000,              \
+        .ppp_timeout_ms = 30000,                       \
+        .task_stack_size = 4096,                       \
+        .task_priority = 5                             \
+    }
+
+typedef struct esp_modem_supervisor *esp_modem_supervisor_handle_t;
+
+/**
+ * @brief Start supervising the link of a modem
+ *
+ * Registration is tracked by +CREG/+CEREG unsolicited result codes, which are enabled here, so the
+ * DCE must be in command mode. The link is recovered when the carrier or the IP address is lost, when
+ * the netif keepalive finds it stalled, or when the module stays unregistered, with jittered exponential
+ * backoff between attempts. Actions escalate from redial to radio off/on, hardware reset and power
+ * cycle, skipping those the DCE does not support. Once the last action failed last_level_attempts times,
+ * the supervisor gives up and posts ESP_MODEM_EVENT_RECOVERY_FAILED: it then ignores link and registration
+ * losses until the application reports one with esp_modem_supervisor_notify_link_down().
+ * ESP_MODEM_EVENT_LINK_DOWN and ESP_MODEM_EVENT_LINK_RECOVERED are posted to the modem event loop.
+ *
+ * @param dte Modem DTE object
+ * @param config supervisor configuration
+ * @return esp_modem_supervisor_handle_t supervisor handle, NULL on error
+ */
+esp_modem_supervisor_handle_t esp_modem_supervisor_start(modem_dte_t *dte, const esp_modem_supervisor_config_t *config);
+
+/**
+ * @brief Stop supervising, to be called before stopping PPP on purpose
+ *
+ * @note Waits for a recovery in progress to end its current step
+ *
+ * @param supervisor supervisor handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_supervisor_stop(esp_modem_supervisor_handle_t supervisor);
+
+/**
+ * @brief Report a link loss detected elsewhere, e.g. by the application
+ *
+ * Also starts recovering again after the supervisor gave up.
+ *
+ * @param supervisor supervisor handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_supervisor_notify_link_down(esp_modem_supervisor_handle_t supervisor);
+
+/**
+ * @brief Get statistics of the supervisor
+ *
+ * @param supervisor supervisor handle
+ * @param stats statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ */
+esp_err_t esp_modem_supervisor_get_stats(esp_modem_supervisor_handle_t supervisor, esp_modem_supervisor_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
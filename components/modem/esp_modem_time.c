@@ -0,0 +1,219 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_time.h"
+
+/**
+ * @brief Dates the clock of a module can hold, earlier and later ones being its reset value
+ *
+ */
+#define ESP_MODEM_TIME_MIN_YEAR (2024)
+#define ESP_MODEM_TIME_MAX_YEAR (2069)
+
+/**
+ * @brief Age after which the source no longer vouches for the system clock, which drifts in deep sleep
+ *
+ */
+#define ESP_MODEM_TIME_MAX_AGE_S (24 * 3600)
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *TIME_TAG = "esp-modem-time";
+#define TIME_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(a))                                                                      \
+        {                                                                              \
+            ESP_LOGE(TIME_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                             \
+        }                                                                              \
+    } while (0)
+
+static portMUX_TYPE s_time_lock = portMUX_INITIALIZER_UNLOCKED;
+/* The system clock runs on through deep sleep, so does its source */
+static RTC_DATA_ATTR esp_modem_time_quality_t s_quality = ESP_MODEM_TIME_NONE; /*!< Source of the system clock */
+static RTC_DATA_ATTR int64_t s_set_s = 0; /*!< System clock when last set by the source, unit: s since 1970-01-01 */
+static bool s_network_time = false; /*!< Network time seen since tracking started */
+
+static const char *const s_quality_names[] = { "none", "module", "network", "sntp" };
+
+/**
+ * @brief Source of the system clock, none once set too long ago or before the clock went back, under lock
+ *
+ * @param now_s system clock, read before taking the lock
+ */
+static esp_modem_time_quality_t esp_modem_time_quality(int64_t now_s)
+{
+    if (now_s < s_set_s || now_s - s_set_s > ESP_MODEM_TIME_MAX_AGE_S) {
+        s_quality = ESP_MODEM_TIME_NONE;
+    }
+    return s_quality;
+}
+
+/**
+ * @brief Time from a civil date and time of day, in a zone given in quarters of an hour
+ */
+static bool esp_modem_time_from_civil(int year, int month, int day, int hour, int minute, int second,
+                                      int zone_quarters, int64_t *utc_ms)
+{
+    if (year < 100) {
+        year += 2000;
+    }
+    if (year < ESP_MODEM_TIME_MIN_YEAR || year > ESP_MODEM_TIME_MAX_YEAR || month < 1 || month > 12 || day < 1 ||
+        day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+    /* Days from 1970-01-01 */
+    year -= month <= 2;
+    int era = year / 400;
+    int year_of_era = year - era * 400;
+    int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    int64_t days = (int64_t)era * 146097 + day_of_era - 719468;
+    *utc_ms = ((days * 24 + hour) * 3600 + minute * 60 + second - zone_quarters * 900) * 1000LL;
+    return true;
+}
+
+/**
+ * @brief Network time, "*PSUTTZ: <year>,<month>,<day>,<hour>,<min>,<sec>,"<zone>",<dst>" in UTC,
+ * "+CTZE: "<zone>",<dst>,"<yyyy/MM/dd,hh:mm:ss>"" in local time, or "+CTZV: <zone>" alone
+ */
+static void esp_modem_time_handle_nitz_urc(modem_dce_t *dce, const char *line, void *context)
+{
+    int year, month, day, hour, minute, second, zone, dst;
+    int64_t utc_ms;
+    portENTER_CRITICAL(&s_time_lock);
+    s_network_time = true;
+    portEXIT_CRITICAL(&s_time_lock);
+    if (sscanf(line, "*PSUTTZ: %d,%d,%d,%d,%d,%d", &year, &month, &day, &hour, &minute, &second) == 6 &&
+        esp_modem_time_from_civil(year, month, day, hour, minute, second, 0, &utc_ms)) {
+        esp_modem_time_set(utc_ms, ESP_MODEM_TIME_NETWORK);
+    } else if (sscanf(line, "+CTZE: \"%d\",%d,\"%d/%d/%d,%d:%d:%d\"", &zone, &dst, &year, &month, &day, &hour,
+                      &minute, &second) == 8 &&
+               esp_modem_time_from_civil(year, month, day, hour, minute, second, zone, &utc_ms)) {
+        esp_modem_time_set(utc_ms, ESP_MODEM_TIME_NETWORK);
+    }
+}
+
+/**
+ * @brief Handle response from AT+CCLK?, "+CCLK: "yy/MM/dd,hh:mm:ss±zz"" in local time, 0 if not set
+ */
+static esp_err_t esp_modem_time_handle_cclk(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    int64_t *utc_ms = dce->handle_line_ctx;
+    int year, month, day, hour, minute, second, zone;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CCLK:", strlen("+CCLK:"))) {
+        if (sscanf(line, "+CCLK: \"%d/%d/%d,%d:%d:%d%d", &year, &month, &day, &hour, &minute, &second, &zone) != 7 ||
+            !esp_modem_time_from_civil(year, month, day, hour, minute, second, zone, utc_ms)) {
+            *utc_ms = 0;
+        }
+        err = ESP_OK;
+    }
+    return err;
+}
+
+esp_err_t esp_modem_time_track(modem_dce_t *dce)
+{
+    portENTER_CRITICAL(&s_time_lock);
+    s_network_time = false;
+    portEXIT_CRITICAL(&s_time_lock);
+    /* +CTZV: and +CTZE: */
+    TIME_CHECK(esp_modem_register_urc_handler(dce->dte, "+CTZ", esp_modem_time_handle_nitz_urc, dce) == ESP_OK &&
+               esp_modem_register_urc_handler(dce->dte, "*PSUTTZ:", esp_modem_time_handle_nitz_urc, dce) == ESP_OK,
+               "register network time handler failed", err);
+    return ESP_OK;
+err:
+    esp_modem_time_untrack(dce);
+    return ESP_ERR_NO_MEM;
+}
+
+void esp_modem_time_untrack(modem_dce_t *dce)
+{
+    esp_modem_unregister_urc_handler(dce->dte, esp_modem_time_handle_nitz_urc, dce);
+}
+
+esp_err_t esp_modem_time_sync(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    int64_t utc_ms = 0;
+    TIME_CHECK(dte->send_cmd(dte, "AT+CCLK?\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                             esp_modem_time_handle_cclk, &utc_ms) == ESP_OK,
+               "get clock failed", err);
+    if (!utc_ms) {
+        ESP_LOGW(TIME_TAG, "clock of the module not set");
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&s_time_lock);
+    esp_modem_time_quality_t quality = s_network_time ? ESP_MODEM_TIME_NETWORK : ESP_MODEM_TIME_MODULE;
+    portEXIT_CRITICAL(&s_time_lock);
+    return esp_modem_time_set(utc_ms, quality);
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_time_set(int64_t utc_ms, esp_modem_time_quality_t quality)
+{
+    struct timeval tv = {
+        .tv_sec = utc_ms / 1000,
+        .tv_usec = (utc_ms % 1000) * 1000
+    };
+    int64_t now_s = time(NULL);
+    portENTER_CRITICAL(&s_time_lock);
+    bool better = quality >= esp_modem_time_quality(now_s);
+    if (better) {
+        s_quality = quality;
+        s_set_s = tv.tv_sec;
+    }
+    portEXIT_CRITICAL(&s_time_lock);
+    if (!better) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    TIME_CHECK(settimeofday(&tv, NULL) == 0, "set system clock failed", err);
+    ESP_LOGI(TIME_TAG, "system clock set from %s time: %lld", s_quality_names[quality], (long long)tv.tv_sec);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_modem_time_quality_t esp_modem_time_get_quality(void)
+{
+    int64_t now_s = time(NULL);
+    portENTER_CRITICAL(&s_time_lock);
+    esp_modem_time_quality_t quality = esp_modem_time_quality(now_s);
+    portEXIT_CRITICAL(&s_time_lock);
+    return quality;
+}
+
+void esp_modem_time_sntp_synced(struct timeval *tv)
+{
+    portENTER_CRITICAL(&s_time_lock);
+    s_quality = ESP_MODEM_TIME_SNTP;
+    s_set_s = tv->tv_sec;
+    portEXIT_CRITICAL(&s_time_lock);
+    ESP_LOGI(TIME_TAG, "system clock refined by sntp: %lld", (long long)tv->tv_sec);
+}
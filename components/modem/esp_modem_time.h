@@ -0,0 +1,100 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/time.h>
+#include "esp_modem_dce.h"
+
+/**
+ * @brief Source of the system clock, in increasing accuracy
+ *
+ */
+typedef enum {
+    ESP_MODEM_TIME_NONE = 0, /*!< System clock not set */
+    ESP_MODEM_TIME_MODULE,   /*!< Clock of the module, no network time seen since it powered up, accuracy unknown */
+    ESP_MODEM_TIME_NETWORK,  /*!< Network time (NITZ) of the current registration, within a few seconds */
+    ESP_MODEM_TIME_SNTP      /*!< SNTP, within tens of milliseconds */
+} esp_modem_time_quality_t;
+
+/**
+ * @brief Start tracking network time, from +CTZV, +CTZE and *PSUTTZ lines
+ *
+ * To be called by drivers on init. Network time carrying the time of day sets the system clock
+ * as it arrives, on the DTE task; a time zone report alone marks the clock of the module as set
+ * by the network, read by the next esp_modem_time_sync().
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NO_MEM if all unsolicited result code handler slots are used
+ */
+esp_err_t esp_modem_time_track(modem_dce_t *dce);
+
+/**
+ * @brief Stop tracking network time, to be called by drivers on deinit
+ *
+ * @param dce Modem DCE object
+ */
+void esp_modem_time_untrack(modem_dce_t *dce);
+
+/**
+ * @brief Set the system clock from the clock of the module (AT+CCLK?), unless a better source did
+ *
+ * Called once registered by esp_modem_attach_network(), and again at will, e.g. if network time
+ * came without the time of day. The clock of the module is ignored until it holds a plausible date.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the clock of the module is not set, or a better source set the system clock
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_time_sync(modem_dce_t *dce);
+
+/**
+ * @brief Set the system clock, unless a better source did within the last day
+ *
+ * @param utc_ms time, unit: ms since 1970-01-01 UTC
+ * @param quality source of the time
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if a better source set the system clock
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_time_set(int64_t utc_ms, esp_modem_time_quality_t quality);
+
+/**
+ * @brief Source of the system clock, for TLS and timestamps to tell how far to trust it
+ *
+ * The source is kept through deep sleep, but only vouches for the clock for a day after it set
+ * it: the clock drifts while asleep, and any source may set it again past that.
+ *
+ * @return esp_modem_time_quality_t source of the system clock
+ */
+esp_modem_time_quality_t esp_modem_time_get_quality(void);
+
+/**
+ * @brief Record an SNTP update of the system clock, to be set with sntp_set_time_sync_notification_cb()
+ *
+ * @param tv time set by SNTP
+ */
+void esp_modem_time_sntp_synced(struct timeval *tv);
+
+#ifdef __cplusplus
+}
+#endif
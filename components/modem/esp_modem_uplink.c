@@ -0,0 +1,365 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_uplink.h"
+
+#define ESP_MODEM_UPLINK_MAX_WAIT_MS (60000) /*!< Longest sleep of the scheduler task, release times are checked again after */
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *UPLINK_TAG = "esp-modem-uplink";
+#define UPLINK_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                   \
+    {                                                                                    \
+        if (!(a))                                                                        \
+        {                                                                                \
+            ESP_LOGE(UPLINK_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                               \
+        }                                                                                \
+    } while (0)
+
+/**
+ * @brief Payload held by the scheduler
+ *
+ */
+typedef struct {
+    void *data;        /*!< Copy of the payload */
+    size_t len;        /*!< Length of the payload */
+    int64_t submitted; /*!< Submission time, unit: us since boot */
+} esp_modem_uplink_entry_t;
+
+/**
+ * @brief Uplink scheduler
+ *
+ */
+struct esp_modem_uplink {
+    modem_dte_t *dte;                   /*!< Modem the payloads go through */
+    esp_modem_uplink_config_t config;   /*!< Configuration */
+    esp_modem_uplink_send_t send;       /*!< Send callback */
+    void *context;                      /*!< Context of the send callback */
+    TaskHandle_t task;                  /*!< Scheduler task */
+    SemaphoreHandle_t exit_sem;         /*!< Given by the scheduler task on exit */
+    volatile bool stop;                 /*!< Request the scheduler task to exit */
+    portMUX_TYPE lock;                  /*!< Protects the fields below */
+    esp_modem_uplink_entry_t *queue;    /*!< Ring of held payloads, max_queued entries */
+    uint32_t head;                      /*!< Oldest payload */
+    uint32_t count;                     /*!< Payloads held */
+    size_t queued_bytes;                /*!< Bytes held */
+    bool release;                       /*!< Urgent payload submitted, or flush requested */
+    bool end_of_burst;                  /*!< Last payload of a burst submitted, early release after the batch */
+    bool module_awake;                  /*!< Module left PSM since last checked */
+    int64_t connected_until;            /*!< End of the connected window of the last activity, unit: us since boot */
+    int64_t last_activity;              /*!< Last batch or wake up of the module, 0 if none yet, unit: us since boot */
+    esp_modem_uplink_stats_t stats;     /*!< Statistics */
+};
+
+/**
+ * @brief Wake up of the module for its periodic TAU or a connection, the radio is up for a while,
+ * until the module reports the connection released
+ */
+static void esp_modem_uplink_on_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    struct esp_modem_uplink *uplink = arg;
+    const modem_power_save_t *power_save = event_data;
+    if ((event_id == ESP_MODEM_EVENT_SLEEP_CHANGED && power_save->sleep_state == MODEM_SLEEP_AWAKE) ||
+            (event_id == ESP_MODEM_EVENT_CONNECTION_CHANGED && power_save->connected)) {
+        portENTER_CRITICAL(&uplink->lock);
+        uplink->module_awake = true;
+        portEXIT_CRITICAL(&uplink->lock);
+        xTaskNotifyGive(uplink->task);
+    } else if (event_id == ESP_MODEM_EVENT_CONNECTION_CHANGED) {
+        /* Payloads submitted from now on would connect again, they are held */
+        int64_t now = esp_timer_get_time();
+        portENTER_CRITICAL(&uplink->lock);
+        if (uplink->connected_until > now) {
+            uplink->connected_until = now;
+        }
+        portEXIT_CRITICAL(&uplink->lock);
+    }
+}
+
+/**
+ * @brief Release time of the held payloads
+ *
+ * The deadline of the oldest payload, moved earlier to a whole number of eDRX cycles after the
+ * last activity, when the module pages at a fixed phase of it.
+ */
+static int64_t esp_modem_uplink_release_time(struct esp_modem_uplink *uplink, int64_t oldest, int64_t last_activity)
+{
+    int64_t deadline = oldest + (int64_t)uplink->config.max_delay_ms * 1000;
+    modem_dce_t *dce = uplink->dte->dce;
+    modem_power_save_t power_save;
+    if (!dce || !last_activity) {
+        return deadline;
+    }
+    esp_modem_dce_read_power_save(dce, &power_save);
+    if (power_save.sleep_state == MODEM_SLEEP_AWAKE && power_save.edrx && power_save.edrx_cycle_ms) {
+        int64_t cycle = (int64_t)power_save.edrx_cycle_ms * 1000;
+        int64_t aligned = last_activity + (deadline - last_activity) / cycle * cycle;
+        if (aligned > oldest) {
+            deadline = aligned;
+        }
+    }
+    return deadline;
+}
+
+/**
+ * @brief Connected window after an activity, the active time (T3324) granted with PSM, or the
+ * configured one
+ */
+static int64_t esp_modem_uplink_window(struct esp_modem_uplink *uplink)
+{
+    modem_dce_t *dce = uplink->dte->dce;
+    modem_power_save_t power_save;
+    if (dce) {
+        esp_modem_dce_read_power_save(dce, &power_save);
+        if (power_save.psm && power_save.active_time_s) {
+            return (int64_t)power_save.active_time_s * 1000000;
+        }
+    }
+    return (int64_t)uplink->config.connected_window_ms * 1000;
+}
+
+/**
+ * @brief Send the payloads held, and those submitted meanwhile
+ *
+ * @param uplink scheduler
+ * @param wakeup the batch wakes the radio up
+ * @param end_of_burst the connection is released early after the batch
+ */
+static void esp_modem_uplink_send_batch(struct esp_modem_uplink *uplink, bool wakeup, bool end_of_burst)
+{
+    uint32_t sent = 0;
+    uint32_t failed = 0;
+    uint64_t bytes = 0;
+    while (true) {
+        portENTER_CRITICAL(&uplink->lock);
+        if (!uplink->count) {
+            portEXIT_CRITICAL(&uplink->lock);
+            break;
+        }
+        esp_modem_uplink_entry_t entry = uplink->queue[uplink->head];
+        uplink->head = (uplink->head + 1) % uplink->config.max_queued;
+        uplink->count--;
+        uplink->queued_bytes -= entry.len;
+        portEXIT_CRITICAL(&uplink->lock);
+        if (uplink->send(entry.data, entry.len, uplink->context) == ESP_OK) {
+            sent++;
+            bytes += entry.len;
+        } else {
+            failed++;
+        }
+        free(entry.data);
+    }
+    /* Held payloads would keep the connection, the release is only asked with none left */
+    bool released = end_of_burst && esp_modem_release_connection(uplink->dte) == ESP_OK;
+    int64_t window = esp_modem_uplink_window(uplink);
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&uplink->lock);
+    uplink->stats.batches++;
+    uplink->stats.wakeups += wakeup ? 1 : 0;
+    uplink->stats.payloads += sent;
+    uplink->stats.bytes += bytes;
+    uplink->stats.failures += failed;
+    uplink->stats.releases += released ? 1 : 0;
+    /* A release may be reported before the request returns, the window is closed either way */
+    uplink->connected_until = released ? now : now + window;
+    uplink->last_activity = now;
+    portEXIT_CRITICAL(&uplink->lock);
+    ESP_LOGD(UPLINK_TAG, "batch of %d payloads, %d bytes, %s%s", sent, (int)bytes, wakeup ? "wake up" : "radio up",
+             released ? ", release requested" : "");
+}
+
+static void esp_modem_uplink_task(void *param)
+{
+    struct esp_modem_uplink *uplink = param;
+    while (!uplink->stop) {
+        int64_t now = esp_timer_get_time();
+        uint32_t wait_ms = 0;
+        bool wakeup = true;
+        int64_t window = esp_modem_uplink_window(uplink);
+        portENTER_CRITICAL(&uplink->lock);
+        if (uplink->module_awake) {
+            uplink->module_awake = false;
+            uplink->connected_until = now + window;
+            uplink->last_activity = now;
+        }
+        bool release = uplink->release;
+        bool end_of_burst = uplink->end_of_burst;
+        uplink->release = false;
+        uint32_t count = uplink->count;
+        size_t queued_bytes = uplink->queued_bytes;
+        int64_t oldest = count ? uplink->queue[uplink->head].submitted : 0;
+        int64_t connected_until = uplink->connected_until;
+        int64_t last_activity = uplink->last_activity;
+        portEXIT_CRITICAL(&uplink->lock);
+        if (count) {
+            if (now < connected_until) {
+                /* The radio is still connected, no extra wake up */
+                release = true;
+                wakeup = false;
+            } else if (count >= uplink->config.max_queued || queued_bytes >= uplink->config.max_queued_bytes) {
+                release = true;
+            } else if (!release) {
+                int64_t at = esp_modem_uplink_release_time(uplink, oldest, last_activity);
+                release = at <= now;
+                wait_ms = (at - now + 999) / 1000;
+            }
+        }
+        if (release && count) {
+            if (end_of_burst) {
+                portENTER_CRITICAL(&uplink->lock);
+                uplink->end_of_burst = false;
+                portEXIT_CRITICAL(&uplink->lock);
+            }
+            esp_modem_uplink_send_batch(uplink, wakeup, end_of_burst);
+            continue;
+        }
+        TickType_t ticks = portMAX_DELAY;
+        if (count) {
+            ticks = pdMS_TO_TICKS(wait_ms < ESP_MODEM_UPLINK_MAX_WAIT_MS ? wait_ms : ESP_MODEM_UPLINK_MAX_WAIT_MS);
+        }
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+    portENTER_CRITICAL(&uplink->lock);
+    uint32_t count = uplink->count;
+    bool end_of_burst = uplink->end_of_burst;
+    portEXIT_CRITICAL(&uplink->lock);
+    if (count) {
+        esp_modem_uplink_send_batch(uplink, true, end_of_burst);
+    }
+    xSemaphoreGive(uplink->exit_sem);
+    vTaskDelete(NULL);
+}
+
+esp_modem_uplink_handle_t esp_modem_uplink_start(modem_dte_t *dte, const esp_modem_uplink_config_t *config,
+                                                 esp_modem_uplink_send_t send, void *context)
+{
+    UPLINK_CHECK(dte && config && send && config->max_queued, "invalid argument", err);
+    struct esp_modem_uplink *uplink = calloc(1, sizeof(struct esp_modem_uplink));
+    UPLINK_CHECK(uplink, "calloc uplink failed", err);
+    uplink->dte = dte;
+    uplink->config = *config;
+    uplink->send = send;
+    uplink->context = context;
+    uplink->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    uplink->queue = calloc(config->max_queued, sizeof(esp_modem_uplink_entry_t));
+    UPLINK_CHECK(uplink->queue, "calloc queue failed", err_queue);
+    uplink->exit_sem = xSemaphoreCreateBinary();
+    UPLINK_CHECK(uplink->exit_sem, "create exit semaphore failed", err_sem);
+    BaseType_t ret = xTaskCreate(esp_modem_uplink_task, "uplink", config->task_stack_size, uplink,
+                                 config->task_priority, &uplink->task);
+    UPLINK_CHECK(ret == pdTRUE, "create uplink task failed", err_task);
+    /* Registered for any event, esp_modem_remove_event_handler() only removes those */
+    UPLINK_CHECK(esp_modem_set_event_handler(dte, esp_modem_uplink_on_event, ESP_EVENT_ANY_ID, uplink) == ESP_OK,
+                 "register event handler failed", err_event);
+    return uplink;
+err_event:
+    uplink->stop = true;
+    xTaskNotifyGive(uplink->task);
+    xSemaphoreTake(uplink->exit_sem, portMAX_DELAY);
+err_task:
+    vSemaphoreDelete(uplink->exit_sem);
+err_sem:
+    free(uplink->queue);
+err_queue:
+    free(uplink);
+err:
+    return NULL;
+}
+
+esp_err_t esp_modem_uplink_stop(esp_modem_uplink_handle_t uplink)
+{
+    UPLINK_CHECK(uplink, "invalid argument", err);
+    esp_modem_remove_event_handler(uplink->dte, esp_modem_uplink_on_event);
+    uplink->stop = true;
+    xTaskNotifyGive(uplink->task);
+    xSemaphoreTake(uplink->exit_sem, portMAX_DELAY);
+    vSemaphoreDelete(uplink->exit_sem);
+    free(uplink->queue);
+    free(uplink);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_uplink_submit(esp_modem_uplink_handle_t uplink, const void *data, size_t len, uint32_t flags)
+{
+    UPLINK_CHECK(uplink && data && len, "invalid argument", err);
+    void *copy = malloc(len);
+    UPLINK_CHECK(copy, "malloc payload failed", err_mem);
+    memcpy(copy, data, len);
+    portENTER_CRITICAL(&uplink->lock);
+    if (uplink->count >= uplink->config.max_queued) {
+        uplink->stats.dropped++;
+        portEXIT_CRITICAL(&uplink->lock);
+        free(copy);
+        ESP_LOGW(UPLINK_TAG, "queue full, payload dropped");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_modem_uplink_entry_t *entry = &uplink->queue[(uplink->head + uplink->count) % uplink->config.max_queued];
+    entry->data = copy;
+    entry->len = len;
+    entry->submitted = esp_timer_get_time();
+    uplink->count++;
+    uplink->queued_bytes += len;
+    if (flags & ESP_MODEM_UPLINK_URGENT) {
+        uplink->release = true;
+        uplink->stats.urgent++;
+    }
+    if (flags & ESP_MODEM_UPLINK_LAST) {
+        uplink->release = true;
+        uplink->end_of_burst = true;
+    }
+    portEXIT_CRITICAL(&uplink->lock);
+    xTaskNotifyGive(uplink->task);
+    return ESP_OK;
+err_mem:
+    return ESP_ERR_NO_MEM;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_uplink_flush(esp_modem_uplink_handle_t uplink)
+{
+    UPLINK_CHECK(uplink, "invalid argument", err);
+    portENTER_CRITICAL(&uplink->lock);
+    uplink->release = true;
+    portEXIT_CRITICAL(&uplink->lock);
+    xTaskNotifyGive(uplink->task);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_uplink_get_stats(esp_modem_uplink_handle_t uplink, esp_modem_uplink_stats_t *stats)
+{
+    UPLINK_CHECK(uplink && stats, "invalid argument", err);
+    portENTER_CRITICAL(&uplink->lock);
+    *stats = uplink->stats;
+    portEXIT_CRITICAL(&uplink->lock);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
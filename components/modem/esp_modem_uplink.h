@@ -0,0 +1,154 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+#include "esp_modem_dte.h"
+
+/**
+ * @brief Flags of esp_modem_uplink_submit()
+ *
+ */
+#define ESP_MODEM_UPLINK_URGENT (1 << 0) /*!< Send now, together with the payloads held so far */
+#define ESP_MODEM_UPLINK_LAST (1 << 1)   /*!< Last payload of a burst, sent now, then the connection is released early */
+
+/**
+ * @brief Send one payload, called from the scheduler task
+ *
+ * @param data payload
+ * @param len length of the payload
+ * @param context context given to esp_modem_uplink_start()
+ * @return esp_err_t
+ *      - ESP_OK if sent
+ *      - any other value to count a failure, the payload is not sent again
+ */
+typedef esp_err_t (*esp_modem_uplink_send_t)(const void *data, size_t len, void *context);
+
+/**
+ * @brief Uplink scheduler configuration
+ *
+ */
+typedef struct {
+    uint32_t max_delay_ms;        /*!< Longest a payload is held */
+    uint32_t connected_window_ms; /*!< Time the radio stays connected after a batch, e.g. the inactivity timer of the network, the granted active time (T3324) taking over with PSM */
+    size_t max_queued_bytes;      /*!< Bytes held before a batch is sent anyway */
+    uint32_t max_queued;          /*!< Payloads held before a batch is sent anyway */
+    uint32_t task_stack_size;     /*!< Stack size of the scheduler task, the send callback runs on it */
+    uint32_t task_priority;       /*!< Priority of the scheduler task */
+} esp_modem_uplink_config_t;
+
+/**
+ * @brief Uplink scheduler default configuration
+ *
+ */
+#define ESP_MODEM_UPLINK_DEFAULT_CONFIG() \
+    {                                     \
+        .max_delay_ms = 900000,           \
+        .connected_window_ms = 10000,     \
+        .max_queued_bytes = 4096,         \
+        .max_queued = 16,                 \
+        .task_stack_size = 3072,          \
+        .task_priority = 4                \
+    }
+
+/**
+ * @brief Uplink scheduler statistics
+ *
+ */
+typedef struct {
+    uint32_t batches;       /*!< Batches sent */
+    uint32_t wakeups;       /*!< Batches that woke the radio, the others went while it was up anyway */
+    uint32_t payloads;      /*!< Payloads sent */
+    uint32_t urgent;        /*!< Payloads submitted with ESP_MODEM_UPLINK_URGENT */
+    uint64_t bytes;         /*!< Bytes sent */
+    uint32_t failures;      /*!< Payloads the send callback failed */
+    uint32_t dropped;       /*!< Payloads refused because the queue was full */
+    uint32_t releases;      /*!< Early releases requested after a batch with ESP_MODEM_UPLINK_LAST */
+} esp_modem_uplink_stats_t;
+
+typedef struct esp_modem_uplink *esp_modem_uplink_handle_t;
+
+/**
+ * @brief Start holding non-urgent uplink payloads and sending them in batches
+ *
+ * A batch goes when the radio is up anyway: when the module leaves PSM for its periodic TAU
+ * (ESP_MODEM_EVENT_SLEEP_CHANGED), with an urgent payload, or within the connected window of the
+ * previous batch, the active time granted with PSM or else connected_window_ms. Otherwise the oldest payload sets the release time, max_delay_ms after its
+ * submission, moved earlier to a whole number of eDRX cycles after the last activity when eDRX
+ * is granted, so that the batch meets a paging window. Queue limits release a batch at once.
+ * A batch ending a burst (ESP_MODEM_UPLINK_LAST) is followed by esp_modem_release_connection(),
+ * the connected window then ends with the request, otherwise it ends early if the module reports a release.
+ * The send callback is to wake the module from PSM itself when its UART sleeps.
+ *
+ * @param dte Modem DTE object, its DCE gives the PSM and eDRX granted
+ * @param config scheduler configuration
+ * @param send send callback
+ * @param context context passed to send
+ * @return esp_modem_uplink_handle_t scheduler handle, NULL on error
+ */
+esp_modem_uplink_handle_t esp_modem_uplink_start(modem_dte_t *dte, const esp_modem_uplink_config_t *config,
+                                                 esp_modem_uplink_send_t send, void *context);
+
+/**
+ * @brief Stop the scheduler, payloads still held are sent first
+ *
+ * @param uplink scheduler handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_uplink_stop(esp_modem_uplink_handle_t uplink);
+
+/**
+ * @brief Submit a payload, copied
+ *
+ * @param uplink scheduler handle
+ * @param data payload
+ * @param len length of the payload
+ * @param flags ESP_MODEM_UPLINK_* flags
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ *      - ESP_ERR_NO_MEM if the queue is full or the copy could not be allocated
+ */
+esp_err_t esp_modem_uplink_submit(esp_modem_uplink_handle_t uplink, const void *data, size_t len, uint32_t flags);
+
+/**
+ * @brief Send the payloads held now
+ *
+ * @param uplink scheduler handle
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_uplink_flush(esp_modem_uplink_handle_t uplink);
+
+/**
+ * @brief Get the scheduler statistics
+ *
+ * @param uplink scheduler handle
+ * @param stats statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid argument
+ */
+esp_err_t esp_modem_uplink_get_stats(esp_modem_uplink_handle_t uplink, esp_modem_uplink_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,1646 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_identity.h"
+#include "esp_modem_time.h"
+#include "esp_modem.h"
+#include "sim7000.h"
+
+#define MODEM_RESULT_CODE_POWERDOWN "NORMAL POWER DOWN"
+
+/**
+ * @brief SIM7000 Timing, Unit: millisecond
+ *
+ */
+#define SIM7000_PWRKEY_ON_MS (1100)    /*!< PWRKEY low to power on, at least 1 s */
+#define SIM7000_RESET_PULSE_MS (300)   /*!< RESET low to reset, at least 252 ms */
+#define SIM7000_BOOT_TIMEOUT_MS (10000) /*!< Power on to AT answered, 4.5 s typical */
+#define SIM7000_BOOT_POLL_MS (200)     /*!< AT polling period while booting */
+
+/**
+ * @brief Band configuration of the factory, for AT+CBANDCFG
+ *
+ */
+#define SIM7000_BAND_CONFIG_ALL                                           \
+    "\"CAT-M\",1,2,3,4,5,8,12,13,14,18,19,20,25,26,27,28,66,85;"          \
+    "+CBANDCFG=\"NB-IOT\",1,2,3,4,5,8,12,13,18,19,20,25,26,28,66,71,85"
+
+/**
+ * @brief Specific Length Constraint
+ *
+ */
+#define SIM7000_MQTT_PAYLOAD_MAX (1024) /*!< Message of AT+SMPUB */
+#define SIM7000_HTTP_READ_MAX (2048)    /*!< Body read by one AT+SHREAD */
+#define SIM7000_HTTP_BODY_LEN (1024)    /*!< Request body, AT+SHCONF="BODYLEN" */
+#define SIM7000_HTTP_HEADER_LEN (350)   /*!< Request headers, AT+SHCONF="HEADERLEN" */
+#define SIM7000_FS_WRITE_MAX (10240)    /*!< File data written by one AT+CFSWFILE */
+
+/**
+ * @brief Assistance file of the GNSS receiver, in /customer, the file system index 3
+ *
+ */
+#define SIM7000_XTRA_FILE "xtra3grc.bin"
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *DCE_TAG = "sim7000";
+#define DCE_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                \
+    {                                                                                 \
+        if (!(a))                                                                     \
+        {                                                                             \
+            ESP_LOGE(DCE_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                            \
+        }                                                                             \
+    } while (0)
+
+/**
+ * @brief SIM7000 Modem
+ *
+ */
+typedef struct {
+    int pwrkey_pin;      /*!< PWRKEY GPIO, -1 if not wired */
+    int reset_pin;       /*!< RESET GPIO, -1 if not wired */
+    int status_pin;      /*!< STATUS GPIO, -1 if not wired */
+    modem_dce_t parent;  /*!< DCE parent class */
+} sim7000_modem_dce_t;
+
+/**
+ * @brief Handle response from AT+CSQ
+ */
+static esp_err_t sim7000_handle_csq(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CSQ", strlen("+CSQ"))) {
+        /* store value of rssi and ber */
+        uint32_t **csq = dce->handle_line_ctx;
+        /* +CSQ: <rssi>,<ber> */
+        sscanf(line, "%*s%d,%d", csq[0], csq[1]);
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CBC
+ */
+static esp_err_t sim7000_handle_cbc(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CBC", strlen("+CBC"))) {
+        /* store value of bcs, bcl, voltage */
+        uint32_t **cbc = dce->handle_line_ctx;
+        /* +CBC: <bcs>,<bcl>,<voltage> */
+        sscanf(line, "%*s%d,%d,%d", cbc[0], cbc[1], cbc[2]);
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from +++
+ */
+static esp_err_t sim7000_handle_exit_data_mode(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_NO_CARRIER)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from ATD*99***<cid>#
+ *
+ * A dial without PDP context or coverage is refused with NO CARRIER, fail at once rather than on timeout.
+ */
+static esp_err_t sim7000_handle_atd_ppp(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_CONNECT)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR) || strstr(line, MODEM_RESULT_CODE_NO_CARRIER) ||
+               strstr(line, MODEM_RESULT_CODE_NO_DIALTONE) || strstr(line, MODEM_RESULT_CODE_BUSY)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CGMM
+ */
+static esp_err_t sim7000_handle_cgmm(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else {
+        int len = snprintf(dce->name, MODEM_MAX_NAME_LENGTH, "%s", line);
+        if (len > 2) {
+            /* Strip "\r\n" */
+            strip_cr_lf_tail(dce->name, len);
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CGSN
+ */
+static esp_err_t sim7000_handle_cgsn(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else {
+        int len = snprintf(dce->imei, MODEM_IMEI_LENGTH + 1, "%s", line);
+        if (len > 2) {
+            /* Strip "\r\n" */
+            strip_cr_lf_tail(dce->imei, len);
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CIMI
+ */
+static esp_err_t sim7000_handle_cimi(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else {
+        int len = snprintf(dce->imsi, MODEM_IMSI_LENGTH + 1, "%s", line);
+        if (len > 2) {
+            /* Strip "\r\n" */
+            strip_cr_lf_tail(dce->imsi, len);
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+COPS?
+ */
+static esp_err_t sim7000_handle_cops(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+COPS", strlen("+COPS"))) {
+        /* there might be some random spaces in operator's name, we can not use sscanf to parse the result */
+        /* strtok will break the string, we need to create a copy */
+        size_t len = strlen(line);
+        char *line_copy = malloc(len + 1);
+        strcpy(line_copy, line);
+        /* +COPS: <mode>[, <format>[, <oper>[, <AcT>]]] */
+        char *str_ptr = NULL;
+        char *p[5];
+        uint8_t i = 0;
+        /* strtok will broke string by replacing delimiter with '\0' */
+        p[i] = strtok_r(line_copy, ",", &str_ptr);
+        while (p[i] && i < 4) {
+            p[++i] = strtok_r(NULL, ",", &str_ptr);
+        }
+        if (i >= 3) {
+            char oper[MODEM_MAX_OPERATOR_LENGTH];
+            int len = snprintf(oper, sizeof(oper), "%s", p[2]);
+            if (len > 2) {
+                /* Strip "\r\n" */
+                strip_cr_lf_tail(oper, len);
+                esp_modem_identity_set_operator(dce, oper);
+                err = ESP_OK;
+            }
+        }
+        free(line_copy);
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CPSI?
+ */
+static esp_err_t sim7000_handle_cpsi(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    sim7000_system_info_t *info = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CPSI", strlen("+CPSI"))) {
+        /* +CPSI: <mode>,<op>,<mcc>-<mnc>,<tac>,<cell>,<pcid>,EUTRAN-BAND<n>,<earfcn>,<dlbw>,<ulbw>,<rsrq>,<rsrp>,<rssi>,<snr>
+         * +CPSI: GSM,<op>,<mcc>-<mnc>,<lac>,<cell>,... or +CPSI: NO SERVICE,<op> */
+        memset(info, 0, sizeof(*info));
+        sscanf(line, "+CPSI: %15[^,],%*[^,],%7[^,],%x,%u", info->system_mode, info->plmn, &info->tac, &info->cell_id);
+        const char *band = strstr(line, "EUTRAN-BAND");
+        if (band) {
+            sscanf(band, "EUTRAN-BAND%d,%*d,%*d,%*d,%d,%d,%d,%d", &info->band, &info->rsrq, &info->rsrp, &info->rssi,
+                   &info->snr);
+        }
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CEREG?
+ */
+static esp_err_t sim7000_handle_cereg(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    modem_reg_status_t *status = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CEREG", strlen("+CEREG"))) {
+        /* +CEREG: <n>,<stat>[,<tac>,<ci>,<AcT>] */
+        int stat = MODEM_REG_UNKNOWN;
+        if (sscanf(line, "%*s%*d,%d", &stat) == 1) {
+            *status = stat;
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CPOWD=1
+ */
+static esp_err_t sim7000_handle_power_down(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_POWERDOWN)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    }
+    return err;
+}
+
+/**
+ * @brief Track PSM entry and exit, "+CPSMSTATUS: "ENTER PSM"" and "+CPSMSTATUS: "EXIT PSM""
+ */
+static void sim7000_handle_cpsmstatus(modem_dce_t *dce, const char *line, void *context)
+{
+    if (strstr(line, "ENTER PSM")) {
+        esp_modem_dce_set_sleep_state(dce, MODEM_SLEEP_PSM);
+    } else if (strstr(line, "EXIT PSM")) {
+        esp_modem_dce_set_sleep_state(dce, MODEM_SLEEP_AWAKE);
+    }
+}
+
+/**
+ * @brief Handle response from AT+CNACT?
+ */
+static esp_err_t sim7000_handle_cnact(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    bool *active = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CNACT", strlen("+CNACT"))) {
+        /* +CNACT: <status>,<ip_addr> */
+        int status = 0;
+        sscanf(line, "%*s%d", &status);
+        *active = status == 1;
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CNACT=1, done once the context is active
+ */
+static esp_err_t sim7000_handle_cnact_set(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, "+APP PDP: ACTIVE")) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, "+APP PDP: DEACTIVE") || strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        /* Accepted, the context comes up later */
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CAOPEN
+ */
+static esp_err_t sim7000_handle_caopen(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    int *result = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, *result ? MODEM_STATE_FAIL : MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CAOPEN", strlen("+CAOPEN"))) {
+        /* +CAOPEN: <cid>,<result> */
+        sscanf(line, "%*s%*d,%d", result);
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CARECV, the payload has been taken out of the header line
+ */
+static esp_err_t sim7000_handle_carecv(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CARECV", strlen("+CARECV"))) {
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+SHREQ, the request answered by OK and completed by
+ * "+SHREQ: "<method>",<status>,<length>"
+ */
+static esp_err_t sim7000_handle_shreq(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    modem_http_response_t *response = dce->handle_line_ctx;
+    int status = 0;
+    int length = 0;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = ESP_OK;
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (sscanf(line, "+SHREQ: \"%*[A-Z]\",%d,%d", &status, &length) == 2) {
+        response->status = status;
+        response->length = length;
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+SHREAD, OK comes first, then the body after "+SHREAD: <length>"
+ */
+static esp_err_t sim7000_handle_shread(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = ESP_OK;
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+SHREAD:", strlen("+SHREAD:"))) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CGNSCPY, "+CGNSCPY: <result>" then OK
+ */
+static esp_err_t sim7000_handle_cgnscpy(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    int *result = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, *result ? MODEM_STATE_FAIL : MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CGNSCPY:", strlen("+CGNSCPY:"))) {
+        *result = atoi(line + strlen("+CGNSCPY:"));
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+CGNSXTRA, "+CGNSXTRA: <diff_time>,<duration_time>,..." in hours,
+ * the age of the assistance data and how long it is valid
+ */
+static esp_err_t sim7000_handle_cgnsxtra(modem_dce_t *dce, const char *line)
+{
+    esp_err_t err = ESP_FAIL;
+    uint32_t *valid_min = dce->handle_line_ctx;
+    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (!strncmp(line, "+CGNSXTRA:", strlen("+CGNSXTRA:"))) {
+        char *end = NULL;
+        float age = strtof(line + strlen("+CGNSXTRA:"), &end);
+        float duration = *end == ',' ? strtof(end + 1, NULL) : 0;
+        *valid_min = duration > age ? (uint32_t)((duration - age) * 60) : 0;
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Track sockets, "+CADATAIND: <cid>", "+CASTATE: <cid>,<state>" and "+APP PDP: DEACTIVE"
+ */
+static void sim7000_handle_socket_urc(modem_dce_t *dce, const char *line, void *context)
+{
+    modem_socket_event_t event = {
+        .id = -1
+    };
+    int state = 1;
+    if (sscanf(line, "+CADATAIND: %d", &event.id) == 1) {
+        event.closed = false;
+    } else if (sscanf(line, "+CASTATE: %d,%d", &event.id, &state) == 2 && state == 0) {
+        event.closed = true;
+    } else if (strstr(line, "+APP PDP: DEACTIVE")) {
+        event.id = -1;
+        event.closed = true;
+    } else {
+        return;
+    }
+    esp_modem_post_event(dce->dte, ESP_MODEM_EVENT_SOCKET, &event, sizeof(event));
+}
+
+/**
+ * @brief Track the MQTT client, "+SMSUB: "<topic>","<message>"" and "+SMSTATE: <state>"
+ *
+ * The message comes without its length, so the payload reader cannot take it. A message longer
+ * than the line buffer, or holding a line break, is cut: it is reported as truncated, not as data.
+ */
+static void sim7000_handle_mqtt_urc(modem_dce_t *dce, const char *line, void *context)
+{
+    const char *topic = NULL;
+    const char *data = NULL;
+    size_t topic_len = 0;
+    size_t data_len = 0;
+    bool connected = true;
+    bool truncated = false;
+    int state = 1;
+    if (!strncmp(line, "+SMSUB: \"", strlen("+SMSUB: \""))) {
+        /* Topics have no quote, the first "," ends the topic whatever the message holds, and the
+         * message runs up to the quote closing the line */
+        topic = line + strlen("+SMSUB: \"");
+        const char *separator = strstr(topic, "\",\"");
+        const char *end = line + strcspn(line, "\r\n") - 1;
+        if (separator && end >= separator + 3 && *end == '"') {
+            topic_len = separator - topic;
+            data = separator + 3;
+            data_len = end - data;
+        } else {
+            ESP_LOGW(DCE_TAG, "message truncated: %s", line);
+            truncated = true;
+        }
+    } else if (sscanf(line, "+SMSTATE: %d", &state) == 1) {
+        connected = state != 0;
+    } else {
+        return;
+    }
+    modem_mqtt_event_t *event = malloc(sizeof(modem_mqtt_event_t) + topic_len + data_len);
+    DCE_CHECK(event, "malloc mqtt event failed", err);
+    event->connected = connected;
+    event->truncated = truncated;
+    event->topic_len = topic_len;
+    event->data_len = data_len;
+    memcpy(event->content, topic, topic_len);
+    memcpy(event->content + topic_len, data, data_len);
+    esp_modem_post_event(dce->dte, ESP_MODEM_EVENT_MQTT, event, sizeof(modem_mqtt_event_t) + topic_len + data_len);
+    free(event);
+err:
+    return;
+}
+
+/**
+ * @brief Get signal quality
+ *
+ * @param dce Modem DCE object
+ * @param rssi received signal strength indication
+ * @param ber bit error ratio
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_get_signal_quality(modem_dce_t *dce, uint32_t *rssi, uint32_t *ber)
+{
+    modem_dte_t *dte = dce->dte;
+    uint32_t *resource[2] = {rssi, ber};
+    DCE_CHECK(dte->send_cmd(dte, "AT+CSQ\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim7000_handle_csq, resource) == ESP_OK,
+              "inquire signal quality failed", err);
+    ESP_LOGD(DCE_TAG, "inquire signal quality ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get battery status
+ *
+ * @param dce Modem DCE object
+ * @param bcs Battery charge status
+ * @param bcl Battery connection level
+ * @param voltage Battery voltage
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_get_battery_status(modem_dce_t *dce, uint32_t *bcs, uint32_t *bcl, uint32_t *voltage)
+{
+    modem_dte_t *dte = dce->dte;
+    uint32_t *resource[3] = {bcs, bcl, voltage};
+    DCE_CHECK(dte->send_cmd(dte, "AT+CBC\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim7000_handle_cbc, resource) == ESP_OK,
+              "inquire battery status failed", err);
+    ESP_LOGD(DCE_TAG, "inquire battery status ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Set Working Mode
+ *
+ * @param dce Modem DCE object
+ * @param mode woking mode
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_set_working_mode(modem_dce_t *dce, modem_mode_t mode)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[24];
+    switch (mode) {
+    case MODEM_COMMAND_MODE:
+        /* Dropping DTR is immediate, the escape sequence needs a guard time on each side */
+        if (!dce->dtr_switch || esp_modem_dce_suspend_data_mode(dce) != ESP_OK) {
+            DCE_CHECK(dte->send_cmd(dte, "+++", MODEM_COMMAND_TIMEOUT_MODE_CHANGE,
+                                    sim7000_handle_exit_data_mode, NULL) == ESP_OK,
+                      "enter command mode failed", err);
+        }
+        ESP_LOGD(DCE_TAG, "enter command mode ok");
+        dce->mode = MODEM_COMMAND_MODE;
+        break;
+    case MODEM_PPP_MODE:
+        if (dce->data_suspended) {
+            /* The data call is still up, no need to dial and negotiate again, the DTE dials if it was lost */
+            DCE_CHECK(esp_modem_dce_resume_data_mode(dce) == ESP_OK, "data call lost", err);
+            ESP_LOGD(DCE_TAG, "resume ppp mode ok");
+            dce->data_suspended = false;
+            dce->mode = MODEM_PPP_MODE;
+            break;
+        }
+        /* The default EPS bearer is up once attached, dialing only binds PPP to it */
+        snprintf(command, sizeof(command), "ATD*99***%d#\r", dce->cid);
+        DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_MODE_CHANGE, sim7000_handle_atd_ppp, NULL) == ESP_OK,
+                  "enter ppp mode failed", err);
+        ESP_LOGD(DCE_TAG, "enter ppp mode ok");
+        dce->data_suspended = false;
+        dce->mode = MODEM_PPP_MODE;
+        break;
+    default:
+        ESP_LOGW(DCE_TAG, "unsupported working mode: %d", mode);
+        goto err;
+        break;
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Wait until the module answers AT, polled rather than waited for a fixed boot time
+ *
+ * @param sim7000_dce sim7000 object
+ * @param timeout_ms longest wait
+ * @return true if the module answered
+ */
+static bool sim7000_wait_ready(sim7000_modem_dce_t *sim7000_dce, uint32_t timeout_ms)
+{
+    int64_t deadline = esp_timer_get_time() + timeout_ms * 1000LL;
+    do {
+        /* STATUS rises a little before the UART is ready, AT is not worth sending until then */
+        if ((sim7000_dce->status_pin < 0 || gpio_get_level(sim7000_dce->status_pin)) &&
+                esp_modem_dce_sync(&sim7000_dce->parent) == ESP_OK) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(SIM7000_BOOT_POLL_MS));
+    } while (esp_timer_get_time() < deadline);
+    return false;
+}
+
+/**
+ * @brief Power Up SIM7000 module
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_power_up(modem_dce_t *dce)
+{
+    sim7000_modem_dce_t *sim7000_dce = __containerof(dce, sim7000_modem_dce_t, parent);
+    esp_modem_timeline_begin(dce->dte, ESP_MODEM_PHASE_POWER_UP);
+    bool on = sim7000_dce->status_pin >= 0 ? gpio_get_level(sim7000_dce->status_pin) > 0 :
+              esp_modem_dce_sync(dce) == ESP_OK;
+    if (!on) {
+        DCE_CHECK(sim7000_dce->pwrkey_pin >= 0, "module is off and PWRKEY is not wired", err);
+        ESP_LOGD(DCE_TAG, "module will be powered up");
+        gpio_set_level(sim7000_dce->pwrkey_pin, 0);
+        vTaskDelay(pdMS_TO_TICKS(SIM7000_PWRKEY_ON_MS));
+        gpio_set_level(sim7000_dce->pwrkey_pin, 1);
+    }
+    DCE_CHECK(sim7000_wait_ready(sim7000_dce, SIM7000_BOOT_TIMEOUT_MS), "module not answering", err);
+    ESP_LOGD(DCE_TAG, "power up ok");
+    esp_modem_timeline_end(dce->dte, ESP_MODEM_PHASE_POWER_UP);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Power down by AT+CPOWD, PWRKEY is not needed
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_power_down(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CPOWD=1\r", MODEM_COMMAND_TIMEOUT_POWEROFF,
+                            sim7000_handle_power_down, NULL) == ESP_OK,
+              "power down failed", err);
+    ESP_LOGD(DCE_TAG, "power down ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Hardware reset by the reset pin
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_reset(modem_dce_t *dce)
+{
+    sim7000_modem_dce_t *sim7000_dce = __containerof(dce, sim7000_modem_dce_t, parent);
+    ESP_LOGD(DCE_TAG, "module will be reset");
+    /* RESET is driven through a transistor, as on the SIM800 boards */
+    gpio_set_level(sim7000_dce->reset_pin, 1);
+    vTaskDelay(pdMS_TO_TICKS(SIM7000_RESET_PULSE_MS));
+    gpio_set_level(sim7000_dce->reset_pin, 0);
+    /* Settings of the module are back to the stored profile */
+    dce->mode = MODEM_COMMAND_MODE;
+    dce->dtr_switch = false;
+    dce->data_suspended = false;
+    ESP_LOGD(DCE_TAG, "reset ok");
+    return ESP_OK;
+}
+
+/**
+ * @brief Hold or release the levels of PWRKEY and RESET
+ *
+ * @param dce Modem DCE object
+ * @param hold true to hold, false to release
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_hold_pins(modem_dce_t *dce, bool hold)
+{
+    sim7000_modem_dce_t *sim7000_dce = __containerof(dce, sim7000_modem_dce_t, parent);
+    if (sim7000_dce->pwrkey_pin >= 0) {
+        DCE_CHECK((hold ? gpio_hold_en(sim7000_dce->pwrkey_pin) : gpio_hold_dis(sim7000_dce->pwrkey_pin)) == ESP_OK,
+                  "hold PWRKEY failed", err);
+    }
+    if (sim7000_dce->reset_pin >= 0) {
+        DCE_CHECK((hold ? gpio_hold_en(sim7000_dce->reset_pin) : gpio_hold_dis(sim7000_dce->reset_pin)) == ESP_OK,
+                  "hold RESET failed", err);
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get DCE module name
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_get_module_name(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CGMM\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim7000_handle_cgmm, NULL) == ESP_OK,
+              "get module name failed", err);
+    ESP_LOGD(DCE_TAG, "get module name ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get DCE module IMEI number
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_get_imei_number(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CGSN\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim7000_handle_cgsn, NULL) == ESP_OK,
+              "get imei number failed", err);
+    ESP_LOGD(DCE_TAG, "get imei number ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get DCE module IMSI number
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_get_imsi_number(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CIMI\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim7000_handle_cimi, NULL) == ESP_OK,
+              "get imsi number failed", err);
+    ESP_LOGD(DCE_TAG, "get imsi number ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get Operator's name
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_get_operator_name(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR, sim7000_handle_cops, NULL) == ESP_OK,
+              "get network operator failed", err);
+    ESP_LOGD(DCE_TAG, "get network operator ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get band configuration restricted to the serving LTE band and category
+ *
+ * @param dce Modem DCE object
+ * @param hint buffer for the band configuration
+ * @param len length of buffer
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error or when not served by LTE
+ */
+static esp_err_t sim7000_get_band_hint(modem_dce_t *dce, char *hint, size_t len)
+{
+    sim7000_system_info_t info;
+    DCE_CHECK(sim7000_get_system_info(dce, &info) == ESP_OK, "get system information failed", err);
+    DCE_CHECK(info.band > 0, "not served by LTE", err);
+    snprintf(hint, len, "\"%s\",%d", strstr(info.system_mode, "NB") ? "NB-IOT" : "CAT-M", info.band);
+    ESP_LOGD(DCE_TAG, "get band hint ok: %s", hint);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Set band configuration
+ *
+ * @param dce Modem DCE object
+ * @param config band configuration, NULL for all bands
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_set_band_config(modem_dce_t *dce, const char *config)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[160];
+    int len = snprintf(command, sizeof(command), "AT+CBANDCFG=%s\r", config ? config : SIM7000_BAND_CONFIG_ALL);
+    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set band configuration failed", err);
+    ESP_LOGD(DCE_TAG, "set band configuration ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Restrict to one radio access technology (AT+CNMP;+CMNB)
+ *
+ * @param dce Modem DCE object
+ * @param rat radio access technology, MODEM_RAT_AUTO for GSM and both LTE categories
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_set_rat(modem_dce_t *dce, modem_rat_t rat)
+{
+    switch (rat) {
+    case MODEM_RAT_GSM:
+        return sim7000_set_network_mode(dce, SIM7000_NETWORK_MODE_GSM, SIM7000_LTE_MODE_BOTH);
+    case MODEM_RAT_LTE_M:
+        return sim7000_set_network_mode(dce, SIM7000_NETWORK_MODE_LTE, SIM7000_LTE_MODE_CAT_M);
+    case MODEM_RAT_NB_IOT:
+        return sim7000_set_network_mode(dce, SIM7000_NETWORK_MODE_LTE, SIM7000_LTE_MODE_NB_IOT);
+    default:
+        return sim7000_set_network_mode(dce, SIM7000_NETWORK_MODE_AUTO, SIM7000_LTE_MODE_BOTH);
+    }
+}
+
+/**
+ * @brief Get serving radio access technology and cell (AT+CPSI?)
+ *
+ * @param dce Modem DCE object
+ * @param rat serving radio access technology
+ * @param cell_id serving cell identity
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error or without service
+ */
+static esp_err_t sim7000_get_serving_cell(modem_dce_t *dce, modem_rat_t *rat, uint32_t *cell_id)
+{
+    sim7000_system_info_t info;
+    DCE_CHECK(sim7000_get_system_info(dce, &info) == ESP_OK, "get system information failed", err);
+    if (!strcmp(info.system_mode, "GSM")) {
+        *rat = MODEM_RAT_GSM;
+    } else if (strstr(info.system_mode, "NB")) {
+        *rat = MODEM_RAT_NB_IOT;
+    } else if (strstr(info.system_mode, "CAT-M")) {
+        *rat = MODEM_RAT_LTE_M;
+    } else {
+        DCE_CHECK(false, "no service", err);
+    }
+    *cell_id = info.cell_id;
+    ESP_LOGD(DCE_TAG, "get serving cell ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Bring the IP stack of the module up or down (AT+CNACT), with socket events tracked
+ *
+ * @param dce Modem DCE object
+ * @param on true to activate the context of the APN, false to deactivate it
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_set_socket_stack(modem_dce_t *dce, bool on)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[MODEM_MAX_APN_LENGTH + 32];
+    bool active = false;
+    esp_modem_unregister_urc_handler(dte, sim7000_handle_socket_urc, dce);
+    if (!on) {
+        DCE_CHECK(dte->send_cmd(dte, "AT+CNACT=0\r", MODEM_COMMAND_TIMEOUT_SOCKET,
+                                esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+                  "deactivate ip stack failed", err);
+        ESP_LOGD(DCE_TAG, "deactivate ip stack ok");
+        return ESP_OK;
+    }
+    DCE_CHECK(esp_modem_register_urc_handler(dte, "+CADATAIND:", sim7000_handle_socket_urc, dce) == ESP_OK &&
+              esp_modem_register_urc_handler(dte, "+CASTATE:", sim7000_handle_socket_urc, dce) == ESP_OK &&
+              esp_modem_register_urc_handler(dte, "+APP PDP:", sim7000_handle_socket_urc, dce) == ESP_OK,
+              "register socket handlers failed", err_urc);
+    DCE_CHECK(dte->send_cmd(dte, "AT+CNACT?\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim7000_handle_cnact, &active) == ESP_OK,
+              "get ip stack state failed", err_urc);
+    if (!active) {
+        snprintf(command, sizeof(command), "AT+CNACT=1,\"%s\"\r", dce->apn);
+        DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET, sim7000_handle_cnact_set, NULL) == ESP_OK,
+                  "activate ip stack failed", err_urc);
+    }
+    ESP_LOGD(DCE_TAG, "activate ip stack ok");
+    return ESP_OK;
+err_urc:
+    esp_modem_unregister_urc_handler(dte, sim7000_handle_socket_urc, dce);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Connect a socket of the module (AT+CAOPEN)
+ *
+ * @param dce Modem DCE object
+ * @param id connection identifier, 0 to 12
+ * @param type TCP or UDP
+ * @param host host name or address of the peer
+ * @param port port of the peer
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_socket_open(modem_dce_t *dce, int id, modem_socket_type_t type, const char *host, uint16_t port)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[128];
+    int result = -1;
+    int len = snprintf(command, sizeof(command), "AT+CAOPEN=%d,\"%s\",\"%s\",%d\r", id,
+                       type == MODEM_SOCKET_UDP ? "UDP" : "TCP", host, port);
+    DCE_CHECK(len < sizeof(command), "host name too long: %s", err, host);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET, sim7000_handle_caopen, &result) == ESP_OK,
+              "open socket %d failed, result %d", err, id, result);
+    ESP_LOGD(DCE_TAG, "open socket %d ok", id);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Send on a socket of the module (AT+CASEND)
+ *
+ * @param dce Modem DCE object
+ * @param id connection identifier
+ * @param data data to send
+ * @param length length of data, at most MODEM_SOCKET_PAYLOAD_MAX
+ * @return int length of data sent, -1 on error
+ */
+static int sim7000_socket_send(modem_dce_t *dce, int id, const void *data, size_t length)
+{
+    char command[32];
+    snprintf(command, sizeof(command), "AT+CASEND=%d,%d\r", id, length);
+    DCE_CHECK(esp_modem_send_payload(dce->dte, command, ">", data, length, MODEM_COMMAND_TIMEOUT_SOCKET_DATA,
+                                     esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "send on socket %d failed", err, id);
+    return length;
+err:
+    return -1;
+}
+
+/**
+ * @brief Read what arrived on a socket of the module (AT+CARECV)
+ *
+ * @param dce Modem DCE object
+ * @param id connection identifier
+ * @param buffer buffer of the data
+ * @param length size of buffer, at most MODEM_SOCKET_PAYLOAD_MAX
+ * @return int length of data read, 0 if none arrived, -1 on error
+ */
+static int sim7000_socket_recv(modem_dce_t *dce, int id, void *buffer, size_t length)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[32];
+    /* +CARECV: <recvlen>,<data> */
+    esp_modem_payload_t payload = {
+        .prefix = "+CARECV:",
+        .same_line = true,
+        .buffer = buffer,
+        .size = length
+    };
+    snprintf(command, sizeof(command), "AT+CARECV=%d,%d\r", id, length);
+    DCE_CHECK(esp_modem_expect_payload(dte, &payload) == ESP_OK, "expect payload failed", err);
+    esp_err_t res = dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET_DATA, sim7000_handle_carecv, NULL);
+    esp_modem_expect_payload(dte, NULL);
+    DCE_CHECK(res == ESP_OK, "read socket %d failed", err, id);
+    return payload.received;
+err:
+    return -1;
+}
+
+/**
+ * @brief Close a socket of the module (AT+CACLOSE)
+ *
+ * @param dce Modem DCE object
+ * @param id connection identifier
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_socket_close(modem_dce_t *dce, int id)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[32];
+    snprintf(command, sizeof(command), "AT+CACLOSE=%d\r", id);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET_DATA,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "close socket %d failed", err, id);
+    ESP_LOGD(DCE_TAG, "close socket %d ok", id);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Send a formatted command, answered by OK
+ *
+ * @param dce Modem DCE object
+ * @param format format of the command
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_send_command(modem_dce_t *dce, const char *format, ...)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[192];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(command, sizeof(command), format, args);
+    va_end(args);
+    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "command failed: %s", err, command);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Connect the MQTT client of the module (AT+SMCONF, AT+SMCONN), with messages tracked
+ *
+ * @param dce Modem DCE object, with the IP stack of the module up
+ * @param config session
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_mqtt_connect(modem_dce_t *dce, const modem_mqtt_config_t *config)
+{
+    modem_dte_t *dte = dce->dte;
+    esp_modem_unregister_urc_handler(dte, sim7000_handle_mqtt_urc, dce);
+    DCE_CHECK(sim7000_send_command(dce, "AT+SMCONF=\"URL\",\"%s\",%d\r", config->host, config->port) == ESP_OK &&
+              sim7000_send_command(dce, "AT+SMCONF=\"CLIENTID\",\"%s\"\r", config->client_id) == ESP_OK &&
+              sim7000_send_command(dce, "AT+SMCONF=\"KEEPTIME\",%d\r", config->keepalive_s) == ESP_OK &&
+              sim7000_send_command(dce, "AT+SMCONF=\"CLEANSS\",%d\r", config->clean_session) == ESP_OK,
+              "configure mqtt failed", err);
+    if (config->username) {
+        DCE_CHECK(sim7000_send_command(dce, "AT+SMCONF=\"USERNAME\",\"%s\"\r", config->username) == ESP_OK &&
+                  sim7000_send_command(dce, "AT+SMCONF=\"PASSWORD\",\"%s\"\r", config->password ? config->password : "") == ESP_OK,
+                  "configure mqtt credentials failed", err);
+    }
+    DCE_CHECK(esp_modem_register_urc_handler(dte, "+SMSUB:", sim7000_handle_mqtt_urc, dce) == ESP_OK &&
+              esp_modem_register_urc_handler(dte, "+SMSTATE:", sim7000_handle_mqtt_urc, dce) == ESP_OK,
+              "register mqtt handlers failed", err_urc);
+    DCE_CHECK(dte->send_cmd(dte, "AT+SMCONN\r", MODEM_COMMAND_TIMEOUT_SOCKET,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "connect to %s:%d failed", err_urc, config->host, config->port);
+    ESP_LOGD(DCE_TAG, "connect mqtt ok");
+    return ESP_OK;
+err_urc:
+    esp_modem_unregister_urc_handler(dte, sim7000_handle_mqtt_urc, dce);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Publish with the MQTT client of the module (AT+SMPUB)
+ *
+ * @param dce Modem DCE object
+ * @param topic topic
+ * @param data message
+ * @param length length of message, at most SIM7000_MQTT_PAYLOAD_MAX
+ * @param qos quality of service, 0 to 2
+ * @param retain retained by the broker
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_mqtt_publish(modem_dce_t *dce, const char *topic, const void *data, size_t length, int qos,
+                                      bool retain)
+{
+    DCE_CHECK(length <= SIM7000_MQTT_PAYLOAD_MAX, "message too long: %d", err, length);
+    char command[160];
+    int len = snprintf(command, sizeof(command), "AT+SMPUB=\"%s\",%d,%d,%d\r", topic, length, qos, retain);
+    DCE_CHECK(len < sizeof(command), "topic too long: %s", err, topic);
+    DCE_CHECK(esp_modem_send_payload(dce->dte, command, ">", data, length, MODEM_COMMAND_TIMEOUT_SOCKET_DATA,
+                                     esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "publish to %s failed", err, topic);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Subscribe with the MQTT client of the module (AT+SMSUB)
+ *
+ * @param dce Modem DCE object
+ * @param topic topic filter
+ * @param qos quality of service, 0 to 2
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_mqtt_subscribe(modem_dce_t *dce, const char *topic, int qos)
+{
+    return sim7000_send_command(dce, "AT+SMSUB=\"%s\",%d\r", topic, qos);
+}
+
+/**
+ * @brief Unsubscribe with the MQTT client of the module (AT+SMUNSUB)
+ *
+ * @param dce Modem DCE object
+ * @param topic topic filter
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_mqtt_unsubscribe(modem_dce_t *dce, const char *topic)
+{
+    return sim7000_send_command(dce, "AT+SMUNSUB=\"%s\"\r", topic);
+}
+
+/**
+ * @brief Disconnect the MQTT client of the module (AT+SMDISC)
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_mqtt_disconnect(modem_dce_t *dce)
+{
+    esp_modem_unregister_urc_handler(dce->dte, sim7000_handle_mqtt_urc, dce);
+    return sim7000_send_command(dce, "AT+SMDISC\r");
+}
+
+/**
+ * @brief Connect the HTTP client of the module (AT+SHCONF, AT+SHCONN)
+ *
+ * @param dce Modem DCE object, with the IP stack of the module up
+ * @param server "http://host[:port]"
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_http_open(modem_dce_t *dce, const char *server)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(sim7000_send_command(dce, "AT+SHCONF=\"URL\",\"%s\"\r", server) == ESP_OK &&
+              sim7000_send_command(dce, "AT+SHCONF=\"BODYLEN\",%d\r", SIM7000_HTTP_BODY_LEN) == ESP_OK &&
+              sim7000_send_command(dce, "AT+SHCONF=\"HEADERLEN\",%d\r", SIM7000_HTTP_HEADER_LEN) == ESP_OK,
+              "configure http failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT+SHCONN\r", MODEM_COMMAND_TIMEOUT_SOCKET,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "connect to %s failed", err, server);
+    ESP_LOGD(DCE_TAG, "connect http ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief GET a range of a resource with the HTTP client of the module (AT+SHAHEAD, AT+SHREQ)
+ *
+ * @param dce Modem DCE object
+ * @param path path of the resource on the server
+ * @param offset first byte
+ * @param length bytes requested, 0 for the rest
+ * @param response status and length of the body, held by the module
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_http_get(modem_dce_t *dce, const char *path, size_t offset, size_t length,
+                                  modem_http_response_t *response)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[192];
+    DCE_CHECK(sim7000_send_command(dce, "AT+SHCHEAD\r") == ESP_OK, "clear headers failed", err);
+    if (length) {
+        DCE_CHECK(sim7000_send_command(dce, "AT+SHAHEAD=\"Range\",\"bytes=%u-%u\"\r", offset,
+                                       offset + length - 1) == ESP_OK, "add range failed", err);
+    } else if (offset) {
+        DCE_CHECK(sim7000_send_command(dce, "AT+SHAHEAD=\"Range\",\"bytes=%u-\"\r", offset) == ESP_OK,
+                  "add range failed", err);
+    }
+    int len = snprintf(command, sizeof(command), "AT+SHREQ=\"%s\",1\r", path);
+    DCE_CHECK(len < sizeof(command), "path too long: %s", err, path);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET, sim7000_handle_shreq, response) == ESP_OK,
+              "get %s failed", err, path);
+    ESP_LOGD(DCE_TAG, "get %s: %d, %d bytes", path, response->status, response->length);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Read the body held by the HTTP client of the module (AT+SHREAD)
+ *
+ * @param dce Modem DCE object
+ * @param offset offset in the body
+ * @param buffer buffer of the data
+ * @param length bytes to read, at most SIM7000_HTTP_READ_MAX
+ * @return int bytes read, -1 on error
+ */
+static int sim7000_http_read(modem_dce_t *dce, size_t offset, void *buffer, size_t length)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[48];
+    esp_modem_payload_t payload = {
+        .prefix = "+SHREAD:",
+        .same_line = false,
+        .buffer = buffer,
+        .size = length
+    };
+    DCE_CHECK(length && length <= SIM7000_HTTP_READ_MAX, "invalid length: %d", err, length);
+    snprintf(command, sizeof(command), "AT+SHREAD=%u,%u\r", offset, length);
+    DCE_CHECK(esp_modem_expect_payload(dte, &payload) == ESP_OK, "expect payload failed", err);
+    esp_err_t res = dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SOCKET_DATA, sim7000_handle_shread, NULL);
+    esp_modem_expect_payload(dte, NULL);
+    DCE_CHECK(res == ESP_OK, "read body at %d failed", err, offset);
+    return payload.received;
+err:
+    return -1;
+}
+
+/**
+ * @brief Disconnect the HTTP client of the module (AT+SHDISC)
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_http_close(modem_dce_t *dce)
+{
+    return sim7000_send_command(dce, "AT+SHDISC\r");
+}
+
+/**
+ * @brief Power the GNSS receiver and select its output (AT+CGNSPWR, AT+CGNSURC, AT+CGNSTST)
+ *
+ * @param dce Modem DCE object
+ * @param output navigation information with +UGNSINF, NMEA sentences, or off
+ * @param report_every fixes per +UGNSINF, 1 to 255
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_set_gnss(modem_dce_t *dce, modem_gnss_output_t output, uint32_t report_every)
+{
+    DCE_CHECK(output != MODEM_GNSS_NAV_INFO || (report_every && report_every <= 255), "invalid report period: %d", err,
+              report_every);
+    if (output != MODEM_GNSS_OFF) {
+        DCE_CHECK(sim7000_send_command(dce, "AT+CGNSPWR=1\r") == ESP_OK, "power on gnss failed", err);
+    }
+    DCE_CHECK(sim7000_send_command(dce, "AT+CGNSURC=%d\r", output == MODEM_GNSS_NAV_INFO ? report_every : 0) == ESP_OK &&
+              sim7000_send_command(dce, "AT+CGNSTST=%d\r", output == MODEM_GNSS_NMEA) == ESP_OK,
+              "select gnss output failed", err);
+    if (output == MODEM_GNSS_OFF) {
+        DCE_CHECK(sim7000_send_command(dce, "AT+CGNSPWR=0\r") == ESP_OK, "power off gnss failed", err);
+    }
+    ESP_LOGD(DCE_TAG, "set gnss output %d ok", output);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Write a chunk of the assistance file to the file system of the module (AT+CFSWFILE)
+ *
+ * @param dce Modem DCE object
+ * @param offset offset of data in the file, 0 to overwrite it, the end of the file otherwise
+ * @param data chunk
+ * @param length length of the chunk, at most SIM7000_FS_WRITE_MAX
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_gnss_assist_write(modem_dce_t *dce, size_t offset, const void *data, size_t length)
+{
+    char command[64];
+    DCE_CHECK(length && length <= SIM7000_FS_WRITE_MAX, "invalid length: %d", err, length);
+    DCE_CHECK(sim7000_send_command(dce, "AT+CFSINIT\r") == ESP_OK, "init file system failed", err);
+    snprintf(command, sizeof(command), "AT+CFSWFILE=3,\"%s\",%d,%d,%d\r", SIM7000_XTRA_FILE, offset ? 1 : 0, length,
+             MODEM_COMMAND_TIMEOUT_SOCKET_DATA);
+    DCE_CHECK(esp_modem_send_payload(dce->dte, command, "DOWNLOAD", data, length, MODEM_COMMAND_TIMEOUT_SOCKET_DATA,
+                                     esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "write file at %d failed", err_term, offset);
+    DCE_CHECK(sim7000_send_command(dce, "AT+CFSTERM\r") == ESP_OK, "free file system failed", err);
+    return ESP_OK;
+err_term:
+    sim7000_send_command(dce, "AT+CFSTERM\r");
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Load the assistance file into the receiver and enable it (AT+CGNSCPY, AT+CGNSXTRA=1)
+ *
+ * @param dce Modem DCE object, with the receiver powered off
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_gnss_assist_load(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    int result = -1;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CGNSCPY\r", MODEM_COMMAND_TIMEOUT_SOCKET_DATA,
+                            sim7000_handle_cgnscpy, &result) == ESP_OK,
+              "copy assistance file failed: %d", err, result);
+    DCE_CHECK(sim7000_send_command(dce, "AT+CGNSXTRA=1\r") == ESP_OK, "enable assistance failed", err);
+    ESP_LOGD(DCE_TAG, "load gnss assistance ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get the validity left of the assistance data (AT+CGNSXTRA)
+ *
+ * @param dce Modem DCE object
+ * @param valid_min validity left, unit: minute, 0 if none or expired
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_get_gnss_assist(modem_dce_t *dce, uint32_t *valid_min)
+{
+    modem_dte_t *dte = dce->dte;
+    *valid_min = 0;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CGNSXTRA\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            sim7000_handle_cgnsxtra, valid_min) == ESP_OK,
+              "get assistance validity failed", err);
+    ESP_LOGD(DCE_TAG, "gnss assistance valid for %d min", *valid_min);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Open SIM7000 object
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on fail
+ */
+static esp_err_t sim7000_open(modem_dce_t *dce)
+{
+    sim7000_modem_dce_t *sim7000_dce = __containerof(dce, sim7000_modem_dce_t, parent);
+    esp_modem_timeline_begin(dce->dte, ESP_MODEM_PHASE_OPEN);
+    if (!sim7000_wait_ready(sim7000_dce, SIM7000_BOOT_TIMEOUT_MS)) {
+        DCE_CHECK(sim7000_dce->reset_pin >= 0, "module is not reachable, and can not be reset", err);
+        ESP_LOGI(DCE_TAG, "module is not reachable, reset");
+        sim7000_reset(dce);
+        /* Drop what the module sent while rebooting */
+        dce->dte->reset(dce->dte);
+        DCE_CHECK(sim7000_wait_ready(sim7000_dce, SIM7000_BOOT_TIMEOUT_MS), "module not answering after reset", err);
+    }
+    /* Close echo */
+    DCE_CHECK(esp_modem_dce_echo(dce, false) == ESP_OK, "close echo mode failed", err);
+    /* Network time updates the clock of the module and is reported, as soon as registered */
+    if (sim7000_send_command(dce, "AT+CLTS=1\r") != ESP_OK) {
+        ESP_LOGW(DCE_TAG, "network time not reported");
+    }
+    /* Identity comes from the cache on warm boot, otherwise it is queried on first access */
+    esp_modem_identity_restore(dce);
+    esp_modem_timeline_end(dce->dte, ESP_MODEM_PHASE_OPEN);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Request PSM timers, with PSM entry and exit reported (AT+CPSMSTATUS=1)
+ *
+ * @param dce Modem DCE object
+ * @param on true to request PSM, false to leave it
+ * @param periodic_tau_s periodic tracking area update, unit: s
+ * @param active_time_s time the module stays reachable once idle, unit: s
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim7000_set_psm(modem_dce_t *dce, bool on, uint32_t periodic_tau_s, uint32_t active_time_s)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(esp_modem_dce_set_psm(dce, on, periodic_tau_s, active_time_s) == ESP_OK, "set psm failed", err);
+    DCE_CHECK(dte->send_cmd(dte, on ? "AT+CPSMSTATUS=1\r" : "AT+CPSMSTATUS=0\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set psm status report failed", err);
+    ESP_LOGD(DCE_TAG, "set psm ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Deinitialize SIM7000 object
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on fail
+ */
+static esp_err_t sim7000_deinit(modem_dce_t *dce)
+{
+    sim7000_modem_dce_t *sim7000_dce = __containerof(dce, sim7000_modem_dce_t, parent);
+    if (dce->dte) {
+        esp_modem_unregister_urc_handler(dce->dte, sim7000_handle_cpsmstatus, dce);
+        esp_modem_unregister_urc_handler(dce->dte, sim7000_handle_socket_urc, dce);
+        esp_modem_unregister_urc_handler(dce->dte, sim7000_handle_mqtt_urc, dce);
+        esp_modem_time_untrack(dce);
+        esp_modem_dce_untrack_power_save(dce);
+        dce->dte->dce = NULL;
+    }
+    free(sim7000_dce);
+    return ESP_OK;
+}
+
+esp_err_t sim7000_set_network_mode(modem_dce_t *dce, sim7000_network_mode_t mode, sim7000_lte_mode_t lte_mode)
+{
+    modem_dte_t *dte = dce->dte;
+    char command[32];
+    snprintf(command, sizeof(command), "AT+CNMP=%d;+CMNB=%d\r", mode, lte_mode);
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT,
+                            esp_modem_dce_handle_response_default, NULL) == ESP_OK,
+              "set network mode failed", err);
+    ESP_LOGD(DCE_TAG, "set network mode ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t sim7000_get_system_info(modem_dce_t *dce, sim7000_system_info_t *info)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CPSI?\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim7000_handle_cpsi, info) == ESP_OK,
+              "get system information failed", err);
+    ESP_LOGD(DCE_TAG, "get system information ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t sim7000_get_eps_registration(modem_dce_t *dce, modem_reg_status_t *status)
+{
+    modem_dte_t *dte = dce->dte;
+    *status = MODEM_REG_UNKNOWN;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CEREG?\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim7000_handle_cereg, status) == ESP_OK,
+              "get eps registration failed", err);
+    ESP_LOGD(DCE_TAG, "get eps registration ok");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+modem_dce_t *sim7000_init(modem_dte_t *dte, const esp_modem_dce_config_t *config)
+{
+    DCE_CHECK(dte, "DCE should bind with a DTE", err);
+    DCE_CHECK(config && config->apn, "invalid config", err);
+    DCE_CHECK(strlen(config->apn) < MODEM_MAX_APN_LENGTH, "apn too long: %s", err, config->apn);
+    DCE_CHECK(config->cid >= 1 && config->cid <= MODEM_MAX_PDP_CID, "invalid cid: %d", err, config->cid);
+    /* malloc memory for sim7000_dce object */
+    sim7000_modem_dce_t *sim7000_dce = calloc(1, sizeof(sim7000_modem_dce_t));
+    DCE_CHECK(sim7000_dce, "calloc sim7000_dce failed", err);
+    sim7000_dce->pwrkey_pin = config->pwrkey_io_num;
+    sim7000_dce->reset_pin = config->reset_io_num;
+    sim7000_dce->status_pin = config->status_io_num;
+    strcpy(sim7000_dce->parent.apn, config->apn);
+    sim7000_dce->parent.cid = config->cid;
+    /* Bind DTE with DCE */
+    sim7000_dce->parent.dte = dte;
+    dte->dce = &(sim7000_dce->parent);
+    /* Bind methods */
+    sim7000_dce->parent.handle_line = NULL;
+    sim7000_dce->parent.sync = esp_modem_dce_sync;
+    sim7000_dce->parent.echo_mode = esp_modem_dce_echo;
+    sim7000_dce->parent.store_profile = esp_modem_dce_store_profile;
+    sim7000_dce->parent.set_flow_ctrl = esp_modem_dce_set_flow_ctrl;
+    sim7000_dce->parent.define_pdp_context = esp_modem_dce_define_pdp_context;
+    sim7000_dce->parent.hang_up = esp_modem_dce_hang_up;
+    sim7000_dce->parent.get_signal_quality = sim7000_get_signal_quality;
+    sim7000_dce->parent.get_battery_status = sim7000_get_battery_status;
+    sim7000_dce->parent.set_working_mode = sim7000_set_working_mode;
+    sim7000_dce->parent.get_module_name = sim7000_get_module_name;
+    sim7000_dce->parent.get_imei_number = sim7000_get_imei_number;
+    sim7000_dce->parent.get_imsi_number = sim7000_get_imsi_number;
+    sim7000_dce->parent.get_iccid_number = esp_modem_dce_get_iccid_number;
+    sim7000_dce->parent.get_operator_name = sim7000_get_operator_name;
+    sim7000_dce->parent.get_band_hint = sim7000_get_band_hint;
+    sim7000_dce->parent.set_band_config = sim7000_set_band_config;
+    sim7000_dce->parent.set_rat = sim7000_set_rat;
+    sim7000_dce->parent.get_serving_cell = sim7000_get_serving_cell;
+    sim7000_dce->parent.set_psm = sim7000_set_psm;
+    sim7000_dce->parent.set_edrx = esp_modem_dce_set_edrx;
+    sim7000_dce->parent.get_power_save = esp_modem_dce_get_power_save;
+    sim7000_dce->parent.release_connection = esp_modem_dce_release_connection;
+    sim7000_dce->parent.set_socket_stack = sim7000_set_socket_stack;
+    sim7000_dce->parent.socket_open = sim7000_socket_open;
+    sim7000_dce->parent.socket_send = sim7000_socket_send;
+    sim7000_dce->parent.socket_recv = sim7000_socket_recv;
+    sim7000_dce->parent.socket_close = sim7000_socket_close;
+    sim7000_dce->parent.mqtt_connect = sim7000_mqtt_connect;
+    sim7000_dce->parent.mqtt_publish = sim7000_mqtt_publish;
+    sim7000_dce->parent.mqtt_subscribe = sim7000_mqtt_subscribe;
+    sim7000_dce->parent.mqtt_unsubscribe = sim7000_mqtt_unsubscribe;
+    sim7000_dce->parent.mqtt_disconnect = sim7000_mqtt_disconnect;
+    sim7000_dce->parent.http_open = sim7000_http_open;
+    sim7000_dce->parent.http_get = sim7000_http_get;
+    sim7000_dce->parent.http_read = sim7000_http_read;
+    sim7000_dce->parent.http_close = sim7000_http_close;
+    sim7000_dce->parent.set_gnss = sim7000_set_gnss;
+    sim7000_dce->parent.gnss_assist_write = sim7000_gnss_assist_write;
+    sim7000_dce->parent.gnss_assist_load = sim7000_gnss_assist_load;
+    sim7000_dce->parent.get_gnss_assist = sim7000_get_gnss_assist;
+    sim7000_dce->parent.power_up = sim7000_power_up;
+    sim7000_dce->parent.open = sim7000_open;
+    sim7000_dce->parent.power_down = sim7000_power_down;
+    /* Without the reset pin, recovery goes on with a power cycle */
+    sim7000_dce->parent.reset = sim7000_dce->reset_pin >= 0 ? sim7000_reset : NULL;
+    sim7000_dce->parent.hold_pins = sim7000_dce->pwrkey_pin >= 0 || sim7000_dce->reset_pin >= 0 ? sim7000_hold_pins : NULL;
+    sim7000_dce->parent.deinit = sim7000_deinit;
+    DCE_CHECK(esp_modem_dce_track_power_save(&(sim7000_dce->parent)) == ESP_OK, "track power save failed", err_track);
+    DCE_CHECK(esp_modem_register_urc_handler(dte, "+CPSMSTATUS:", sim7000_handle_cpsmstatus, &(sim7000_dce->parent)) == ESP_OK,
+              "register +CPSMSTATUS handler failed", err_urc);
+    DCE_CHECK(esp_modem_time_track(&(sim7000_dce->parent)) == ESP_OK, "track network time failed", err_time);
+
+    /* Setup GPIO of module, PWRKEY is active low and released high */
+    if (sim7000_dce->pwrkey_pin >= 0) {
+        gpio_pad_select_gpio(sim7000_dce->pwrkey_pin);
+        gpio_set_direction(sim7000_dce->pwrkey_pin, GPIO_MODE_OUTPUT);
+        gpio_set_level(sim7000_dce->pwrkey_pin, 1);
+    }
+    if (sim7000_dce->reset_pin >= 0) {
+        gpio_pad_select_gpio(sim7000_dce->reset_pin);
+        gpio_set_direction(sim7000_dce->reset_pin, GPIO_MODE_OUTPUT);
+        gpio_set_level(sim7000_dce->reset_pin, 0);
+    }
+    if (sim7000_dce->status_pin >= 0) {
+        gpio_pad_select_gpio(sim7000_dce->status_pin);
+        gpio_set_direction(sim7000_dce->status_pin, GPIO_MODE_INPUT);
+    }
+
+    return &(sim7000_dce->parent);
+err_time:
+    esp_modem_unregister_urc_handler(dte, sim7000_handle_cpsmstatus, &(sim7000_dce->parent));
+err_urc:
+    esp_modem_dce_untrack_power_save(&(sim7000_dce->parent));
+err_track:
+    dte->dce = NULL;
+    free(sim7000_dce);
+err:
+    return NULL;
+}
@@ -0,0 +1,115 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce_service.h"
+#include "esp_modem.h"
+
+/**
+ * @brief Specific Length Constraint
+ *
+ */
+#define SIM7000_MAX_SYSTEM_MODE_LENGTH (16) /*!< Max System Mode Length, e.g. "LTE CAT-M1" */
+#define SIM7000_MAX_PLMN_LENGTH (8)         /*!< Max PLMN Length, e.g. "460-11" */
+
+/**
+ * @brief Preferred radio access technologies (AT+CNMP)
+ *
+ */
+typedef enum {
+    SIM7000_NETWORK_MODE_AUTO = 2,     /*!< GSM or LTE, chosen by the module */
+    SIM7000_NETWORK_MODE_GSM = 13,     /*!< GSM only */
+    SIM7000_NETWORK_MODE_LTE = 38,     /*!< LTE only */
+    SIM7000_NETWORK_MODE_GSM_LTE = 51  /*!< GSM and LTE only */
+} sim7000_network_mode_t;
+
+/**
+ * @brief LTE categories (AT+CMNB)
+ *
+ */
+typedef enum {
+    SIM7000_LTE_MODE_CAT_M = 1,  /*!< LTE-M only */
+    SIM7000_LTE_MODE_NB_IOT = 2, /*!< NB-IoT only */
+    SIM7000_LTE_MODE_BOTH = 3    /*!< LTE-M and NB-IoT */
+} sim7000_lte_mode_t;
+
+/**
+ * @brief Serving system, as reported by AT+CPSI?
+ *
+ */
+typedef struct {
+    char system_mode[SIM7000_MAX_SYSTEM_MODE_LENGTH]; /*!< "LTE CAT-M1", "LTE NB-IOT", "GSM" or "NO SERVICE" */
+    char plmn[SIM7000_MAX_PLMN_LENGTH];               /*!< MCC-MNC, empty without service */
+    uint32_t tac;                                     /*!< Tracking or location area code */
+    uint32_t cell_id;                                 /*!< Serving cell identity */
+    int band;                                         /*!< E-UTRAN band, 0 if not on LTE */
+    int rsrq;                                         /*!< Reference signal received quality, unit: dB, LTE only */
+    int rsrp;                                         /*!< Reference signal received power, unit: dBm, LTE only */
+    int rssi;                                         /*!< Received signal strength, unit: dBm, LTE only */
+    int snr;                                          /*!< Signal to noise ratio, unit: dB, LTE only */
+} sim7000_system_info_t;
+
+/**
+ * @brief Create and initialize SIM7000 object
+ *
+ * Without the STATUS pin, the module is taken as on when it answers AT. Without the PWRKEY pin,
+ * the module has to be powered on by the board.
+ *
+ * @param dte Modem DTE object
+ * @param config GPIOs of the module and APN
+ * @return modem_dce_t* Modem DCE object
+ */
+modem_dce_t *sim7000_init(modem_dte_t *dte, const esp_modem_dce_config_t *config);
+
+/**
+ * @brief Select the radio access technologies, in one command line (AT+CNMP;+CMNB)
+ *
+ * @param dce Modem DCE object of a SIM7000
+ * @param mode preferred radio access technologies
+ * @param lte_mode LTE categories
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t sim7000_set_network_mode(modem_dce_t *dce, sim7000_network_mode_t mode, sim7000_lte_mode_t lte_mode);
+
+/**
+ * @brief Get the serving system (AT+CPSI?)
+ *
+ * @param dce Modem DCE object of a SIM7000
+ * @param info serving system
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t sim7000_get_system_info(modem_dce_t *dce, sim7000_system_info_t *info);
+
+/**
+ * @brief Get the EPS network registration status (AT+CEREG?)
+ *
+ * @param dce Modem DCE object of a SIM7000
+ * @param status registration status
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t sim7000_get_eps_registration(modem_dce_t *dce, modem_reg_status_t *status);
+
+#ifdef __cplusplus
+}
+#endif
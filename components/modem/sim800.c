@@ -19,6 +19,8 @@
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "esp_modem_dce_service.h"
+#include "esp_modem_identity.h"
+#include "esp_modem.h"
 #include "sim800.h"
 
 #define MODEM_RESULT_CODE_POWERDOWN "POWER DOWN"
@@ -43,7 +45,9 @@ static const char *DCE_TAG = "sim800";
  *
  */
 typedef struct {
-    void *priv_resource; /*!< Private resource */
+    int pwrkey_pin;      /*!< PWRKEY GPIO */
+    int reset_pin;       /*!< RESET GPIO, -1 if not wired */
+    int status_pin;      /*!< STATUS GPIO */
     modem_dce_t parent;  /*!< DCE parent class */
 } sim800_modem_dce_t;
 
@@ -53,14 +57,13 @@ typedef struct {
 static esp_err_t sim800_handle_csq(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
     if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
     } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     } else if (!strncmp(line, "+CSQ", strlen("+CSQ"))) {
         /* store value of rssi and ber */
-        uint32_t **csq = sim800_dce->priv_resource;
+        uint32_t **csq = dce->handle_line_ctx;
         /* +CSQ: <rssi>,<ber> */
         sscanf(line, "%*s%d,%d", csq[0], csq[1]);
         err = ESP_OK;
@@ -74,14 +77,13 @@ static esp_err_t sim800_handle_csq(modem_dce_t *dce, const char *line)
 static esp_err_t sim800_handle_cbc(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
     if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
     } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     } else if (!strncmp(line, "+CBC", strlen("+CBC"))) {
         /* store value of bcs, bcl, voltage */
-        uint32_t **cbc = sim800_dce->priv_resource;
+        uint32_t **cbc = dce->handle_line_ctx;
         /* +CBC: <bcs>,<bcl>,<voltage> */
         sscanf(line, "%*s%d,%d,%d", cbc[0], cbc[1], cbc[2]);
         err = ESP_OK;
@@ -106,7 +108,7 @@ static esp_err_t sim800_handle_exit_data_mode(modem_dce_t *dce, const char *line
 }
 
 /**
- * @brief Handle response from ATD*99#
+ * @brief Handle response from ATD*99***<cid>#
  */
 static esp_err_t sim800_handle_atd_ppp(modem_dce_t *dce, const char *line)
 {
@@ -212,10 +214,12 @@ static esp_err_t sim800_handle_cops(modem_dce_t *dce, const char *line)
             p[++i] = strtok_r(NULL, ",", &str_ptr);
         }
         if (i >= 3) {
-            int len = snprintf(dce->oper, MODEM_MAX_OPERATOR_LENGTH, "%s", p[2]);
+            char oper[MODEM_MAX_OPERATOR_LENGTH];
+            int len = snprintf(oper, sizeof(oper), "%s", p[2]);
             if (len > 2) {
                 /* Strip "\r\n" */
-                strip_cr_lf_tail(dce->oper, len);
+                strip_cr_lf_tail(oper, len);
+                esp_modem_identity_set_operator(dce, oper);
                 err = ESP_OK;
             }
         }
@@ -251,12 +255,9 @@ static esp_err_t sim800_handle_power_down(modem_dce_t *dce, const char *line)
 static esp_err_t sim800_get_signal_quality(modem_dce_t *dce, uint32_t *rssi, uint32_t *ber)
 {
     modem_dte_t *dte = dce->dte;
-    sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
     uint32_t *resource[2] = {rssi, ber};
-    sim800_dce->priv_resource = resource;
-    dce->handle_line = sim800_handle_csq;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CSQ\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire signal quality failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT+CSQ\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim800_handle_csq, resource) == ESP_OK,
+              "inquire signal quality failed", err);
     ESP_LOGD(DCE_TAG, "inquire signal quality ok");
     return ESP_OK;
 err:
@@ -277,12 +278,9 @@ err:
 static esp_err_t sim800_get_battery_status(modem_dce_t *dce, uint32_t *bcs, uint32_t *bcl, uint32_t *voltage)
 {
     modem_dte_t *dte = dce->dte;
-    sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
     uint32_t *resource[3] = {bcs, bcl, voltage};
-    sim800_dce->priv_resource = resource;
-    dce->handle_line = sim800_handle_cbc;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CBC\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire battery status failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT+CBC\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim800_handle_cbc, resource) == ESP_OK,
+              "inquire battery status failed", err);
     ESP_LOGD(DCE_TAG, "inquire battery status ok");
     return ESP_OK;
 err:
@@ -301,19 +299,33 @@ err:
 static esp_err_t sim800_set_working_mode(modem_dce_t *dce, modem_mode_t mode)
 {
     modem_dte_t *dte = dce->dte;
+    char command[24];
     switch (mode) {
     case MODEM_COMMAND_MODE:
-        dce->handle_line = sim800_handle_exit_data_mode;
-        DCE_CHECK(dte->send_cmd(dte, "+++", MODEM_COMMAND_TIMEOUT_MODE_CHANGE) == ESP_OK, "send command failed", err);
-        DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "enter command mode failed", err);
+        /* Dropping DTR is immediate, the escape sequence needs a guard time on each side */
+        if (!dce->dtr_switch || esp_modem_dce_suspend_data_mode(dce) != ESP_OK) {
+            DCE_CHECK(dte->send_cmd(dte, "+++", MODEM_COMMAND_TIMEOUT_MODE_CHANGE,
+                                    sim800_handle_exit_data_mode, NULL) == ESP_OK,
+                      "enter command mode failed", err);
+        }
         ESP_LOGD(DCE_TAG, "enter command mode ok");
         dce->mode = MODEM_COMMAND_MODE;
         break;
     case MODEM_PPP_MODE:
-        dce->handle_line = sim800_handle_atd_ppp;
-        DCE_CHECK(dte->send_cmd(dte, "ATD*99#\r", MODEM_COMMAND_TIMEOUT_MODE_CHANGE) == ESP_OK, "send command failed", err);
-        DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "enter ppp mode failed", err);
+        if (dce->data_suspended) {
+            /* The data call is still up, no need to dial and negotiate again, the DTE dials if it was lost */
+            DCE_CHECK(esp_modem_dce_resume_data_mode(dce) == ESP_OK, "data call lost", err);
+            ESP_LOGD(DCE_TAG, "resume ppp mode ok");
+            dce->data_suspended = false;
+            dce->mode = MODEM_PPP_MODE;
+            break;
+        }
+        /* Dial the selected PDP context */
+        snprintf(command, sizeof(command), "ATD*99***%d#\r", dce->cid);
+        DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_MODE_CHANGE, sim800_handle_atd_ppp, NULL) == ESP_OK,
+                  "enter ppp mode failed", err);
         ESP_LOGD(DCE_TAG, "enter ppp mode ok");
+        dce->data_suspended = false;
         dce->mode = MODEM_PPP_MODE;
         break;
     default:
@@ -329,13 +341,16 @@ err:
 /**
  * @brief Power Up SIM800 module
  *
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t sim800_power_up()
+static esp_err_t sim800_power_up(modem_dce_t *dce)
 {
     ESP_LOGD(DCE_TAG, "start power-up SIM800 module");
+    sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
+    esp_modem_timeline_begin(dce->dte, ESP_MODEM_PHASE_POWER_UP);
 
     bool status = false;
     int inc = 0;
@@ -346,12 +361,12 @@ static esp_err_t sim800_power_up()
         vTaskDelay(500 / portTICK_PERIOD_MS);
         inc += 1;
         ESP_LOGD(DCE_TAG, ".");
-        status = gpio_get_level(CONFIG_EXAMPLE_GPIO_MODEM_STATUS) > 0;
+        status = gpio_get_level(sim800_dce->status_pin) > 0;
 
         // Unbounce input
         if(status) {
             vTaskDelay(30 / portTICK_PERIOD_MS);
-            status = gpio_get_level(CONFIG_EXAMPLE_GPIO_MODEM_STATUS) > 0;
+            status = gpio_get_level(sim800_dce->status_pin) > 0;
         }
         ESP_LOGD(DCE_TAG, "STATUS is %d, inc is %d", status, inc);
     } while (!(status==true || inc>20));
@@ -362,13 +377,13 @@ static esp_err_t sim800_power_up()
 
         // Power-on module (pulse of 100ms on PWRKEY pin)
         ESP_LOGD(DCE_TAG, "module will be power-up");
-        gpio_set_level(CONFIG_EXAMPLE_GPIO_MODEM_PWRKEY, 1);
+        gpio_set_level(sim800_dce->pwrkey_pin, 1);
         vTaskDelay(100 / portTICK_PERIOD_MS);
-        gpio_set_level(CONFIG_EXAMPLE_GPIO_MODEM_PWRKEY, 0);
+        gpio_set_level(sim800_dce->pwrkey_pin, 0);
         ESP_LOGD(DCE_TAG, "Pulse on PWRKEY is done");
 
         vTaskDelay(1100 / portTICK_PERIOD_MS);
-        gpio_set_level(CONFIG_EXAMPLE_GPIO_MODEM_PWRKEY, 1);
+        gpio_set_level(sim800_dce->pwrkey_pin, 1);
 
         // Wait time of startup (5sec)
         ESP_LOGD(DCE_TAG, "Start waiting 5sec (minimal startup time)");
@@ -387,12 +402,12 @@ static esp_err_t sim800_power_up()
             vTaskDelay(500 / portTICK_PERIOD_MS);
             inc += 1;
             ESP_LOGD(DCE_TAG, ".");
-            status = gpio_get_level(CONFIG_EXAMPLE_GPIO_MODEM_STATUS) > 0;
+            status = gpio_get_level(sim800_dce->status_pin) > 0;
 
             // Unbounce input
             if(status) {
                 vTaskDelay(30 / portTICK_PERIOD_MS);
-                status = gpio_get_level(CONFIG_EXAMPLE_GPIO_MODEM_STATUS) > 0;
+                status = gpio_get_level(sim800_dce->status_pin) > 0;
             }
             ESP_LOGD(DCE_TAG, "STATUS is %d", status);
         } while (!(status==true || inc>20));
@@ -406,6 +421,7 @@ static esp_err_t sim800_power_up()
     // Wait 2sec to ensure that module is ready to communicate
     vTaskDelay(2000 / portTICK_PERIOD_MS);
     ESP_LOGD(DCE_TAG, "STATUS of module is OK");
+    esp_modem_timeline_end(dce->dte, ESP_MODEM_PHASE_POWER_UP);
 
     return ESP_OK;
 }
@@ -421,29 +437,74 @@ static esp_err_t sim800_power_up()
 static esp_err_t sim800_power_down(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
-    dce->handle_line = sim800_handle_power_down;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CPOWD=1\r", MODEM_COMMAND_TIMEOUT_POWEROFF) == ESP_OK, "send command failed", err);
-    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "power down failed", err);
+    DCE_CHECK(dte->send_cmd(dte, "AT+CPOWD=1\r", MODEM_COMMAND_TIMEOUT_POWEROFF,
+                            sim800_handle_power_down, NULL) == ESP_OK,
+              "power down failed", err);
     ESP_LOGD(DCE_TAG, "power down ok");
     return ESP_OK;
 err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Hardware reset by the reset pin
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim800_reset(modem_dce_t *dce)
+{
+    sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
+    ESP_LOGD(DCE_TAG, "module will be reset");
+    gpio_set_level(sim800_dce->reset_pin, 1);
+    vTaskDelay(300 / portTICK_PERIOD_MS);
+    gpio_set_level(sim800_dce->reset_pin, 0);
+    /* Settings of the module are back to the stored profile */
+    dce->mode = MODEM_COMMAND_MODE;
+    dce->dtr_switch = false;
+    dce->data_suspended = false;
+    ESP_LOGD(DCE_TAG, "reset ok");
+    return ESP_OK;
+}
+
+/**
+ * @brief Hold or release the levels of PWRKEY and RESET
+ *
+ * @param dce Modem DCE object
+ * @param hold true to hold, false to release
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t sim800_hold_pins(modem_dce_t *dce, bool hold)
+{
+    sim800_modem_dce_t *sim800_dce = __containerof(dce, sim800_modem_dce_t, parent);
+    DCE_CHECK((hold ? gpio_hold_en(sim800_dce->pwrkey_pin) : gpio_hold_dis(sim800_dce->pwrkey_pin)) == ESP_OK,
+              "hold PWRKEY failed", err);
+    if (sim800_dce->reset_pin >= 0) {
+        DCE_CHECK((hold ? gpio_hold_en(sim800_dce->reset_pin) : gpio_hold_dis(sim800_dce->reset_pin)) == ESP_OK,
+                  "hold RESET failed", err);
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 /**
  * @brief Get DCE module name
  *
- * @param sim800_dce sim800 object
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t sim800_get_module_name(sim800_modem_dce_t *sim800_dce)
+static esp_err_t sim800_get_module_name(modem_dce_t *dce)
 {
-    modem_dte_t *dte = sim800_dce->parent.dte;
-    sim800_dce->parent.handle_line = sim800_handle_cgmm;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CGMM\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(sim800_dce->parent.state == MODEM_STATE_SUCCESS, "get module name failed", err);
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CGMM\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim800_handle_cgmm, NULL) == ESP_OK,
+              "get module name failed", err);
     ESP_LOGD(DCE_TAG, "get module name ok");
     return ESP_OK;
 err:
@@ -453,17 +514,16 @@ err:
 /**
  * @brief Get DCE module IMEI number
  *
- * @param sim800_dce sim800 object
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t sim800_get_imei_number(sim800_modem_dce_t *sim800_dce)
+static esp_err_t sim800_get_imei_number(modem_dce_t *dce)
 {
-    modem_dte_t *dte = sim800_dce->parent.dte;
-    sim800_dce->parent.handle_line = sim800_handle_cgsn;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CGSN\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(sim800_dce->parent.state == MODEM_STATE_SUCCESS, "get imei number failed", err);
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CGSN\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim800_handle_cgsn, NULL) == ESP_OK,
+              "get imei number failed", err);
     ESP_LOGD(DCE_TAG, "get imei number ok");
     return ESP_OK;
 err:
@@ -473,17 +533,16 @@ err:
 /**
  * @brief Get DCE module IMSI number
  *
- * @param sim800_dce sim800 object
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t sim800_get_imsi_number(sim800_modem_dce_t *sim800_dce)
+static esp_err_t sim800_get_imsi_number(modem_dce_t *dce)
 {
-    modem_dte_t *dte = sim800_dce->parent.dte;
-    sim800_dce->parent.handle_line = sim800_handle_cimi;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CIMI\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
-    DCE_CHECK(sim800_dce->parent.state == MODEM_STATE_SUCCESS, "get imsi number failed", err);
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CIMI\r", MODEM_COMMAND_TIMEOUT_DEFAULT, sim800_handle_cimi, NULL) == ESP_OK,
+              "get imsi number failed", err);
     ESP_LOGD(DCE_TAG, "get imsi number ok");
     return ESP_OK;
 err:
@@ -493,17 +552,16 @@ err:
 /**
  * @brief Get Operator's name
  *
- * @param sim800_dce sim800 object
+ * @param dce Modem DCE object
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t sim800_get_operator_name(sim800_modem_dce_t *sim800_dce)
+static esp_err_t sim800_get_operator_name(modem_dce_t *dce)
 {
-    modem_dte_t *dte = sim800_dce->parent.dte;
-    sim800_dce->parent.handle_line = sim800_handle_cops;
-    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK, "send command failed", err);
-    DCE_CHECK(sim800_dce->parent.state == MODEM_STATE_SUCCESS, "get network operator failed", err);
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR, sim800_handle_cops, NULL) == ESP_OK,
+              "get network operator failed", err);
     ESP_LOGD(DCE_TAG, "get network operator ok");
     return ESP_OK;
 err:
@@ -526,6 +584,7 @@ static esp_err_t sim800_open(modem_dce_t *dce)
     bool sync = false;
     bool status = false;
     int inc = 0;
+    esp_modem_timeline_begin(dce->dte, ESP_MODEM_PHASE_OPEN);
 
     ESP_LOGD(DCE_TAG, "try to sync with the module");
     do
@@ -537,18 +596,21 @@ static esp_err_t sim800_open(modem_dce_t *dce)
         ESP_LOGD(DCE_TAG, "SYNC is %d, inc is %d", sync, inc);
     } while (!(sync==true || inc>10));
 
-    if (!sync) {
+    if (!sync && sim800_dce->reset_pin < 0) {
+        ESP_LOGE(DCE_TAG, "module is not reacheable, and can not be reset");
+        return ESP_FAIL;
+    } else if (!sync) {
         ESP_LOGI(DCE_TAG, "module is not reacheable");
 
         // Reset on module (300ms on NRESET pin)
         ESP_LOGD(DCE_TAG, "module will be reset");
-        gpio_set_level(CONFIG_EXAMPLE_GPIO_MODEM_RESET, 1);
+        gpio_set_level(sim800_dce->reset_pin, 1);
         vTaskDelay(300 / portTICK_PERIOD_MS);
-        gpio_set_level(CONFIG_EXAMPLE_GPIO_MODEM_RESET, 0);
+        gpio_set_level(sim800_dce->reset_pin, 0);
         ESP_LOGD(DCE_TAG, "Pulse on RESET is done");
 
         vTaskDelay(1100 / portTICK_PERIOD_MS);
-        gpio_set_level(CONFIG_EXAMPLE_GPIO_MODEM_PWRKEY, 1);
+        gpio_set_level(sim800_dce->pwrkey_pin, 1);
 
         // Wait time of reboot (6sec)
         ESP_LOGD(DCE_TAG, "Start waiting 6sec (minimal reset time)");
@@ -558,6 +620,8 @@ static esp_err_t sim800_open(modem_dce_t *dce)
             ESP_LOGD(DCE_TAG, ".");
         }
         ESP_LOGD(DCE_TAG, "end of delay");
+        /* Drop what the module sent while rebooting */
+        dce->dte->reset(dce->dte);
 
         ESP_LOGD(DCE_TAG, "launch STATUS reading");
         status = false;
@@ -567,12 +631,12 @@ static esp_err_t sim800_open(modem_dce_t *dce)
             vTaskDelay(500 / portTICK_PERIOD_MS);
             inc += 1;
             ESP_LOGD(DCE_TAG, ".");
-            status = gpio_get_level(CONFIG_EXAMPLE_GPIO_MODEM_STATUS) > 0;
+            status = gpio_get_level(sim800_dce->status_pin) > 0;
 
             // Unbounce input
             if(status) {
                 vTaskDelay(30 / portTICK_PERIOD_MS);
-                status = gpio_get_level(CONFIG_EXAMPLE_GPIO_MODEM_STATUS) > 0;
+                status = gpio_get_level(sim800_dce->status_pin) > 0;
             }
             ESP_LOGD(DCE_TAG, "STATUS is %d", status);
         } while (!(status==true || inc>20));
@@ -606,17 +670,11 @@ static esp_err_t sim800_open(modem_dce_t *dce)
     DCE_CHECK(esp_modem_dce_sync(&(sim800_dce->parent)) == ESP_OK, "sync failed", err_io);
     /* Close echo */
     DCE_CHECK(esp_modem_dce_echo(&(sim800_dce->parent), false) == ESP_OK, "close echo mode failed", err_io);
-    /* Get Module name */
-    DCE_CHECK(sim800_get_module_name(sim800_dce) == ESP_OK, "get module name failed", err_io);
-    /* Get IMEI number */
-    DCE_CHECK(sim800_get_imei_number(sim800_dce) == ESP_OK, "get imei failed", err_io);
-    /* Get IMSI number */
-    DCE_CHECK(sim800_get_imsi_number(sim800_dce) == ESP_OK, "get imsi failed", err_io);
-    /* Get operator name */
-    DCE_CHECK(sim800_get_operator_name(sim800_dce) == ESP_OK, "get operator name failed", err_io);
+    /* Identity comes from the cache on warm boot, otherwise it is queried on first access */
+    esp_modem_identity_restore(&(sim800_dce->parent));
+    esp_modem_timeline_end(dce->dte, ESP_MODEM_PHASE_OPEN);
     return ESP_OK;
 err_io:
-    free(dce);
     return ESP_FAIL;
 }
 
@@ -638,12 +696,21 @@ static esp_err_t sim800_deinit(modem_dce_t *dce)
     return ESP_OK;
 }
 
-modem_dce_t *sim800_init(modem_dte_t *dte)
+modem_dce_t *sim800_init(modem_dte_t *dte, const esp_modem_dce_config_t *config)
 {
     DCE_CHECK(dte, "DCE should bind with a DTE", err);
+    DCE_CHECK(config && config->apn, "invalid config", err);
+    DCE_CHECK(strlen(config->apn) < MODEM_MAX_APN_LENGTH, "apn too long: %s", err, config->apn);
+    DCE_CHECK(config->cid >= 1 && config->cid <= MODEM_MAX_PDP_CID, "invalid cid: %d", err, config->cid);
+    DCE_CHECK(config->pwrkey_io_num >= 0 && config->status_io_num >= 0, "PWRKEY and STATUS must be wired", err);
     /* malloc memory for sim800_dce object */
     sim800_modem_dce_t *sim800_dce = calloc(1, sizeof(sim800_modem_dce_t));
     DCE_CHECK(sim800_dce, "calloc sim800_dce failed", err);
+    sim800_dce->pwrkey_pin = config->pwrkey_io_num;
+    sim800_dce->reset_pin = config->reset_io_num;
+    sim800_dce->status_pin = config->status_io_num;
+    strcpy(sim800_dce->parent.apn, config->apn);
+    sim800_dce->parent.cid = config->cid;
     /* Bind DTE with DCE */
     sim800_dce->parent.dte = dte;
     dte->dce = &(sim800_dce->parent);
@@ -658,20 +725,30 @@ modem_dce_t *sim800_init(modem_dte_t *dte)
     sim800_dce->parent.get_signal_quality = sim800_get_signal_quality;
     sim800_dce->parent.get_battery_status = sim800_get_battery_status;
     sim800_dce->parent.set_working_mode = sim800_set_working_mode;
+    sim800_dce->parent.get_module_name = sim800_get_module_name;
+    sim800_dce->parent.get_imei_number = sim800_get_imei_number;
+    sim800_dce->parent.get_imsi_number = sim800_get_imsi_number;
+    sim800_dce->parent.get_iccid_number = esp_modem_dce_get_iccid_number;
+    sim800_dce->parent.get_operator_name = sim800_get_operator_name;
     sim800_dce->parent.power_up = sim800_power_up;
     sim800_dce->parent.open = sim800_open;
     sim800_dce->parent.power_down = sim800_power_down;
+    /* Without the reset pin, recovery goes on with a power cycle */
+    sim800_dce->parent.reset = sim800_dce->reset_pin >= 0 ? sim800_reset : NULL;
+    sim800_dce->parent.hold_pins = sim800_hold_pins;
     sim800_dce->parent.deinit = sim800_deinit;
 
     /* Setup GPIO of module */
-    gpio_pad_select_gpio(CONFIG_EXAMPLE_GPIO_MODEM_PWRKEY);
-    gpio_set_direction(CONFIG_EXAMPLE_GPIO_MODEM_PWRKEY, GPIO_MODE_OUTPUT);
-    gpio_set_level(CONFIG_EXAMPLE_GPIO_MODEM_RESET, 0);
-    gpio_pad_select_gpio(CONFIG_EXAMPLE_GPIO_MODEM_RESET);
-    gpio_set_direction(CONFIG_EXAMPLE_GPIO_MODEM_RESET, GPIO_MODE_OUTPUT);
-    gpio_set_level(CONFIG_EXAMPLE_GPIO_MODEM_RESET, 0);
-    gpio_pad_select_gpio(CONFIG_EXAMPLE_GPIO_MODEM_STATUS);
-    gpio_set_direction(CONFIG_EXAMPLE_GPIO_MODEM_STATUS, GPIO_MODE_INPUT);
+    gpio_pad_select_gpio(sim800_dce->pwrkey_pin);
+    gpio_set_direction(sim800_dce->pwrkey_pin, GPIO_MODE_OUTPUT);
+    if (sim800_dce->reset_pin >= 0) {
+        gpio_set_level(sim800_dce->reset_pin, 0);
+        gpio_pad_select_gpio(sim800_dce->reset_pin);
+        gpio_set_direction(sim800_dce->reset_pin, GPIO_MODE_OUTPUT);
+        gpio_set_level(sim800_dce->reset_pin, 0);
+    }
+    gpio_pad_select_gpio(sim800_dce->status_pin);
+    gpio_set_direction(sim800_dce->status_pin, GPIO_MODE_INPUT);
 
     return &(sim800_dce->parent);
 err:
@@ -24,9 +24,10 @@ extern "C" {
  * @brief Create and initialize SIM800 object
  *
  * @param dte Modem DTE object
+ * @param config GPIOs of the module, PWRKEY and STATUS are required, and APN
  * @return modem_dce_t* Modem DCE object
  */
-modem_dce_t *sim800_init(modem_dte_t *dte);
+modem_dce_t *sim800_init(modem_dte_t *dte, const esp_modem_dce_config_t *config);
 
 #ifdef __cplusplus
 }
@@ -11,13 +11,36 @@
 #include "freertos/event_groups.h"
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
+#include "nvs_flash.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#ifdef CONFIG_EXAMPLE_MODEM_SNTP_SERVER
+#include "esp_sntp.h"
+#endif
 #include "mqtt_client.h"
 #include "esp_modem.h"
 #include "esp_modem_netif.h"
+#include "esp_modem_identity.h"
+#include "esp_modem_attach.h"
+#include "esp_modem_sleep.h"
+#include "esp_modem_supervisor.h"
+#include "esp_modem_radio.h"
+#include "esp_modem_route.h"
+#include "esp_modem_rat.h"
+#include "esp_modem_socket.h"
+#include "esp_modem_mqtt.h"
+#include "esp_modem_download.h"
+#include "esp_modem_gnss.h"
+#include "esp_modem_agnss.h"
+#include "esp_modem_time.h"
+#include "esp_modem_dce_service.h"
 #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
 #include "esp_log.h"
 #include "sim800.h"
+#include "sim7000.h"
 #include "bg96.h"
+#include "modem_bench.h"
 
 #define BROKER_URL "mqtt://mqtt.eclipse.org"
 
@@ -59,46 +82,31 @@ static esp_err_t example_handle_cmgs(modem_dce_t *dce, const char *line)
 
 #define MODEM_SMS_MAX_LENGTH (128)
 #define MODEM_COMMAND_TIMEOUT_SMS_MS (120000)
-#define MODEM_PROMPT_TIMEOUT_MS (10)
 
 static esp_err_t example_send_message_text(modem_dce_t *dce, const char *phone_num, const char *text)
 {
     modem_dte_t *dte = dce->dte;
-    dce->handle_line = example_default_handle;
     /* Set text mode */
-    if (dte->send_cmd(dte, "AT+CMGF=1\r", MODEM_COMMAND_TIMEOUT_DEFAULT) != ESP_OK) {
-        ESP_LOGE(TAG, "send command failed");
-        goto err;
-    }
-    if (dce->state != MODEM_STATE_SUCCESS) {
+    if (dte->send_cmd(dte, "AT+CMGF=1\r", MODEM_COMMAND_TIMEOUT_DEFAULT, example_default_handle, NULL) != ESP_OK) {
         ESP_LOGE(TAG, "set message format failed");
         goto err;
     }
     ESP_LOGD(TAG, "set message format ok");
     /* Specify character set */
-    dce->handle_line = example_default_handle;
-    if (dte->send_cmd(dte, "AT+CSCS=\"GSM\"\r", MODEM_COMMAND_TIMEOUT_DEFAULT) != ESP_OK) {
-        ESP_LOGE(TAG, "send command failed");
-        goto err;
-    }
-    if (dce->state != MODEM_STATE_SUCCESS) {
+    if (dte->send_cmd(dte, "AT+CSCS=\"GSM\"\r", MODEM_COMMAND_TIMEOUT_DEFAULT, example_default_handle, NULL) != ESP_OK) {
         ESP_LOGE(TAG, "set character set failed");
         goto err;
     }
     ESP_LOGD(TAG, "set character set ok");
     /* send message */
     char command[MODEM_SMS_MAX_LENGTH] = {0};
-    int length = snprintf(command, MODEM_SMS_MAX_LENGTH, "AT+CMGS=\"%s\"\r", phone_num);
-    /* set phone number and wait for "> " */
-    dte->send_wait(dte, command, length, "\r\n> ", MODEM_PROMPT_TIMEOUT_MS);
+    char message[MODEM_SMS_MAX_LENGTH] = {0};
+    snprintf(command, MODEM_SMS_MAX_LENGTH, "AT+CMGS=\"%s\"\r", phone_num);
     /* end with CTRL+Z */
-    snprintf(command, MODEM_SMS_MAX_LENGTH, "%s\x1A", text);
-    dce->handle_line = example_handle_cmgs;
-    if (dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_SMS_MS) != ESP_OK) {
-        ESP_LOGE(TAG, "send command failed");
-        goto err;
-    }
-    if (dce->state != MODEM_STATE_SUCCESS) {
+    int length = snprintf(message, MODEM_SMS_MAX_LENGTH, "%s\x1A", text);
+    /* set phone number, wait for "> " and send the text, all under the command lock */
+    if (esp_modem_send_payload(dte, command, "> ", message, length, MODEM_COMMAND_TIMEOUT_SMS_MS,
+                               example_handle_cmgs, NULL) != ESP_OK) {
         ESP_LOGE(TAG, "send message failed");
         goto err;
     }
@@ -122,11 +130,70 @@ static void modem_event_handler(void *event_handler_arg, esp_event_base_t event_
     case ESP_MODEM_EVENT_UNKNOWN:
         ESP_LOGW(TAG, "Unknow line received: %s", (char *)event_data);
         break;
+    case ESP_MODEM_EVENT_CARRIER_LOST:
+        ESP_LOGW(TAG, "Modem carrier lost (%s)",
+                 *(esp_modem_carrier_loss_t *)event_data == ESP_MODEM_CARRIER_LOSS_DCD ? "DCD" : "NO CARRIER");
+        break;
+    case ESP_MODEM_EVENT_RADIO_CHANGED: {
+        esp_modem_radio_event_t *radio = event_data;
+        ESP_LOGI(TAG, "Radio changed 0x%x: rssi %d, ber %d, voltage %d mV, registration %d, cell %s", radio->changed,
+                 radio->status.rssi, radio->status.ber, radio->status.voltage, radio->status.registration, radio->status.cell);
+        break;
+    }
+    case ESP_MODEM_EVENT_LINK_STALLED:
+        ESP_LOGW(TAG, "Modem link stalled");
+        break;
+    case ESP_MODEM_EVENT_LINK_DOWN:
+        ESP_LOGW(TAG, "Modem link down");
+        break;
+    case ESP_MODEM_EVENT_LINK_RECOVERED: {
+        esp_modem_recovery_t *recovery = event_data;
+        ESP_LOGI(TAG, "Modem link recovered in %d ms, level %d, %d attempts",
+                 recovery->time_to_recover_ms, recovery->level, recovery->attempts);
+        break;
+    }
+    case ESP_MODEM_EVENT_RECOVERY_FAILED: {
+        esp_modem_recovery_t *recovery = event_data;
+        ESP_LOGE(TAG, "Modem link recovery given up after %d ms, level %d, %d attempts",
+                 recovery->time_to_recover_ms, recovery->level, recovery->attempts);
+        break;
+    }
     default:
         break;
     }
 }
 
+/**
+ * @brief Escape a value for a double quoted field of the timeline, as read back by shlex
+ */
+static void modem_timeline_escape(const char *value, char *escaped, size_t size)
+{
+    size_t len = 0;
+    for (; *value && len + 2 < size; value++) {
+        if (*value == '"' || *value == '\\') {
+            escaped[len++] = '\\';
+        }
+        escaped[len++] = *value;
+    }
+    escaped[len] = '\0';
+}
+
+/**
+ * @brief Log the boot to IP timeline in the format read by tools/modem_timeline.py
+ */
+static void modem_timeline_handler(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    /* Runs in the modem task, only use the identity already known */
+    modem_dce_t *dce = event_handler_arg;
+    char phases[ESP_MODEM_TIMELINE_MAX_LENGTH];
+    char oper[MODEM_MAX_OPERATOR_LENGTH];
+    char escaped[2 * MODEM_MAX_OPERATOR_LENGTH];
+    esp_modem_timeline_format(event_data, phases, sizeof(phases));
+    esp_modem_identity_copy_operator(dce, oper, sizeof(oper));
+    modem_timeline_escape(oper, escaped, sizeof(escaped));
+    ESP_LOGI(TAG, "TIMELINE imei=%s oper=\"%s\" %s", dce->imei[0] ? dce->imei : "-", escaped, phases);
+}
+
 static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 {
     esp_mqtt_client_handle_t client = event->client;
@@ -167,6 +234,48 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
     return ESP_OK;
 }
 
+#ifdef CONFIG_EXAMPLE_MODEM_MQTT_OFFLOAD
+static esp_err_t mqtt_offload_event_handler(esp_modem_mqtt_event_handle_t event)
+{
+    esp_modem_mqtt_client_handle_t client = event->client;
+    int msg_id;
+    switch (event->event_id) {
+    case ESP_MODEM_MQTT_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+        msg_id = esp_modem_mqtt_client_subscribe(client, "/topic/esp-pppos", 0);
+        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+        break;
+    case ESP_MODEM_MQTT_EVENT_DISCONNECTED:
+        ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+        break;
+    case ESP_MODEM_MQTT_EVENT_SUBSCRIBED:
+        ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+        msg_id = esp_modem_mqtt_client_publish(client, "/topic/esp-pppos", "esp32-pppos", 0, 0, 0);
+        ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
+        break;
+    case ESP_MODEM_MQTT_EVENT_UNSUBSCRIBED:
+        ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
+        break;
+    case ESP_MODEM_MQTT_EVENT_PUBLISHED:
+        ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        break;
+    case ESP_MODEM_MQTT_EVENT_DATA:
+        ESP_LOGI(TAG, "MQTT_EVENT_DATA");
+        printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
+        printf("DATA=%.*s\r\n", event->data_len, event->data);
+        xEventGroupSetBits(event_group, GOT_DATA_BIT);
+        break;
+    case ESP_MODEM_MQTT_EVENT_ERROR:
+        ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
+        break;
+    default:
+        ESP_LOGI(TAG, "MQTT other event id: %d", event->event_id);
+        break;
+    }
+    return ESP_OK;
+}
+#endif
+
 static void on_ppp_changed(void *arg, esp_event_base_t event_base,
                         int32_t event_id, void *event_data)
 {
@@ -211,10 +320,98 @@ static void on_ip_event(void *arg, esp_event_base_t event_base,
     }
 }
 
+/**
+ * @brief Configuration of the modem wired as in the build flags
+ *
+ */
+static void example_modem_config(esp_modem_dte_config_t *dte_config, esp_modem_dce_config_t *dce_config)
+{
+    dte_config->tx_io_num = CONFIG_EXAMPLE_UART_MODEM_TX_PIN;
+    dte_config->rx_io_num = CONFIG_EXAMPLE_UART_MODEM_RX_PIN;
+    dte_config->rts_io_num = CONFIG_EXAMPLE_UART_MODEM_RTS_PIN;
+    dte_config->cts_io_num = CONFIG_EXAMPLE_UART_MODEM_CTS_PIN;
+#ifdef CONFIG_EXAMPLE_UART_MODEM_DTR_PIN
+    dte_config->dtr_io_num = CONFIG_EXAMPLE_UART_MODEM_DTR_PIN;
+#endif
+#ifdef CONFIG_EXAMPLE_UART_MODEM_DCD_PIN
+    dte_config->dcd_io_num = CONFIG_EXAMPLE_UART_MODEM_DCD_PIN;
+#endif
+    dte_config->rx_buffer_size = CONFIG_EXAMPLE_UART_RX_BUFFER_SIZE;
+    dte_config->tx_buffer_size = CONFIG_EXAMPLE_UART_TX_BUFFER_SIZE;
+    dte_config->event_queue_size = CONFIG_EXAMPLE_UART_EVENT_QUEUE_SIZE;
+    dte_config->pattern_queue_size = CONFIG_EXAMPLE_UART_PATTERN_QUEUE_SIZE;
+    dte_config->line_buffer_size = CONFIG_EXAMPLE_UART_RX_BUFFER_SIZE / 2;
+    dte_config->event_task_stack_size = CONFIG_EXAMPLE_UART_EVENT_TASK_STACK_SIZE;
+    dte_config->event_task_priority = CONFIG_EXAMPLE_UART_EVENT_TASK_PRIORITY;
+    dce_config->pwrkey_io_num = CONFIG_EXAMPLE_GPIO_MODEM_PWRKEY;
+    dce_config->reset_io_num = CONFIG_EXAMPLE_GPIO_MODEM_RESET;
+    dce_config->status_io_num = CONFIG_EXAMPLE_GPIO_MODEM_STATUS;
+}
+
+#if CONFIG_EXAMPLE_MODEM_BENCH_MS
+/**
+ * @brief Run the scaling benchmark on the modem of the build flags, and on the second and third
+ *        modems when wired (CONFIG_EXAMPLE_MODEM2_* and CONFIG_EXAMPLE_MODEM3_*)
+ *
+ */
+static void example_modem_bench(void)
+{
+    modem_bench_instance_t instances[3];
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        instances[i] = (modem_bench_instance_t) {
+            .dte = ESP_MODEM_DTE_DEFAULT_CONFIG(),
+            .dce = ESP_MODEM_DCE_DEFAULT_CONFIG(CONFIG_EXAMPLE_MODEM_APN)
+        };
+        example_modem_config(&instances[i].dte, &instances[i].dce);
+    }
+    count++;
+#ifdef CONFIG_EXAMPLE_MODEM2_UART_PORT
+    instances[count].dte.port_num = CONFIG_EXAMPLE_MODEM2_UART_PORT;
+    instances[count].dte.tx_io_num = CONFIG_EXAMPLE_MODEM2_TX_PIN;
+    instances[count].dte.rx_io_num = CONFIG_EXAMPLE_MODEM2_RX_PIN;
+    /* Only TX and RX are wired, RTS and CTS stay with the first modem */
+    instances[count].dte.rts_io_num = UART_PIN_NO_CHANGE;
+    instances[count].dte.cts_io_num = UART_PIN_NO_CHANGE;
+    instances[count].dte.flow_control = MODEM_FLOW_CONTROL_NONE;
+    instances[count].dte.dtr_io_num = -1;
+    instances[count].dte.dcd_io_num = -1;
+    instances[count].dce.pwrkey_io_num = CONFIG_EXAMPLE_MODEM2_PWRKEY;
+    instances[count].dce.reset_io_num = -1;
+    instances[count].dce.status_io_num = CONFIG_EXAMPLE_MODEM2_STATUS;
+    count++;
+#endif
+#ifdef CONFIG_EXAMPLE_MODEM3_UART_PORT
+    instances[count].dte.port_num = CONFIG_EXAMPLE_MODEM3_UART_PORT;
+    instances[count].dte.tx_io_num = CONFIG_EXAMPLE_MODEM3_TX_PIN;
+    instances[count].dte.rx_io_num = CONFIG_EXAMPLE_MODEM3_RX_PIN;
+    /* Only TX and RX are wired, RTS and CTS stay with the first modem */
+    instances[count].dte.rts_io_num = UART_PIN_NO_CHANGE;
+    instances[count].dte.cts_io_num = UART_PIN_NO_CHANGE;
+    instances[count].dte.flow_control = MODEM_FLOW_CONTROL_NONE;
+    instances[count].dte.dtr_io_num = -1;
+    instances[count].dte.dcd_io_num = -1;
+    instances[count].dce.pwrkey_io_num = CONFIG_EXAMPLE_MODEM3_PWRKEY;
+    instances[count].dce.reset_io_num = -1;
+    instances[count].dce.status_io_num = CONFIG_EXAMPLE_MODEM3_STATUS;
+    count++;
+#endif
+    modem_bench_run(instances, count, CONFIG_EXAMPLE_MODEM_BENCH_MS);
+}
+#endif
+
 void app_main(void)
 {
     esp_log_level_set("*", ESP_LOG_VERBOSE);
 
+    /* NVS holds the modem identity cache */
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+
 #if CONFIG_LWIP_PPP_PAP_SUPPORT
     esp_netif_auth_type_t auth_type = NETIF_PPP_AUTHTYPE_PAP;
 #elif CONFIG_LWIP_PPP_CHAP_SUPPORT
@@ -234,33 +431,64 @@ void app_main(void)
     esp_netif_t *esp_netif = esp_netif_new(&cfg);
     assert(esp_netif);
 
+#if CONFIG_EXAMPLE_MODEM_BENCH_MS
+    example_modem_bench();
+#endif
+
     /* create dte object */
     esp_modem_dte_config_t config = ESP_MODEM_DTE_DEFAULT_CONFIG();
+    esp_modem_dce_config_t dce_config = ESP_MODEM_DCE_DEFAULT_CONFIG(CONFIG_EXAMPLE_MODEM_APN);
+    example_modem_config(&config, &dce_config);
     modem_dte_t *dte = esp_modem_dte_init(&config);
     /* Register event handler */
     ESP_ERROR_CHECK(esp_modem_set_event_handler(dte, modem_event_handler, ESP_EVENT_ANY_ID, NULL));
-    /* create dce object */
+    /* create dce object, on wake from deep sleep the module is still up with the data call suspended */
+    bool restored = false;
 #if CONFIG_EXAMPLE_MODEM_DEVICE_SIM800
-    modem_dce_t *dce = sim800_init(dte);
+    modem_dce_t *dce = sim800_init(dte, &dce_config);
     ESP_LOGD(TAG, "Device SIM800 is init()");
     assert(dce);
-    ESP_ERROR_CHECK(dce->power_up());
-    ESP_LOGD(TAG, "Device SIM800 is power_up()");
-    ESP_ERROR_CHECK(dce->open(dce));
-    ESP_LOGD(TAG, "Device SIM800 is open()");
+    restored = esp_modem_sleep_restore(dce) == ESP_OK;
+    if (!restored) {
+        ESP_ERROR_CHECK(dce->power_up(dce));
+        ESP_LOGD(TAG, "Device SIM800 is power_up()");
+        ESP_ERROR_CHECK(dce->open(dce));
+        ESP_LOGD(TAG, "Device SIM800 is open()");
+    }
+#elif CONFIG_EXAMPLE_MODEM_DEVICE_SIM7000
+    modem_dce_t *dce = sim7000_init(dte, &dce_config);
+    assert(dce);
+    restored = esp_modem_sleep_restore(dce) == ESP_OK;
+    if (!restored) {
+        ESP_ERROR_CHECK(dce->power_up(dce));
+        ESP_ERROR_CHECK(dce->open(dce));
+#ifdef CONFIG_EXAMPLE_MODEM_SIM7000_LTE_MODE
+        /* Scanning a single LTE category shortens the attach */
+        ESP_ERROR_CHECK(sim7000_set_network_mode(dce, SIM7000_NETWORK_MODE_LTE, CONFIG_EXAMPLE_MODEM_SIM7000_LTE_MODE));
+#endif
+    }
 #elif CONFIG_EXAMPLE_MODEM_DEVICE_BG96
-    modem_dce_t *dce = bg96_init(dte);
+    modem_dce_t *dce = bg96_init(dte, &dce_config);
+    assert(dce);
+    restored = esp_modem_sleep_restore(dce) == ESP_OK;
 #else
 #error "Unsupported DCE"
 #endif
-    ESP_ERROR_CHECK(dce->set_flow_ctrl(dce, MODEM_FLOW_CONTROL_NONE));
-    ESP_ERROR_CHECK(dce->store_profile(dce));
+    ESP_ERROR_CHECK(esp_modem_set_event_handler(dte, modem_timeline_handler, ESP_MODEM_EVENT_TIMELINE, dce));
+    if (!restored) {
+        ESP_ERROR_CHECK(dce->set_flow_ctrl(dce, MODEM_FLOW_CONTROL_NONE));
+        ESP_ERROR_CHECK(dce->store_profile(dce));
+    }
 
     /* Print Module ID, Operator, IMEI, IMSI */
-    ESP_LOGI(TAG, "Module: %s", dce->name);
-    ESP_LOGI(TAG, "Operator: %s", dce->oper);
-    ESP_LOGI(TAG, "IMEI: %s", dce->imei);
-    ESP_LOGI(TAG, "IMSI: %s", dce->imsi);
+    ESP_LOGI(TAG, "Module: %s", esp_modem_identity_get_module_name(dce));
+    /* Queried on first access, then copied as the background refresh may rewrite it */
+    char oper[MODEM_MAX_OPERATOR_LENGTH];
+    esp_modem_identity_get_operator(dce);
+    esp_modem_identity_copy_operator(dce, oper, sizeof(oper));
+    ESP_LOGI(TAG, "Operator: %s", oper);
+    ESP_LOGI(TAG, "IMEI: %s", esp_modem_identity_get_imei(dce));
+    ESP_LOGI(TAG, "IMSI: %s", esp_modem_identity_get_imsi(dce));
     /* Get signal quality */
     uint32_t rssi = 0, ber = 0;
     ESP_ERROR_CHECK(dce->get_signal_quality(dce, &rssi, &ber));
@@ -270,14 +498,134 @@ void app_main(void)
     ESP_ERROR_CHECK(dce->get_battery_status(dce, &bcs, &bcl, &voltage));
     ESP_LOGI(TAG, "Battery voltage: %d mV", voltage);
 
+    /* Attach to the network, steered by the hints of the last attach */
+    esp_modem_rat_handle_t rat_policy = NULL;
+    /* Link measures of this session for the policy, end to end, 0 if the exchange is not configured */
+    uint32_t link_rtt_ms = 0, link_bps = 0;
+    if (!restored) {
+#ifdef CONFIG_EXAMPLE_MODEM_RAT_POLICY
+        /* On the technology that performed best at this site, the module chooses after a failure */
+        esp_modem_rat_config_t rat_config = ESP_MODEM_RAT_DEFAULT_CONFIG();
+        rat_policy = esp_modem_rat_init(dce, &rat_config);
+        assert(rat_policy);
+        esp_err_t attach_err = ESP_FAIL;
+        for (int attempt = 0; attempt < 2 && attach_err != ESP_OK; attempt++) {
+            ESP_ERROR_CHECK(esp_modem_rat_apply(rat_policy, NULL));
+            int64_t attach_start = esp_timer_get_time();
+            attach_err = esp_modem_attach_network(dce, 120000);
+            esp_modem_rat_record_attach(rat_policy, attach_err == ESP_OK, (esp_timer_get_time() - attach_start) / 1000);
+        }
+        ESP_ERROR_CHECK(attach_err);
+#else
+        ESP_ERROR_CHECK(esp_modem_attach_network(dce, 120000));
+#endif
+        esp_modem_attach_metrics_t metrics;
+        if (esp_modem_attach_get_metrics(dce, &metrics) == ESP_OK) {
+            ESP_LOGI(TAG, "Attach: %d ms, hinted %d (avg %d ms), full search %d (avg %d ms), failures %d",
+                     metrics.last_ms, metrics.hinted, metrics.hinted_avg_ms, metrics.full_search,
+                     metrics.full_search_avg_ms, metrics.failures);
+        }
+    }
+
+#ifdef CONFIG_EXAMPLE_MODEM_BULK_APN
+    /* Telemetry on the private APN, downloads on the public one, defined at once */
+    if (!restored) {
+        const modem_pdp_context_t contexts[] = {
+            {.cid = 1, .type = "IP", .apn = CONFIG_EXAMPLE_MODEM_APN},
+            {.cid = 2, .type = "IP", .apn = CONFIG_EXAMPLE_MODEM_BULK_APN}
+        };
+        ESP_ERROR_CHECK(esp_modem_dce_define_pdp_contexts(dce, contexts, 2));
+    }
+#endif
+    /* Heap left before the data path is set up, to compare PPP with the MQTT offload */
+    size_t heap_before = esp_get_free_heap_size();
+#ifdef CONFIG_EXAMPLE_MODEM_MQTT_OFFLOAD
+    /* MQTT on the client of the module, neither PPP, lwIP nor esp-mqtt carry the session */
+    esp_modem_mqtt_config_t offload_config = ESP_MODEM_MQTT_DEFAULT_CONFIG();
+    offload_config.uri = BROKER_URL;
+    offload_config.event_handle = mqtt_offload_event_handler;
+    esp_modem_mqtt_client_handle_t offload_client = esp_modem_mqtt_client_init(dce, &offload_config);
+    assert(offload_client);
+    ESP_ERROR_CHECK(esp_modem_mqtt_client_start(offload_client));
+    xEventGroupWaitBits(event_group, GOT_DATA_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+    ESP_LOGI(TAG, "MQTT offload heap: %d bytes used, minimum free %d bytes",
+             (int)(heap_before - esp_get_free_heap_size()), esp_get_minimum_free_heap_size());
+    esp_modem_mqtt_stats_t offload_stats;
+    esp_modem_mqtt_client_get_stats(offload_client, &offload_stats);
+    ESP_LOGI(TAG, "MQTT offload usage: %d published, %d received, %d dropped, %d truncated, rx %llu, tx %llu bytes",
+             offload_stats.published, offload_stats.received, offload_stats.dropped, offload_stats.truncated,
+             offload_stats.rx_bytes, offload_stats.tx_bytes);
+    ESP_ERROR_CHECK(esp_modem_mqtt_client_destroy(offload_client));
+#else
     /* setup PPPoS network parameters */
     esp_netif_ppp_set_auth(esp_netif, auth_type, CONFIG_EXAMPLE_MODEM_PPP_AUTH_USERNAME, CONFIG_EXAMPLE_MODEM_PPP_AUTH_PASSWORD);
     void *modem_netif_adapter = esp_modem_netif_setup(dte);
     esp_modem_netif_set_default_handlers(modem_netif_adapter, esp_netif);
+    /* Watch the link from now on, registration URCs are enabled while still in command mode */
+    esp_modem_supervisor_config_t supervisor_config = ESP_MODEM_SUPERVISOR_DEFAULT_CONFIG(esp_netif);
+    esp_modem_supervisor_handle_t supervisor = esp_modem_supervisor_start(dte, &supervisor_config);
+    assert(supervisor);
+#ifdef CONFIG_EXAMPLE_MODEM_PSM_TAU_SEC
+    /* Sleep between the periodic updates, the timers the network grants come with +CEREG */
+    if (!restored && dce->set_psm) {
+        ESP_ERROR_CHECK(dce->set_psm(dce, true, CONFIG_EXAMPLE_MODEM_PSM_TAU_SEC, CONFIG_EXAMPLE_MODEM_PSM_ACTIVE_SEC));
+    }
+#endif
+#if CONFIG_EXAMPLE_MODEM_CMUX
+    /* Keep an AT channel next to the data call, a restored session runs without the multiplexer */
+    if (!restored) {
+        ESP_ERROR_CHECK(esp_modem_start_cmux(dte));
+    }
+#endif
     /* attach the modem to the network interface */
     esp_netif_attach(esp_netif, modem_netif_adapter);
+    /* Probe the link while idle, a stall is reported to the supervisor */
+    esp_modem_keepalive_config_t keepalive_config = ESP_MODEM_KEEPALIVE_DEFAULT_CONFIG();
+    ESP_ERROR_CHECK(esp_modem_netif_start_keepalive(modem_netif_adapter, &keepalive_config));
     /* Wait for IP address */
-    xEventGroupWaitBits(event_group, CONNECT_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+    EventBits_t bits = xEventGroupWaitBits(event_group, CONNECT_BIT, pdTRUE, pdTRUE,
+                                           restored ? pdMS_TO_TICKS(30000) : portMAX_DELAY);
+    if (!(bits & CONNECT_BIT)) {
+        /* The peer did not take the restored session, start over with a full bring-up */
+        ESP_LOGW(TAG, "Restored session failed");
+        esp_modem_sleep_invalidate();
+        /* The module would keep the suspended call through the restart, hang it up or power down */
+        if (esp_modem_stop_ppp(dte) != ESP_OK) {
+            dce->power_down(dce);
+        }
+        esp_restart();
+    }
+#ifdef CONFIG_EXAMPLE_MODEM_BULK_APN
+    /* One modem dials one context, both classes share it; splitting them takes a second modem dialing context 2 */
+    esp_modem_route_set(ESP_MODEM_TRAFFIC_CONTROL, esp_netif);
+    esp_modem_route_set(ESP_MODEM_TRAFFIC_BULK, esp_netif);
+#endif
+    esp_netif_ip_info_t saved_ip, ip;
+    if (esp_modem_sleep_get_ip_info(&saved_ip) == ESP_OK && esp_netif_get_ip_info(esp_netif, &ip) == ESP_OK) {
+        ESP_LOGI(TAG, "Session restored, address %s", saved_ip.ip.addr == ip.ip.addr ? "kept" : "changed");
+    }
+    /* The clock was set from network time on attach, TLS and timestamps need not wait for SNTP */
+    ESP_LOGI(TAG, "System clock quality at IP: %d", esp_modem_time_get_quality());
+#ifdef CONFIG_EXAMPLE_MODEM_SNTP_SERVER
+    /* SNTP refines the clock in the background */
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, CONFIG_EXAMPLE_MODEM_SNTP_SERVER);
+    sntp_set_time_sync_notification_cb(esp_modem_time_sntp_synced);
+    sntp_init();
+#endif
+
+    /* Sample the radio in the background, without tearing down the PPP session */
+    esp_modem_radio_config_t radio_config = ESP_MODEM_RADIO_DEFAULT_CONFIG();
+#if CONFIG_EXAMPLE_MODEM_DEVICE_SIM800
+    radio_config.cell_query = "+CENG?";
+    radio_config.cell_setup = "AT+CENG=1,0\r";
+#elif CONFIG_EXAMPLE_MODEM_DEVICE_SIM7000
+    radio_config.cell_query = "+CPSI?";
+#elif CONFIG_EXAMPLE_MODEM_DEVICE_BG96
+    radio_config.cell_query = "+QENG=\"servingcell\"";
+#endif
+    esp_modem_radio_handle_t radio = esp_modem_radio_start(dte, &radio_config);
+    assert(radio);
 
     /* Config MQTT */
     esp_mqtt_client_config_t mqtt_config = {
@@ -287,7 +635,49 @@ void app_main(void)
     esp_mqtt_client_handle_t mqtt_client = esp_mqtt_client_init(&mqtt_config);
     esp_mqtt_client_start(mqtt_client);
     xEventGroupWaitBits(event_group, GOT_DATA_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+    ESP_LOGI(TAG, "PPP and esp-mqtt heap: %d bytes used, minimum free %d bytes",
+             (int)(heap_before - esp_get_free_heap_size()), esp_get_minimum_free_heap_size());
     esp_mqtt_client_destroy(mqtt_client);
+#ifdef CONFIG_EXAMPLE_MODEM_PSM_TAU_SEC
+    /* End of the burst, go idle without waiting for the inactivity timer of the network */
+    esp_err_t release_err = esp_modem_release_connection(dte);
+    if (release_err == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGI(TAG, "Early release not supported");
+    } else if (release_err == ESP_ERR_INVALID_STATE) {
+        ESP_LOGI(TAG, "Early release needs CMUX while PPP runs");
+    }
+#endif
+
+    esp_modem_radio_status_t radio_status;
+    if (esp_modem_radio_get(radio, &radio_status, 0) == ESP_OK) {
+        ESP_LOGI(TAG, "Last radio sample: rssi %d, voltage %d mV", radio_status.rssi, radio_status.voltage);
+    }
+    ESP_ERROR_CHECK(esp_modem_radio_stop(radio));
+    /* Stopping PPP on purpose is not a link loss */
+    ESP_ERROR_CHECK(esp_modem_netif_stop_keepalive(modem_netif_adapter));
+    ESP_ERROR_CHECK(esp_modem_supervisor_stop(supervisor));
+    esp_modem_netif_stats_t netif_stats;
+    esp_modem_netif_get_stats(modem_netif_adapter, &netif_stats);
+    ESP_LOGI(TAG, "Data usage: rx %llu, tx %llu bytes, keepalive rx %d, tx %d bytes, %d echoes, interval %d ms",
+             netif_stats.rx_bytes, netif_stats.tx_bytes, netif_stats.keepalive_rx_bytes, netif_stats.keepalive_tx_bytes,
+             netif_stats.keepalive_echoes, netif_stats.keepalive_interval_ms);
+    xEventGroupClearBits(event_group, STOP_BIT);
+#ifdef CONFIG_EXAMPLE_MODEM_PSM_TAU_SEC
+    modem_power_save_t power_save;
+    esp_modem_dce_read_power_save(dce, &power_save);
+    ESP_LOGI(TAG, "PSM %s, tau %d s, active time %d s, eDRX cycle %d ms", power_save.psm ? "granted" : "not granted",
+             power_save.periodic_tau_s, power_save.active_time_s, power_save.edrx_cycle_ms);
+    ESP_LOGI(TAG, "Last connection %d ms, %s", power_save.last_connected_ms,
+             power_save.connected ? "still connected" : power_save.last_release_ms ? "released early" : "released by the network");
+#endif
+
+#if CONFIG_EXAMPLE_DEEP_SLEEP_SEC
+    /* Keep the data call up while sleeping, the next wake up skips open, attach and dial */
+    if (esp_modem_sleep_prepare(dte, esp_netif) == ESP_OK) {
+        ESP_LOGI(TAG, "Deep sleep for %d s", CONFIG_EXAMPLE_DEEP_SLEEP_SEC);
+        esp_deep_sleep(CONFIG_EXAMPLE_DEEP_SLEEP_SEC * 1000000ULL);
+    }
+#endif
 
     /* Exit PPP mode */
     ESP_ERROR_CHECK(esp_modem_stop_ppp(dte));
@@ -295,6 +685,100 @@ void app_main(void)
     esp_modem_netif_clear_default_handlers(modem_netif_adapter);
     esp_modem_netif_teardown(modem_netif_adapter);
     xEventGroupWaitBits(event_group, STOP_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+#if CONFIG_EXAMPLE_MODEM_CMUX
+    if (esp_modem_is_cmux(dte)) {
+        ESP_ERROR_CHECK(esp_modem_stop_cmux(dte));
+    }
+#endif
+#endif
+
+#ifdef CONFIG_EXAMPLE_MODEM_SOCKET_HOST
+    /* A telemetry report over the IP stack of the module, no PPP nor lwIP on the ESP32 */
+    esp_modem_socket_layer_handle_t sockets = esp_modem_socket_init(dce);
+    if (sockets) {
+        int s = esp_modem_socket_open(sockets, MODEM_SOCKET_TCP);
+        if (s >= 0 && esp_modem_socket_connect(sockets, s, CONFIG_EXAMPLE_MODEM_SOCKET_HOST,
+                                               CONFIG_EXAMPLE_MODEM_SOCKET_PORT) == ESP_OK) {
+            char report[64];
+            int len = snprintf(report, sizeof(report), "rssi=%d voltage=%d\n", rssi, voltage);
+            int64_t sent = esp_timer_get_time();
+            esp_modem_socket_send(sockets, s, report, len);
+            len = esp_modem_socket_recv(sockets, s, report, sizeof(report) - 1, 10000);
+            ESP_LOGI(TAG, "Socket reply: %d bytes", len);
+            if (len > 0) {
+                /* Report and reply, through the radio and the server, unlike the LCP echo the module answers */
+                link_rtt_ms = (esp_timer_get_time() - sent) / 1000;
+            }
+        }
+        if (s >= 0) {
+            esp_modem_socket_close(sockets, s);
+        }
+        esp_modem_socket_stats_t socket_stats;
+        esp_modem_socket_get_stats(sockets, &socket_stats);
+        ESP_LOGI(TAG, "Socket usage: rx %llu, tx %llu bytes", socket_stats.rx_bytes, socket_stats.tx_bytes);
+        ESP_ERROR_CHECK(esp_modem_socket_deinit(sockets));
+    }
+#endif
+
+#ifdef CONFIG_EXAMPLE_MODEM_DOWNLOAD_URL
+    /* A bulk download by the HTTP client of the module, each chunk written to flash as it is read */
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                                CONFIG_EXAMPLE_MODEM_DOWNLOAD_PARTITION);
+    if (partition) {
+        esp_modem_download_partition_t storage;
+        esp_modem_download_config_t download_config = ESP_MODEM_DOWNLOAD_DEFAULT_CONFIG();
+        download_config.url = CONFIG_EXAMPLE_MODEM_DOWNLOAD_URL;
+        esp_modem_download_stats_t download_stats;
+        ESP_ERROR_CHECK(esp_modem_download_partition_init(&storage, partition, download_config.offset));
+        if (esp_modem_download(dce, &download_config, esp_modem_download_partition_write, &storage,
+                               &download_stats) != ESP_OK) {
+            ESP_LOGW(TAG, "Download stopped, resume from %d bytes", download_stats.offset);
+        } else if (download_stats.duration_ms) {
+            link_bps = (uint64_t)(download_stats.offset - download_config.offset) * 1000 / download_stats.duration_ms;
+        }
+    }
+#endif
+#if defined(CONFIG_EXAMPLE_MODEM_GNSS) && defined(CONFIG_EXAMPLE_MODEM_AGNSS)
+    /* Assistance data refreshed on the IP session of the download if still up, only once it is about to expire */
+    esp_modem_agnss_config_t agnss_config = ESP_MODEM_AGNSS_DEFAULT_CONFIG();
+    esp_modem_agnss_handle_t agnss = esp_modem_agnss_init(dce, &agnss_config);
+    if (agnss) {
+        if (esp_modem_agnss_refresh(agnss, false) != ESP_OK) {
+            ESP_LOGW(TAG, "A-GNSS refresh failed, cold start without assistance");
+        }
+        ESP_ERROR_CHECK(esp_modem_agnss_deinit(agnss));
+    }
+#endif
+#if defined(CONFIG_EXAMPLE_MODEM_DOWNLOAD_URL) || (defined(CONFIG_EXAMPLE_MODEM_GNSS) && defined(CONFIG_EXAMPLE_MODEM_AGNSS))
+    /* One IP session for the download and the refresh, down before the receiver takes the radio */
+    if (dce->set_socket_stack) {
+        dce->set_socket_stack(dce, false);
+    }
+#endif
+    if (rat_policy) {
+        /* Without the socket report or the download, only the attach time compares the technologies */
+        esp_modem_rat_record_link(rat_policy, link_bps, link_rtt_ms);
+        ESP_ERROR_CHECK(esp_modem_rat_deinit(rat_policy));
+    }
+
+#ifdef CONFIG_EXAMPLE_MODEM_GNSS
+    /* Position from the receiver of the module, polled from the latest fix without AT round trip */
+    esp_modem_gnss_config_t gnss_config = ESP_MODEM_GNSS_DEFAULT_CONFIG();
+    esp_modem_gnss_handle_t gnss = esp_modem_gnss_start(dce, &gnss_config);
+    if (gnss) {
+        esp_modem_gnss_fix_t fix;
+        for (int i = 0; i < 120 && esp_modem_gnss_get_fix(gnss, &fix) != ESP_OK; i++) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+        if (esp_modem_gnss_get_fix(gnss, &fix) == ESP_OK) {
+            esp_modem_gnss_stats_t gnss_stats;
+            ESP_ERROR_CHECK(esp_modem_gnss_get_stats(gnss, &gnss_stats));
+            ESP_LOGI(TAG, "GNSS fix: lat %d, lon %d (1e-7 deg), alt %d cm, %d satellites, TTFF %d ms", fix.latitude,
+                     fix.longitude, fix.altitude, fix.satellites, gnss_stats.ttff_ms);
+        }
+        ESP_ERROR_CHECK(esp_modem_gnss_stop(gnss));
+    }
+#endif
 
 #if CONFIG_EXAMPLE_SEND_MSG
     const char *message = "Welcome to ESP32!";
@@ -0,0 +1,139 @@
+/* Modem Scaling Benchmark
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdlib.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "sim800.h"
+#include "sim7000.h"
+#include "bg96.h"
+#include "modem_bench.h"
+
+#define MODEM_BENCH_MAX_INSTANCES (3)
+
+static const char *TAG = "modem-bench";
+
+/**
+ * @brief Load of one instance during a step
+ *
+ */
+typedef struct {
+    modem_dce_t *dce;           /*!< Instance under load */
+    uint32_t duration_ms;       /*!< Duration of the step */
+    uint32_t commands;          /*!< Commands answered */
+    uint32_t failures;          /*!< Commands failed or timed out */
+    uint32_t max_latency_us;    /*!< Worst command latency */
+    SemaphoreHandle_t done;     /*!< Given once the step is over */
+} modem_bench_load_t;
+
+static void modem_bench_load_task(void *param)
+{
+    modem_bench_load_t *load = param;
+    int64_t end = esp_timer_get_time() + load->duration_ms * 1000LL;
+    uint32_t rssi, ber;
+    while (esp_timer_get_time() < end) {
+        int64_t start = esp_timer_get_time();
+        if (load->dce->get_signal_quality(load->dce, &rssi, &ber) == ESP_OK) {
+            uint32_t latency = esp_timer_get_time() - start;
+            load->commands++;
+            if (latency > load->max_latency_us) {
+                load->max_latency_us = latency;
+            }
+        } else {
+            load->failures++;
+        }
+    }
+    xSemaphoreGive(load->done);
+    vTaskDelete(NULL);
+}
+
+static modem_dce_t *modem_bench_init(const modem_bench_instance_t *instance)
+{
+    modem_dte_t *dte = esp_modem_dte_init(&instance->dte);
+    if (!dte) {
+        return NULL;
+    }
+#if CONFIG_EXAMPLE_MODEM_DEVICE_SIM800
+    modem_dce_t *dce = sim800_init(dte, &instance->dce);
+    if (dce && (dce->power_up(dce) != ESP_OK || dce->open(dce) != ESP_OK)) {
+        dce->deinit(dce);
+        dce = NULL;
+    }
+#elif CONFIG_EXAMPLE_MODEM_DEVICE_SIM7000
+    modem_dce_t *dce = sim7000_init(dte, &instance->dce);
+    if (dce && (dce->power_up(dce) != ESP_OK || dce->open(dce) != ESP_OK)) {
+        dce->deinit(dce);
+        dce = NULL;
+    }
+#elif CONFIG_EXAMPLE_MODEM_DEVICE_BG96
+    modem_dce_t *dce = bg96_init(dte, &instance->dce);
+#endif
+    if (!dce) {
+        dte->deinit(dte);
+    }
+    return dce;
+}
+
+void modem_bench_run(const modem_bench_instance_t *instances, int count, uint32_t duration_ms)
+{
+    modem_dce_t *dces[MODEM_BENCH_MAX_INSTANCES] = {0};
+    modem_bench_load_t loads[MODEM_BENCH_MAX_INSTANCES];
+    uint32_t single_rate = 0;
+    count = MIN(count, MODEM_BENCH_MAX_INSTANCES);
+    for (int i = 0; i < count; i++) {
+        uint32_t heap = esp_get_free_heap_size();
+        dces[i] = modem_bench_init(&instances[i]);
+        if (!dces[i]) {
+            ESP_LOGE(TAG, "instance %d on uart %d failed to come up", i, instances[i].dte.port_num);
+            count = i;
+            break;
+        }
+        ESP_LOGI(TAG, "instance %d on uart %d: %d bytes of heap", i, instances[i].dte.port_num,
+                 heap - esp_get_free_heap_size());
+    }
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(MODEM_BENCH_MAX_INSTANCES, 0);
+    for (int n = 1; n <= count && done; n++) {
+        for (int i = 0; i < n; i++) {
+            loads[i] = (modem_bench_load_t) {
+                .dce = dces[i],
+                .duration_ms = duration_ms,
+                .done = done
+            };
+            xTaskCreate(modem_bench_load_task, "modem_bench", 3072, &loads[i], 5, NULL);
+        }
+        uint32_t commands = 0, failures = 0, max_latency_us = 0;
+        for (int i = 0; i < n; i++) {
+            xSemaphoreTake(done, portMAX_DELAY);
+        }
+        for (int i = 0; i < n; i++) {
+            commands += loads[i].commands;
+            failures += loads[i].failures;
+            max_latency_us = MAX(max_latency_us, loads[i].max_latency_us);
+        }
+        uint32_t rate = commands * 1000ULL / duration_ms;
+        if (n == 1) {
+            single_rate = rate;
+        }
+        ESP_LOGI(TAG, "%d instance(s): %d cmd/s (%d%% of linear), %d failed, worst latency %d ms, free heap %d",
+                 n, rate, single_rate ? (int)(rate * 100 / (single_rate * n)) : 0, failures,
+                 max_latency_us / 1000, esp_get_free_heap_size());
+    }
+    if (done) {
+        vSemaphoreDelete(done);
+    }
+    for (int i = 0; i < count; i++) {
+        modem_dte_t *dte = dces[i]->dte;
+        dces[i]->deinit(dces[i]);
+        dte->deinit(dte);
+    }
+}
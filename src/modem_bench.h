@@ -0,0 +1,33 @@
+/* Modem Scaling Benchmark
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include "esp_modem.h"
+
+/**
+ * @brief One modem of the benchmark, on its own UART
+ *
+ */
+typedef struct {
+    esp_modem_dte_config_t dte; /*!< UART, pins, buffers and task of the instance */
+    esp_modem_dce_config_t dce; /*!< GPIOs of the module */
+} modem_bench_instance_t;
+
+/**
+ * @brief Measure how modem instances scale on one ESP32
+ *
+ * All instances are brought up, then for 1 to count instances side by side, each instance sends
+ * AT+CSQ in a loop from its own task for duration_ms. Heap taken by each instance, commands per
+ * second and worst command latency are logged per step, the instances are torn down at the end.
+ *
+ * @param instances modems to bring up
+ * @param count number of modems
+ * @param duration_ms duration of each step
+ */
+void modem_bench_run(const modem_bench_instance_t *instances, int count, uint32_t duration_ms);
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Render boot to IP timelines collected from device logs.
+
+Devices log one line per bring-up, as formatted by esp_modem_timeline_format():
+
+    I (23456) pppos-example: TIMELINE imei=866... oper="Carrier" power_up=310+7820 open=8130+1210 ...
+
+Each phase is "<name>=<start>+<duration>[/<retries>]", unit: ms since boot. The operator name is
+double quoted with '"' and '\\' escaped by a backslash, so that it may hold spaces.
+
+    tools/modem_timeline.py logs/*.log                  one row per bring-up
+    tools/modem_timeline.py --bars logs/*.log           same, with a chart of the phases
+    tools/modem_timeline.py --group-by oper logs/*.log  median and p90 per carrier
+    tools/modem_timeline.py --baseline old/*.log -- logs/*.log
+                                                        flag phases slower than the baseline
+"""
+
+import argparse
+import re
+import shlex
+import sys
+
+PHASES = ['power_up', 'open', 'attach', 'dial', 'ppp']
+PHASE_RE = re.compile(r'^(\w+)=(\d+)\+(\d+)(?:/(\d+))?$')
+COLOR_RE = re.compile(r'\x1b\[[0-9;]*m')
+BAR_WIDTH = 60
+BAR_CHARS = {'power_up': 'P', 'open': 'O', 'attach': 'A', 'dial': 'D', 'ppp': '#'}
+
+
+def parse_line(line, source):
+    # Colored logs end the line with a reset sequence, it would stick to the last phase
+    line = COLOR_RE.sub('', line)
+    pos = line.find('TIMELINE ')
+    if pos < 0:
+        return None
+    record = {'source': source, 'imei': '-', 'oper': '', 'phases': {}}
+    try:
+        tokens = shlex.split(line[pos + len('TIMELINE '):].strip())
+    except ValueError:
+        return None
+    for token in tokens:
+        match = PHASE_RE.match(token)
+        if match and match.group(1) in PHASES:
+            start, duration, retries = int(match.group(2)), int(match.group(3)), int(match.group(4) or 0)
+            record['phases'][match.group(1)] = (start, duration, retries)
+        elif '=' in token:
+            key, value = token.split('=', 1)
+            record[key] = value
+    if not record['phases']:
+        return None
+    last = max(start + duration for start, duration, _ in record['phases'].values())
+    record['total'] = last if 'ppp' in record['phases'] else None
+    return record
+
+
+def load(paths):
+    records = []
+    for path in paths:
+        with open(path, errors='replace') as f:
+            for line in f:
+                record = parse_line(line, path)
+                if record:
+                    records.append(record)
+    return records
+
+
+def percentile(values, pct):
+    if not values:
+        return None
+    values = sorted(values)
+    index = min(len(values) - 1, int(round(pct / 100.0 * (len(values) - 1))))
+    return values[index]
+
+
+def fmt(value):
+    return '-' if value is None else str(value)
+
+
+def durations(records, phase):
+    return [r['phases'][phase][1] for r in records if phase in r['phases']]
+
+
+def totals(records):
+    return [r['total'] for r in records if r['total'] is not None]
+
+
+def print_records(records, bars):
+    header = ['imei', 'oper'] + PHASES + ['total']
+    rows = []
+    for r in records:
+        row = [r['imei'], r['oper']]
+        for phase in PHASES:
+            span = r['phases'].get(phase)
+            row.append('-' if span is None else '%d%s' % (span[1], '/%d' % span[2] if span[2] else ''))
+        row.append(fmt(r['total']))
+        rows.append(row)
+    print_table(header, rows)
+    if bars:
+        scale = max(max(s + d for s, d, _ in r['phases'].values()) for r in records) / float(BAR_WIDTH)
+        print()
+        for r in records:
+            line = [' '] * BAR_WIDTH
+            for phase in PHASES:
+                if phase not in r['phases']:
+                    continue
+                start, duration, _ = r['phases'][phase]
+                first = min(BAR_WIDTH - 1, int(start / scale))
+                last = max(first, min(BAR_WIDTH - 1, int((start + duration) / scale)))
+                for i in range(first, last + 1):
+                    line[i] = BAR_CHARS[phase]
+            print('%-16s |%s|' % (r['imei'][-16:], ''.join(line)))
+        print('%-16s  %s' % ('', '  '.join('%s=%s' % (BAR_CHARS[p], p) for p in PHASES)))
+
+
+def summarize(records):
+    row = [str(len(records))]
+    for phase in PHASES + ['total']:
+        values = totals(records) if phase == 'total' else durations(records, phase)
+        row.append('%s/%s' % (fmt(percentile(values, 50)), fmt(percentile(values, 90))))
+    return row
+
+
+def print_groups(records, key):
+    groups = {}
+    for r in records:
+        groups.setdefault(r.get(key, ''), []).append(r)
+    header = [key, 'count'] + ['%s p50/p90' % p for p in PHASES + ['total']]
+    rows = [[name or '-'] + summarize(groups[name]) for name in sorted(groups)]
+    print_table(header, rows)
+
+
+def compare(baseline, records, threshold):
+    header = ['phase', 'baseline p50', 'current p50', 'change']
+    rows = []
+    regressions = 0
+    for phase in PHASES + ['total']:
+        if phase == 'total':
+            old, new = percentile(totals(baseline), 50), percentile(totals(records), 50)
+        else:
+            old, new = percentile(durations(baseline, phase), 50), percentile(durations(records, phase), 50)
+        change = '-'
+        if old and new is not None:
+            pct = (new - old) * 100.0 / old
+            change = '%+.1f%%' % pct
+            if pct > threshold:
+                change += '  REGRESSION'
+                regressions += 1
+        rows.append([phase, fmt(old), fmt(new), change])
+    print_table(header, rows)
+    return regressions
+
+
+def print_table(header, rows):
+    widths = [max(len(str(c)) for c in column) for column in zip(header, *rows)]
+    print('  '.join(h.ljust(w) for h, w in zip(header, widths)).rstrip())
+    print('  '.join('-' * w for w in widths))
+    for row in rows:
+        print('  '.join(str(c).ljust(w) for c, w in zip(row, widths)).rstrip())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Render boot to IP timelines from device logs')
+    parser.add_argument('logs', nargs='+', help='log files captured from the devices')
+    parser.add_argument('--bars', action='store_true', help='draw the phases of each bring-up')
+    parser.add_argument('--group-by', metavar='KEY', help='summarize per key, e.g. oper or imei')
+    parser.add_argument('--baseline', nargs='+', metavar='LOG', help='logs of the reference firmware')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='median increase flagged as regression, unit: percent (default: 10)')
+    args = parser.parse_args()
+
+    records = load(args.logs)
+    if not records:
+        sys.exit('no TIMELINE line found')
+    if args.baseline:
+        baseline = load(args.baseline)
+        if not baseline:
+            sys.exit('no TIMELINE line found in baseline')
+        sys.exit(1 if compare(baseline, records, args.threshold) else 0)
+    if args.group_by:
+        print_groups(records, args.group_by)
+    else:
+        print_records(records, args.bars)
+
+
+if __name__ == '__main__':
+    main()
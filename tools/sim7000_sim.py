@@ -0,0 +1,1137 @@
+#!/usr/bin/env python3
+#
+# Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Simulate the AT interface of a SIM7000 for host testing of the sim7000 driver.
+
+The simulator answers on a pseudo terminal, or on a serial port wired to the UART of an ESP32
+through a USB adapter. It boots, registers on LTE after a delay, answers the commands used by
+the driver and the esp_modem services (+CPSI, +CEREG, +CNMP, +CMNB, +CBANDCFG, +CGDCONT, ...),
+batched on one line or not, and sends the registration URCs. PSM and eDRX are granted as requested;
+data traffic keeps the simulated RRC connection up (+CSCON) until the network inactivity timer, or
+shortly after AT+CNMPSD. Once idle and the active time over without activity, the simulator sleeps
+until the periodic TAU and does not listen to the UART meanwhile, as a module in PSM. Dialing
+enters data mode, left by the escape sequence; URCs are held meanwhile. PPP frames are dropped
+unless a PPP peer is given with --ppp. The application IP stack (+CNACT, +CAOPEN, +CASEND, +CARECV,
++CACLOSE) opens real sockets on the host, with +CADATAIND and +CASTATE as data arrives or the peer
+closes. The MQTT client (+SMCONF, +SMCONN, +SMSUB, +SMUNSUB, +SMPUB, +SMDISC) talks to a loopback
+broker: a message published on a subscribed topic comes back as +SMSUB. The HTTP client (+SHCONF,
++SHCONN, +SHAHEAD, +SHREQ, +SHREAD, +SHDISC) fetches from the real server with the headers added,
+Range included, and hands out the body as is. The GNSS receiver (+CGNSPWR, +CGNSURC, +CGNSTST,
++CGNSINF) fixes after its time to first fix and reports once a second, as +UGNSINF or NMEA. An
+assistance file written to the file system (+CFSINIT, +CFSWFILE, +CFSTERM) and loaded (+CGNSCPY,
++CGNSXTRA) shortens the time to first fix while valid. Network time sets the clock (+CCLK) on
+registration, reported as +CTZV and *PSUTTZ once enabled with AT+CLTS=1.
+
+    tools/sim7000_sim.py                                  on a pseudo terminal, path printed
+    tools/sim7000_sim.py --link /tmp/sim7000              same, with a stable symlink
+    tools/sim7000_sim.py --port /dev/ttyUSB0              on a serial port, to a real ESP32
+    tools/sim7000_sim.py --attach-delay 8 --nb-iot        slow NB-IoT attach
+    tools/sim7000_sim.py --nb-iot-attach-delay 20         NB-IoT much slower than LTE-M at this site
+    tools/sim7000_sim.py --gnss-ttff 5 --gnss-position 48.1173,11.5167
+                                                          quick GNSS fix at a given place
+    tools/sim7000_sim.py --gnss-ttff 40 --xtra-ttff 3 --xtra-validity 1
+                                                          assisted fixes, assistance expiring quickly
+    tools/sim7000_sim.py --ppp 'pppd notty local noauth nodetach 10.64.64.1:10.64.64.2'
+                                                          real PPP peer in data mode
+"""
+
+import argparse
+import os
+import re
+import select
+import shlex
+import socket
+import subprocess
+import sys
+import termios
+import time
+import tty
+import urllib.error
+import urllib.request
+
+IMEI = '869951030000000'
+IMSI = '460110000000000'
+ICCID = '89860000000000000000'
+CONNECT = 'CONNECT 150000000'
+REG_NOT_REGISTERED, REG_HOME, REG_SEARCHING = 0, 1, 2
+NETWORK_MODES = (2, 13, 38, 51)
+# Timer units by unit bits, unit: s, 3GPP TS 24.008 10.5.7.4a and 10.5.7.4
+TAU_UNITS = {0: 600, 1: 3600, 2: 36000, 3: 2, 4: 30, 5: 60, 6: 1152000, 7: 0}
+ACTIVE_TIME_UNITS = {0: 2, 1: 60, 2: 360, 7: 0}
+LTE_MODES = (1, 2, 3)
+# Clock of the module from power on until network time, 1980-01-06 00:00:00 UTC
+CLOCK_RESET = 315964800
+
+
+class Sim7000(object):
+    def __init__(self, args, write):
+        self.args = args
+        self.write = write
+        self.ppp = None
+        self.sockets = {}
+        # Kept in the flash of the module across power cycles
+        self.files = {}
+        self.xtra_loaded = None
+        self.xtra_enabled = False
+        self.power_on()
+
+    def power_on(self):
+        self.boot_until = time.time() + self.args.boot_delay
+        self.booted = False
+        self.echo = True
+        self.cfun = 1
+        self.network_mode = 2
+        self.lte_mode = 2 if self.args.nb_iot else 1
+        self.urc = {'CREG': 0, 'CEREG': 0, 'CGREG': 0}
+        self.contexts = {1: ('IP', '')}
+        self.registration = REG_SEARCHING
+        self.attach_at = self.boot_until + self.attach_delay()
+        self.data_mode = False
+        self.call = False
+        self.line = b''
+        self.last_rx = 0.0
+        self.escape_at = None
+        self.psm = None
+        self.psm_urc = False
+        self.psm_until = None
+        self.edrx = None
+        self.last_activity = time.time()
+        self.cscon_urc = False
+        self.connected = False
+        self.last_traffic = 0.0
+        self.idle_since = self.last_activity
+        self.release_at = None
+        self.held_urcs = []
+        self.deferred_urcs = []
+        self.app_pdp = False
+        self.close_sockets()
+        self.mqtt_config = {}
+        self.mqtt_connected = False
+        self.mqtt_topics = set()
+        self.http_config = {}
+        self.http_connected = False
+        self.http_headers = []
+        self.http_body = b''
+        self.gnss_on = False
+        self.gnss_urc = 0
+        self.gnss_nmea = False
+        self.gnss_since = None
+        self.gnss_ttff = self.args.gnss_ttff
+        self.gnss_next = None
+        self.gnss_count = 0
+        self.fs_init = False
+        self.clts = False
+        self.clock_offset = None
+        self.payload = None
+        self.stop_ppp()
+
+    # Output
+
+    def send(self, text):
+        # Text, or a header line followed by binary data
+        self.write(b'\r\n' + (text if isinstance(text, bytes) else text.encode()) + b'\r\n')
+
+    def send_urc(self, text):
+        if self.args.verbose:
+            sys.stderr.write('URC %s\n' % text)
+        if self.data_mode:
+            # Held until back in command mode, as with the ring indicator off
+            self.held_urcs.append(text)
+        else:
+            self.send(text)
+
+    def send_urc_after(self, text):
+        # After the final result code of the command being answered
+        self.deferred_urcs.append(text)
+
+    def command_mode(self):
+        self.data_mode = False
+        for text in self.held_urcs:
+            self.send(text)
+        self.held_urcs = []
+
+    # Timers
+
+    def tick(self):
+        now = time.time()
+        for text in self.deferred_urcs:
+            self.send_urc(text)
+        self.deferred_urcs = []
+        if not self.booted and now >= self.boot_until:
+            self.booted = True
+            if not self.args.quiet_boot:
+                for urc in ('RDY', '+CFUN: 1', '+CPIN: READY', 'SMS Ready'):
+                    self.send_urc(urc)
+        if self.booted and self.registration != REG_HOME and self.cfun == 1 and now >= self.attach_at:
+            self.set_registration(REG_HOME)
+        if self.connected and (now - self.last_traffic >= self.args.inactivity or
+                               (self.release_at is not None and now >= self.release_at)):
+            self.set_connected(False)
+        if self.psm and self.psm_until is None and not self.call and not self.connected and \
+                self.registration == REG_HOME and \
+                now - max(self.last_activity, self.idle_since) >= timer_seconds(self.psm[1], ACTIVE_TIME_UNITS):
+            # Active time over, asleep until the periodic TAU
+            self.psm_until = now + max(timer_seconds(self.psm[0], TAU_UNITS) - timer_seconds(self.psm[1], ACTIVE_TIME_UNITS), 0)
+            if self.psm_urc:
+                self.send_urc('+CPSMSTATUS: "ENTER PSM"')
+        if self.psm_until is not None and now >= self.psm_until:
+            self.wake_up()
+        if self.gnss_on and now >= self.gnss_next:
+            self.gnss_report(now)
+        if self.escape_at is not None and now - self.escape_at >= self.args.guard:
+            # Guard time after the escape sequence, back to command mode with the call kept up
+            self.escape_at = None
+            self.send('OK')
+            self.command_mode()
+
+    def attach_delay(self):
+        if self.network_mode == 13 and self.args.gsm_attach_delay is not None:
+            return self.args.gsm_attach_delay
+        if self.network_mode != 13 and self.lte_mode == 2 and self.args.nb_iot_attach_delay is not None:
+            return self.args.nb_iot_attach_delay
+        return self.args.attach_delay
+
+    def wake_up(self):
+        self.psm_until = None
+        self.last_activity = time.time()
+        if self.psm_urc:
+            self.send_urc('+CPSMSTATUS: "EXIT PSM"')
+        # Tracking area update
+        self.traffic(self.last_activity)
+
+    def traffic(self, now):
+        self.last_traffic = now
+        self.release_at = None
+        if not self.connected:
+            self.set_connected(True)
+
+    def set_connected(self, connected):
+        self.connected = connected
+        self.release_at = None
+        if not connected:
+            self.idle_since = time.time()
+        if self.cscon_urc:
+            self.send_urc('+CSCON: %d' % connected)
+
+    def set_registration(self, status):
+        if status == self.registration:
+            return
+        self.registration = status
+        if status == REG_HOME and not self.args.no_nitz:
+            self.network_time()
+        for name, mode in self.urc.items():
+            if mode == 1:
+                self.send_urc('+%s: %d' % (name, status))
+            elif mode >= 2:
+                self.send_urc('+%s: %s' % (name, self.location(status, name == 'CEREG' and mode == 4)))
+        if status != REG_HOME and self.call:
+            self.hang_up()
+            if self.data_mode:
+                self.send('NO CARRIER')
+                self.command_mode()
+
+    def location(self, status, timers=False):
+        if status != REG_HOME:
+            return '%d' % status
+        location = '%d,"5A1E","0B28A3BC",%d' % (status, 9 if self.lte_mode == 2 else 7)
+        if timers and self.psm:
+            # Timers granted as requested
+            location += ',,,"%s","%s"' % (self.psm[1], self.psm[0])
+        return location
+
+    # Input
+
+    def receive(self, data):
+        now = time.time()
+        if not self.booted or self.psm_until is not None:
+            # Off or asleep, the UART is not listened to
+            return
+        self.last_activity = now
+        if self.data_mode:
+            self.receive_data(data, now)
+        else:
+            for byte in data:
+                self.receive_command_byte(bytes([byte]))
+        self.last_rx = now
+
+    def receive_data(self, data, now):
+        if data == b'+++' and now - self.last_rx >= self.args.guard:
+            self.escape_at = now
+            return
+        if self.escape_at is not None:
+            # Not an escape sequence after all
+            self.escape_at = None
+            data = b'+++' + data
+        self.traffic(now)
+        if self.ppp:
+            self.ppp.stdin.write(data)
+            self.ppp.stdin.flush()
+
+    def receive_command_byte(self, byte):
+        if self.payload:
+            self.receive_payload_byte(byte)
+            return
+        if self.echo:
+            self.write(byte)
+        if byte == b'\r':
+            line, self.line = self.line.decode(errors='replace').strip(), b''
+            if line:
+                self.execute(line)
+        elif byte != b'\n':
+            self.line += byte
+
+    def receive_payload_byte(self, byte):
+        length, data, done = self.payload
+        data += byte
+        if len(data) < length:
+            self.payload = (length, data, done)
+            return
+        self.payload = None
+        self.send('OK' if done(data) else 'ERROR')
+
+    def socket_send(self, cid, data):
+        entry = self.sockets.get(cid)
+        try:
+            if entry['closed']:
+                raise OSError('closed by the peer')
+            entry['socket'].send(data)
+        except (OSError, TypeError):
+            return False
+        self.traffic(time.time())
+        return True
+
+    def socket_inputs(self):
+        return [entry['socket'] for entry in self.sockets.values() if not entry['closed']]
+
+    def socket_output(self, ready):
+        for cid, entry in list(self.sockets.items()):
+            if entry['socket'] not in ready:
+                continue
+            try:
+                data = entry['socket'].recv(4096)
+            except OSError:
+                data = b''
+            if not data and entry['type'] == 'TCP':
+                # What arrived before stays readable until AT+CACLOSE
+                entry['closed'] = True
+                self.send_urc('+CASTATE: %d,0' % cid)
+                continue
+            self.traffic(time.time())
+            if not entry['rx']:
+                self.send_urc('+CADATAIND: %d' % cid)
+            entry['rx'] += data
+
+    def close_sockets(self):
+        for entry in self.sockets.values():
+            entry['socket'].close()
+        self.sockets = {}
+
+    def ppp_output(self):
+        data = os.read(self.ppp.stdout.fileno(), 4096)
+        if not data:
+            self.hang_up()
+            if self.data_mode:
+                self.send('NO CARRIER')
+                self.command_mode()
+        elif self.data_mode:
+            self.traffic(time.time())
+            self.write(data)
+
+    # Commands
+
+    def execute(self, line):
+        if self.args.verbose:
+            sys.stderr.write('AT  %s\n' % line)
+        if not line.upper().startswith('AT'):
+            self.send('ERROR')
+            return
+        for command in split_commands(line[2:]):
+            result = self.command(command)
+            if result is None:
+                # Final result already sent, e.g. CONNECT
+                return
+            if not result:
+                self.send('ERROR')
+                return
+        self.send('OK')
+
+    def command(self, command):
+        upper = command.upper()
+        if upper.startswith('+'):
+            match = re.match(r'\+(\w+)(=\?|\?|=)?(.*)$', command)
+            if not match:
+                return False
+            name, op, params = match.group(1).upper(), match.group(2) or '', match.group(3)
+            handler = getattr(self, 'at_' + name.lower(), None)
+            if handler:
+                return handler(op, parse_params(params))
+            return self.args.lenient
+        return self.basic(upper)
+
+    def basic(self, command):
+        while command:
+            if command.startswith('D'):
+                return self.dial(command[1:])
+            match = re.match(r'(&?[A-Z])(\d*)', command)
+            if not match:
+                return False
+            name, value = match.group(1), int(match.group(2) or 0)
+            command = command[match.end():]
+            if name == 'E':
+                self.echo = value == 1
+            elif name == 'H':
+                self.hang_up()
+            elif name == 'O':
+                if not self.call:
+                    self.send('NO CARRIER')
+                    return None
+                self.data_mode = True
+                self.send(CONNECT)
+                return None
+            elif name == 'Z':
+                self.echo = True
+            elif name not in ('V', 'Q', '&D', '&C', '&W', '&F', 'I'):
+                return False
+        return True
+
+    def dial(self, number):
+        match = re.match(r'\*99(?:\*\*\*(\d+))?#$', number)
+        cid = int(match.group(1) or 1) if match else 0
+        if not match or cid not in self.contexts or self.registration != REG_HOME:
+            self.send('NO CARRIER')
+            return None
+        self.call = True
+        self.data_mode = True
+        self.send(CONNECT)
+        if self.args.ppp and not self.ppp:
+            self.ppp = subprocess.Popen(shlex.split(self.args.ppp), stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        return None
+
+    def hang_up(self):
+        self.call = False
+        self.stop_ppp()
+
+    def stop_ppp(self):
+        if self.ppp:
+            self.ppp.terminate()
+            self.ppp.wait()
+            self.ppp = None
+
+    def at_cgmm(self, op, params):
+        self.send('SIMCOM_SIM7000E')
+        return True
+
+    def at_cgmr(self, op, params):
+        self.send('Revision:1351B04SIM7000E')
+        return True
+
+    def at_cgsn(self, op, params):
+        self.send(IMEI)
+        return True
+
+    at_gsn = at_cgsn
+
+    def at_cimi(self, op, params):
+        self.send(IMSI)
+        return True
+
+    def at_ccid(self, op, params):
+        self.send(ICCID)
+        return True
+
+    def at_csq(self, op, params):
+        self.send('+CSQ: %d,99' % (self.args.rssi if self.registration == REG_HOME else 99))
+        return True
+
+    def at_cbc(self, op, params):
+        self.send('+CBC: 0,85,3900')
+        return True
+
+    def at_ifc(self, op, params):
+        return True
+
+    def at_cops(self, op, params):
+        if op == '?':
+            if self.registration == REG_HOME:
+                self.send('+COPS: 0,0,"%s",%d' % (self.args.operator, 9 if self.lte_mode == 2 else 7))
+            else:
+                self.send('+COPS: 0')
+            return True
+        if op == '=':
+            self.set_registration(REG_SEARCHING)
+            self.attach_at = time.time() + self.attach_delay()
+            return True
+        return op == '=?'
+
+    def registration_query(self, name, op, params):
+        if op == '?':
+            self.send('+%s: %d,%s' % (name, self.urc[name], self.location(self.registration, self.urc[name] == 4)))
+            return True
+        if op == '=' and params and params[0] in ((0, 1, 2, 4) if name == 'CEREG' else (0, 1, 2)):
+            self.urc[name] = params[0]
+            return True
+        return op == '=?'
+
+    def at_creg(self, op, params):
+        return self.registration_query('CREG', op, params)
+
+    def at_cereg(self, op, params):
+        return self.registration_query('CEREG', op, params)
+
+    def at_cgreg(self, op, params):
+        return self.registration_query('CGREG', op, params)
+
+    def at_cpsms(self, op, params):
+        if op == '?':
+            self.send('+CPSMS: %d,,,"%s","%s"' % ((1,) + self.psm if self.psm else (0, '00000000', '00000000')))
+            return True
+        if op != '=' or not params or params[0] not in (0, 1):
+            return False
+        if params[0] == 1 and len(params) == 5 and all(is_bits(p, 8) for p in params[3:]):
+            self.psm = (params[3], params[4])
+        elif params[0] == 0:
+            self.psm = None
+        else:
+            return False
+        if self.registration == REG_HOME and self.urc['CEREG'] == 4:
+            # Tracking area update with the new request, accepted as is
+            self.send_urc('+CEREG: %s' % self.location(REG_HOME, True))
+        return True
+
+    def at_cpsmstatus(self, op, params):
+        if op == '=' and params and params[0] in (0, 1):
+            self.psm_urc = params[0] == 1
+            return True
+        return False
+
+    def at_cscon(self, op, params):
+        if op == '?':
+            self.send('+CSCON: %d,%d' % (self.cscon_urc, self.connected))
+            return True
+        if op == '=?':
+            self.send('+CSCON: (0,1)')
+            return True
+        if op == '=' and params and params[0] in (0, 1):
+            self.cscon_urc = params[0] == 1
+            return True
+        return False
+
+    def at_cnmpsd(self, op, params):
+        if op:
+            return op == '=?'
+        if self.connected:
+            # Released by the network shortly after, without waiting for the inactivity timer
+            self.release_at = time.time() + 0.2
+        return True
+
+    def at_cedrxs(self, op, params):
+        if op == '?':
+            if self.edrx:
+                self.send('+CEDRXS: %d,"%s"' % self.edrx)
+            return True
+        if op != '=' or not params or params[0] not in (0, 1, 2, 3):
+            return False
+        if params[0] in (1, 2) and len(params) == 3 and params[1] in (4, 5) and is_bits(params[2], 4):
+            self.edrx = (params[1], params[2])
+            if params[0] == 2:
+                self.send_urc('+CEDRXP: %d,"%s","%s","0011"' % (self.edrx + (self.edrx[1],)))
+        elif params[0] in (0, 3):
+            self.edrx = None
+        else:
+            return False
+        return True
+
+    def at_cedrxrdp(self, op, params):
+        if self.edrx and self.registration == REG_HOME:
+            self.send('+CEDRXRDP: %d,"%s","%s","0011"' % (self.edrx + (self.edrx[1],)))
+        else:
+            self.send('+CEDRXRDP: 0')
+        return True
+
+    def at_cgatt(self, op, params):
+        if op == '?':
+            self.send('+CGATT: %d' % (self.registration == REG_HOME))
+        return True
+
+    def at_cpsi(self, op, params):
+        if op != '?':
+            return False
+        if self.registration != REG_HOME:
+            self.send('+CPSI: NO SERVICE,Online')
+        elif self.network_mode == 13:
+            self.send('+CPSI: GSM,Online,460-11,0x1882,55133,71 EGSM 900,-64,2110,42-42')
+        elif self.lte_mode == 2:
+            self.send('+CPSI: LTE NB-IOT,Online,460-11,0x5A1E,187214780,257,EUTRAN-BAND%d,3736,0,0,-11,-103,-88,9'
+                      % self.args.band)
+        else:
+            self.send('+CPSI: LTE CAT-M1,Online,460-11,0x5A1E,187214780,257,EUTRAN-BAND%d,1350,5,5,-12,-111,-81,14'
+                      % self.args.band)
+        return True
+
+    def at_cnmp(self, op, params):
+        if op == '?':
+            self.send('+CNMP: %d' % self.network_mode)
+            return True
+        if op == '=' and params and params[0] in NETWORK_MODES:
+            if (params[0] == 13) != (self.network_mode == 13):
+                # GSM to LTE or back, registered again after a scan
+                self.network_mode = params[0]
+                self.set_registration(REG_SEARCHING)
+                self.attach_at = time.time() + self.attach_delay()
+            self.network_mode = params[0]
+            return True
+        return False
+
+    def at_cmnb(self, op, params):
+        if op == '?':
+            self.send('+CMNB: %d' % self.lte_mode)
+            return True
+        if op == '=' and params and params[0] in LTE_MODES:
+            if params[0] != 3 and params[0] != self.lte_mode:
+                # Another category, registered again after a scan
+                self.lte_mode = params[0]
+                self.set_registration(REG_SEARCHING)
+                self.attach_at = time.time() + self.attach_delay()
+            self.lte_mode = params[0] if params[0] != 3 else self.lte_mode
+            return True
+        return False
+
+    def at_cbandcfg(self, op, params):
+        if op == '?':
+            self.send('+CBANDCFG: "CAT-M",%d' % self.args.band)
+            self.send('+CBANDCFG: "NB-IOT",%d' % self.args.band)
+            return True
+        return op == '=' and len(params) >= 2 and params[0] in ('CAT-M', 'NB-IOT')
+
+    def at_cgdcont(self, op, params):
+        if op == '?':
+            for cid in sorted(self.contexts):
+                self.send('+CGDCONT: %d,"%s","%s","0.0.0.0",0,0,0,0' % ((cid,) + self.contexts[cid]))
+            return True
+        if op == '=' and params and isinstance(params[0], int) and 1 <= params[0] <= 24:
+            if len(params) == 1:
+                self.contexts.pop(params[0], None)
+            else:
+                self.contexts[params[0]] = (params[1], params[2] if len(params) > 2 else '')
+            return True
+        return False
+
+    def at_cfun(self, op, params):
+        if op == '?':
+            self.send('+CFUN: %d' % self.cfun)
+            return True
+        if op == '=' and params and params[0] in (0, 1, 4):
+            self.cfun = params[0]
+            if self.cfun != 1:
+                self.set_registration(REG_NOT_REGISTERED)
+            else:
+                self.attach_at = time.time() + self.attach_delay()
+            if len(params) > 1 and params[1] == 1:
+                self.power_on()
+            return True
+        return False
+
+    def at_cclk(self, op, params):
+        if op != '?':
+            return op == '='
+        # Reset value until set by the network, UTC with a zero zone offset in quarters of an hour
+        now = time.time() + (self.clock_offset if self.clock_offset is not None else CLOCK_RESET - self.boot_until)
+        self.send('+CCLK: "%s+00"' % time.strftime('%y/%m/%d,%H:%M:%S', time.gmtime(now)))
+        return True
+
+    def at_clts(self, op, params):
+        if op == '?':
+            self.send('+CLTS: %d' % self.clts)
+            return True
+        if op != '=' or not params or params[0] not in (0, 1):
+            return False
+        self.clts = params[0] == 1
+        return True
+
+    def network_time(self):
+        # Host time as network time, setting the clock of the module, reported with AT+CLTS=1
+        self.clock_offset = 0.0
+        if self.clts:
+            utc = time.gmtime()
+            self.send_urc('+CTZV: +00,0')
+            self.send_urc('*PSUTTZ: %d,%d,%d,%d,%d,%d,"+00",0' % utc[:6])
+            self.send_urc('DST: 0')
+
+    def at_cpowd(self, op, params):
+        self.send('NORMAL POWER DOWN')
+        # Off until powered on again, which the simulator does after the boot delay
+        self.power_on()
+        return None
+
+    def at_cnact(self, op, params):
+        if op == '?':
+            self.send('+CNACT: %d,"%s"' % (self.app_pdp, '10.64.64.2' if self.app_pdp else '0.0.0.0'))
+            return True
+        if op != '=' or not params or params[0] not in (0, 1):
+            return False
+        if params[0] == 1:
+            if self.app_pdp or self.registration != REG_HOME:
+                return False
+            self.app_pdp = True
+            self.send_urc_after('+APP PDP: ACTIVE')
+        else:
+            self.close_sockets()
+            self.app_pdp = False
+            self.send_urc_after('+APP PDP: DEACTIVE')
+            if self.mqtt_connected:
+                self.mqtt_connected = False
+                self.send_urc_after('+SMSTATE: 0')
+        return True
+
+    def at_caopen(self, op, params):
+        if op != '=' or len(params) != 4 or params[1] not in ('TCP', 'UDP') or not self.app_pdp or \
+                params[0] in self.sockets:
+            return False
+        cid, kind, host, port = params
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM if kind == 'TCP' else socket.SOCK_DGRAM)
+        sock.settimeout(10)
+        try:
+            sock.connect((host, port))
+        except OSError:
+            sock.close()
+            self.send('+CAOPEN: %d,1' % cid)
+            return True
+        sock.setblocking(False)
+        self.sockets[cid] = {'socket': sock, 'type': kind, 'rx': b'', 'closed': False}
+        self.traffic(time.time())
+        self.send('+CAOPEN: %d,0' % cid)
+        return True
+
+    def at_casend(self, op, params):
+        if op != '=' or len(params) < 2 or params[0] not in self.sockets or not 0 < params[1] <= 1460:
+            return False
+        # Payload taken as is, then the final result code
+        cid = params[0]
+        self.payload = (params[1], b'', lambda data: self.socket_send(cid, data))
+        self.write(b'>')
+        return None
+
+    def at_carecv(self, op, params):
+        if op != '=' or len(params) != 2 or params[0] not in self.sockets or not 0 < params[1] <= 1460:
+            return False
+        entry = self.sockets[params[0]]
+        data, entry['rx'] = entry['rx'][:params[1]], entry['rx'][params[1]:]
+        if data:
+            self.write(b'\r\n+CARECV: %d,' % len(data) + data + b'\r\n')
+        else:
+            self.send('+CARECV: 0')
+        return True
+
+    def at_caclose(self, op, params):
+        if op != '=' or not params or params[0] not in self.sockets:
+            return False
+        self.sockets.pop(params[0])['socket'].close()
+        return True
+
+    def at_smconf(self, op, params):
+        if op != '=' or len(params) < 2:
+            return False
+        self.mqtt_config[str(params[0]).upper()] = params[1:]
+        return True
+
+    def at_smconn(self, op, params):
+        if op or not self.app_pdp or 'URL' not in self.mqtt_config or self.mqtt_connected:
+            return False
+        if self.mqtt_config.get('CLEANSS', [1])[0]:
+            self.mqtt_topics = set()
+        self.mqtt_connected = True
+        self.traffic(time.time())
+        return True
+
+    def at_smstate(self, op, params):
+        if op != '?':
+            return False
+        self.send('+SMSTATE: %d' % self.mqtt_connected)
+        return True
+
+    def at_smsub(self, op, params):
+        if op != '=' or len(params) != 2 or not self.mqtt_connected:
+            return False
+        self.mqtt_topics.add(params[0])
+        self.traffic(time.time())
+        return True
+
+    def at_smunsub(self, op, params):
+        if op != '=' or len(params) != 1 or not self.mqtt_connected:
+            return False
+        self.mqtt_topics.discard(params[0])
+        self.traffic(time.time())
+        return True
+
+    def at_smpub(self, op, params):
+        if op != '=' or len(params) != 4 or not self.mqtt_connected or not 0 < params[1] <= 1024:
+            return False
+        topic = params[0]
+        self.payload = (params[1], b'', lambda data: self.mqtt_publish(topic, data))
+        self.write(b'>')
+        return None
+
+    def at_smdisc(self, op, params):
+        if op or not self.mqtt_connected:
+            return False
+        self.mqtt_connected = False
+        return True
+
+    def mqtt_publish(self, topic, data):
+        if not self.mqtt_connected:
+            return False
+        self.traffic(time.time())
+        if any(topic_matches(topic_filter, topic) for topic_filter in self.mqtt_topics):
+            # The loopback broker delivers it back, after the final result code of the publish
+            self.send_urc_after('+SMSUB: "%s","%s"' % (topic, data.decode(errors='replace')))
+        return True
+
+    def at_shconf(self, op, params):
+        if op != '=' or len(params) != 2:
+            return False
+        self.http_config[str(params[0]).upper()] = params[1]
+        return True
+
+    def at_shconn(self, op, params):
+        if op or not self.app_pdp or 'URL' not in self.http_config or self.http_connected:
+            return False
+        self.http_connected = True
+        self.traffic(time.time())
+        return True
+
+    def at_shdisc(self, op, params):
+        if op or not self.http_connected:
+            return False
+        self.http_connected = False
+        return True
+
+    def at_shchead(self, op, params):
+        self.http_headers = []
+        return not op
+
+    def at_shahead(self, op, params):
+        if op != '=' or len(params) != 2:
+            return False
+        self.http_headers.append((params[0], params[1]))
+        return True
+
+    def at_shreq(self, op, params):
+        if op != '=' or len(params) != 2 or params[1] != 1 or not self.http_connected:
+            return False
+        request = urllib.request.Request(self.http_config['URL'] + params[0], headers=dict(self.http_headers))
+        try:
+            with urllib.request.urlopen(request, timeout=30) as response:
+                status, self.http_body = response.status, response.read()
+        except urllib.error.HTTPError as e:
+            status, self.http_body = e.code, e.read()
+        except (urllib.error.URLError, OSError):
+            # Network error of the module
+            status, self.http_body = 601, b''
+        self.traffic(time.time())
+        self.send_urc_after('+SHREQ: "GET",%d,%d' % (status, len(self.http_body)))
+        return True
+
+    def at_shread(self, op, params):
+        if op != '=' or len(params) != 2 or not 0 < params[1] <= 2048 or \
+                params[0] + params[1] > len(self.http_body):
+            return False
+        data = self.http_body[params[0]:params[0] + params[1]]
+        self.send_urc_after(b'+SHREAD: %d\r\n' % len(data) + data)
+        return True
+
+    def at_cgnspwr(self, op, params):
+        if op == '?':
+            self.send('+CGNSPWR: %d' % self.gnss_on)
+            return True
+        if op != '=' or not params or params[0] not in (0, 1):
+            return False
+        if params[0] and not self.gnss_on:
+            # Cold start, shorter with valid assistance data
+            self.gnss_since = time.time()
+            self.gnss_ttff = self.args.xtra_ttff if self.xtra_valid_hours(self.gnss_since) else self.args.gnss_ttff
+            self.gnss_next = self.gnss_since + 1
+            self.gnss_count = 0
+        self.gnss_on = params[0] == 1
+        return True
+
+    def at_cgnsurc(self, op, params):
+        if op == '?':
+            self.send('+CGNSURC: %d' % self.gnss_urc)
+            return True
+        if op != '=' or not params or not 0 <= params[0] <= 255:
+            return False
+        self.gnss_urc = params[0]
+        return True
+
+    def at_cgnstst(self, op, params):
+        if op != '=' or not params or params[0] not in (0, 1):
+            return False
+        self.gnss_nmea = params[0] == 1
+        return True
+
+    def at_cgnsinf(self, op, params):
+        if op:
+            return False
+        self.send('+CGNSINF: %s' % self.gnss_nav_info(time.time()))
+        return True
+
+    def gnss_fixed(self, now):
+        return self.gnss_on and now - self.gnss_since >= self.gnss_ttff
+
+    def gnss_nav_info(self, now):
+        utc = time.strftime('%Y%m%d%H%M%S.000', time.gmtime(now))
+        if not self.gnss_fixed(now):
+            return '%d,0,%s,,,,,,0,,,,,,11,0,,,,,' % (self.gnss_on, utc)
+        latitude, longitude = self.args.gnss_position
+        return '1,1,%s,%.6f,%.6f,40.200,0.00,0.0,1,,1.1,1.4,0.9,,11,7,,,35,,' % (utc, latitude, longitude)
+
+    def gnss_nmea_sentences(self, now):
+        utc = time.gmtime(now)
+        hms = time.strftime('%H%M%S.00', utc)
+        if not self.gnss_fixed(now):
+            return [nmea('GPGGA,%s,,,,,0,00,,,M,,M,,' % hms), nmea('GPRMC,%s,V,,,,,,,%s,,,N' % (hms, time.strftime('%d%m%y', utc)))]
+        latitude, longitude = self.args.gnss_position
+        position = '%s,%s,%s,%s' % (nmea_coordinate(latitude, 2), 'N' if latitude >= 0 else 'S',
+                                    nmea_coordinate(longitude, 3), 'E' if longitude >= 0 else 'W')
+        return [nmea('GPGGA,%s,%s,1,07,1.1,40.2,M,0.0,M,,' % (hms, position)),
+                nmea('GPRMC,%s,A,%s,0.0,0.0,%s,,,A' % (hms, position, time.strftime('%d%m%y', utc)))]
+
+    def gnss_report(self, now):
+        # Once a second, the navigation information every gnss_urc fixes
+        self.gnss_next += 1
+        self.gnss_count += 1
+        if self.gnss_urc and self.gnss_count % self.gnss_urc == 0:
+            self.send_urc('+UGNSINF: %s' % self.gnss_nav_info(now))
+        if self.gnss_nmea:
+            for sentence in self.gnss_nmea_sentences(now):
+                self.send_urc(sentence)
+
+    def at_cfsinit(self, op, params):
+        if op or self.fs_init:
+            return False
+        self.fs_init = True
+        return True
+
+    def at_cfsterm(self, op, params):
+        if op or not self.fs_init:
+            return False
+        self.fs_init = False
+        return True
+
+    def at_cfswfile(self, op, params):
+        # <index>,<filename>,<mode>,<size>,<input time>, index 3 being /customer
+        if op != '=' or len(params) != 5 or not self.fs_init or params[0] != 3 or params[2] not in (0, 1) \
+                or not 0 < params[3] <= 10240:
+            return False
+        name, append = params[1], params[2] == 1
+
+        def write(data):
+            self.files[name] = (self.files.get(name, b'') if append else b'') + data
+            return True
+        self.payload = (params[3], b'', write)
+        self.send('DOWNLOAD')
+        return None
+
+    def at_cgnscpy(self, op, params):
+        if op or self.gnss_on:
+            return False
+        # The assistance file is taken whatever its content, valid from now
+        data = self.files.get('xtra3grc.bin')
+        if data:
+            self.xtra_loaded = time.time()
+        self.send('+CGNSCPY: %d' % (0 if data else 1))
+        return True
+
+    def at_cgnsxtra(self, op, params):
+        if op == '=':
+            if not params or params[0] not in (0, 1):
+                return False
+            self.xtra_enabled = params[0] == 1
+            return True
+        if op or self.xtra_loaded is None:
+            return False
+        now = time.time()
+        self.send('+CGNSXTRA: %.2f,%d,"%s"' % ((now - self.xtra_loaded) / 3600, self.args.xtra_validity,
+                                                time.strftime('%Y/%m/%d,%H:%M:%S', time.gmtime(self.xtra_loaded))))
+        return True
+
+    def xtra_valid_hours(self, now):
+        if not self.xtra_enabled or self.xtra_loaded is None:
+            return 0
+        return max(0, self.args.xtra_validity - (now - self.xtra_loaded) / 3600)
+
+    def at_cmux(self, op, params):
+        # The multiplexer is not simulated, the driver carries on without it
+        return False
+
+
+def split_quoted(line, separator):
+    """Split on separator outside of quotes"""
+    fields, current, quoted = [], '', False
+    for c in line:
+        if c == '"':
+            quoted = not quoted
+        if c == separator and not quoted:
+            fields.append(current)
+            current = ''
+        else:
+            current += c
+    fields.append(current)
+    return [f.strip() for f in fields]
+
+
+def split_commands(line):
+    """Split "AT+CSQ;+CBC;+CREG?" after "AT" into commands, quotes kept whole"""
+    commands = split_quoted(line, ';')
+    return commands if commands[-1] or len(commands) == 1 else commands[:-1]
+
+
+def parse_params(params):
+    """Parameters of a command, empty ones kept as '' so that positions hold"""
+    values = []
+    if not params:
+        return values
+    for value in split_quoted(params, ','):
+        if value.startswith('"'):
+            values.append(value.strip('"'))
+        else:
+            try:
+                values.append(int(value))
+            except ValueError:
+                values.append(value)
+    return values
+
+
+def topic_matches(topic_filter, topic):
+    """Whether an MQTT topic filter, with + and # wildcards, matches a topic"""
+    filter_levels, levels = topic_filter.split('/'), topic.split('/')
+    for i, level in enumerate(filter_levels):
+        if level == '#':
+            return True
+        if i >= len(levels) or (level != '+' and level != levels[i]):
+            return False
+    return len(filter_levels) == len(levels)
+
+
+def nmea(body):
+    """NMEA sentence with its checksum"""
+    checksum = 0
+    for c in body:
+        checksum ^= ord(c)
+    return '$%s*%02X' % (body, checksum)
+
+
+def nmea_coordinate(value, degree_digits):
+    """Degrees to NMEA ddmm.mmmmmm, dddmm.mmmmmm for a longitude"""
+    value = abs(value)
+    degrees = int(value)
+    return '%0*d%09.6f' % (degree_digits, degrees, (value - degrees) * 60)
+
+
+def position(text):
+    latitude, longitude = (float(v) for v in text.split(','))
+    return latitude, longitude
+
+
+def is_bits(value, length):
+    return isinstance(value, str) and len(value) == length and set(value) <= set('01')
+
+
+def timer_seconds(bits, units):
+    """Duration of a 3GPP timer octet, e.g. "00100001" for one hour"""
+    octet = int(bits, 2)
+    return units.get(octet >> 5, 60) * (octet & 0x1f)
+
+
+def open_port(port, baud):
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, 'B%d' % baud)
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Simulate the AT interface of a SIM7000')
+    parser.add_argument('--port', help='serial port to answer on, a pseudo terminal is created otherwise')
+    parser.add_argument('--baud', type=int, default=115200, help='baud rate of --port (default: 115200)')
+    parser.add_argument('--link', help='symlink to the pseudo terminal')
+    parser.add_argument('--boot-delay', type=float, default=2.0, help='power on to AT answered, unit: s (default: 2)')
+    parser.add_argument('--attach-delay', type=float, default=3.0, help='boot to registered, unit: s (default: 3)')
+    parser.add_argument('--nb-iot', action='store_true', help='register on NB-IoT rather than LTE-M')
+    parser.add_argument('--nb-iot-attach-delay', type=float, help='attach delay on NB-IoT (default: --attach-delay)')
+    parser.add_argument('--gsm-attach-delay', type=float, help='attach delay on GSM (default: --attach-delay)')
+    parser.add_argument('--band', type=int, default=20, help='serving E-UTRAN band (default: 20)')
+    parser.add_argument('--rssi', type=int, default=20, help='AT+CSQ signal strength (default: 20)')
+    parser.add_argument('--operator', default='Carrier', help='operator name (default: Carrier)')
+    parser.add_argument('--inactivity', type=float, default=10.0,
+                        help='network inactivity timer, connected to idle, unit: s (default: 10)')
+    parser.add_argument('--guard', type=float, default=1.0, help='escape sequence guard time, unit: s (default: 1)')
+    parser.add_argument('--gnss-ttff', type=float, default=30.0,
+                        help='GNSS power on to first fix, unit: s (default: 30)')
+    parser.add_argument('--gnss-position', type=position, default=(31.221783, 121.354338),
+                        help='GNSS position, "latitude,longitude" in degrees (default: 31.221783,121.354338)')
+    parser.add_argument('--xtra-ttff', type=float, default=5.0,
+                        help='GNSS power on to first fix with valid assistance data, unit: s (default: 5)')
+    parser.add_argument('--xtra-validity', type=int, default=72,
+                        help='assistance data validity from its loading, unit: h (default: 72)')
+    parser.add_argument('--no-nitz', action='store_true', help='no network time on registration, AT+CCLK? stays unset')
+    parser.add_argument('--ppp', metavar='COMMAND', help='PPP peer on stdin/stdout run in data mode, e.g. pppd notty')
+    parser.add_argument('--quiet-boot', action='store_true', help='no RDY and other boot URCs, as with auto-baud')
+    parser.add_argument('--lenient', action='store_true', help='answer OK to unknown extended commands')
+    parser.add_argument('-v', '--verbose', action='store_true', help='log commands and URCs on stderr')
+    args = parser.parse_args()
+
+    if args.port:
+        fd = open_port(args.port, args.baud)
+    else:
+        fd, slave = os.openpty()
+        tty.setraw(slave)
+        name = os.ttyname(slave)
+        if args.link:
+            if os.path.lexists(args.link):
+                os.remove(args.link)
+            os.symlink(name, args.link)
+        print('SIM7000 simulator on %s' % (args.link or name))
+        sys.stdout.flush()
+
+    modem = Sim7000(args, lambda data: os.write(fd, data))
+    try:
+        while True:
+            inputs = [fd] + ([modem.ppp.stdout] if modem.ppp else []) + modem.socket_inputs()
+            ready, _, _ = select.select(inputs, [], [], 0.05)
+            if fd in ready:
+                try:
+                    modem.receive(os.read(fd, 4096))
+                except OSError:
+                    # Pseudo terminal not opened yet, or closed by the other side
+                    time.sleep(0.1)
+            if modem.ppp and modem.ppp.stdout in ready:
+                modem.ppp_output()
+            modem.socket_output(ready)
+            modem.tick()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        modem.stop_ppp()
+        modem.close_sockets()
+        if args.link and os.path.islink(args.link):
+            os.remove(args.link)
+
+
+if __name__ == '__main__':
+    main()